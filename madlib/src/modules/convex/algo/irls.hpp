@@ -0,0 +1,128 @@
+/* ----------------------------------------------------------------------- *//**
+ *
+ * @file irls.hpp
+ *
+ * Generic implementaion of iteratively reweighted least squares, in the
+ * fashion of user-definied aggregates. They should be called by actually
+ * database functions, after arguments are properly parsed.
+ *
+ *//* ----------------------------------------------------------------------- */
+
+#include <dbconnector/dbconnector.hpp>
+
+#ifndef MADLIB_MODULES_CONVEX_ALGO_IRLS_HPP_
+#define MADLIB_MODULES_CONVEX_ALGO_IRLS_HPP_
+
+#include <cmath>
+
+namespace madlib {
+
+namespace modules {
+
+namespace convex {
+
+// use Eigen
+using namespace madlib::dbal::eigen_integration;
+
+// IRLS is Newton's method (Fisher scoring for non-canonical links) with the
+// Hessian X'WX. Instead of a rank-1 update of X'WX per row, the rows
+// sqrt(w_i) * x_i are buffered in State::algo.block and added blockSize at a
+// time with one symmetric rank-k update, which keeps the Hessian in cache.
+// Only the lower triangle of the Hessian is maintained.
+template <class State, class ConstState, class Task>
+class IRLS {
+public:
+    typedef State state_type;
+    typedef ConstState const_state_type;
+    typedef typename Task::tuple_type tuple_type;
+    typedef typename Task::model_type model_type;
+
+    static void transition(state_type &state, const tuple_type &tuple);
+    static void merge(state_type &state, const_state_type &otherState);
+    static void final(state_type &state);
+
+private:
+    static void flush(state_type &state);
+};
+
+template <class State, class ConstState, class Task>
+void
+IRLS<State, ConstState, Task>::transition(state_type &state,
+        const tuple_type &tuple) {
+    bool initial = (state.task.numIterations == 0);
+    double weight, score;
+    Task::irls(
+            state.task.model,
+            tuple.indVar,
+            tuple.depVar,
+            state.task.power,
+            initial,
+            weight,
+            score);
+
+    // gradient of the loss, the final step subtracts H^{-1} g
+    state.algo.gradient -= score * tuple.indVar;
+
+    uint16_t col = state.algo.numBuffered;
+    state.algo.block.col(col) = std::sqrt(weight) * tuple.indVar;
+    state.algo.numBuffered = col + 1;
+    if (col + 1 == State::blockSize) { flush(state); }
+
+    // there is no model to evaluate in the first iteration
+    if (!initial) {
+        state.algo.loss += Task::loss(
+                state.task.model,
+                tuple.indVar,
+                tuple.depVar,
+                state.task.power);
+    }
+}
+
+template <class State, class ConstState, class Task>
+void
+IRLS<State, ConstState, Task>::flush(state_type &state) {
+    uint16_t n = state.algo.numBuffered;
+    if (n == 0) { return; }
+
+    state.algo.hessian.template selfadjointView<Eigen::Lower>().rankUpdate(
+            state.algo.block.leftCols(n));
+    state.algo.numBuffered = 0;
+}
+
+template <class State, class ConstState, class Task>
+void
+IRLS<State, ConstState, Task>::merge(state_type &state,
+        const_state_type &otherState) {
+    flush(state);
+
+    state.algo.gradient += otherState.algo.gradient;
+    state.algo.hessian.template triangularView<Eigen::Lower>() +=
+        otherState.algo.hessian;
+    uint16_t n = otherState.algo.numBuffered;
+    if (n > 0) {
+        state.algo.hessian.template selfadjointView<Eigen::Lower>().rankUpdate(
+                otherState.algo.block.leftCols(n));
+    }
+    state.algo.loss += otherState.algo.loss;
+}
+
+template <class State, class ConstState, class Task>
+void
+IRLS<State, ConstState, Task>::final(state_type &state) {
+    flush(state);
+
+    // w_{k+1} = w_k - H_k^{-1} g_k, see newton.hpp
+    state.algo.gradient = state.algo.hessian.template
+        selfadjointView<Eigen::Lower>().ldlt().solve(state.algo.gradient);
+    state.task.model -= state.algo.gradient;
+    state.task.numIterations ++;
+}
+
+} // namespace convex
+
+} // namespace modules
+
+} // namespace madlib
+
+#endif
+
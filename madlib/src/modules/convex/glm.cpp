@@ -0,0 +1,224 @@
+/* ----------------------------------------------------------------------- *//**
+ *
+ * @file glm.cpp
+ *
+ * @brief Generalized linear models (Poisson, Gamma, Tweedie) fitted by IRLS
+ *
+ *//* ----------------------------------------------------------------------- */
+
+#include <dbconnector/dbconnector.hpp>
+#include <modules/shared/HandleTraits.hpp>
+
+#include "glm.hpp"
+
+#include "task/glm.hpp"
+#include "algo/irls.hpp"
+
+#include "type/tuple.hpp"
+#include "type/model.hpp"
+#include "type/state.hpp"
+
+namespace madlib {
+
+namespace modules {
+
+namespace convex {
+
+typedef GLMNewtonState<MutableArrayHandle<double> > GLMState;
+typedef GLMNewtonState<ArrayHandle<double> > GLMConstState;
+
+template <class Family, class Link>
+struct GLMIRLS {
+    typedef IRLS<GLMState, GLMConstState,
+            GLM<GLMModel, GLMTuple, Family, Link> > Algorithm;
+};
+
+// Merge and final only touch the accumulated sums, which do not depend on
+// the family or the link
+typedef GLMIRLS<GLMPoisson, GLMLogLink>::Algorithm GLMIRLSAlgorithm;
+
+template <class Family, class Link>
+static void
+glm_irls_step(GLMState &state, const GLMTuple &tuple) {
+    if (!Family::validResponse(tuple.depVar)) {
+        throw std::runtime_error("Invalid response: the dependent variable "
+                "is out of the domain of the family");
+    }
+    GLMIRLS<Family, Link>::Algorithm::transition(state, tuple);
+}
+
+template <class Link>
+static void
+glm_irls_dispatch(GLMState &state, const GLMTuple &tuple) {
+    switch (static_cast<uint16_t>(state.task.family)) {
+        case GLM_POISSON: glm_irls_step<GLMPoisson, Link>(state, tuple); break;
+        case GLM_GAMMA: glm_irls_step<GLMGamma, Link>(state, tuple); break;
+        default: glm_irls_step<GLMTweedie, Link>(state, tuple); break;
+    }
+}
+
+/**
+ * @brief Perform the generalized linear model transition step
+ *
+ * Called for each tuple. Arguments: state, ind_var, dep_var,
+ * previous_state, family (1: Poisson, 2: Gamma, 3: Tweedie),
+ * link (1: log, 2: identity), power (Tweedie variance power).
+ */
+AnyType
+glm_newton_transition::run(AnyType &args) {
+    // The real state.
+    // For the first tuple: args[0] is nothing more than a marker that
+    // indicates that we should do some initial operations.
+    // For other tuples: args[0] holds the computation state until last tuple
+    GLMState state = args[0];
+
+    // initilize the state if first tuple
+    if (state.algo.numRows == 0) {
+        if (!args[3].isNull()) {
+            GLMConstState previousState = args[3];
+            state.allocate(*this, previousState.task.dimension);
+            state = previousState;
+        } else {
+            // configuration parameters
+            uint16_t dimension = args[1].getAs<MappedColumnVector>().size();
+            if (dimension == 0) {
+                throw std::runtime_error("Invalid parameter: dimension = 0");
+            }
+            uint16_t family = args[4].getAs<uint16_t>();
+            if (family < GLM_POISSON || family > GLM_TWEEDIE) {
+                throw std::runtime_error("Invalid parameter: unknown family");
+            }
+            uint16_t link = args[5].getAs<uint16_t>();
+            if (link != GLM_LOG_LINK && link != GLM_IDENTITY_LINK) {
+                throw std::runtime_error("Invalid parameter: unknown link");
+            }
+            double power = args[6].getAs<double>();
+            if (family == GLM_TWEEDIE && (power <= 1. || power >= 2.)) {
+                throw std::runtime_error("Invalid parameter: power must be "
+                        "in (1, 2) for the Tweedie family");
+            }
+
+            state.allocate(*this, dimension);
+            state.task.family = family;
+            state.task.link = link;
+            state.task.power = power;
+        }
+        // resetting in either case
+        state.reset();
+    }
+
+    // tuple
+    MappedColumnVector x = args[1].getAs<MappedColumnVector>();
+    if (x.size() != state.task.dimension) {
+        throw std::runtime_error("Inconsistent dimensions of the "
+                "independent variables");
+    }
+    GLMTuple tuple;
+    tuple.indVar.rebind(x.memoryHandle(), x.size());
+    tuple.depVar = args[2].getAs<double>();
+
+    // Now do the transition step
+    if (state.task.link == GLM_LOG_LINK) {
+        glm_irls_dispatch<GLMLogLink>(state, tuple);
+    } else {
+        glm_irls_dispatch<GLMIdentityLink>(state, tuple);
+    }
+    state.algo.numRows ++;
+
+    return state;
+}
+
+/**
+ * @brief Perform the perliminary aggregation function: Merge transition states
+ */
+AnyType
+glm_newton_merge::run(AnyType &args) {
+    GLMState stateLeft = args[0];
+    GLMConstState stateRight = args[1];
+
+    // We first handle the trivial case where this function is called with one
+    // of the states being the initial state
+    if (stateLeft.algo.numRows == 0) { return stateRight; }
+    else if (stateRight.algo.numRows == 0) { return stateLeft; }
+
+    // Merge states together
+    GLMIRLSAlgorithm::merge(stateLeft, stateRight);
+    stateLeft.algo.numRows += stateRight.algo.numRows;
+
+    return stateLeft;
+}
+
+/**
+ * @brief Perform the generalized linear model final step
+ */
+AnyType
+glm_newton_final::run(AnyType &args) {
+    // We request a mutable object. Depending on the backend, this might perform
+    // a deep copy.
+    GLMState state = args[0];
+
+    // Aggregates that haven't seen any data just return Null.
+    if (state.algo.numRows == 0) { return Null(); }
+
+    // finalizing
+    GLMIRLSAlgorithm::final(state);
+
+    return state;
+}
+
+/**
+ * @brief Return the relative difference in deviance between two states
+ *
+ * The deviance of a state is the one of the model it started from, so it
+ * is only known from the second iteration on.
+ */
+AnyType
+internal_glm_newton_distance::run(AnyType &args) {
+    GLMConstState stateLeft = args[0];
+    GLMConstState stateRight = args[1];
+
+    double left = stateLeft.algo.loss;
+    double right = stateRight.algo.loss;
+    return std::abs(left - right) / (std::abs(right) + 0.1);
+}
+
+/**
+ * @brief Return the coefficients and diagnostic statistics of the state
+ */
+AnyType
+internal_glm_newton_result::run(AnyType &args) {
+    GLMConstState state = args[0];
+
+    AnyType tuple;
+    tuple << state.task.model
+        << static_cast<double>(state.algo.loss)
+        << static_cast<uint64_t>(state.algo.numRows)
+        << static_cast<uint32_t>(state.task.numIterations);
+
+    return tuple;
+}
+
+/**
+ * @brief Predict the mean response: args are coef, ind_var, link
+ */
+AnyType
+glm_predict::run(AnyType &args) {
+    MappedColumnVector coef = args[0].getAs<MappedColumnVector>();
+    MappedColumnVector x = args[1].getAs<MappedColumnVector>();
+    uint16_t link = args[2].getAs<uint16_t>();
+    if (coef.size() != x.size()) {
+        throw std::runtime_error("Coefficients and independent variables "
+                "are of incompatible length");
+    }
+
+    double eta = dot(coef, x);
+    return link == GLM_LOG_LINK ? GLMLogLink::mean(eta)
+        : GLMIdentityLink::mean(eta);
+}
+
+} // namespace convex
+
+} // namespace modules
+
+} // namespace madlib
+
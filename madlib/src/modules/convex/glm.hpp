@@ -0,0 +1,38 @@
+/* ----------------------------------------------------------------------- *//**
+ *
+ * @file glm.hpp
+ *
+ *//* ----------------------------------------------------------------------- */
+
+/**
+ * @brief Generalized linear models (IRLS): Transition function
+ */
+DECLARE_UDF(convex, glm_newton_transition)
+
+/**
+ * @brief Generalized linear models (IRLS): State merge function
+ */
+DECLARE_UDF(convex, glm_newton_merge)
+
+/**
+ * @brief Generalized linear models (IRLS): Final function
+ */
+DECLARE_UDF(convex, glm_newton_final)
+
+/**
+ * @brief Generalized linear models (IRLS): Relative difference in deviance
+ *     between two transition states
+ */
+DECLARE_UDF(convex, internal_glm_newton_distance)
+
+/**
+ * @brief Generalized linear models (IRLS): Convert transition state to
+ *     result tuple
+ */
+DECLARE_UDF(convex, internal_glm_newton_result)
+
+/**
+ * @brief Generalized linear models: Predict the mean of the response
+ */
+DECLARE_UDF(convex, glm_predict)
+
@@ -0,0 +1,182 @@
+/* ----------------------------------------------------------------------- *//**
+ *
+ * @file glm.hpp
+ *
+ * Exponential-family generalized linear models (Poisson, Gamma, Tweedie)
+ * fitted by iteratively reweighted least squares.
+ *
+ *//* ----------------------------------------------------------------------- */
+
+#ifndef MADLIB_MODULES_CONVEX_TASK_GLM_HPP_
+#define MADLIB_MODULES_CONVEX_TASK_GLM_HPP_
+
+#include <dbconnector/dbconnector.hpp>
+#include <cmath>
+#include <limits>
+
+namespace madlib {
+
+namespace modules {
+
+namespace convex {
+
+// Use Eigen
+using namespace madlib::dbal::eigen_integration;
+
+/**
+ * @brief Codes of the families and links, as stored in GLMNewtonState
+ */
+enum { GLM_POISSON = 1, GLM_GAMMA = 2, GLM_TWEEDIE = 3 };
+enum { GLM_LOG_LINK = 1, GLM_IDENTITY_LINK = 2 };
+
+// The identity link can produce non-positive means, which none of the
+// families admit; they are clamped to this value
+const double kGLMMinMean = 1e-10;
+
+struct GLMLogLink {
+    static double mean(double eta) { return std::exp(eta); }
+    static double link(double mu) { return std::log(mu); }
+    // d mu / d eta
+    static double meanDerivative(double /* eta */, double mu) { return mu; }
+};
+
+struct GLMIdentityLink {
+    static double mean(double eta) { return eta; }
+    static double link(double mu) { return mu; }
+    static double meanDerivative(double /* eta */, double /* mu */) {
+        return 1.;
+    }
+};
+
+struct GLMPoisson {
+    static bool validResponse(double y) { return y >= 0.; }
+    static double start(double y) { return y + 0.1; }
+    static double variance(double mu, double /* power */) { return mu; }
+    static double deviance(double y, double mu, double /* power */) {
+        double d = mu - y;
+        if (y > 0.) { d += y * std::log(y / mu); }
+        return 2. * d;
+    }
+};
+
+struct GLMGamma {
+    static bool validResponse(double y) { return y > 0.; }
+    static double start(double y) { return y; }
+    static double variance(double mu, double /* power */) { return mu * mu; }
+    static double deviance(double y, double mu, double /* power */) {
+        return 2. * ((y - mu) / mu - std::log(y / mu));
+    }
+};
+
+/**
+ * Tweedie family with variance mu^power. Only 1 < power < 2 (compound
+ * Poisson-Gamma, the usual choice for insurance losses) is accepted by
+ * the aggregate, so exact zeros are valid responses.
+ */
+struct GLMTweedie {
+    static bool validResponse(double y) { return y >= 0.; }
+    static double start(double y) { return y + 0.1; }
+    static double variance(double mu, double power) {
+        return std::pow(mu, power);
+    }
+    static double deviance(double y, double mu, double power) {
+        double d = std::pow(mu, 2. - power) / (2. - power)
+            - y * std::pow(mu, 1. - power) / (1. - power);
+        if (y > 0.) {
+            d += std::pow(y, 2. - power) / ((1. - power) * (2. - power));
+        }
+        return 2. * d;
+    }
+};
+
+template <class Model, class Tuple, class Family, class Link>
+class GLM {
+public:
+    typedef Model model_type;
+    typedef Tuple tuple_type;
+    typedef typename Tuple::independent_variables_type
+        independent_variables_type;
+    typedef typename Tuple::dependent_variable_type dependent_variable_type;
+
+    static bool validResponse(const dependent_variable_type &y) {
+        return Family::validResponse(y);
+    }
+
+    static void irls(
+            const model_type                    &model,
+            const independent_variables_type    &x,
+            const dependent_variable_type       &y,
+            const double                        &power,
+            bool                                initial,
+            double                              &weight,
+            double                              &score);
+
+    static double loss(
+            const model_type                    &model,
+            const independent_variables_type    &x,
+            const dependent_variable_type       &y,
+            const double                        &power);
+
+    static dependent_variable_type predict(
+            const model_type                    &model,
+            const independent_variables_type    &x);
+};
+
+/**
+ * @brief IRLS weight and score of one row
+ *
+ * With z = eta + (y - mu) / mu'(eta) the working response, the row adds
+ * weight * x * x' to X'WX and score * x to X'W(z - X * model), where
+ * weight = mu'(eta)^2 / V(mu). The first iteration has no model yet and
+ * starts from the family's mean estimate of y instead.
+ */
+template <class Model, class Tuple, class Family, class Link>
+void
+GLM<Model, Tuple, Family, Link>::irls(
+        const model_type                    &model,
+        const independent_variables_type    &x,
+        const dependent_variable_type       &y,
+        const double                        &power,
+        bool                                initial,
+        double                              &weight,
+        double                              &score)
+{
+    double xb = initial ? 0. : dot(model, x);
+    double mu = initial ? Family::start(y) : Link::mean(xb);
+    mu = std::max(mu, kGLMMinMean);
+    double eta = initial ? Link::link(mu) : xb;
+    double dmu = Link::meanDerivative(eta, mu);
+    double variance = Family::variance(mu, power);
+
+    weight = dmu * dmu / variance;
+    score = weight * (eta - xb) + dmu * (y - mu) / variance;
+}
+
+template <class Model, class Tuple, class Family, class Link>
+double
+GLM<Model, Tuple, Family, Link>::loss(
+        const model_type                    &model,
+        const independent_variables_type    &x,
+        const dependent_variable_type       &y,
+        const double                        &power)
+{
+    double mu = std::max(Link::mean(dot(model, x)), kGLMMinMean);
+    return Family::deviance(y, mu, power);
+}
+
+template <class Model, class Tuple, class Family, class Link>
+typename Tuple::dependent_variable_type
+GLM<Model, Tuple, Family, Link>::predict(
+        const model_type                    &model,
+        const independent_variables_type    &x) {
+    return Link::mean(dot(model, x));
+}
+
+} // namespace convex
+
+} // namespace modules
+
+} // namespace madlib
+
+#endif
+
@@ -540,8 +540,13 @@ public:
  * exposed as a single DOUBLE PRECISION array, to the C++ code it is a proper
  * object containing scalars and vectors.
  *
+ * Generalized linear models fitted by IRLS keep their family, link and
+ * (Tweedie) variance power in the inter-iteration fields. The Hessian is not
+ * updated one row at a time: weighted rows are buffered in a block of
+ * blockSize columns and added with a single rank-k update (see irls.hpp).
+ *
  * Note: We assume that the DOUBLE PRECISION array is initialized by the
- * database with length at least 5, and at least first elemenet is 0
+ * database with length at least 8, and at least first elemenet is 0
  * (exact values of other elements are ignored).
  *
  */
@@ -551,6 +556,11 @@ class GLMNewtonState {
     friend class GLMNewtonState;
 
 public:
+    /**
+     * @brief Number of rows buffered before they are added to the Hessian
+     */
+    static const uint16_t blockSize = 32;
+
     GLMNewtonState(const AnyType &inArray) : mStorage(inArray.getAs<Handle>()) {
         rebind();
     }
@@ -596,12 +606,13 @@ public:
     inline void reset() {
         algo.numRows = 0;
         algo.loss = 0.;
+        algo.numBuffered = 0;
         algo.gradient = ColumnVector::Zero(task.dimension);
         algo.hessian = Matrix::Zero(task.dimension, task.dimension);
     }
 
     static inline uint32_t arraySize(const uint16_t inDimension) {
-        return 3 + (inDimension + 2) * inDimension;
+        return 8 + (inDimension + 2 + blockSize) * inDimension;
     }
 
 private:
@@ -611,23 +622,36 @@ private:
      * Array layout (iteration refers to one aggregate-function call):
      * Inter-iteration components (updated in final function):
      * - 0: dimension (dimension of the model)
-     * - 1: model (coefficients)
+     * - 1: family (GLM family, see task/glm.hpp)
+     * - 2: link (GLM link function, see task/glm.hpp)
+     * - 3: power (variance power of the Tweedie family)
+     * - 4: numIterations (number of final function calls so far)
+     * - 5: model (coefficients)
      *
      * Intra-iteration components (updated in transition step):
-     * - 1 + dimension: numRows (number of rows processed in this iteration)
-     * - 2 + dimension: loss (sum of loss for each rows)
-     * - 3 + dimension: gradient (volatile gradient for update)
-     * - 3 + 2 * dimension: hessian (volatile hessian for update)
+     * - 5 + dimension: numRows (number of rows processed in this iteration)
+     * - 6 + dimension: loss (sum of loss for each rows)
+     * - 7 + dimension: numBuffered (rows in the block not yet in the hessian)
+     * - 8 + dimension: gradient (volatile gradient for update)
+     * - 8 + 2 * dimension: hessian (volatile hessian for update)
+     * - 8 + (2 + dimension) * dimension: block (weighted rows, one per column)
      */
     void rebind() {
         task.dimension.rebind(&mStorage[0]);
-        task.model.rebind(&mStorage[1], task.dimension);
-
-        algo.numRows.rebind(&mStorage[1 + task.dimension]);
-        algo.loss.rebind(&mStorage[2 + task.dimension]);
-        algo.gradient.rebind(&mStorage[3 + task.dimension], task.dimension);
-        algo.hessian.rebind(&mStorage[3 + 2 * task.dimension], task.dimension,
+        task.family.rebind(&mStorage[1]);
+        task.link.rebind(&mStorage[2]);
+        task.power.rebind(&mStorage[3]);
+        task.numIterations.rebind(&mStorage[4]);
+        task.model.rebind(&mStorage[5], task.dimension);
+
+        algo.numRows.rebind(&mStorage[5 + task.dimension]);
+        algo.loss.rebind(&mStorage[6 + task.dimension]);
+        algo.numBuffered.rebind(&mStorage[7 + task.dimension]);
+        algo.gradient.rebind(&mStorage[8 + task.dimension], task.dimension);
+        algo.hessian.rebind(&mStorage[8 + 2 * task.dimension], task.dimension,
                 task.dimension);
+        algo.block.rebind(&mStorage[8 + (2 + task.dimension) * task.dimension],
+                task.dimension, blockSize);
     }
 
     Handle mStorage;
@@ -635,14 +659,20 @@ private:
 public:
     struct TaskState {
         typename HandleTraits<Handle>::ReferenceToUInt16 dimension;
+        typename HandleTraits<Handle>::ReferenceToUInt16 family;
+        typename HandleTraits<Handle>::ReferenceToUInt16 link;
+        typename HandleTraits<Handle>::ReferenceToDouble power;
+        typename HandleTraits<Handle>::ReferenceToUInt32 numIterations;
         typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap model;
     } task;
 
     struct AlgoState {
         typename HandleTraits<Handle>::ReferenceToUInt64 numRows;
         typename HandleTraits<Handle>::ReferenceToDouble loss;
+        typename HandleTraits<Handle>::ReferenceToUInt16 numBuffered;
         typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap gradient;
         typename HandleTraits<Handle>::MatrixTransparentHandleMap hessian;
+        typename HandleTraits<Handle>::MatrixTransparentHandleMap block;
     } algo;
 };
 
@@ -119,11 +119,11 @@ public:
 
     static const int m=7;// The number of corrections used in the LBFGS update.
 
-private:
     static inline uint32_t arraySize(const uint32_t num_features) {
         return 52 + 3 * num_features + num_features*(2*m+1)+2*m;
     }
 
+private:
     void rebind(uint32_t inWidthOfFeature) {
         iteration.rebind(&mStorage[0]);
         num_features.rebind(&mStorage[1]);
@@ -160,6 +160,89 @@ public:
     typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap mcsrch_state;
 };
 
+/**
+ * @brief Per-pass state of the linear-chain crf gradient aggregate
+ *
+ * Only the fields that operator+= of LinCrfLBFGSTransitionState merges: the
+ * gradient, the log-likelihood and the number of rows, 4 + num_features
+ * doubles instead of about 18 * num_features. The coefficients are an
+ * argument of the aggregate, and the L-BFGS history (ws, diag, lbfgs_state,
+ * mcsrch_state) stays in the LinCrfLBFGSTransitionState updated once per
+ * iteration by lincrf_lbfgs_step_update.
+ *
+ * Note: We assume that the DOUBLE PRECISION array is initialized by the
+ * database with length at least 4, and all elements are 0.
+ */
+template <class Handle>
+class LinCrfLBFGSGradientState {
+    template <class OtherHandle>
+    friend class LinCrfLBFGSGradientState;
+
+public:
+    LinCrfLBFGSGradientState(const AnyType &inArray)
+        : mStorage(inArray.getAs<Handle>()) {
+
+        rebind(static_cast<uint32_t>(mStorage[0]));
+    }
+
+    /**
+     * @brief Convert to backend representation
+     */
+    inline operator AnyType() const {
+        return mStorage;
+    }
+
+    /**
+     * @brief Initialize the gradient state.
+     *
+     * This function is only called for the first row.
+     */
+    inline void initialize(const Allocator &inAllocator, uint32_t inWidthOfX,
+                            uint32_t tagSize) {
+        mStorage = inAllocator.allocateArray<double, dbal::AggregateContext,
+        dbal::DoZero, dbal::ThrowBadAlloc>(arraySize(inWidthOfX));
+        rebind(inWidthOfX);
+        num_features = inWidthOfX;
+        num_labels =  tagSize;
+    }
+
+    /**
+     * @brief Merge with another State object
+     */
+    template <class OtherHandle>
+    LinCrfLBFGSGradientState &operator+=(
+        const LinCrfLBFGSGradientState<OtherHandle> &inOtherState) {
+        if (mStorage.size() != inOtherState.mStorage.size())
+            throw std::logic_error("Internal error: Incompatible transition "
+                                   "states");
+        numRows += inOtherState.numRows;
+        grad += inOtherState.grad;
+        loglikelihood += inOtherState.loglikelihood;
+        return *this;
+    }
+
+private:
+    static inline uint32_t arraySize(const uint32_t num_features) {
+        return 4 + num_features;
+    }
+
+    void rebind(uint32_t inWidthOfFeature) {
+        num_features.rebind(&mStorage[0]);
+        num_labels.rebind(&mStorage[1]);
+        numRows.rebind(&mStorage[2]);
+        loglikelihood.rebind(&mStorage[3]);
+        grad.rebind(&mStorage[4], inWidthOfFeature);
+    }
+    Handle mStorage;
+
+public:
+    typename HandleTraits<Handle>::ReferenceToUInt32 num_features;
+    typename HandleTraits<Handle>::ReferenceToUInt32 num_labels;
+    typename HandleTraits<Handle>::ReferenceToUInt64 numRows;
+    typename HandleTraits<Handle>::ReferenceToDouble loglikelihood;
+    typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap grad;
+};
+
 
 /** This class contains code for the limited-memory Broyden-Fletcher-Goldfarb-Shanno
  * (LBFGS) algorithm for large-scale multidimensional unconstrained minimization problems.
@@ -700,8 +783,12 @@ Eigen::VectorXd mult(Eigen::MatrixXd Mi, Eigen::VectorXd Vi, bool trans,
 
 /**
  *@brief compute loglikelihood and gradient using forward-backward algorithm
+ *
+ * State is a LinCrfLBFGSTransitionState or a LinCrfLBFGSGradientState, coef
+ * the coefficients of the previous iteration
  */
-void compute_logli_gradient(LinCrfLBFGSTransitionState<MutableArrayHandle<double> >& state,
+template <class State, class Coef>
+void compute_logli_gradient(State& state, const Coef& coef,
                             MappedColumnVector& sparse_r,
                             MappedColumnVector& dense_m,
                             MappedColumnVector& sparse_m) {
@@ -738,12 +825,12 @@ void compute_logli_gradient(LinCrfLBFGSTransitionState<MutableArrayHandle<double
         while (index-4>=0 && sparse_r(index-1) == i) {
             int curr_index =  (int)sparse_r(index-3);
             int f_index =  (int)sparse_r(index-2);
-            Vi(curr_index) += state.coef(f_index);
+            Vi(curr_index) += coef(f_index);
             index-=5;
         }
         //(f_index, prev_label, curr_label)
         for(int n=0; n+2<sparse_m_size ; n+=3) {
-            Mi((int)sparse_m(n+1), (int)sparse_m(n+2)) += state.coef((int)sparse_m(n));
+            Mi((int)sparse_m(n+1), (int)sparse_m(n+2)) += coef((int)sparse_m(n));
         }
 
         compute_exp_Mi(state.num_labels, Mi, Vi);
@@ -766,12 +853,12 @@ void compute_logli_gradient(LinCrfLBFGSTransitionState<MutableArrayHandle<double
         while (((index+4) <= (r_size-1)) && sparse_r(index+3) == j) {
             int curr_index =  (int)sparse_r(index+1);
             int f_index =  (int)sparse_r(index+2);
-            Vi(curr_index) += state.coef(f_index);
+            Vi(curr_index) += coef(f_index);
             index+=5;
         }
         if(j>=1)
             for(int n=0; n+2<sparse_m_size ; n+=3) {
-                Mi((int)sparse_m(n+1), (int)sparse_m(n+2)) += state.coef((int)sparse_m(n));
+                Mi((int)sparse_m(n+1), (int)sparse_m(n+2)) += coef((int)sparse_m(n));
             }
 
         compute_exp_Mi(state.num_labels, Mi, Vi);
@@ -792,7 +879,7 @@ void compute_logli_gradient(LinCrfLBFGSTransitionState<MutableArrayHandle<double
             int exist = (int)sparse_r(index+4);
             if (exist == 1) {
                 state.grad(f_index) += 1;
-                state.loglikelihood += state.coef(f_index);
+                state.loglikelihood += coef(f_index);
             }
             ExpF(f_index) += next_alpha(curr_index) * betas(curr_index,j);
             index+=5;
@@ -801,7 +888,7 @@ void compute_logli_gradient(LinCrfLBFGSTransitionState<MutableArrayHandle<double
         if(j>=1) {
             int f_index = (int)dense_m((j-1)*5+2);
             state.grad(f_index) += 1;
-            state.loglikelihood += state.coef(f_index);
+            state.loglikelihood += coef(f_index);
             //(f_index, prev_label, curr_label)
             for(int n=0; n+2<sparse_m_size ; n+=3) {
                 int f_index = (int)sparse_m(n);
@@ -849,7 +936,7 @@ lincrf_lbfgs_step_transition::run(AnyType &args) {
         }
     }
     state.numRows++;
-    compute_logli_gradient(state, sparse_r, dense_m, sparse_m);
+    compute_logli_gradient(state, state.coef, sparse_r, dense_m, sparse_m);
     return state;
 }
 
@@ -874,18 +961,10 @@ lincrf_lbfgs_step_merge_states::run(AnyType &args) {
 }
 
 /**
- * @brief Perform the licrf_lbfgs final step
+ * @brief One L-BFGS iteration on the merged gradient and log-likelihood
+ * of state, updating its coefficients and history
  */
-AnyType
-lincrf_lbfgs_step_final::run(AnyType &args) {
-// We request a mutable object. Depending on the backend, this might perform
-    // a deep copy.
-    LinCrfLBFGSTransitionState<MutableArrayHandle<double> > state = args[0];
-
-    // Aggregates that haven't seen any data just return Null.
-    if (state.numRows == 0)
-        return Null();
-
+void lbfgs_step(LinCrfLBFGSTransitionState<MutableArrayHandle<double> > &state) {
     // To avoid overfitting, penalize the likelihood with a spherical Gaussian
     // weight prior
     double sigma_square = 100;
@@ -924,9 +1003,132 @@ lincrf_lbfgs_step_final::run(AnyType &args) {
                                        "is likely of poor numerical condition.");
 
     state.iteration++;
+}
+
+/**
+ * @brief Perform the licrf_lbfgs final step
+ */
+AnyType
+lincrf_lbfgs_step_final::run(AnyType &args) {
+// We request a mutable object. Depending on the backend, this might perform
+    // a deep copy.
+    LinCrfLBFGSTransitionState<MutableArrayHandle<double> > state = args[0];
+
+    // Aggregates that haven't seen any data just return Null.
+    if (state.numRows == 0)
+        return Null();
+
+    lbfgs_step(state);
+    return state;
+}
+
+/**
+ * @brief Compute the log likelihood and gradient vector for each tuple,
+ * against the coefficients of the previous iteration
+ *
+ * Unlike lincrf_lbfgs_step_transition the state holds only what is merged,
+ * the coefficients (args[6], zeros for the first iteration) are passed once
+ * per pass instead of the whole previous state.
+ */
+AnyType
+lincrf_lbfgs_grad_transition::run(AnyType &args) {
+    LinCrfLBFGSGradientState<MutableArrayHandle<double> > state = args[0];
+    MappedColumnVector sparse_r = args[1].getAs<MappedColumnVector>();
+    MappedColumnVector dense_m = args[2].getAs<MappedColumnVector>();
+    MappedColumnVector sparse_m = args[3].getAs<MappedColumnVector>();
+    MappedColumnVector coef = args[6].getAs<MappedColumnVector>();
+    if (state.numRows == 0) {
+        state.initialize(*this, static_cast<uint32_t>(args[4].getAs<double>()), static_cast<uint32_t>(args[5].getAs<double>()));
+        if (static_cast<uint32_t>(coef.size()) != state.num_features)
+            throw std::invalid_argument("Invalid arguments: Dimensions of "
+                "coefficients and features not consistent.");
+    }
+    state.numRows++;
+    compute_logli_gradient(state, coef, sparse_r, dense_m, sparse_m);
+    return state;
+}
+
+/**
+ * @brief Merge gradient states
+ */
+AnyType
+lincrf_lbfgs_grad_merge_states::run(AnyType &args) {
+    LinCrfLBFGSGradientState<MutableArrayHandle<double> > stateLeft = args[0];
+    LinCrfLBFGSGradientState<ArrayHandle<double> > stateRight = args[1];
+
+    // We first handle the trivial case where this function is called with one
+    // of the states being the initial state
+    if (stateLeft.numRows == 0)
+        return stateRight;
+    else if (stateRight.numRows == 0)
+        return stateLeft;
+
+    // Merge states together and return
+    stateLeft += stateRight;
+    return stateLeft;
+}
+
+/**
+ * @brief The merged gradient state, Null if no rows were seen
+ */
+AnyType
+lincrf_lbfgs_grad_final::run(AnyType &args) {
+    LinCrfLBFGSGradientState<ArrayHandle<double> > state = args[0];
+
+    // Aggregates that haven't seen any data just return Null.
+    if (state.numRows == 0)
+        return Null();
+
+    return state;
+}
+
+/**
+ * @brief Perform one L-BFGS iteration with the result of the gradient
+ * aggregate
+ *
+ * args[0] is the state of the previous iteration, Null for the first one,
+ * and args[1] the result of lincrf_lbfgs_grad. This is the only function
+ * that reads and writes the L-BFGS history, and it runs once per iteration.
+ */
+AnyType
+lincrf_lbfgs_step_update::run(AnyType &args) {
+    if (args[1].isNull())
+        return args[0];
+    LinCrfLBFGSGradientState<ArrayHandle<double> > gradState = args[1];
+
+    // We request a mutable object. Depending on the backend, this might
+    // perform a deep copy.
+    LinCrfLBFGSTransitionState<MutableArrayHandle<double> > state =
+        args[0].isNull()
+        ? AnyType(allocateArray<double>(
+            LinCrfLBFGSTransitionState<ArrayHandle<double> >::arraySize(0)))
+        : args[0];
+    uint32_t num_features = gradState.num_features;
+    if (state.num_features == 0)
+        state.initialize(*this, num_features, gradState.num_labels);
+    else if (state.num_features != num_features)
+        throw std::invalid_argument("Invalid arguments: Dimensions of "
+            "gradient and state not consistent.");
+
+    state.numRows = static_cast<uint64_t>(gradState.numRows);
+    state.grad = gradState.grad;
+    state.loglikelihood = static_cast<double>(gradState.loglikelihood);
+    lbfgs_step(state);
     return state;
 }
 
+/**
+ * @brief The coefficients of a state, to pass to lincrf_lbfgs_grad
+ */
+AnyType
+internal_lincrf_lbfgs_coef::run(AnyType &args) {
+    LinCrfLBFGSTransitionState<ArrayHandle<double> > state = args[0];
+    MutableNativeColumnVector coef(
+        allocateArray<double>(state.coef.size()));
+    coef = state.coef;
+    return coef;
+}
+
 /**
  * @brief Return iflag which indicates whether L-BFGS converge or not
  */
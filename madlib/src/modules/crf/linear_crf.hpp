@@ -18,6 +18,31 @@ DECLARE_UDF(crf, lincrf_lbfgs_step_merge_states)
  */
 DECLARE_UDF(crf, lincrf_lbfgs_step_final)
 
+/**
+ * @brief Linear-chain CRF (L-BFGS gradient): Transition function
+ */
+DECLARE_UDF(crf, lincrf_lbfgs_grad_transition)
+
+/**
+ * @brief Linear-chain CRF (L-BFGS gradient): State merge function
+ */
+DECLARE_UDF(crf, lincrf_lbfgs_grad_merge_states)
+
+/**
+ * @brief Linear-chain CRF (L-BFGS gradient): Final function
+ */
+DECLARE_UDF(crf, lincrf_lbfgs_grad_final)
+
+/**
+ * @brief Linear-chain CRF (L-BFGS): One iteration on the merged gradient
+ */
+DECLARE_UDF(crf, lincrf_lbfgs_step_update)
+
+/**
+ * @brief Linear-chain CRF (L-BFGS): Coefficients of the transition state
+ */
+DECLARE_UDF(crf, internal_lincrf_lbfgs_coef)
+
 /**
  * @brief Linear-chain CRF (L-BFGS) Return status which indicates whether L-BFGS converge or not
  */
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <functional>
 #include <numeric>
+#include <limits>
 #include "lda.hpp"
 
 namespace madlib {
@@ -37,6 +38,31 @@ typedef struct __type_info{
 } type_info;
 static type_info INT4TI(INT4OID);
 
+/**
+ * @brief The unnormalised probability of a topic, excluding the contribution
+ * of the word being resampled
+ **/
+static inline double __lda_topic_unpr(
+    int32_t i, int32_t topic_num, int32_t topic, const int32_t * count_d_z,
+    const int32_t * count_w_z, const int32_t * count_z, double alpha,
+    double beta)
+{
+    int32_t nwz = count_w_z[i];
+    int32_t ndz = count_d_z[i];
+    int32_t nz = count_z[i];
+
+    /* Adjust the counts to exclude current word's contribution */
+    if (i == topic) {
+        nwz--;
+        ndz--;
+        nz--;
+    }
+
+    // Note that ndz, nwz, nz are non-negative, and topic_num, alpha, and
+    // beta are positive, so the division by zero will not occure here.
+    return (ndz + alpha) * (nwz + beta) / (nz + topic_num * beta);
+}
+
 /**
  * @brief This function samples a new topic for a word in a document based on
  * the topic counts computed on the rest of the corpus. This is the core
@@ -63,89 +89,295 @@ static int32_t __lda_gibbs_sample(
     int32_t topic_num, int32_t topic, const int32_t * count_d_z, const int32_t * count_w_z,
     const int32_t * count_z, double alpha, double beta) 
 {
-    /* The cumulative probability distribution of the topics */
-    double * topic_prs = new double[topic_num]; 
-    if(!topic_prs)
-        throw std::runtime_error("out of memory");
-
-    /* Calculate topic (unnormalised) probabilities */
+    /* Calculate the total (unnormalised) probability */
+    // The sampler runs once per token, so rather than allocating the
+    // cumulative distribution it walks the probabilities a second time
     double total_unpr = 0;
-    for (int32_t i = 0; i < topic_num; i++) {
-        int32_t nwz = count_w_z[i];
-        int32_t ndz = count_d_z[i];
-        int32_t nz = count_z[i];
-
-        /* Adjust the counts to exclude current word's contribution */
-        if (i == topic) {
-            nwz--;
-            ndz--;
-            nz--;
-        }
-
-        /* Compute the probability */
-        // Note that ndz, nwz, nz are non-negative, and topic_num, alpha, and
-        // beta are positive, so the division by zero will not occure here.
-        double unpr = (ndz + alpha) * (nwz + beta) / (nz + topic_num * beta);
-        total_unpr += unpr;
-        topic_prs[i] = total_unpr;
-    }
-
-    /* Normalise the probabilities */
-    // Note that the division by zero will not occure here, so no need to check
-    // whether total_unpr is zero
     for (int32_t i = 0; i < topic_num; i++)
-        topic_prs[i] /= total_unpr;
+        total_unpr += __lda_topic_unpr(i, topic_num, topic, count_d_z,
+                                       count_w_z, count_z, alpha, beta);
 
     /* Draw a topic at random */
-    double r = drand48();
+    // Note that the division by zero will not occure here, so no need to check
+    // whether total_unpr is zero
+    double r = drand48() * total_unpr;
+    double cumulative = 0;
     int32_t retopic = 0;
     while (true) {
-        if (retopic == topic_num - 1 || r < topic_prs[retopic])
+        cumulative += __lda_topic_unpr(retopic, topic_num, topic, count_d_z,
+                                       count_w_z, count_z, alpha, beta);
+        if (retopic == topic_num - 1 || r < cumulative)
             break;
         retopic++; 
     }
 
-    delete[] topic_prs;
     return retopic;
 }
 
 /**
- * @brief Get the min value of an array - for parameter checking
- * @return      The min value
+ * @brief The min, max and sum of a range of an array - for parameter checking
+ **/
+typedef struct __array_summary{
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} array_summary;
+
+/**
+ * @brief Get the min, max and sum of a range of an array in a single pass.
+ * The loop keeps independent accumulators and has no early exit so that the
+ * compiler vectorizes it.
  * @note The caller will ensure that ah is always non-null.
  **/
-static int32_t __min(
+static array_summary __summarize(
     ArrayHandle<int32_t> ah, size_t start, size_t len){
     const int32_t * array = ah.ptr() + start;
-    return *std::min_element(array, array + len);
+    int32_t min = std::numeric_limits<int32_t>::max();
+    int32_t max = std::numeric_limits<int32_t>::min();
+    int64_t sum = 0;
+    for(size_t i = 0; i < len; i++){
+        min = std::min(min, array[i]);
+        max = std::max(max, array[i]);
+        sum += array[i];
+    }
+    array_summary summary = {min, max, sum};
+    return summary;
 }
-static int32_t __min(ArrayHandle<int32_t> ah){
-    return __min(ah, 0, ah.size());
+static array_summary __summarize(ArrayHandle<int32_t> ah){
+    return __summarize(ah, 0, ah.size());
 }
 
 /**
- * @brief Get the max value of an array - for parameter checking
- * @return      The max value
- * @note The caller will ensure that ah is always non-null.
+ * @brief Check the unique words and the word counts of a document
+ * @return      The number of words in the document
+ * @note If MADLIB_LDA_TRUSTED_INPUT is defined, the word ids are assumed to
+ * be valid and only the counts are scanned, since their sum is needed anyway.
  **/
-static int32_t __max(
-    ArrayHandle<int32_t> ah, size_t start, size_t len){
-    const int32_t * array = ah.ptr() + start;
-    return *std::max_element(array, array + len);
+static int32_t __check_words(
+    ArrayHandle<int32_t> words, ArrayHandle<int32_t> counts,
+    int32_t voc_size){
+    if(words.size() != counts.size())
+        throw std::invalid_argument(
+            "dimensions mismatch: words.size() != counts.size()");
+#ifndef MADLIB_LDA_TRUSTED_INPUT
+    array_summary ws = __summarize(words);
+    if(ws.min < 0 || ws.max >= voc_size)
+        throw std::invalid_argument(
+            "invalid values in words");
+#endif
+    array_summary cs = __summarize(counts);
+    if(cs.min <= 0)
+        throw std::invalid_argument(
+            "invalid values in counts");
+    if(cs.sum > std::numeric_limits<int32_t>::max())
+        throw std::invalid_argument(
+            "invalid values in counts");
+    return static_cast<int32_t>(cs.sum);
 }
-static int32_t __max(ArrayHandle<int32_t> ah){
-    return __max(ah, 0, ah.size());
+
+/**
+ * @brief Check the topic counts and topic assignments of a document
+ **/
+static void __check_doc_topic(
+    ArrayHandle<int32_t> doc_topic, int32_t word_count, int32_t topic_num){
+    if(doc_topic.size() != (size_t)(word_count + topic_num))
+        throw std::invalid_argument(
+            "invalid dimension - doc_topic.size() != word_count + topic_num");
+#ifndef MADLIB_LDA_TRUSTED_INPUT
+    if(__summarize(doc_topic, 0, topic_num).min < 0)
+        throw std::invalid_argument("invalid values in topic_count");
+    array_summary as = __summarize(doc_topic, topic_num, word_count);
+    if(as.min < 0 || as.max >= topic_num)
+        throw std::invalid_argument( "invalid values in topic_assignment");
+#endif
 }
 
 /**
- * @brief Get the sum of an array - for parameter checking
- * @return      The sum
- * @note The caller will ensure that ah is always non-null.
+ * @brief Check the dimension and the topic counts of a model
  **/
-static int32_t __sum(ArrayHandle<int32_t> ah){
-    const int32_t * array = ah.ptr();
-    int32_t size = ah.size();
-    return std::accumulate(array, array + size, 0);
+static void __check_model(
+    ArrayHandle<int32_t> model, int32_t voc_size, int32_t topic_num){
+    if(model.size() != (size_t)((voc_size + 1) * topic_num))
+        throw std::invalid_argument(
+            "invalid dimension - model.size() != (voc_size + 1) * topic_num");
+#ifndef MADLIB_LDA_TRUSTED_INPUT
+    if(__summarize(model).min < 0)
+        throw std::invalid_argument("invalid topic counts in model");
+#endif
+}
+
+/**
+ * @brief Layout of the sparse word topic count states used by the topic count
+ * aggregator. The state is an int32 array holding a fixed header followed by
+ * (key, delta) pairs of word topic counts, where key = wordid * topic_num +
+ * topic. The pairs are kept as one sorted run with unique keys followed by an
+ * unsorted tail; the tail is folded into the run once it grows as large as
+ * the run. The corpus topic counts are not stored, they are the column sums
+ * of the deltas.
+ **/
+enum {
+    DELTA_VOC_SIZE = 0,
+    DELTA_TOPIC_NUM = 1,
+    DELTA_NUM_SORTED = 2,
+    DELTA_NUM_TAIL = 3,
+    DELTA_CAPACITY = 4,
+    DELTA_HEADER = 6        // keeps the pairs 8-byte aligned
+};
+
+/* Minimum tail length before it is folded into the sorted run */
+static const int32_t DELTA_MIN_TAIL = 4096;
+
+/* A sparse state is converted to a dense one once the number of pairs
+ * exceeds 1/DELTA_DENSE_RATIO of the cells of the dense model, i.e. once the
+ * pairs take half the memory of the dense array */
+static const int32_t DELTA_DENSE_RATIO = 4;
+
+typedef struct __delta_pair{
+    int32_t key;
+    int32_t delta;
+
+    bool operator<(const __delta_pair & other) const {
+        return key < other.key;
+    }
+} delta_pair;
+
+static delta_pair * __delta_pairs(int32_t * state){
+    return reinterpret_cast<delta_pair *>(state + DELTA_HEADER);
+}
+
+/**
+ * @brief Allocate an empty delta state with room for capacity pairs
+ **/
+static MutableArrayHandle<int32_t> __delta_alloc(
+    int32_t voc_size, int32_t topic_num, int32_t capacity){
+    MutableArrayHandle<int32_t> state(
+        madlib_construct_array(
+            NULL, DELTA_HEADER + 2 * capacity, INT4TI.oid, INT4TI.len,
+            INT4TI.byval, INT4TI.align));
+    state[DELTA_VOC_SIZE] = voc_size;
+    state[DELTA_TOPIC_NUM] = topic_num;
+    state[DELTA_CAPACITY] = capacity;
+    return state;
+}
+
+/**
+ * @brief Make sure the state can take extra more pairs; the returned state
+ * is either the input state or a larger copy of it
+ **/
+static MutableArrayHandle<int32_t> __delta_reserve(
+    MutableArrayHandle<int32_t> state, int32_t extra){
+    int32_t used = state[DELTA_NUM_SORTED] + state[DELTA_NUM_TAIL];
+    int32_t capacity = state[DELTA_CAPACITY];
+    if(used + extra <= capacity)
+        return state;
+
+    MutableArrayHandle<int32_t> grown = __delta_alloc(
+        state[DELTA_VOC_SIZE], state[DELTA_TOPIC_NUM],
+        std::max(2 * capacity, used + extra));
+    memcpy(grown.ptr(), state.ptr(),
+        (DELTA_HEADER + 2 * used) * sizeof(int32_t));
+    grown[DELTA_CAPACITY] = std::max(2 * capacity, used + extra);
+    return grown;
+}
+
+/**
+ * @brief Fold the unsorted tail into the sorted run, summing the deltas of
+ * equal keys and dropping the pairs whose deltas cancel out
+ **/
+static void __delta_compact(int32_t * state){
+    int32_t num_sorted = state[DELTA_NUM_SORTED];
+    int32_t num_tail = state[DELTA_NUM_TAIL];
+    if(num_tail == 0)
+        return;
+
+    delta_pair * pairs = __delta_pairs(state);
+    std::sort(pairs + num_sorted, pairs + num_sorted + num_tail);
+    std::inplace_merge(pairs, pairs + num_sorted, pairs + num_sorted + num_tail);
+
+    int32_t out = 0;
+    for(int32_t i = 0; i < num_sorted + num_tail; i++){
+        if(out > 0 && pairs[out - 1].key == pairs[i].key)
+            pairs[out - 1].delta += pairs[i].delta;
+        else
+            pairs[out++] = pairs[i];
+        if(pairs[out - 1].delta == 0)
+            out--;
+    }
+    state[DELTA_NUM_SORTED] = out;
+    state[DELTA_NUM_TAIL] = 0;
+}
+
+/**
+ * @brief Append a word topic count change to the tail of the state. The
+ * caller must have reserved the room.
+ **/
+static inline void __delta_push(int32_t * state, int32_t key, int32_t delta){
+    delta_pair * pairs = __delta_pairs(state);
+    pairs[state[DELTA_NUM_SORTED] + state[DELTA_NUM_TAIL]].key = key;
+    pairs[state[DELTA_NUM_SORTED] + state[DELTA_NUM_TAIL]].delta = delta;
+    state[DELTA_NUM_TAIL]++;
+}
+
+/**
+ * @brief Add the pairs of state2 to state1; the returned state is either
+ * state1 or a larger copy of it
+ **/
+static MutableArrayHandle<int32_t> __delta_merge(
+    MutableArrayHandle<int32_t> state1, ArrayHandle<int32_t> state2){
+    if(state1[DELTA_VOC_SIZE] != state2[DELTA_VOC_SIZE] ||
+            state1[DELTA_TOPIC_NUM] != state2[DELTA_TOPIC_NUM])
+        throw std::invalid_argument("invalid dimension");
+
+    int32_t num2 = state2[DELTA_NUM_SORTED] + state2[DELTA_NUM_TAIL];
+    state1 = __delta_reserve(state1, num2);
+
+    int32_t used1 = state1[DELTA_NUM_SORTED] + state1[DELTA_NUM_TAIL];
+    memcpy(state1.ptr() + DELTA_HEADER + 2 * used1,
+        state2.ptr() + DELTA_HEADER, 2 * num2 * sizeof(int32_t));
+    state1[DELTA_NUM_TAIL] += num2;
+    __delta_compact(state1.ptr());
+    return state1;
+}
+
+/**
+ * @brief Add the pairs of a sparse state to a dense (voc_size + 1) *
+ * topic_num model, including the corpus topic counts. The state is left
+ * as it is, its tail does not need to be folded first.
+ **/
+static void __delta_apply(int32_t * model, const int32_t * state){
+    int32_t voc_size = state[DELTA_VOC_SIZE];
+    int32_t topic_num = state[DELTA_TOPIC_NUM];
+
+    const delta_pair * pairs =
+        reinterpret_cast<const delta_pair *>(state + DELTA_HEADER);
+    int32_t * count_z = model + voc_size * topic_num;
+    int32_t num = state[DELTA_NUM_SORTED] + state[DELTA_NUM_TAIL];
+    for(int32_t i = 0; i < num; i++){
+        model[pairs[i].key] += pairs[i].delta;
+        count_z[pairs[i].key % topic_num] += pairs[i].delta;
+    }
+}
+
+/**
+ * @brief Allocate a zeroed dense (voc_size + 1) * topic_num model
+ **/
+static MutableArrayHandle<int32_t> __dense_alloc(
+    int32_t voc_size, int32_t topic_num){
+    int dims[2] = {voc_size + 1, topic_num};
+    int lbs[2] = {1, 1};
+    return madlib_construct_md_array(
+        NULL, NULL, 2, dims, lbs, INT4TI.oid, INT4TI.len, INT4TI.byval,
+        INT4TI.align);
+}
+
+/**
+ * @brief Element-wise sum of two dense models. The loop is kept free of
+ * aliasing and branches so that the compiler vectorizes it.
+ **/
+static void __dense_add(
+    int32_t * __restrict__ dst, const int32_t * __restrict__ src, size_t len){
+    for(size_t i = 0; i < len; i++)
+        dst[i] += src[i];
 }
 
 /**
@@ -194,26 +426,8 @@ AnyType lda_gibbs_sample::run(AnyType & args)
         throw std::invalid_argument(
             "invalid argument - iter_num");
 
-    if(words.size() != counts.size())
-        throw std::invalid_argument(
-            "dimensions mismatch: words.size() != counts.size()");
-    if(__min(words) < 0 || __max(words) >= voc_size)
-        throw std::invalid_argument(
-            "invalid values in words");
-    if(__min(counts) <= 0)
-        throw std::invalid_argument(
-            "invalid values in counts");
-
-    int32_t word_count = __sum(counts);
-    if(doc_topic.size() != (size_t)(word_count + topic_num))
-        throw std::invalid_argument(
-            "invalid dimension - doc_topic.size() != word_count + topic_num");
-    if(__min(doc_topic, 0, topic_num) < 0)
-        throw std::invalid_argument("invalid values in topic_count");
-    if(
-        __min(doc_topic, topic_num, word_count) < 0 ||
-        __max(doc_topic, topic_num, word_count) >= topic_num)
-        throw std::invalid_argument( "invalid values in topic_assignment");
+    int32_t word_count = __check_words(words, counts, voc_size);
+    __check_doc_topic(doc_topic, word_count, topic_num);
 
     if (!args.getUserFuncContext())
     {
@@ -221,11 +435,7 @@ AnyType lda_gibbs_sample::run(AnyType & args)
             throw std::invalid_argument("invalid argument - the model \
             parameter should not be null for the first call");
         ArrayHandle<int32_t> model = args[3].getAs<ArrayHandle<int32_t> >();
-        if(model.size() != (size_t)((voc_size + 1) * topic_num))
-            throw std::invalid_argument(
-                "invalid dimension - model.size() != (voc_size + 1) * topic_num");
-        if(__min(model) < 0)
-            throw std::invalid_argument("invalid topic counts in model");
+        __check_model(model, voc_size, topic_num);
 
         int32 * state = 
             static_cast<int32 *>(
@@ -311,7 +521,13 @@ AnyType lda_random_assign::run(AnyType & args)
  * @param args[3]   The topic assignments in the document
  * @param args[4]   The size of vocabulary
  * @param args[5]   The number of topics 
+ * @param args[6]   Optional, whether the state may be kept sparse
  * @return          The updated state
+ * @note By default the state is the dense (voc_size + 1) * topic_num array
+ * from the first call, so the aggregate needs no final function. When
+ * args[6] is true a large model is counted in sparse (word, topic) pairs
+ * until it gets dense, and the aggregate must be declared with
+ * lda_count_topic_ffunc as its final function to return the dense array.
  **/
 AnyType lda_count_topic_sfunc::run(AnyType & args)
 {
@@ -334,44 +550,68 @@ AnyType lda_count_topic_sfunc::run(AnyType & args)
     ArrayHandle<int32_t> words = args[1].getAs<ArrayHandle<int32_t> >();
     ArrayHandle<int32_t> counts = args[2].getAs<ArrayHandle<int32_t> >();
     ArrayHandle<int32_t> topic_assignment = args[3].getAs<ArrayHandle<int32_t> >();
-    if(words.size() != counts.size())
-        throw std::invalid_argument(
-            "dimensions mismatch - words.size() != counts.size()");
-    if(__min(words) < 0 || __max(words) >= voc_size)
-        throw std::invalid_argument(
-            "invalid values in words");
-    if(__min(counts) <= 0)
-        throw std::invalid_argument(
-            "invalid values in counts");
-    if(__min(topic_assignment) < 0 || __max(topic_assignment) >= topic_num)
-        throw std::invalid_argument("invalid values in topics");
-    if((size_t)__sum(counts) != topic_assignment.size())
+    int32_t word_count = __check_words(words, counts, voc_size);
+    if((size_t)word_count != topic_assignment.size())
         throw std::invalid_argument(
             "dimension mismatch - sum(counts) != topic_assignment.size()");
+#ifndef MADLIB_LDA_TRUSTED_INPUT
+    array_summary ts = __summarize(topic_assignment);
+    if(ts.min < 0 || ts.max >= topic_num)
+        throw std::invalid_argument("invalid values in topics");
+#endif
+
+    bool sparse = args.numFields() > 6 && !args[6].isNull() &&
+        args[6].getAs<bool>();
 
     MutableArrayHandle<int32_t> state(NULL);
     if(args[0].isNull()){
-        int dims[2] = {voc_size + 1, topic_num};
-        int lbs[2] = {1, 1};
-        state = madlib_construct_md_array(
-            NULL, NULL, 2, dims, lbs, INT4TI.oid, INT4TI.len, INT4TI.byval,
-            INT4TI.align);
+        // small models are cheaper to count densely from the start
+        if(!sparse || (int64_t)(voc_size + 1) * topic_num <=
+                (int64_t)DELTA_MIN_TAIL * DELTA_DENSE_RATIO)
+            state = __dense_alloc(voc_size, topic_num);
+        else
+            state = __delta_alloc(
+                voc_size, topic_num,
+                std::max(DELTA_MIN_TAIL, (int32_t)topic_assignment.size()));
     } else {
         state = args[0].getAs<MutableArrayHandle<int32_t> >();
     }
 
     int32_t unique_word_count = words.size();
     int32_t word_index = 0;
+    if(state.dims() == 2){
+        for(int32_t i = 0; i < unique_word_count; i++){
+            int32_t wordid = words[i];
+            for(int32_t j = 0; j < counts[i]; j++){
+                int32_t topic = topic_assignment[word_index];
+                state[wordid * topic_num + topic]++;
+                state[voc_size * topic_num + topic]++;
+                word_index++;
+            }
+        }
+        return state;
+    }
+
+    state = __delta_reserve(state, topic_assignment.size());
     for(int32_t i = 0; i < unique_word_count; i++){
         int32_t wordid = words[i];
         for(int32_t j = 0; j < counts[i]; j++){
             int32_t topic = topic_assignment[word_index];
-            state[wordid * topic_num + topic]++;
-            state[voc_size * topic_num + topic]++;
+            __delta_push(state.ptr(), wordid * topic_num + topic, 1);
             word_index++;
         }
     }
 
+    if(state[DELTA_NUM_TAIL] >= std::max(DELTA_MIN_TAIL, state[DELTA_NUM_SORTED])){
+        __delta_compact(state.ptr());
+        if((int64_t)state[DELTA_NUM_SORTED] * DELTA_DENSE_RATIO >
+                (int64_t)(voc_size + 1) * topic_num){
+            MutableArrayHandle<int32_t> dense = __dense_alloc(voc_size, topic_num);
+            __delta_apply(dense.ptr(), state.ptr());
+            return dense;
+        }
+    }
+
     return state;
 }
 
@@ -380,22 +620,76 @@ AnyType lda_count_topic_sfunc::run(AnyType & args)
  * topic counts.
  * @param args[0]   The state variable, local topic counts
  * @param args[1]   The state variable, local topic counts
- * @return          The merged state, element-wise sum of two local states
+ * @return          The merged state, the sum of two local states, which is
+ *                  state1 or, when state1 is sparse and must grow, a copy
+ * @note With the sparse option of lda_count_topic_sfunc, local states are
+ * sparse (word, topic) count pairs until they get dense enough to be
+ * converted to a (voc_size + 1) * topic_num array, so a fragment holding few
+ * documents only ships the counts it has seen.
  **/
 AnyType lda_count_topic_prefunc::run(AnyType & args)
 {
     MutableArrayHandle<int32_t> state1 = args[0].getAs<MutableArrayHandle<int32_t> >();
     ArrayHandle<int32_t> state2 = args[1].getAs<ArrayHandle<int32_t> >();
 
-    if(state1.size() != state2.size())
-        throw std::invalid_argument("invalid dimension");
+    if(state1.dims() == 2 && state2.dims() == 2){
+        if(state1.size() != state2.size())
+            throw std::invalid_argument("invalid dimension");
+        __dense_add(state1.ptr(), state2.ptr(), state1.size());
+        return state1;
+    }
+    if(state1.dims() == 2){
+        if(state1.size() != (size_t)((state2[DELTA_VOC_SIZE] + 1) *
+                state2[DELTA_TOPIC_NUM]))
+            throw std::invalid_argument("invalid dimension");
+        __delta_apply(state1.ptr(), state2.ptr());
+        return state1;
+    }
+    if(state2.dims() == 2){
+        // state2 is read only, so the sparse state1 grows into a dense copy
+        if(state2.size() != (size_t)((state1[DELTA_VOC_SIZE] + 1) *
+                state1[DELTA_TOPIC_NUM]))
+            throw std::invalid_argument("invalid dimension");
+        MutableArrayHandle<int32_t> dense = __dense_alloc(
+            state1[DELTA_VOC_SIZE], state1[DELTA_TOPIC_NUM]);
+        memcpy(dense.ptr(), state2.ptr(), state2.size() * sizeof(int32_t));
+        __delta_apply(dense.ptr(), state1.ptr());
+        return dense;
+    }
 
-    for(size_t i = 0; i < state1.size(); i++)
-        state1[i] += state2[i];
-    
+    state1 = __delta_merge(state1, state2);
+    int32_t voc_size = state1[DELTA_VOC_SIZE];
+    int32_t topic_num = state1[DELTA_TOPIC_NUM];
+    if((int64_t)state1[DELTA_NUM_SORTED] * DELTA_DENSE_RATIO >
+            (int64_t)(voc_size + 1) * topic_num){
+        MutableArrayHandle<int32_t> dense = __dense_alloc(voc_size, topic_num);
+        __delta_apply(dense.ptr(), state1.ptr());
+        return dense;
+    }
     return state1;
 }
 
+/**
+ * @brief This function is the finalfunc for the aggregator computing the
+ * topic counts.
+ * @param args[0]   The global state
+ * @return          The word topic counts and corpus topic counts as a
+ *                  (voc_size + 1) * topic_num array
+ * @note Only needed when the sparse option of lda_count_topic_sfunc is used,
+ * dense states are returned as they are.
+ **/
+AnyType lda_count_topic_ffunc::run(AnyType & args)
+{
+    MutableArrayHandle<int32_t> state = args[0].getAs<MutableArrayHandle<int32_t> >();
+    if(state.dims() == 2)
+        return state;
+
+    MutableArrayHandle<int32_t> dense = __dense_alloc(
+        state[DELTA_VOC_SIZE], state[DELTA_TOPIC_NUM]);
+    __delta_apply(dense.ptr(), state.ptr());
+    return dense;
+}
+
 /**
  * @brief This function transposes a matrix represented by a 2-D array
  * @param args[0]   The input matrix
@@ -520,20 +814,12 @@ AnyType lda_perplexity_sfunc::run(AnyType & args){
         throw std::invalid_argument(
             "invalid argument - topic_num");
 
-    if(words.size() != counts.size())
-        throw std::invalid_argument(
-            "dimensions mismatch: words.size() != counts.size()");
-    if(__min(words) < 0 || __max(words) >= voc_size)
-        throw std::invalid_argument(
-            "invalid values in words");
-    if(__min(counts) <= 0)
-        throw std::invalid_argument(
-            "invalid values in counts");
+    int32_t n_d = __check_words(words, counts, voc_size);
 
     if(topic_counts.size() != (size_t)(topic_num))
         throw std::invalid_argument(
             "invalid dimension - topic_counts.size() != topic_num");
-    if(__min(topic_counts, 0, topic_num) < 0)
+    if(__summarize(topic_counts).min < 0)
         throw std::invalid_argument("invalid values in topic_counts");
 
     MutableArrayHandle<int32_t> state(NULL);
@@ -543,11 +829,7 @@ AnyType lda_perplexity_sfunc::run(AnyType & args){
             parameter should not be null for the first call");
         ArrayHandle<int32_t> model = args[4].getAs<ArrayHandle<int32_t> >();
 
-        if(model.size() != (size_t)((voc_size + 1) * topic_num))
-            throw std::invalid_argument(
-                "invalid dimension - model.size() != (voc_size + 1) * topic_num");
-        if(__min(model) < 0)
-            throw std::invalid_argument("invalid topic counts in model");
+        __check_model(model, voc_size, topic_num);
 
         state =  madlib_construct_array(
             NULL, model.size() + 2, INT4TI.oid, INT4TI.len, INT4TI.byval,
@@ -561,11 +843,6 @@ AnyType lda_perplexity_sfunc::run(AnyType & args){
     int32 * model = state.ptr();
     double * perp = reinterpret_cast<double *>(state.ptr() + state.size() - 2);
 
-    int32_t n_d = 0;
-    for(size_t i = 0; i < words.size(); i++){
-        n_d += counts[i];
-    }
-    
     for(size_t i = 0; i < words.size(); i++){
         int32_t w = words[i];
         int32_t n_dw = counts[i];
@@ -617,3 +894,147 @@ AnyType lda_perplexity_ffunc::run(AnyType & args){
 }
 }
 }
+
+/**
+ * @brief This function is the sfunc of an aggregator that computes the topic
+ * counts and the log-likelihood of the corpus in one scan over the output of
+ * lda_gibbs_sample, in place of lda_count_topic_agg followed by
+ * lda_perplexity_agg.
+ * @param args[0]   The current state
+ * @param args[1]   The unique words in the document
+ * @param args[2]   The counts of each unique word in the document
+ * @param args[3]   The topic counts and topic assignments in the document,
+ *                  as returned by lda_gibbs_sample
+ * @param args[4]   The model the topics were sampled with (word topic counts
+ *                  and corpus topic counts)
+ * @param args[5]   The Dirichlet parameter for per-document topic
+ *                  multinomial, i.e. alpha
+ * @param args[6]   The Dirichlet parameter for per-topic word
+ *                  multinomial, i.e. beta
+ * @param args[7]   The size of vocabulary
+ * @param args[8]   The number of topics
+ * @return          The updated state
+ * @note The state is the (voc_size + 1) * topic_num new topic counts
+ * followed by the log-likelihood in two slots, the layout of the perplexity
+ * state, so lda_perplexity_ffunc is its final function and
+ * lda_count_perplexity_model extracts the new model. The model is read in
+ * place rather than copied into the state, so the log-likelihood is the one
+ * of the new assignments under the model of the previous iteration.
+ **/
+AnyType lda_count_perplexity_sfunc::run(AnyType & args){
+    if(args[1].isNull() || args[2].isNull() || args[3].isNull())
+        return args[0];
+    if(args[4].isNull())
+        throw std::invalid_argument(
+            "invalid argument - the model parameter should not be null");
+
+    ArrayHandle<int32_t> words = args[1].getAs<ArrayHandle<int32_t> >();
+    ArrayHandle<int32_t> counts = args[2].getAs<ArrayHandle<int32_t> >();
+    ArrayHandle<int32_t> doc_topic = args[3].getAs<ArrayHandle<int32_t> >();
+    ArrayHandle<int32_t> model = args[4].getAs<ArrayHandle<int32_t> >();
+    double alpha = args[5].getAs<double>();
+    double beta = args[6].getAs<double>();
+    int32_t voc_size = args[7].getAs<int32_t>();
+    int32_t topic_num = args[8].getAs<int32_t>();
+
+    if(alpha <= 0)
+        throw std::invalid_argument("invalid argument - alpha");
+    if(beta <= 0)
+        throw std::invalid_argument("invalid argument - beta");
+    if(voc_size <= 0)
+        throw std::invalid_argument(
+            "invalid argument - voc_size");
+    if(topic_num <= 0)
+        throw std::invalid_argument(
+            "invalid argument - topic_num");
+
+    int32_t n_d = __check_words(words, counts, voc_size);
+    __check_doc_topic(doc_topic, n_d, topic_num);
+    __check_model(model, voc_size, topic_num);
+
+    MutableArrayHandle<int32_t> state(NULL);
+    if(args[0].isNull()){
+        state = madlib_construct_array(
+            NULL, model.size() + 2, INT4TI.oid, INT4TI.len, INT4TI.byval,
+            INT4TI.align);
+    }else{
+        state = args[0].getAs<MutableArrayHandle<int32_t> >();
+        if(state.size() != model.size() + 2)
+            throw std::invalid_argument("invalid dimension");
+    }
+
+    int32_t * count = state.ptr();
+    double * perp = reinterpret_cast<double *>(state.ptr() + state.size() - 2);
+    const int32_t * topic_counts = doc_topic.ptr();
+    const int32_t * n_z = model.ptr() + voc_size * topic_num;
+
+    int32_t word_index = topic_num;
+    for(size_t i = 0; i < words.size(); i++){
+        int32_t w = words[i];
+        int32_t n_dw = counts[i];
+        const int32_t * n_wz = model.ptr() + w * topic_num;
+
+        double sum_p = 0.0;
+        for(int32_t z = 0; z < topic_num; z++)
+            sum_p += (n_wz[z] + beta) * (topic_counts[z] + alpha)
+                        / (n_z[z] + voc_size * beta);
+        sum_p /= (n_d + topic_num * alpha);
+        *perp += n_dw * log(sum_p);
+
+        for(int32_t j = 0; j < n_dw; j++){
+            int32_t topic = doc_topic[word_index];
+            count[w * topic_num + topic]++;
+            count[voc_size * topic_num + topic]++;
+            word_index++;
+        }
+    }
+
+    return state;
+}
+
+/**
+ * @brief This function is the prefunc of the aggregator computing the topic
+ * counts and the log-likelihood.
+ * @param args[0]   The local state
+ * @param args[1]   The local state
+ * @return          The merged state
+ **/
+AnyType lda_count_perplexity_prefunc::run(AnyType & args){
+    MutableArrayHandle<int32_t> state1 = args[0].getAs<MutableArrayHandle<int32_t> >();
+    ArrayHandle<int32_t> state2 = args[1].getAs<ArrayHandle<int32_t> >();
+    if(state1.size() != state2.size())
+        throw std::invalid_argument("invalid dimension");
+
+    __dense_add(state1.ptr(), state2.ptr(), state1.size() - 2);
+    double * perp1 = reinterpret_cast<double *>(state1.ptr() + state1.size() - 2);
+    const double * perp2 = reinterpret_cast<const double *>(state2.ptr() + state2.size() - 2);
+    *perp1 += *perp2;
+    return state1;
+}
+
+/**
+ * @brief This function returns the topic counts of the state of the
+ * aggregator computing the topic counts and the log-likelihood.
+ * @param args[0]   The global state
+ * @param args[1]   The size of vocabulary
+ * @param args[2]   The number of topics
+ * @return          The word topic counts and corpus topic counts as a
+ *                  (voc_size + 1) * topic_num array
+ **/
+AnyType lda_count_perplexity_model::run(AnyType & args){
+    ArrayHandle<int32_t> state = args[0].getAs<ArrayHandle<int32_t> >();
+    int32_t voc_size = args[1].getAs<int32_t>();
+    int32_t topic_num = args[2].getAs<int32_t>();
+    if(voc_size <= 0)
+        throw std::invalid_argument(
+            "invalid argument - voc_size");
+    if(topic_num <= 0)
+        throw std::invalid_argument(
+            "invalid argument - topic_num");
+    if(state.size() != (size_t)((voc_size + 1) * topic_num) + 2)
+        throw std::invalid_argument("invalid dimension");
+
+    MutableArrayHandle<int32_t> model = __dense_alloc(voc_size, topic_num);
+    memcpy(model.ptr(), state.ptr(), model.size() * sizeof(int32_t));
+    return model;
+}
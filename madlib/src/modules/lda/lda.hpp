@@ -11,6 +11,7 @@ DECLARE_UDF(lda, lda_gibbs_sample)
 
 DECLARE_UDF(lda, lda_count_topic_sfunc)
 DECLARE_UDF(lda, lda_count_topic_prefunc)
+DECLARE_UDF(lda, lda_count_topic_ffunc)
 
 DECLARE_UDF(lda, lda_transpose)
 DECLARE_SR_UDF(lda, lda_unnest)
@@ -18,3 +19,7 @@ DECLARE_SR_UDF(lda, lda_unnest)
 DECLARE_UDF(lda, lda_perplexity_sfunc)
 DECLARE_UDF(lda, lda_perplexity_prefunc)
 DECLARE_UDF(lda, lda_perplexity_ffunc)
+
+DECLARE_UDF(lda, lda_count_perplexity_sfunc)
+DECLARE_UDF(lda, lda_count_perplexity_prefunc)
+DECLARE_UDF(lda, lda_count_perplexity_model)
@@ -53,7 +53,7 @@ public:
     typename HandleTraits<Handle>::MatrixTransparentHandleMap::ColXpr
     newColumn(const Allocator& inAllocator) {
         uint64_t numColsReserved = utils::nextPowerOfTwo(
-            static_cast<uint16_t>(numCols));
+            static_cast<uint64_t>(numCols));
 
         if (numColsReserved <= numCols) {
             if (numColsReserved == 0)
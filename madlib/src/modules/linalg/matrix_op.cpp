@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <functional>
 #include <numeric>
+#include <Eigen/Dense>
 #include "matrix_op.hpp"
 
 namespace madlib {
@@ -35,6 +36,29 @@ typedef struct __type_info{
 static type_info FLOAT8TI(FLOAT8OID);
 static type_info INT4TI(INT4OID);
 
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    RowMajorMatrix;
+
+/**
+ * @brief Accumulate r += a * b, or r += a * b^T if trans_b, where all three
+ * are row-major blocks as stored in 2-D arrays. Eigen's product kernel is
+ * cache-blocked and vectorized, unlike a plain triple loop.
+ **/
+static void __block_mult_acc(
+    const double * a, int row_a, int col_a,
+    const double * b, int row_b, int col_b, bool trans_b, double * r)
+{
+    Eigen::Map<const RowMajorMatrix> ma(a, row_a, col_a);
+    Eigen::Map<const RowMajorMatrix> mb(b, row_b, col_b);
+    if (trans_b) {
+        Eigen::Map<RowMajorMatrix> mr(r, row_a, row_b);
+        mr.noalias() += ma * mb.transpose();
+    } else {
+        Eigen::Map<RowMajorMatrix> mr(r, row_a, col_b);
+        mr.noalias() += ma * mb;
+    }
+}
+
 AnyType matrix_densify_sfunc::run(AnyType & args)
 {
     int32_t col_dim = args[1].getAs<int32_t>();
@@ -158,16 +182,83 @@ AnyType matrix_mem_mult::run(AnyType & args)
             NULL, NULL, 2, dims, lbs, FLOAT8TI.oid,
             FLOAT8TI.len, FLOAT8TI.byval, FLOAT8TI.align);
 
-    for (int i = 0; i < row_a; i++){
-        for(int j = 0; j < col_a; j++){
-            for(int k = 0; k < dims[1]; k++){
-                *(r.ptr() + i * dims[1] + k) += trans_b ?
-                    *(a.ptr() + i * col_a + j) * *(b.ptr() + k * col_b + j) :
-                        *(a.ptr() + i * col_a + j) * *(b.ptr() + j * col_b + k);
-            }
+    __block_mult_acc(
+        a.ptr(), row_a, col_a, b.ptr(), row_b, col_b, trans_b, r.ptr());
+    return r;
+}
+
+/**
+ * @brief The sfunc of the block product aggregator: accumulates the products
+ * A_ik * B_kj of block pairs into the output block C_ij in place, so that a
+ * blockized product is one join plus one aggregate.
+ * @param args[0]   The state, the output block
+ * @param args[1]   The block of A
+ * @param args[2]   The block of B
+ * @param args[3]   Whether to multiply by the transpose of the block of B
+ * @return          The updated state
+ **/
+AnyType matrix_block_mult_sfunc::run(AnyType & args)
+{
+    if (args[1].isNull() || args[2].isNull())
+        return args[0];
+
+    ArrayHandle<double> a = args[1].getAs<ArrayHandle<double> >();
+    ArrayHandle<double> b = args[2].getAs<ArrayHandle<double> >();
+    bool trans_b = args[3].isNull() ? false : args[3].getAs<bool>();
+
+    if (a.dims() != 2 || b.dims() !=2){
+        throw std::invalid_argument(
+            "invalid argument - 2-d array expected");
+    }
+
+    int row_a = a.sizeOfDim(0);
+    int col_a = a.sizeOfDim(1);
+    int row_b = b.sizeOfDim(0);
+    int col_b = b.sizeOfDim(1);
+
+    if ((!trans_b && col_a != row_b) || (trans_b && col_a != col_b)){
+        throw std::invalid_argument(
+            "invalid argument - dimension mismatch");
+    }
+
+    int dims[2] = {row_a, trans_b ? row_b : col_b};
+    MutableArrayHandle<double> state(NULL);
+    if (args[0].isNull()){
+        int lbs[2] = {1, 1};
+        state = madlib_construct_md_array(
+            NULL, NULL, 2, dims, lbs, FLOAT8TI.oid,
+            FLOAT8TI.len, FLOAT8TI.byval, FLOAT8TI.align);
+    }else{
+        state = args[0].getAs<MutableArrayHandle<double> >();
+        if (state.sizeOfDim(0) != (size_t)dims[0] ||
+                state.sizeOfDim(1) != (size_t)dims[1]){
+            throw std::invalid_argument(
+                "invalid argument - dimension mismatch");
         }
     }
-    return r;
+
+    __block_mult_acc(
+        a.ptr(), row_a, col_a, b.ptr(), row_b, col_b, trans_b, state.ptr());
+    return state;
+}
+
+/**
+ * @brief The prefunc of the block product aggregator: the element-wise sum
+ * of two partial output blocks
+ **/
+AnyType matrix_block_mult_prefunc::run(AnyType & args)
+{
+    MutableArrayHandle<double> state1 = args[0].getAs<MutableArrayHandle<double> >();
+    ArrayHandle<double> state2 = args[1].getAs<ArrayHandle<double> >();
+
+    if (state1.size() != state2.size()){
+        throw std::invalid_argument(
+            "invalid argument - dimension mismatch");
+    }
+
+    Eigen::Map<Eigen::VectorXd>(state1.ptr(), state1.size()) +=
+        Eigen::Map<const Eigen::VectorXd>(state2.ptr(), state2.size());
+    return state1;
 }
 
 AnyType matrix_mem_trans::run(AnyType & args)
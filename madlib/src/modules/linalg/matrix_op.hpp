@@ -7,6 +7,9 @@
 DECLARE_UDF(linalg, matrix_mem_mult)
 DECLARE_UDF(linalg, matrix_mem_trans)
 
+DECLARE_UDF(linalg, matrix_block_mult_sfunc)
+DECLARE_UDF(linalg, matrix_block_mult_prefunc)
+
 DECLARE_UDF(linalg, matrix_densify_sfunc)
 DECLARE_UDF(linalg, matrix_blockize_sfunc)
 DECLARE_UDF(linalg, matrix_unblockize_sfunc)
@@ -317,7 +317,6 @@ struct NonNegativeIntegerDomainCheck : public IntegerDomainCheck<Distribution> {
  *
  * https://svn.boost.org/trac/boost/ticket/6937
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::bernoulli_distribution<RealType, Policy> >
   : public IntegerDomainCheck<
@@ -372,7 +371,6 @@ struct DomainCheck<boost::math::bernoulli_distribution<RealType, Policy> >
  *
  * https://svn.boost.org/trac/boost/ticket/6937
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::binomial_distribution<RealType, Policy> >
   : public IntegerDomainCheck<
@@ -448,7 +446,6 @@ struct DomainCheck<boost::math::binomial_distribution<RealType, Policy> >
  * FIXME: No boost bug filed so far
  * Boost does not catch the case where lambda is non-finite.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::exponential_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -514,7 +511,6 @@ struct DomainCheck<boost::math::exponential_distribution<RealType, Policy> >
  * Boost does not catch the case where the location or scale parameters are
  * non-finite.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::extreme_value_distribution<RealType, Policy> >
   : public RealDomainCheck<
@@ -576,7 +572,6 @@ struct DomainCheck<boost::math::extreme_value_distribution<RealType, Policy> >
  *
  * https://svn.boost.org/trac/boost/ticket/6937
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::fisher_f_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -615,7 +610,6 @@ struct DomainCheck<boost::math::fisher_f_distribution<RealType, Policy> >
  * For the gamma distribution, boost's pdf always returns 0 for x = 0. That is
  * wrong.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::gamma_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -657,7 +651,6 @@ struct DomainCheck<boost::math::gamma_distribution<RealType, Policy> >
  *
  * https://svn.boost.org/trac/boost/ticket/6937
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::geometric_distribution<RealType, Policy> >
   : public NonNegativeIntegerDomainCheck<
@@ -701,7 +694,6 @@ struct DomainCheck<boost::math::geometric_distribution<RealType, Policy> >
 /**
  * @brief Boost only accepts a limited range for random variates
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::hypergeometric_distribution<RealType, Policy> >
   : public NonNegativeIntegerDomainCheck<
@@ -744,7 +736,6 @@ struct DomainCheck<boost::math::hypergeometric_distribution<RealType, Policy> >
 /**
  * @brief Boost returns a small non-zero value for quantile(0) instead of 0
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::inverse_gamma_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -778,7 +769,6 @@ struct DomainCheck<boost::math::inverse_gamma_distribution<RealType, Policy> >
  * FIXME: No boost bug filed so far
  * Boost does not catch the case where location or scale are not finite.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::lognormal_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -832,7 +822,6 @@ struct DomainCheck<boost::math::lognormal_distribution<RealType, Policy> >
  * Also, we want to raise an error if the success probability is 0, because the
  * distribution is not well-defined in that case.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::negative_binomial_distribution<RealType, Policy> >
   : public NonNegativeIntegerDomainCheck<
@@ -906,7 +895,6 @@ struct DomainCheck<boost::math::negative_binomial_distribution<RealType, Policy>
  *
  * FIXME: No boost bug filed so far
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::non_central_beta_distribution<RealType, Policy> >
   : public ZeroOneDomainCheck<
@@ -960,7 +948,6 @@ struct DomainCheck<boost::math::non_central_beta_distribution<RealType, Policy>
  *
  * FIXME: No boost bug filed so far
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::non_central_chi_squared_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -1003,7 +990,6 @@ struct DomainCheck<boost::math::non_central_chi_squared_distribution<RealType, P
  *
  * FIXME: No boost bug filed so far
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::non_central_f_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -1047,7 +1033,6 @@ struct DomainCheck<boost::math::non_central_f_distribution<RealType, Policy> >
  * For the Pareto distribution, boost sometimes returns max_value instead
  * of infinity. We override that.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::pareto_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -1112,7 +1097,6 @@ struct DomainCheck<boost::math::pareto_distribution<RealType, Policy> >
  *
  * https://svn.boost.org/trac/boost/ticket/6937
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::poisson_distribution<RealType, Policy> >
   : public NonNegativeIntegerDomainCheck<
@@ -1148,7 +1132,6 @@ struct DomainCheck<boost::math::poisson_distribution<RealType, Policy> >
  * FIXME: No boost bug filed so far
  * Boost does not catch the case where sigma is NaN.
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::rayleigh_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -1215,7 +1198,6 @@ struct DomainCheck<boost::math::rayleigh_distribution<RealType, Policy> >
  * https://svn.boost.org/trac/boost/ticket/6938
  * https://svn.boost.org/trac/boost/ticket/6939
  */
-template <>
 template <class RealType, class Policy>
 struct DomainCheck<boost::math::weibull_distribution<RealType, Policy> >
   : public PositiveDomainCheck<
@@ -1294,7 +1276,6 @@ struct DomainCheck<boost::math::weibull_distribution<RealType, Policy> >
 
 
 #define DOMAIN_CHECK_OVERRIDE(dist, check) \
-    template <> \
     template <class RealType, class Policy> \
     struct DomainCheck<boost::math::dist ## _distribution<RealType, Policy> > \
       : public check<boost::math::dist ## _distribution<RealType, Policy> > { };
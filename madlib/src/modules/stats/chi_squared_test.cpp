@@ -10,6 +10,9 @@
 #include <modules/shared/HandleTraits.hpp>
 #include <modules/prob/boost.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include "chi_squared_test.hpp"
 
 namespace madlib {
@@ -175,6 +178,275 @@ chi2_gof_test_final::run(AnyType &args) {
     return tuple;
 }
 
+/**
+ * @brief Transition state for the chi-squared test of independence
+ *
+ * The contingency table is sparse: an open-addressing hash table of
+ * (a, b) -> count stored in the DOUBLE PRECISION array itself, so that only
+ * the category pairs that occur take space and states merge without ever
+ * becoming dense. The marginals are summed from the table in the final
+ * function. Category ids must be exactly representable as doubles.
+ *
+ * Note: We assume that the DOUBLE PRECISION array is initialized by the
+ * database with length 3, and all elements are 0. Handle::operator[] will
+ * perform bounds checking.
+ */
+template <class Handle>
+class Chi2IndepTestTransitionState {
+public:
+    Chi2IndepTestTransitionState(const AnyType &inArray)
+      : mStorage(inArray.getAs<Handle>()) {
+
+        rebind();
+    }
+
+    inline operator AnyType() const {
+        return mStorage;
+    }
+
+    /**
+     * @brief Add count observations of the pair (a, b)
+     *
+     * The table is kept at most half full; when the next pair would exceed
+     * that, the storage is reallocated with twice the slots.
+     */
+    void add(const Allocator &inAllocator, double a, double b, double count);
+
+    /**
+     * @brief Number of slots, the slot of pair i is cell(i), a free slot
+     *     has count 0
+     */
+    uint64_t numSlots() const {
+        return static_cast<uint64_t>(slotsReserved);
+    }
+
+    const double *cell(uint64_t inSlot) const {
+        return &cells[3 * inSlot];
+    }
+
+private:
+    static inline size_t arraySize(uint64_t inNumSlots) {
+        return 3 + 3 * inNumSlots;
+    }
+
+    static inline uint64_t hash(double a, double b) {
+        uint64_t h = static_cast<uint64_t>(static_cast<int64_t>(a))
+            * 0x9E3779B97F4A7C15ULL;
+        h ^= static_cast<uint64_t>(static_cast<int64_t>(b))
+            + 0x7F4A7C159E3779B9ULL + (h << 6) + (h >> 2);
+        return h ^ (h >> 29);
+    }
+
+    void rebind() {
+        numRows.rebind(&mStorage[0]);
+        slotsReserved.rebind(&mStorage[1]);
+        slotsUsed.rebind(&mStorage[2]);
+        madlib_assert(mStorage.size() >= arraySize(numSlots()),
+            std::runtime_error("Out-of-bounds array access detected."));
+        cells = mStorage.size() > 3 ? &mStorage[3] : NULL;
+    }
+
+    /**
+     * @brief Add to the cell of (a, b), there must be a free slot
+     */
+    void insert(double a, double b, double count) {
+        uint64_t mask = numSlots() - 1;
+        for (uint64_t i = hash(a, b) & mask; ; i = (i + 1) & mask) {
+            double *c = &cells[3 * i];
+            if (c[2] == 0) {
+                c[0] = a;
+                c[1] = b;
+                c[2] = count;
+                slotsUsed++;
+                return;
+            }
+            if (c[0] == a && c[1] == b) {
+                c[2] += count;
+                return;
+            }
+        }
+    }
+
+    Handle mStorage;
+
+public:
+    typename HandleTraits<Handle>::ReferenceToDouble numRows;
+    typename HandleTraits<Handle>::ReferenceToUInt64 slotsReserved;
+    typename HandleTraits<Handle>::ReferenceToUInt64 slotsUsed;
+    typename HandleTraits<Handle>::DoublePtr cells;
+};
+
+template <>
+void
+Chi2IndepTestTransitionState<MutableArrayHandle<double> >::add(
+    const Allocator &inAllocator, double a, double b, double count) {
+
+    if (2 * (slotsUsed + 1) > numSlots()) {
+        // Save our current state, so we can subsequently restore it with the
+        // new storage
+        Chi2IndepTestTransitionState oldSelf = *this;
+        uint64_t oldSlots = oldSelf.numSlots();
+        uint64_t newSlots = oldSlots == 0 ? 64 : 2 * oldSlots;
+
+        mStorage = inAllocator.allocateArray<double, dbal::AggregateContext,
+            dbal::DoZero, dbal::ThrowBadAlloc>(arraySize(newSlots));
+        numRows.rebind(&mStorage[0]);
+        slotsReserved.rebind(&mStorage[1]);
+        numRows = oldSelf.numRows;
+        slotsReserved = newSlots;
+        rebind();
+
+        for (uint64_t i = 0; i < oldSlots; i++) {
+            const double *c = oldSelf.cell(i);
+            if (c[2] != 0)
+                insert(c[0], c[1], c[2]);
+        }
+    }
+
+    insert(a, b, count);
+    numRows += count;
+}
+
+/**
+ * @brief Perform the transition step: args are state, a, b and optionally
+ *     the number of observations of the pair (default 1)
+ */
+AnyType
+chi2_indep_test_transition::run(AnyType &args) {
+    Chi2IndepTestTransitionState<MutableArrayHandle<double> > state = args[0];
+    int64_t a = args[1].getAs<int64_t>();
+    int64_t b = args[2].getAs<int64_t>();
+    int64_t count = args.numFields() <= 3 ? 1 : args[3].getAs<int64_t>();
+
+    if (count < 0)
+        throw std::invalid_argument("Number of observations must be "
+            "nonnegative.");
+    else if (count == 0)
+        return state;
+
+    state.add(*this, static_cast<double>(a), static_cast<double>(b),
+        static_cast<double>(count));
+    return state;
+}
+
+/**
+ * @brief Perform the perliminary aggregation function: Merge transition states
+ */
+AnyType
+chi2_indep_test_merge_states::run(AnyType &args) {
+    Chi2IndepTestTransitionState<MutableArrayHandle<double> > stateLeft
+        = args[0];
+    Chi2IndepTestTransitionState<ArrayHandle<double> > stateRight = args[1];
+
+    if (stateLeft.numRows == 0)
+        return stateRight;
+
+    // Merge states together and return
+    for (uint64_t i = 0; i < stateRight.numSlots(); i++) {
+        const double *c = stateRight.cell(i);
+        if (c[2] != 0)
+            stateLeft.add(*this, c[0], c[1], c[2]);
+    }
+
+    return stateLeft;
+}
+
+/**
+ * @brief Sum the counts of the cells per category of one side
+ *
+ * On return, marginal[i] is the total count of the category of cell i.
+ * Returns the number of distinct categories.
+ */
+inline
+uint64_t
+chi2Marginals(const std::vector<const double*> &inCells, int inSide,
+    std::vector<double> &outMarginal) {
+
+    std::vector<std::pair<double, uint64_t> > order(inCells.size());
+    for (uint64_t i = 0; i < inCells.size(); i++)
+        order[i] = std::make_pair(inCells[i][inSide], i);
+    std::sort(order.begin(), order.end());
+
+    outMarginal.resize(inCells.size());
+    uint64_t numCategories = 0;
+    for (uint64_t start = 0, end; start < order.size(); start = end) {
+        double total = 0;
+        for (end = start; end < order.size()
+            && order[end].first == order[start].first; end++)
+            total += inCells[order[end].second][2];
+        for (uint64_t k = start; k < end; k++)
+            outMarginal[order[k].second] = total;
+        numCategories++;
+    }
+    return numCategories;
+}
+
+/**
+ * @brief Perform the chi-squared test of independence final step
+ *
+ * Only the non-zero cells contribute: Pearson's statistic is
+ * sum O^2 / E - n and the G-statistic is 2 sum O ln(O / E) with
+ * E = row total * column total / n.
+ */
+AnyType
+chi2_indep_test_final::run(AnyType &args) {
+    using boost::math::complement;
+
+    Chi2IndepTestTransitionState<ArrayHandle<double> > state = args[0];
+
+    // If we haven't seen any data, just return Null.
+    if (state.numRows == 0)
+        return Null();
+
+    std::vector<const double*> cells;
+    cells.reserve(static_cast<uint64_t>(state.slotsUsed));
+    for (uint64_t i = 0; i < state.numSlots(); i++)
+        if (state.cell(i)[2] != 0)
+            cells.push_back(state.cell(i));
+
+    std::vector<double> rowTotal, colTotal;
+    uint64_t numRowCategories = chi2Marginals(cells, 0, rowTotal);
+    uint64_t numColCategories = chi2Marginals(cells, 1, colTotal);
+
+    double n = state.numRows;
+    double sumObsSquareOverExp = 0;
+    double g = 0;
+    for (uint64_t i = 0; i < cells.size(); i++) {
+        double observed = cells[i][2];
+        double expected = rowTotal[i] * colTotal[i] / n;
+        sumObsSquareOverExp += observed * observed / expected;
+        g += observed * std::log(observed / expected);
+    }
+    double statistic = std::max(sumObsSquareOverExp - n, 0.);
+    g = std::max(2 * g, 0.);
+
+    int64_t degreeOfFreedom = static_cast<int64_t>(
+        (numRowCategories - 1) * (numColCategories - 1));
+
+    // Cramer's V
+    uint64_t minDim = std::min(numRowCategories, numColCategories);
+    double V = minDim > 1
+        ? std::sqrt(statistic / (n * static_cast<double>(minDim - 1)))
+        : 0.;
+
+    AnyType tuple;
+    tuple
+        << statistic
+        << (degreeOfFreedom > 0
+            ? prob::cdf(complement(prob::chi_squared(
+                static_cast<double>(degreeOfFreedom)), statistic))
+            : Null())
+        << degreeOfFreedom
+        << g
+        << (degreeOfFreedom > 0
+            ? prob::cdf(complement(prob::chi_squared(
+                static_cast<double>(degreeOfFreedom)), g))
+            : Null())
+        << V;
+    return tuple;
+}
+
+
 } // namespace stats
 
 } // namespace modules
@@ -18,3 +18,18 @@ DECLARE_UDF(stats, chi2_gof_test_merge_states)
  * @brief Pearson's chi-squared test: Final function
  */
 DECLARE_UDF(stats, chi2_gof_test_final)
+
+/**
+ * @brief Chi-squared test of independence: Transition function
+ */
+DECLARE_UDF(stats, chi2_indep_test_transition)
+
+/**
+ * @brief Chi-squared test of independence: State merge function
+ */
+DECLARE_UDF(stats, chi2_indep_test_merge_states)
+
+/**
+ * @brief Chi-squared test of independence: Final function
+ */
+DECLARE_UDF(stats, chi2_indep_test_final)
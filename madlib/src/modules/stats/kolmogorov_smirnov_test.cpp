@@ -10,6 +10,10 @@
 #include <modules/shared/HandleTraits.hpp>
 #include <modules/prob/kolmogorov.hpp>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "kolmogorov_smirnov_test.hpp"
 
 namespace madlib {
@@ -18,23 +22,46 @@ namespace modules {
 
 namespace stats {
 
+/**
+ * @brief The number of doubles of a run in the transition state
+ */
+const size_t kKSRunSize = 12;
+
 /**
  * @brief Transition state for Kolmogorov-Smirnov-Test functions
  *
+ * A state is a list of runs of kKSRunSize doubles, each covering a sorted
+ * run of values. To merge the runs of fragments that received disjoint
+ * ranges (see ks_merge_all_runs), a run also keeps the first value and the
+ * signed difference F_1 - F_2 of the empirical distribution functions: its
+ * extremes over the ends of the groups of ties seen so far, and its last
+ * value. The differences are relative to the start of the run, a run above
+ * others is offset by their last signed difference. The transition function
+ * extends the first run, the merge function concatenates the lists.
+ *
  * Note: We assume that the DOUBLE PRECISION array is initialized by the
- * database with length 7, and all elemenets are 0. Handle::operator[] will
+ * database with length 12, and all elemenets are 0. Handle::operator[] will
  * perform bounds checking.
  */
 template <class Handle>
 class KSTestTransitionState {
 public:
-    KSTestTransitionState(const AnyType &inArray)
+    KSTestTransitionState(const AnyType &inArray, size_t inRun = 0)
       : mStorage(inArray.getAs<Handle>()),
-        num(&mStorage[0], 2),
-        expectedNum(&mStorage[2], 2),
-        last(&mStorage[4]),
-        maxDiff(&mStorage[5]),
-        lastDiff(&mStorage[6]) { }
+        num(&mStorage[kKSRunSize * inRun], 2),
+        expectedNum(&mStorage[kKSRunSize * inRun + 2], 2),
+        last(&mStorage[kKSRunSize * inRun + 4]),
+        maxDiff(&mStorage[kKSRunSize * inRun + 5]),
+        lastDiff(&mStorage[kKSRunSize * inRun + 6]),
+        first(&mStorage[kKSRunSize * inRun + 7]),
+        lastSignedDiff(&mStorage[kKSRunSize * inRun + 8]),
+        maxSignedDiff(&mStorage[kKSRunSize * inRun + 9]),
+        minSignedDiff(&mStorage[kKSRunSize * inRun + 10]),
+        numGroups(&mStorage[kKSRunSize * inRun + 11]) { }
+
+    size_t numRuns() const {
+        return mStorage.size() / kKSRunSize;
+    }
 
     inline operator AnyType() const {
         return mStorage;
@@ -49,6 +76,11 @@ public:
     typename HandleTraits<Handle>::ReferenceToDouble last;
     typename HandleTraits<Handle>::ReferenceToDouble maxDiff;
     typename HandleTraits<Handle>::ReferenceToDouble lastDiff;
+    typename HandleTraits<Handle>::ReferenceToDouble first;
+    typename HandleTraits<Handle>::ReferenceToDouble lastSignedDiff;
+    typename HandleTraits<Handle>::ReferenceToDouble maxSignedDiff;
+    typename HandleTraits<Handle>::ReferenceToDouble minSignedDiff;
+    typename HandleTraits<Handle>::ReferenceToUInt64 numGroups;
 };
 
 /**
@@ -79,24 +111,169 @@ ks_test_transition::run(AnyType &args) {
         if (state.last > value)
             throw std::invalid_argument("Must be used as an ordered "
                 "aggregate, in ascending order of the second argument.");
-        else if (state.last < value && state.maxDiff < state.lastDiff)
+        else if (state.last < value) {
             // We have seen the end of a group of ties, so we may now compare
             // the empirical distribution functions (conceptually, we are
             // evaluating the two empricical distribution functions at
             // state.last).
             // Note: We must wait till we have seen all rows of a group of ties.
             // (See also MADLIB-554).
-            state.maxDiff = state.lastDiff;
+            if (state.maxDiff < state.lastDiff)
+                state.maxDiff = state.lastDiff;
+            if (state.numGroups == 0
+                || state.maxSignedDiff < state.lastSignedDiff)
+                state.maxSignedDiff = state.lastSignedDiff;
+            if (state.numGroups == 0
+                || state.minSignedDiff > state.lastSignedDiff)
+                state.minSignedDiff = state.lastSignedDiff;
+            state.numGroups++;
+        }
+    } else {
+        state.first = value;
     }
     state.num(sample)++;
     state.last = value;
 
-    state.lastDiff = std::fabs(state.num(0) / state.expectedNum(0)
-                    - state.num(1) / state.expectedNum(1));
+    state.lastSignedDiff = state.num(0) / state.expectedNum(0)
+                         - state.num(1) / state.expectedNum(1);
+    state.lastDiff = std::fabs(state.lastSignedDiff);
 
     return state;
 }
 
+/**
+ * @brief Merge the states of two adjacent sorted runs into out
+ *
+ * The signed differences of the upper run are offset by the last signed
+ * difference of the lower one. Unless the upper run starts with the last
+ * value of the lower one, that last difference ends a group of ties too.
+ *
+ * out may be lower or upper.
+ */
+template <class Lower, class Upper>
+void
+ks_merge_runs(KSTestTransitionState<MutableArrayHandle<double> > &out,
+    const Lower &lower, const Upper &upper) {
+
+    if (lower.last > upper.first)
+        throw std::invalid_argument("Fragments must receive disjoint ranges "
+            "of the second argument, each in ascending order.");
+    bool tied = lower.last == upper.first;
+
+    double offset = lower.lastSignedDiff;
+    uint64_t numGroups = lower.numGroups;
+    double maxSignedDiff = lower.maxSignedDiff;
+    double minSignedDiff = lower.minSignedDiff;
+    if (!tied) {
+        if (numGroups == 0 || maxSignedDiff < offset)
+            maxSignedDiff = offset;
+        if (numGroups == 0 || minSignedDiff > offset)
+            minSignedDiff = offset;
+        numGroups++;
+    }
+    if (upper.numGroups > 0) {
+        if (numGroups == 0 || maxSignedDiff < offset + upper.maxSignedDiff)
+            maxSignedDiff = offset + upper.maxSignedDiff;
+        if (numGroups == 0 || minSignedDiff > offset + upper.minSignedDiff)
+            minSignedDiff = offset + upper.minSignedDiff;
+        numGroups += upper.numGroups;
+    }
+    double lastSignedDiff = offset + upper.lastSignedDiff;
+    double first = lower.first;
+    double last = upper.last;
+    Eigen::Vector2d num = lower.num + upper.num;
+
+    out.num = num;
+    out.first = first;
+    out.last = last;
+    out.numGroups = numGroups;
+    out.maxSignedDiff = maxSignedDiff;
+    out.minSignedDiff = minSignedDiff;
+    out.maxDiff = numGroups == 0 ? 0.
+        : std::max(std::fabs(maxSignedDiff), std::fabs(minSignedDiff));
+    out.lastSignedDiff = lastSignedDiff;
+    out.lastDiff = std::fabs(lastSignedDiff);
+}
+
+/**
+ * @brief Merge the states of two fragments
+ *
+ * The fragments must have received disjoint ranges of values, and each must
+ * have seen its range in ascending order. The runs of both states are kept,
+ * the final function merges them, so neither the order of the ranges nor the
+ * order of the merges matters.
+ */
+AnyType
+ks_test_merge_states::run(AnyType &args) {
+    KSTestTransitionState<MutableArrayHandle<double> > stateLeft = args[0];
+    KSTestTransitionState<ArrayHandle<double> > stateRight = args[1];
+
+    // We first handle the trivial case where this function is called with one
+    // of the states being the initial state
+    if (stateLeft.num.sum() == 0)
+        return stateRight;
+    else if (stateRight.num.sum() == 0)
+        return stateLeft;
+
+    if (stateLeft.expectedNum != stateRight.expectedNum)
+        throw std::invalid_argument("Number of samples must be constant "
+            "parameters.");
+
+    ArrayHandle<double> left = args[0].getAs<ArrayHandle<double> >();
+    ArrayHandle<double> right = args[1].getAs<ArrayHandle<double> >();
+    MutableArrayHandle<double> runs = allocateArray<double,
+        dbal::AggregateContext, dbal::DoZero, dbal::ThrowBadAlloc>(
+            left.size() + right.size());
+    std::copy(left.ptr(), left.ptr() + left.size(), runs.ptr());
+    std::copy(right.ptr(), right.ptr() + right.size(),
+        runs.ptr() + left.size());
+    return runs;
+}
+
+/**
+ * @brief Merge the runs of a state, in ascending order, into one run
+ *
+ * Runs that start with the same group of ties are ordered by their end.
+ */
+inline
+MutableArrayHandle<double>
+ks_merge_all_runs(const Allocator &inAllocator, const AnyType &inState) {
+    KSTestTransitionState<ArrayHandle<double> > state = inState;
+    std::vector<std::pair<std::pair<double, double>, size_t> > order;
+    for (size_t k = 0; k < state.numRuns(); k++) {
+        KSTestTransitionState<ArrayHandle<double> > run(inState, k);
+        if (run.num.sum() > 0)
+            order.push_back(std::make_pair(std::make_pair(
+                static_cast<double>(run.first),
+                static_cast<double>(run.last)), k));
+    }
+    std::sort(order.begin(), order.end());
+
+    MutableArrayHandle<double> merged
+        = inAllocator.allocateArray<double>(kKSRunSize);
+    KSTestTransitionState<MutableArrayHandle<double> > out
+        = static_cast<AnyType>(merged);
+    out.expectedNum = state.expectedNum;
+    for (size_t i = 0; i < order.size(); i++) {
+        KSTestTransitionState<ArrayHandle<double> > run(inState,
+            order[i].second);
+        if (i == 0) {
+            out.num = run.num;
+            out.last = run.last;
+            out.maxDiff = run.maxDiff;
+            out.lastDiff = run.lastDiff;
+            out.first = run.first;
+            out.lastSignedDiff = run.lastSignedDiff;
+            out.maxSignedDiff = run.maxSignedDiff;
+            out.minSignedDiff = run.minSignedDiff;
+            out.numGroups = run.numGroups;
+        } else {
+            ks_merge_runs(out, out, run);
+        }
+    }
+    return merged;
+}
+
 /**
  * @brief Perform the Kolmogorov-Smirnov-test final step
  *
@@ -121,7 +298,8 @@ AnyType
 ks_test_final::run(AnyType &args) {
     using boost::math::complement;
 
-    KSTestTransitionState<ArrayHandle<double> > state = args[0];
+    AnyType merged = ks_merge_all_runs(*this, args[0]);
+    KSTestTransitionState<ArrayHandle<double> > state = merged;
 
     if (state.num != state.expectedNum) {
         std::stringstream tmp;
@@ -9,6 +9,11 @@
  */
 DECLARE_UDF(stats, ks_test_transition)
 
+/**
+ * @brief Kolmogorov-Smirnov Test: Merge function
+ */
+DECLARE_UDF(stats, ks_test_merge_states)
+
 /**
  * @brief Kolmogorov-Smirnov Test: Final function
  */
@@ -11,6 +11,10 @@
 #include <modules/shared/HandleTraits.hpp>
 #include <utils/Math.hpp>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "mann_whitney_test.hpp"
 
 namespace madlib {
@@ -19,22 +23,41 @@ namespace modules {
 
 namespace stats {
 
+/**
+ * @brief The number of doubles of a run in the transition state
+ */
+const size_t kMWRunSize = 10;
+
 /**
  * @brief Transition state for Mann-Whitney-Test functions
  *
+ * A state is a list of runs of kMWRunSize doubles, each covering a sorted
+ * run of values. Besides the last value and the ties at its end, a run keeps
+ * the first value and the ties at its start, so that the runs of fragments
+ * that received disjoint ranges of values can be merged exactly. The
+ * transition function extends the first run, the merge function
+ * concatenates the lists, and the final function merges the runs in
+ * ascending order, so states may be merged in any order.
+ *
  * Note: We assume that the DOUBLE PRECISION array is initialized by the
- * database with length 7, and all elemenets are 0. Handle::operator[] will
+ * database with length 10, and all elemenets are 0. Handle::operator[] will
  * perform bounds checking.
  */
 template <class Handle>
 class MWTestTransitionState {
 public:
-    MWTestTransitionState(const AnyType &inArray)
+    MWTestTransitionState(const AnyType &inArray, size_t inRun = 0)
       : mStorage(inArray.getAs<Handle>()),
-        num(&mStorage[0], 2),
-        numTies(&mStorage[2], 2),
-        rankSum(&mStorage[4], 2),
-        last(&mStorage[6]) { }
+        num(&mStorage[kMWRunSize * inRun], 2),
+        numTies(&mStorage[kMWRunSize * inRun + 2], 2),
+        rankSum(&mStorage[kMWRunSize * inRun + 4], 2),
+        last(&mStorage[kMWRunSize * inRun + 6]),
+        first(&mStorage[kMWRunSize * inRun + 7]),
+        leadTies(&mStorage[kMWRunSize * inRun + 8], 2) { }
+
+    size_t numRuns() const {
+        return mStorage.size() / kMWRunSize;
+    }
 
     inline operator AnyType() const {
         return mStorage;
@@ -48,6 +71,8 @@ public:
     typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap numTies;
     typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap rankSum;
     typename HandleTraits<Handle>::ReferenceToDouble last;
+    typename HandleTraits<Handle>::ReferenceToDouble first;
+    typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap leadTies;
 };
 
 /**
@@ -62,7 +87,9 @@ mw_test_transition::run(AnyType &args) {
     // For almostEqual, we choose a precision of 2 * 1 units in the last place.
     // This is because we assume that value is original data, so the only
     // precision loss is due to representation as floating-point number.
+    bool tied = false;
     if (utils::almostEqual(static_cast<double>(state.last), value, 2)) {
+        tied = true;
         for (int i = 0; i <= 1; i++)
             state.rankSum(i) += state.numTies(i) * 0.5;
     } else if (state.last < value) {
@@ -77,6 +104,12 @@ mw_test_transition::run(AnyType &args) {
             "in ascending order of the second argument.");
     }
 
+    if (state.num.sum() == 0)
+        state.first = value;
+    if (state.num.sum() == 0
+        || (tied && state.leadTies.sum() == state.num.sum()))
+        state.leadTies(sample)++;
+
     state.num(sample)++;
     state.rankSum(sample) += (2. * state.num.sum() - state.numTies.sum()) / 2.;
     state.numTies(sample)++;
@@ -85,11 +118,131 @@ mw_test_transition::run(AnyType &args) {
     return state;
 }
 
+/**
+ * @brief Merge the states of two adjacent sorted runs into out
+ *
+ * The ranks of the upper run are offset by the number of values in the lower
+ * one. If the last value of the lower run ties with the first of the upper
+ * one, the two groups of ties become one and their mid-ranks are corrected:
+ * the tied values of the lower run move up by half the ties of the upper run,
+ * and those of the upper run down by half the ties of the lower run.
+ *
+ * out may be lower or upper.
+ */
+template <class Lower, class Upper>
+void
+mw_merge_runs(MWTestTransitionState<MutableArrayHandle<double> > &out,
+    const Lower &lower, const Upper &upper) {
+
+    bool tied = utils::almostEqual(static_cast<double>(lower.last),
+        static_cast<double>(upper.first), 2);
+    if (!tied && lower.last > upper.first)
+        throw std::invalid_argument("Fragments must receive disjoint ranges "
+            "of the second argument, each in ascending order.");
+
+    Eigen::Vector2d num = lower.num + upper.num;
+    Eigen::Vector2d rankSum = lower.rankSum + upper.rankSum
+        + upper.num * lower.num.sum();
+    Eigen::Vector2d numTies = upper.numTies;
+    Eigen::Vector2d leadTies = lower.leadTies;
+    if (tied) {
+        rankSum += lower.numTies * (upper.leadTies.sum() * 0.5)
+            - upper.leadTies * (lower.numTies.sum() * 0.5);
+        // a run that is a single group of ties extends the group of the other
+        if (upper.leadTies.sum() == upper.num.sum())
+            numTies += lower.numTies;
+        if (lower.leadTies.sum() == lower.num.sum())
+            leadTies += upper.leadTies;
+    }
+    double first = lower.first;
+    double last = upper.last;
+
+    out.num = num;
+    out.rankSum = rankSum;
+    out.numTies = numTies;
+    out.leadTies = leadTies;
+    out.first = first;
+    out.last = last;
+}
+
+/**
+ * @brief Merge the states of two fragments
+ *
+ * The fragments must have received disjoint ranges of values, for instance
+ * by range-partitioning on the value, and each must have seen its range in
+ * ascending order. The runs of both states are kept, the final function
+ * merges them, so neither the order of the ranges nor the order of the
+ * merges matters.
+ */
+AnyType
+mw_test_merge_states::run(AnyType &args) {
+    MWTestTransitionState<MutableArrayHandle<double> > stateLeft = args[0];
+    MWTestTransitionState<ArrayHandle<double> > stateRight = args[1];
+
+    // We first handle the trivial case where this function is called with one
+    // of the states being the initial state
+    if (stateLeft.num.sum() == 0)
+        return stateRight;
+    else if (stateRight.num.sum() == 0)
+        return stateLeft;
+
+    ArrayHandle<double> left = args[0].getAs<ArrayHandle<double> >();
+    ArrayHandle<double> right = args[1].getAs<ArrayHandle<double> >();
+    MutableArrayHandle<double> runs = allocateArray<double,
+        dbal::AggregateContext, dbal::DoZero, dbal::ThrowBadAlloc>(
+            left.size() + right.size());
+    std::copy(left.ptr(), left.ptr() + left.size(), runs.ptr());
+    std::copy(right.ptr(), right.ptr() + right.size(),
+        runs.ptr() + left.size());
+    return runs;
+}
+
+/**
+ * @brief Merge the runs of a state, in ascending order, into one run
+ *
+ * Runs that start with the same group of ties are ordered by their end.
+ */
+inline
+MutableArrayHandle<double>
+mw_merge_all_runs(const Allocator &inAllocator, const AnyType &inState) {
+    MWTestTransitionState<ArrayHandle<double> > state = inState;
+    std::vector<std::pair<std::pair<double, double>, size_t> > order;
+    for (size_t k = 0; k < state.numRuns(); k++) {
+        MWTestTransitionState<ArrayHandle<double> > run(inState, k);
+        if (run.num.sum() > 0)
+            order.push_back(std::make_pair(std::make_pair(
+                static_cast<double>(run.first),
+                static_cast<double>(run.last)), k));
+    }
+    std::sort(order.begin(), order.end());
+
+    MutableArrayHandle<double> merged
+        = inAllocator.allocateArray<double>(kMWRunSize);
+    MWTestTransitionState<MutableArrayHandle<double> > out
+        = static_cast<AnyType>(merged);
+    for (size_t i = 0; i < order.size(); i++) {
+        MWTestTransitionState<ArrayHandle<double> > run(inState,
+            order[i].second);
+        if (i == 0) {
+            out.num = run.num;
+            out.numTies = run.numTies;
+            out.rankSum = run.rankSum;
+            out.leadTies = run.leadTies;
+            out.first = run.first;
+            out.last = run.last;
+        } else {
+            mw_merge_runs(out, out, run);
+        }
+    }
+    return merged;
+}
+
 AnyType
 mw_test_final::run(AnyType &args) {
     using boost::math::complement;
 
-    MWTestTransitionState<ArrayHandle<double> > state = args[0];
+    AnyType merged = mw_merge_all_runs(*this, args[0]);
+    MWTestTransitionState<ArrayHandle<double> > state = merged;
 
     Eigen::Vector2d U;
     double numProd = state.num.prod();
@@ -9,6 +9,11 @@
  */
 DECLARE_UDF(stats, mw_test_transition)
 
+/**
+ * @brief Mann-Whitney U Test: Merge function
+ */
+DECLARE_UDF(stats, mw_test_merge_states)
+
 /**
  * @brief Mann-Whitney U Test: Final function
  */
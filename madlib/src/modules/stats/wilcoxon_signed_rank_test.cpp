@@ -11,6 +11,10 @@
 #include <modules/shared/HandleTraits.hpp>
 #include <utils/Math.hpp>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "wilcoxon_signed_rank_test.hpp"
 
 namespace madlib {
@@ -19,23 +23,42 @@ namespace modules {
 
 namespace stats {
 
+/**
+ * @brief The number of doubles of a run in the transition state
+ */
+const size_t kWSRRunSize = 13;
+
 /**
  * @brief Transition state for Wilcoxon signed-rank functions
  *
+ * A state is a list of runs of kWSRRunSize doubles, each covering a sorted
+ * run of absolute values. The first absolute value, its lower bound and the
+ * ties at the start of a run let the runs of fragments that received
+ * disjoint ranges be merged exactly. The transition function extends the
+ * first run, the merge function concatenates the lists, and the final
+ * function merges the runs in ascending order (see wsr_merge_all_runs).
+ *
  * Note: We assume that the DOUBLE PRECISION array is initialized by the
- * database with length 9, and all elemenets are 0.
+ * database with length 13, and all elemenets are 0.
  */
 template <class Handle>
 class WSRTestTransitionState {
 public:
-    WSRTestTransitionState(const AnyType &inArray)
+    WSRTestTransitionState(const AnyType &inArray, size_t inRun = 0)
       : mStorage(inArray.getAs<Handle>()),
-        num(&mStorage[0], 2),
-        numTies(&mStorage[2], 2),
-        rankSum(&mStorage[4], 2),
-        lastAbs(&mStorage[6]),
-        lastAbsUpperBound(&mStorage[7]),
-        reduceVariance(&mStorage[8]) { }
+        num(&mStorage[kWSRRunSize * inRun], 2),
+        numTies(&mStorage[kWSRRunSize * inRun + 2], 2),
+        rankSum(&mStorage[kWSRRunSize * inRun + 4], 2),
+        lastAbs(&mStorage[kWSRRunSize * inRun + 6]),
+        lastAbsUpperBound(&mStorage[kWSRRunSize * inRun + 7]),
+        reduceVariance(&mStorage[kWSRRunSize * inRun + 8]),
+        firstAbs(&mStorage[kWSRRunSize * inRun + 9]),
+        firstAbsLowerBound(&mStorage[kWSRRunSize * inRun + 10]),
+        leadTies(&mStorage[kWSRRunSize * inRun + 11], 2) { }
+
+    size_t numRuns() const {
+        return mStorage.size() / kWSRRunSize;
+    }
 
     inline operator AnyType() const {
         return mStorage;
@@ -51,6 +74,9 @@ public:
     typename HandleTraits<Handle>::ReferenceToDouble lastAbs;
     typename HandleTraits<Handle>::ReferenceToDouble lastAbsUpperBound;
     typename HandleTraits<Handle>::ReferenceToDouble reduceVariance;
+    typename HandleTraits<Handle>::ReferenceToDouble firstAbs;
+    typename HandleTraits<Handle>::ReferenceToDouble firstAbsLowerBound;
+    typename HandleTraits<Handle>::ColumnVectorTransparentHandleMap leadTies;
 };
 
 
@@ -81,12 +107,14 @@ wsr_test_transition::run(AnyType &args) {
     double absValue = std::fabs(value);
     int sample = value > 0 ? 0 : 1;
 
+    bool tied = false;
     if (state.num.sum() > 0) {
         if (absValue < state.lastAbs)
             throw std::invalid_argument("Must be used as an ordered aggregate, "
                 "in ascending order of the absolute value of the first "
                 "argument.");
         else if (absValue - precision <= state.lastAbsUpperBound) {
+            tied = true;
             for (int i = 0; i <= 1; i++)
                 state.rankSum(i) += state.numTies(i) * 0.5;
 
@@ -113,6 +141,14 @@ wsr_test_transition::run(AnyType &args) {
         }
     }
 
+    if (state.num.sum() == 0) {
+        state.firstAbs = absValue;
+        state.firstAbsLowerBound = absValue - precision;
+    }
+    if (state.num.sum() == 0
+        || (tied && state.leadTies.sum() == state.num.sum()))
+        state.leadTies(sample)++;
+
     state.num(sample)++;
     state.rankSum(sample) += (2. * state.num.sum() - state.numTies.sum()) / 2.;
     state.numTies(sample)++;
@@ -123,11 +159,153 @@ wsr_test_transition::run(AnyType &args) {
     return state;
 }
 
+/**
+ * @brief (t^3 - t)/48, the reduction of the variance due to a group of t
+ * ties
+ */
+inline double wsr_tie_variance(double t) {
+    return (t * t * t - t) / 48.;
+}
+
+/**
+ * @brief Merge the states of two adjacent sorted runs into out
+ *
+ * The ranks of the upper run are offset by the number of values in the lower
+ * one. If the first value of the upper run ties with the last of the lower
+ * one, the two groups of ties become one: their mid-ranks are corrected as in
+ * mw_merge_runs, and the variance reduction of the two groups is replaced by
+ * the one of the joint group.
+ *
+ * out may be lower or upper.
+ */
+template <class Lower, class Upper>
+void
+wsr_merge_runs(WSRTestTransitionState<MutableArrayHandle<double> > &out,
+    const Lower &lower, const Upper &upper) {
+
+    if (upper.firstAbs < lower.lastAbs)
+        throw std::invalid_argument("Fragments must receive disjoint ranges "
+            "of the absolute value of the first argument, each in ascending "
+            "order.");
+    bool tied = upper.firstAbsLowerBound <= lower.lastAbsUpperBound;
+
+    Eigen::Vector2d num = lower.num + upper.num;
+    Eigen::Vector2d rankSum = lower.rankSum + upper.rankSum
+        + upper.num * lower.num.sum();
+    Eigen::Vector2d numTies = upper.numTies;
+    Eigen::Vector2d leadTies = lower.leadTies;
+    double reduceVariance = lower.reduceVariance + upper.reduceVariance;
+    if (tied) {
+        double tLower = lower.numTies.sum();
+        double tUpper = upper.leadTies.sum();
+        rankSum += lower.numTies * (tUpper * 0.5)
+            - upper.leadTies * (tLower * 0.5);
+        reduceVariance += wsr_tie_variance(tLower + tUpper)
+            - wsr_tie_variance(tLower) - wsr_tie_variance(tUpper);
+        // a run that is a single group of ties extends the group of the other
+        if (upper.leadTies.sum() == upper.num.sum())
+            numTies += lower.numTies;
+        if (lower.leadTies.sum() == lower.num.sum())
+            leadTies += upper.leadTies;
+    }
+    double firstAbs = lower.firstAbs;
+    double firstAbsLowerBound = lower.firstAbsLowerBound;
+    double lastAbs = upper.lastAbs;
+    double lastAbsUpperBound = std::max(
+        static_cast<double>(lower.lastAbsUpperBound),
+        static_cast<double>(upper.lastAbsUpperBound));
+
+    out.num = num;
+    out.rankSum = rankSum;
+    out.numTies = numTies;
+    out.leadTies = leadTies;
+    out.reduceVariance = reduceVariance;
+    out.firstAbs = firstAbs;
+    out.firstAbsLowerBound = firstAbsLowerBound;
+    out.lastAbs = lastAbs;
+    out.lastAbsUpperBound = lastAbsUpperBound;
+}
+
+/**
+ * @brief Merge the states of two fragments
+ *
+ * The fragments must have received disjoint ranges of absolute values, and
+ * each must have seen its range in ascending order. The runs of both states
+ * are kept, the final function merges them, so neither the order of the
+ * ranges nor the order of the merges matters.
+ */
+AnyType
+wsr_test_merge_states::run(AnyType &args) {
+    WSRTestTransitionState<MutableArrayHandle<double> > stateLeft = args[0];
+    WSRTestTransitionState<ArrayHandle<double> > stateRight = args[1];
+
+    // We first handle the trivial case where this function is called with one
+    // of the states being the initial state
+    if (stateLeft.num.sum() == 0)
+        return stateRight;
+    else if (stateRight.num.sum() == 0)
+        return stateLeft;
+
+    ArrayHandle<double> left = args[0].getAs<ArrayHandle<double> >();
+    ArrayHandle<double> right = args[1].getAs<ArrayHandle<double> >();
+    MutableArrayHandle<double> runs = allocateArray<double,
+        dbal::AggregateContext, dbal::DoZero, dbal::ThrowBadAlloc>(
+            left.size() + right.size());
+    std::copy(left.ptr(), left.ptr() + left.size(), runs.ptr());
+    std::copy(right.ptr(), right.ptr() + right.size(),
+        runs.ptr() + left.size());
+    return runs;
+}
+
+/**
+ * @brief Merge the runs of a state, in ascending order, into one run
+ *
+ * Runs that start with the same group of ties are ordered by their end.
+ */
+inline
+MutableArrayHandle<double>
+wsr_merge_all_runs(const Allocator &inAllocator, const AnyType &inState) {
+    WSRTestTransitionState<ArrayHandle<double> > state = inState;
+    std::vector<std::pair<std::pair<double, double>, size_t> > order;
+    for (size_t k = 0; k < state.numRuns(); k++) {
+        WSRTestTransitionState<ArrayHandle<double> > run(inState, k);
+        if (run.num.sum() > 0)
+            order.push_back(std::make_pair(std::make_pair(
+                static_cast<double>(run.firstAbs),
+                static_cast<double>(run.lastAbs)), k));
+    }
+    std::sort(order.begin(), order.end());
+
+    MutableArrayHandle<double> merged
+        = inAllocator.allocateArray<double>(kWSRRunSize);
+    WSRTestTransitionState<MutableArrayHandle<double> > out
+        = static_cast<AnyType>(merged);
+    for (size_t i = 0; i < order.size(); i++) {
+        WSRTestTransitionState<ArrayHandle<double> > run(inState,
+            order[i].second);
+        if (i == 0) {
+            out.num = run.num;
+            out.numTies = run.numTies;
+            out.rankSum = run.rankSum;
+            out.leadTies = run.leadTies;
+            out.reduceVariance = run.reduceVariance;
+            out.firstAbs = run.firstAbs;
+            out.firstAbsLowerBound = run.firstAbsLowerBound;
+            out.lastAbs = run.lastAbs;
+            out.lastAbsUpperBound = run.lastAbsUpperBound;
+        } else {
+            wsr_merge_runs(out, out, run);
+        }
+    }
+    return merged;
+}
+
 AnyType
 wsr_test_final::run(AnyType &args) {
     using boost::math::complement;
 
-    WSRTestTransitionState<ArrayHandle<double> > state = args[0];
+    AnyType merged = wsr_merge_all_runs(*this, args[0]);
+    WSRTestTransitionState<ArrayHandle<double> > state = merged;
 
     double n_n1 = state.num.sum() * (state.num.sum() + 1);
     double statistic = state.rankSum.minCoeff();
@@ -9,6 +9,11 @@
  */
 DECLARE_UDF(stats, wsr_test_transition)
 
+/**
+ * @brief Wilcoxon-Signed-Rank Test: Merge function
+ */
+DECLARE_UDF(stats, wsr_test_merge_states)
+
 /**
  * @brief Wilcoxon-Signed-Rank Test: Final function
  */
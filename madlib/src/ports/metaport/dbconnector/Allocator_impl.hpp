@@ -174,7 +174,16 @@ template <dbal::MemoryContext MC, dbal::ZeroMemory ZM,
 inline
 void *
 Allocator::allocate(size_t inSize) const {
-  return alloc.Allocate(inSize);
+  // the port allocator returns uninitialized memory, PostgreSQL zeroes it
+  void *ptr = alloc.Allocate(inSize);
+  if (ptr == NULL) {
+    if (F == dbal::ThrowBadAlloc)
+      throw std::bad_alloc();
+    return NULL;
+  }
+  if (ZM == dbal::DoZero)
+    std::memset(ptr, 0, inSize);
+  return ptr;
     //return internalAllocate<MC, ZM, F, NewAllocation>(NULL, inSize);
 }
 
@@ -81,25 +81,115 @@ AnyType::AnyType(SystemInformation* inSysInfo, Datum inDatum,
  * any scalar value (including arrays, but excluding composite types). This will
  * typically only happen for preparing the return value of a user-defined
  * function.
- * This constructor immediately converts the object into a mainmemQL Datum
- * using the TypeTraits class. If memory has to be retained, it has to be done
- * there.
+ * Values of at most kInlineBytes bytes (scalars, handles, Eigen maps) are
+ * copied into the object, larger ones are only referenced and must outlive
+ * it.
  */
 template <typename T>
 inline
 AnyType::AnyType(const T& inValue, bool inForceLazyConversionToDatum)
   : mContentType(Scalar),
-    //mContent(),
-    //mToDatumFn(),
-    //mDatum(0),
-    //fcinfo(NULL),
-    //mSysInfo(TypeTraits<T>::toSysInfo(inValue)),
-    //mTupleHeader(NULL),
-    //mTypeID(TypeTraits<T>::oid),
-    mTypeName(TypeTraits<T>::typeName()),
-    mIsMutable(TypeTraits<T>::isMutable) {
-
-    mDatum = (void*) &inValue;
+    mNumChildren(0),
+    mOverflow(NULL) {
+
+    init(inValue, boost::integral_constant<bool,
+        sizeof(T) <= kInlineBytes &&
+        boost::alignment_of<T>::value <= boost::alignment_of<Value>::value>());
+}
+
+template <typename T>
+inline
+void
+AnyType::InlineOps<T>::copy(void* inDst, const void* inSrc) {
+    new (inDst) T(*static_cast<const T*>(inSrc));
+}
+
+template <typename T>
+inline
+void
+AnyType::InlineOps<T>::destroy(void* inValue) {
+    static_cast<T*>(inValue)->~T();
+}
+
+/**
+ * @brief Copy a small value into the inline storage
+ */
+template <typename T>
+inline
+void
+AnyType::init(const T& inValue, boost::true_type) {
+    mValue.mContentType = Scalar;
+    mValue.mDatum = mValue.mStorage.mBytes;
+    mValue.mCopy = &InlineOps<T>::copy;
+    mValue.mDestroy = &InlineOps<T>::destroy;
+    mValue.mTypeName = TypeTraits<T>::typeName();
+    mValue.mIsMutable = TypeTraits<T>::isMutable;
+    new (mValue.mStorage.mBytes) T(inValue);
+}
+
+/**
+ * @brief Reference a value too large for the inline storage
+ */
+template <typename T>
+inline
+void
+AnyType::init(const T& inValue, boost::false_type) {
+    mValue.mContentType = Scalar;
+    mValue.mDatum = const_cast<T*>(&inValue);
+    mValue.mCopy = NULL;
+    mValue.mDestroy = NULL;
+    mValue.mTypeName = TypeTraits<T>::typeName();
+    mValue.mIsMutable = TypeTraits<T>::isMutable;
+}
+
+inline
+void
+AnyType::Value::reset() {
+    mContentType = Null;
+    mDatum = NULL;
+    mCopy = NULL;
+    mDestroy = NULL;
+    mTypeName = NULL;
+    mIsMutable = false;
+}
+
+/**
+ * @brief Copy another value into this one, which must hold nothing
+ */
+inline
+void
+AnyType::Value::assign(const Value& inOther) {
+    mContentType = inOther.mContentType;
+    mCopy = inOther.mCopy;
+    mDestroy = inOther.mDestroy;
+    mTypeName = inOther.mTypeName;
+    mIsMutable = inOther.mIsMutable;
+    if (mCopy) {
+        mCopy(mStorage.mBytes, inOther.mStorage.mBytes);
+        mDatum = mStorage.mBytes;
+    } else {
+        mDatum = inOther.mDatum;
+    }
+}
+
+inline
+void
+AnyType::Value::release() {
+    if (mDestroy)
+        mDestroy(mStorage.mBytes);
+    reset();
+}
+
+/**
+ * @brief Wrap a field of a composite value
+ */
+inline
+AnyType::AnyType(const Value& inValue)
+  : mContentType(inValue.mContentType),
+    mNumChildren(0),
+    mOverflow(NULL) {
+
+    mValue.assign(inValue);
 }
 
 /**
@@ -112,16 +202,66 @@ AnyType::AnyType(const T& inValue, bool inForceLazyConversionToDatum)
 inline
 AnyType::AnyType()
   : mContentType(Null),
-    mContent(),
-    //mToDatumFn(),
-    mDatum(0),
-    //fcinfo(NULL),
-    //mSysInfo(NULL),
-    //mTupleHeader(NULL),
-    //mTypeID(InvalidOid),
-    mTypeName(NULL),
-    mIsMutable(false)
-    { }
+    mNumChildren(0),
+    mOverflow(NULL) {
+
+    mValue.reset();
+}
+
+/**
+ * @brief Copy constructor, copies the inline values and fields
+ */
+inline
+AnyType::AnyType(const AnyType& inOther)
+  : mContentType(inOther.mContentType),
+    mNumChildren(0),
+    mOverflow(NULL) {
+
+    mValue.assign(inOther.mValue);
+    assignChildren(inOther);
+}
+
+inline
+AnyType::~AnyType() {
+    mValue.release();
+    releaseChildren();
+}
+
+inline
+AnyType&
+AnyType::operator=(const AnyType& inOther) {
+    if (this != &inOther) {
+        mValue.release();
+        releaseChildren();
+        mContentType = inOther.mContentType;
+        mValue.assign(inOther.mValue);
+        assignChildren(inOther);
+    }
+    return *this;
+}
+
+/**
+ * @brief Copy the fields of a composite value, this object must have none
+ */
+inline
+void
+AnyType::assignChildren(const AnyType& inOther) {
+    for (uint16_t i = 0; i < inOther.mNumChildren; ++i)
+        mChildren[i].assign(inOther.mChildren[i]);
+    mNumChildren = inOther.mNumChildren;
+    if (inOther.mOverflow)
+        mOverflow = new std::vector<AnyType>(*inOther.mOverflow);
+}
+
+inline
+void
+AnyType::releaseChildren() {
+    for (uint16_t i = 0; i < mNumChildren; ++i)
+        mChildren[i].release();
+    mNumChildren = 0;
+    delete mOverflow;
+    mOverflow = NULL;
+}
 
 /**
  * @brief Verify consistency of AnyType object. Throw exception if not.
@@ -164,7 +304,7 @@ template <typename T>
 inline
 T
 AnyType::getAs() const {
-  return *(T*) mDatum;
+  return *static_cast<const T*>(mValue.mDatum);
     //consistencyCheck();
 
     /*
@@ -259,7 +399,9 @@ AnyType::numFields() const {
     switch (mContentType) {
         case Null: return 0;
         case Scalar: return 1;
-        case ReturnComposite: return static_cast<uint16_t>(mChildren.size());
+        case ReturnComposite:
+            return mOverflow ? static_cast<uint16_t>(mOverflow->size())
+                : mNumChildren;
         //case FunctionComposite: return PG_NARGS();
         //case NativeComposite: return HeapTupleHeaderGetNatts(mTupleHeader);
         default:
@@ -292,8 +434,12 @@ AnyType::operator[](uint16_t inID) const {
             "Composite type where not expected.");
     }
 
-    if (mContentType == ReturnComposite)
-        return mChildren[inID];
+    if (mContentType == ReturnComposite) {
+        if (inID >= numFields())
+            throw std::out_of_range("Invalid type conversion. Access behind "
+                "end of composite object.");
+        return mOverflow ? (*mOverflow)[inID] : AnyType(mChildren[inID]);
+    }
 
     throw std::out_of_range("Unimplemented");
 
@@ -377,7 +523,22 @@ AnyType::operator<<(const AnyType &inValue) {
             "return value."));
 
     mContentType = ReturnComposite;
-    mChildren.push_back(inValue);
+    if (!mOverflow && mNumChildren < kInlineChildren && !inValue.isComposite()) {
+        mChildren[mNumChildren++].assign(inValue.mValue);
+        return *this;
+    }
+
+    // Move the inline fields out once, all later fields go to the vector
+    if (!mOverflow) {
+        mOverflow = new std::vector<AnyType>();
+        mOverflow->reserve(mNumChildren + 1);
+        for (uint16_t i = 0; i < mNumChildren; ++i)
+            mOverflow->push_back(AnyType(mChildren[i]));
+        for (uint16_t i = 0; i < mNumChildren; ++i)
+            mChildren[i].release();
+        mNumChildren = 0;
+    }
+    mOverflow->push_back(inValue);
     return *this;
 }
 
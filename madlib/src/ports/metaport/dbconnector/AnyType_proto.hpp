@@ -28,10 +28,21 @@ struct SystemInformation;
  *   of all function arguments
  * - A native composite value, which is a mainmemQL HeapTupleHeader
  * - A return composite value, which is a vector of AnyType objects
+ *
+ * In this port, AnyType objects mostly pack the arguments of a UDF called
+ * once per row, so building and reading them must not allocate. Scalar values
+ * of at most kInlineBytes bytes are copied into the object; larger values are
+ * referenced and have to outlive it. The first kInlineChildren fields of a
+ * composite value are kept inline as well. Only wider composite values, or
+ * composite values nested into another one, spill into a heap-allocated
+ * vector.
  */
 class AnyType {
 public:
     AnyType();
+    AnyType(const AnyType& inOther);
+    ~AnyType();
+    AnyType& operator=(const AnyType& inOther);
     template <typename T> AnyType(const T& inValue,
         bool inForceLazyConversionToDatum = false);
     template <typename T> T getAs() const;
@@ -96,18 +107,59 @@ protected:
     class Placeholder;
     */
 
+    enum {
+        kInlineBytes = 48,
+        kInlineChildren = 12
+    };
+
+    /**
+     * @brief Copies and destroys a value of type T kept in inline storage
+     */
+    template <typename T>
+    struct InlineOps {
+        static void copy(void* inDst, const void* inSrc);
+        static void destroy(void* inValue);
+    };
+
+    /**
+     * @brief A Null or scalar value
+     *
+     * mDatum points to mStorage if the value was copied there (then mCopy and
+     * mDestroy are set), or else to the value the object was constructed
+     * from.
+     */
+    struct Value {
+        ContentType mContentType;
+        void* mDatum;
+        void (*mCopy)(void*, const void*);
+        void (*mDestroy)(void*);
+        const char* mTypeName;
+        bool mIsMutable;
+        union {
+            char mBytes[kInlineBytes];
+            long double mAlignLongDouble;
+            int64_t mAlignInteger;
+            void* mAlignPointer;
+        } mStorage;
+
+        void reset();
+        void assign(const Value& inOther);
+        void release();
+    };
+
+    template <typename T>
+    void init(const T& inValue, boost::true_type /* fitsInline */);
+    template <typename T>
+    void init(const T& inValue, boost::false_type /* fitsInline */);
+    AnyType(const Value& inValue);
+    void assignChildren(const AnyType& inOther);
+    void releaseChildren();
+
     ContentType mContentType;
-    boost::any mContent;
-    //std::function<Datum()> mToDatumFn;
-    // XXX FIXME new type for this
-    void* mDatum;
-    //FunctionCallInfo fcinfo;
-    //SystemInformation* mSysInfo;
-    //HeapTupleHeader mTupleHeader;
-    std::vector<AnyType> mChildren;
-    //Oid mTypeID;
-    const char* mTypeName;
-    bool mIsMutable;
+    Value mValue;
+    uint16_t mNumChildren;
+    Value mChildren[kInlineChildren];
+    std::vector<AnyType>* mOverflow;
 };
 
 AnyType Null();
@@ -578,6 +578,15 @@ struct TypeTraits<Eigen::MatrixBase<Derived> > {
     // MappedColumnVector or MappedMatrix instead.
 };
 
+#if EIGEN_VERSION_AT_LEAST(3, 2, 0)
+// Eigen 3.2 dropped the HasDirectAccess parameter of Block
+template<class XprType, int BlockRows, int BlockCols, bool InnerPanel>
+struct TypeTraits<
+    Eigen::Block<XprType, BlockRows, BlockCols, InnerPanel> > {
+
+    typedef Eigen::Block<XprType, BlockRows, BlockCols, InnerPanel>
+        value_type;
+#else
 template<class XprType, int BlockRows, int BlockCols, bool InnerPanel,
     bool HasDirectAccess>
 struct TypeTraits<
@@ -585,6 +594,7 @@ struct TypeTraits<
 
     typedef Eigen::Block<XprType, BlockRows, BlockCols, InnerPanel,
         HasDirectAccess> value_type;
+#endif
 
     WITH_OID( FLOAT8ARRAYOID );
     WITH_TYPE_CLASS( dbal::ArrayType );
@@ -67,10 +67,18 @@ extern "C" {
 #include <boost/type_traits/remove_cv.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/utility/enable_if.hpp>
+#if __cplusplus >= 201103L
+// the names imported from TR1 below are part of the standard library
+#include <array>
+#include <functional>
+#include <tuple>
+#else
 #include <boost/tr1/functional.hpp>
 #include <boost/tr1/array.hpp>
 #include <boost/tr1/tuple.hpp>
+#endif
 #include <limits>
+#include <new>
 #include <stdexcept>
 #include <vector>
 #include <fstream>
@@ -89,6 +97,7 @@ struct MemHandle {
 
 
 
+#if __cplusplus < 201103L
 namespace std {
     // Import names from TR1.
 
@@ -101,6 +110,7 @@ namespace std {
     using tr1::tie;
     using tr1::tuple;
 }
+#endif
 // XXX ADDED BY VICTOR
 #include "dbal/EigenIntegration/EigenIntegration.hpp"
 
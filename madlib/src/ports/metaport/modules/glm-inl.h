@@ -0,0 +1,162 @@
+
+#ifndef MADLIB_METAPORT_MODULES_GLM_INL_H
+#define MADLIB_METAPORT_MODULES_GLM_INL_H
+
+#include "modules/convex/glm.cpp"
+
+namespace madlib {
+namespace modules {
+namespace convex {
+
+typedef MutableArrayHandle<double> GlmHandle_t;
+typedef GLMNewtonState<GlmHandle_t> GlmModel;
+
+/*! \brief Wraps a state handle into the array MADlib expects
+ *
+ * The size of a state handle is in bytes, as the StringVal it comes from;
+ * the array is sized in doubles.
+ */
+inline madlib::ArrayType GlmArray(MemHandle<char> mh) {
+  madlib::ArrayType arr;
+  arr.len = mh.size;
+  arr.ptr = static_cast<void*>(mh.ptr);
+  arr.dims[0] = mh.size / sizeof(double);
+  arr.ndims = 1;
+  return arr;
+}
+
+/*! \brief Returns the handle of a state returned by MADlib, sized in bytes
+ */
+inline MemHandle<char> GlmHandle(GlmHandle_t res) {
+  MemHandle<char> r = {res.size() * sizeof(double), (char*) &res[0]};
+  return r;
+}
+
+/*! \brief Adds an example to the IRLS sums of the GLM
+ * Note: new state may be backed by new memory than the previous state.
+ * \param pa the allocator to use if new state needs to be created
+ * \param mh the handle to the current state
+ * \param vec the example's values
+ * \param vec_len the length of vec
+ * \param y the response of the example
+ * \param prevh state from the previous pass of the UDA, size 0 on the first
+ * \param family 1: Poisson, 2: Gamma, 3: Tweedie
+ * \param link 1: log, 2: identity
+ * \param power the variance power of the Tweedie family, in (1, 2)
+ * \return a handle to the new state
+ */
+MemHandle<char> GlmTransition(PortAllocator pa, MemHandle<char> mh,
+                              double* vec, size_t vec_len, double y,
+                              MemHandle<char> prevh, uint16_t family,
+                              uint16_t link, double power) {
+  madlib::ArrayType state_arr = GlmArray(mh);
+  GlmHandle_t state_(&state_arr);
+  GlmModel state(state_);
+
+  glm_newton_transition step;
+  step.SetPortAllocator(pa);
+  TransparentHandle<double> th(vec);
+  MappedColumnVector v(th, vec_len);
+
+  AnyType t1;
+  t1 << state;
+  t1 << v;
+  t1 << y;
+
+  // after the first pass, the state carries the model to start from
+  madlib::ArrayType pstate_arr = GlmArray(prevh);
+  if ((prevh.size != 0) && (prevh.ptr != NULL)) {
+    GlmHandle_t pstate_(&pstate_arr);
+    GlmModel prev(pstate_);
+    t1 << prev;
+  } else {
+    AnyType null;
+    t1 << null;
+  }
+  t1 << family;
+  t1 << link;
+  t1 << power;
+
+  AnyType result = step.run(t1);
+  return GlmHandle(result.getAs<GlmHandle_t>());
+}
+
+/*! \brief Creates an initial state for the GLM, which is empty zeros
+ */
+MemHandle<char> GlmInit(PortAllocator pa) {
+  MemHandle<char> m;
+  m.ptr = static_cast<char*>(pa.Allocate(8*sizeof(double)));
+  m.size = 8*sizeof(double);
+  memset(m.ptr, 0x0, m.size);
+  return m;
+}
+
+/*! \brief Adds the sums of b to a
+ */
+MemHandle<char> GlmMerge(PortAllocator pa, MemHandle<char> a,
+                         MemHandle<char> b) {
+  madlib::ArrayType st = GlmArray(a);
+  GlmHandle_t state_(&st);
+  GlmModel state(state_);
+
+  madlib::ArrayType st2 = GlmArray(b);
+  GlmHandle_t state_2(&st2);
+  GlmModel state2(state_2);
+
+  AnyType t1;
+  t1 << state;
+  t1 << state2;
+
+  glm_newton_merge merge;
+  merge.SetPortAllocator(pa);
+  AnyType result = merge.run(t1);
+  return GlmHandle(result.getAs<GlmHandle_t>());
+}
+
+/*! \brief Solves the weighted least squares problem of the pass
+ *
+ * The returned state holds the updated coefficients and is the previous
+ * state of the next pass.
+ */
+MemHandle<char> GlmFinal(PortAllocator pa, MemHandle<char> mh) {
+  madlib::ArrayType st = GlmArray(mh);
+  GlmHandle_t state_(&st);
+  GlmModel state(state_);
+
+  AnyType t1;
+  t1 << state;
+
+  glm_newton_final final;
+  final.SetPortAllocator(pa);
+  AnyType result = final.run(t1);
+  return GlmHandle(result.getAs<GlmHandle_t>());
+}
+
+/*! \brief Copies the coef out of the state into a new handle
+ */
+MemHandle<double> GlmCoef(PortAllocator pa, MemHandle<char> mh) {
+  madlib::ArrayType st = GlmArray(mh);
+  GlmHandle_t state_(&st);
+  GlmModel state(state_);
+
+  MemHandle<double> coef;
+  coef.size = state.task.model.size();
+  coef.ptr = static_cast<double*>(pa.Allocate(coef.size * sizeof(double)));
+
+  memcpy(coef.ptr, &state.task.model[0], coef.size * sizeof(double));
+  return coef;
+}
+
+/*! \brief Deviance of the model the pass of the state started from
+ */
+double GlmDeviance(MemHandle<char> mh) {
+  madlib::ArrayType st = GlmArray(mh);
+  GlmHandle_t state_(&st);
+  GlmModel state(state_);
+  return state.algo.loss;
+}
+
+} // namespace convex
+}
+} // namespace madlib
+#endif
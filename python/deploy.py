@@ -15,7 +15,19 @@ libs = [
     ('lib/libsvm.so', 'libsvm.so'),
     ('lib/libbismarckarray.so', 'libbismarckarray.so'),
     ('lib/liblogr.so', 'liblogr.so'),
-    ('lib/liblinr.so', 'liblinr.so')
+    ('lib/liblinr.so', 'liblinr.so'),
+    ('lib/libvocab.so', 'libvocab.so'),
+    ('lib/libpagerank.so', 'libpagerank.so'),
+    ('lib/libglm.so', 'libglm.so'),
+    ('lib/libstrata.so', 'libstrata.so'),
+    ('lib/librank.so', 'librank.so'),
+    ('lib/libigd.so', 'libigd.so'),
+    ('lib/libscore.so', 'libscore.so'),
+    ('lib/libquantile.so', 'libquantile.so'),
+    ('lib/libmatrix.so', 'libmatrix.so'),
+    ('lib/libbootstrap.so', 'libbootstrap.so'),
+    ('lib/libscreen.so', 'libscreen.so'),
+    ('lib/libembed.so', 'libembed.so')
     ]
 
 queries = [
@@ -71,6 +83,305 @@ queries = [
 
     "DROP function IF EXISTS logrloss(string, string, boolean);",
     "create function logrloss(string, string, boolean) returns double location '%s/liblogr.so' SYMBOL='LogrLoss';",
+
+    #
+    # Vocabulary (LDA input)
+    #
+    "DROP aggregate function IF EXISTS vocab(string, bigint);",
+    "create aggregate function vocab(string, bigint) returns string location '%s/libvocab.so' UPDATE_FN='VocabUpdate';",
+
+    "DROP function IF EXISTS vocabwords(string, string);",
+    "create function vocabwords(string, string) returns string location '%s/libvocab.so' SYMBOL='VocabWords' PREPARE_FN='VocabPrepare' CLOSE_FN='VocabClose';",
+
+    "DROP function IF EXISTS vocabcounts(string, string);",
+    "create function vocabcounts(string, string) returns string location '%s/libvocab.so' SYMBOL='VocabCounts' PREPARE_FN='VocabPrepare' CLOSE_FN='VocabClose';",
+
+    "DROP function IF EXISTS vocabsize(string);",
+    "create function vocabsize(string) returns bigint location '%s/libvocab.so' SYMBOL='VocabSize' PREPARE_FN='VocabPrepare' CLOSE_FN='VocabClose';",
+
+    #
+    # Graphs
+    #
+    "DROP aggregate function IF EXISTS outdegree(bigint);",
+    "create aggregate function outdegree(bigint) returns string location '%s/libpagerank.so' UPDATE_FN='DegreeUpdate' SERIALIZE_FN='DegreeSerialize';",
+
+    "DROP aggregate function IF EXISTS csrblock(bigint, bigint);",
+    "create aggregate function csrblock(bigint, bigint) returns string location '%s/libpagerank.so' UPDATE_FN='CSRUpdate';",
+
+    "DROP aggregate function IF EXISTS pagerank(string, string, string);",
+    "create aggregate function pagerank(string, string, string) returns string location '%s/libpagerank.so' UPDATE_FN='PageRankUpdate';",
+
+    "DROP function IF EXISTS pageranknext(string, string, string, double);",
+    "create function pageranknext(string, string, string, double) returns string location '%s/libpagerank.so' SYMBOL='PageRankNext';",
+
+    "DROP function IF EXISTS pagerankdelta(string, string);",
+    "create function pagerankdelta(string, string) returns double location '%s/libpagerank.so' SYMBOL='PageRankDelta';",
+
+    #
+    # Generalized linear models (Poisson, Gamma, Tweedie)
+    #
+    "DROP aggregate function IF EXISTS glm(string, string, double, int, int, double);",
+    "create aggregate function glm(string, string, double, int, int, double) returns string location '%s/libglm.so' UPDATE_FN='GlmUpdate';",
+
+    "DROP function IF EXISTS glmcoef(string);",
+    "create function glmcoef(string) returns string location '%s/libglm.so' SYMBOL='GlmCoef';",
+
+    "DROP function IF EXISTS glmdeviance(string);",
+    "create function glmdeviance(string) returns double location '%s/libglm.so' SYMBOL='GlmDeviance';",
+
+    "DROP function IF EXISTS glmpredict(string, string, int);",
+    "create function glmpredict(string, string, int) returns double location '%s/libglm.so' SYMBOL='GlmPredict';",
+
+    #
+    # Stratified sampling
+    #
+    "DROP aggregate function IF EXISTS strata(string, bigint, double, int, bigint);",
+    "create aggregate function strata(string, bigint, double, int, bigint) returns string location '%s/libstrata.so' UPDATE_FN='StrataUpdate';",
+
+    "DROP function IF EXISTS stratacontains(string, string, bigint);",
+    "create function stratacontains(string, string, bigint) returns boolean location '%s/libstrata.so' SYMBOL='StrataContains';",
+
+    "DROP function IF EXISTS stratasize(string);",
+    "create function stratasize(string) returns bigint location '%s/libstrata.so' SYMBOL='StrataSize';",
+
+    #
+    # Pairwise ranking, input clustered by query
+    #
+    "DROP aggregate function IF EXISTS ranktrain(string, bigint, string, double, double, double, int, int);",
+    "create aggregate function ranktrain(string, bigint, string, double, double, double, int, int) returns string location '%s/librank.so' UPDATE_FN='RankUpdate' SERIALIZE_FN='RankSerialize';",
+
+    "DROP function IF EXISTS rankscore(string, string);",
+    "create function rankscore(string, string) returns double location '%s/librank.so' SYMBOL='RankScore';",
+
+    "DROP aggregate function IF EXISTS rankeval(bigint, double, double, int, int);",
+    "create aggregate function rankeval(bigint, double, double, int, int) returns double intermediate string location '%s/librank.so' UPDATE_FN='RankEvalUpdate' SERIALIZE_FN='RankEvalSerialize';",
+
+    #
+    # SVM and logistic regression on downsampled negatives
+    #
+    "DROP aggregate function IF EXISTS svmsampled(string, bigint, string, boolean, double, double, double, bigint);",
+    "create aggregate function svmsampled(string, bigint, string, boolean, double, double, double, bigint) returns string location '%s/libsvm.so' INIT_FN='SVMInit' UPDATE_FN='SVMSampledUpdate' MERGE_FN='SVMMerge' FINALIZE_FN='SVMFinalize';",
+
+    "DROP function IF EXISTS svmsampledloss(string, string, boolean, bigint, double, bigint);",
+    "create function svmsampledloss(string, string, boolean, bigint, double, bigint) returns double location '%s/libsvm.so' SYMBOL='SVMSampledLoss';",
+
+    "DROP aggregate function IF EXISTS logrsampled(string, bigint, string, boolean, double, double, double, bigint);",
+    "create aggregate function logrsampled(string, bigint, string, boolean, double, double, double, bigint) returns string location '%s/liblogr.so' INIT_FN='LogrInit' UPDATE_FN='LogrSampledUpdate' MERGE_FN='LogrMerge' FINALIZE_FN='LogrFinalize';",
+
+    "DROP function IF EXISTS logrsampledloss(string, string, boolean, bigint, double, bigint);",
+    "create function logrsampledloss(string, string, boolean, bigint, double, bigint) returns double location '%s/liblogr.so' SYMBOL='LogrSampledLoss';",
+
+    "DROP function IF EXISTS logrcalibrate(double, double);",
+    "create function logrcalibrate(double, double) returns double location '%s/liblogr.so' SYMBOL='LogrCalibrate';",
+
+    #
+    # SVM and logistic regression shipping sparsified model deltas
+    #
+    "DROP aggregate function IF EXISTS svmdelta(string, string, boolean, double, double, double, double, int);",
+    "create aggregate function svmdelta(string, string, boolean, double, double, double, double, int) returns string location '%s/libsvm.so' UPDATE_FN='SVMDeltaUpdate' SERIALIZE_FN='SVMDeltaSerialize' MERGE_FN='SVMDeltaMerge' FINALIZE_FN='SVMDeltaFinalize' INIT_FN='SVMInit';",
+
+    "DROP function IF EXISTS svmdeltaapply(string, string);",
+    "create function svmdeltaapply(string, string) returns string location '%s/libsvm.so' SYMBOL='SVMDeltaApply';",
+
+    "DROP aggregate function IF EXISTS logrdelta(string, string, boolean, double, double, double, double, int);",
+    "create aggregate function logrdelta(string, string, boolean, double, double, double, double, int) returns string location '%s/liblogr.so' UPDATE_FN='LogrDeltaUpdate' SERIALIZE_FN='LogrDeltaSerialize' MERGE_FN='LogrDeltaMerge' FINALIZE_FN='LogrDeltaFinalize' INIT_FN='LogrInit';",
+
+    "DROP function IF EXISTS logrdeltaapply(string, string);",
+    "create function logrdeltaapply(string, string) returns string location '%s/liblogr.so' SYMBOL='LogrDeltaApply';",
+
+    #
+    # IGD models composed from a loss, regularizer, step rule and example
+    # representation (src/igd.cc); labels are doubles, > 0 is positive
+    #
+    "DROP aggregate function IF EXISTS svml1(string, string, double, double, double);",
+    "create aggregate function svml1(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='SVML1Init' UPDATE_FN='SVML1Update' MERGE_FN='SVML1Merge' FINALIZE_FN='SVML1Finalize';",
+
+    "DROP function IF EXISTS svml1predict(string, string);",
+    "create function svml1predict(string, string) returns double location '%s/libigd.so' SYMBOL='SVML1Predict';",
+
+    "DROP function IF EXISTS svml1loss(string, string, double);",
+    "create function svml1loss(string, string, double) returns double location '%s/libigd.so' SYMBOL='SVML1Loss';",
+
+    "DROP aggregate function IF EXISTS igdlogr(string, string, double, double, double);",
+    "create aggregate function igdlogr(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='IGDLogrInit' UPDATE_FN='IGDLogrUpdate' MERGE_FN='IGDLogrMerge' FINALIZE_FN='IGDLogrFinalize';",
+
+    "DROP function IF EXISTS igdlogrpredict(string, string);",
+    "create function igdlogrpredict(string, string) returns double location '%s/libigd.so' SYMBOL='IGDLogrPredict';",
+
+    "DROP function IF EXISTS igdlogrloss(string, string, double);",
+    "create function igdlogrloss(string, string, double) returns double location '%s/libigd.so' SYMBOL='IGDLogrLoss';",
+
+    "DROP aggregate function IF EXISTS logrsparse(string, string, double, double, double);",
+    "create aggregate function logrsparse(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='LogrSparseInit' UPDATE_FN='LogrSparseUpdate' MERGE_FN='LogrSparseMerge' FINALIZE_FN='LogrSparseFinalize';",
+
+    "DROP function IF EXISTS logrsparsepredict(string, string);",
+    "create function logrsparsepredict(string, string) returns double location '%s/libigd.so' SYMBOL='LogrSparsePredict';",
+
+    "DROP function IF EXISTS logrsparseloss(string, string, double);",
+    "create function logrsparseloss(string, string, double) returns double location '%s/libigd.so' SYMBOL='LogrSparseLoss';",
+
+    "DROP aggregate function IF EXISTS logrfloat(string, string, double, double, double);",
+    "create aggregate function logrfloat(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='LogrFloatInit' UPDATE_FN='LogrFloatUpdate' MERGE_FN='LogrFloatMerge' FINALIZE_FN='LogrFloatFinalize';",
+
+    "DROP function IF EXISTS logrfloatpredict(string, string);",
+    "create function logrfloatpredict(string, string) returns double location '%s/libigd.so' SYMBOL='LogrFloatPredict';",
+
+    "DROP function IF EXISTS logrfloatloss(string, string, double);",
+    "create function logrfloatloss(string, string, double) returns double location '%s/libigd.so' SYMBOL='LogrFloatLoss';",
+
+    "DROP aggregate function IF EXISTS ridge(string, string, double, double, double);",
+    "create aggregate function ridge(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='RidgeInit' UPDATE_FN='RidgeUpdate' MERGE_FN='RidgeMerge' FINALIZE_FN='RidgeFinalize';",
+
+    "DROP function IF EXISTS ridgepredict(string, string);",
+    "create function ridgepredict(string, string) returns double location '%s/libigd.so' SYMBOL='RidgePredict';",
+
+    "DROP function IF EXISTS ridgeloss(string, string, double);",
+    "create function ridgeloss(string, string, double) returns double location '%s/libigd.so' SYMBOL='RidgeLoss';",
+
+    "DROP aggregate function IF EXISTS hubernet(string, string, double, double, double);",
+    "create aggregate function hubernet(string, string, double, double, double) returns string location '%s/libigd.so' INIT_FN='HuberNetInit' UPDATE_FN='HuberNetUpdate' MERGE_FN='HuberNetMerge' FINALIZE_FN='HuberNetFinalize';",
+
+    "DROP function IF EXISTS hubernetpredict(string, string);",
+    "create function hubernetpredict(string, string) returns double location '%s/libigd.so' SYMBOL='HuberNetPredict';",
+
+    "DROP function IF EXISTS hubernetloss(string, string, double);",
+    "create function hubernetloss(string, string, double) returns double location '%s/libigd.so' SYMBOL='HuberNetLoss';",
+
+    "DROP function IF EXISTS tosparse(string);",
+    "create function tosparse(string) returns string location '%s/libigd.so' SYMBOL='ToSparse';",
+
+    "DROP function IF EXISTS tofloat(string);",
+    "create function tofloat(string) returns string location '%s/libigd.so' SYMBOL='ToFloat';",
+
+    #
+    # Batch scoring against one linear model, group the rows into blocks,
+    # e.g. by id div 4096, and read a row back with scoreget(scores, id)
+    #
+    "DROP aggregate function IF EXISTS scorebatch(string, bigint, string, int);",
+    "create aggregate function scorebatch(string, bigint, string, int) returns string location '%s/libscore.so' UPDATE_FN='ScoreUpdate' SERIALIZE_FN='ScoreSerialize';",
+
+    "DROP function IF EXISTS scoreget(string, bigint);",
+    "create function scoreget(string, bigint) returns double location '%s/libscore.so' SYMBOL='ScoreGet';",
+
+    "DROP function IF EXISTS scorevalues(string);",
+    "create function scorevalues(string) returns string location '%s/libscore.so' SYMBOL='ScoreValues';",
+
+    #
+    # Per-feature quantile sketches and binning
+    #
+    "DROP aggregate function IF EXISTS quantilecuts(string, int, int);",
+    "create aggregate function quantilecuts(string, int, int) returns string location '%s/libquantile.so' UPDATE_FN='QuantileUpdate';",
+
+    "DROP function IF EXISTS quantilebins(string, string);",
+    "create function quantilebins(string, string) returns string location '%s/libquantile.so' SYMBOL='QuantileBins';",
+
+    #
+    # Memory held by the states of each library, e.g. select svmmemory(), and
+    # the BISMARCK_MEMORY_BUDGET (bytes, or with a K/M/G suffix) they degrade at
+    #
+    "DROP function IF EXISTS svmmemory();",
+    "create function svmmemory() returns string location '%s/libsvm.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS logrmemory();",
+    "create function logrmemory() returns string location '%s/liblogr.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS linrmemory();",
+    "create function linrmemory() returns string location '%s/liblinr.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS vocabmemory();",
+    "create function vocabmemory() returns string location '%s/libvocab.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS pagerankmemory();",
+    "create function pagerankmemory() returns string location '%s/libpagerank.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS glmmemory();",
+    "create function glmmemory() returns string location '%s/libglm.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS stratamemory();",
+    "create function stratamemory() returns string location '%s/libstrata.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS rankmemory();",
+    "create function rankmemory() returns string location '%s/librank.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS igdmemory();",
+    "create function igdmemory() returns string location '%s/libigd.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS scorememory();",
+    "create function scorememory() returns string location '%s/libscore.so' SYMBOL='BismarckMemory';",
+
+    "DROP function IF EXISTS quantilememory();",
+    "create function quantilememory() returns string location '%s/libquantile.so' SYMBOL='BismarckMemory';",
+
+    #
+    # Matrix from column vectors, like MADlib's matrix_agg. With
+    # BISMARCK_SPILL_DIR set, full chunks of columns are spilled to local
+    # scratch files instead of held in memory
+    #
+    "DROP aggregate function IF EXISTS matrixagg(string);",
+    "create aggregate function matrixagg(string) returns string location '%s/libmatrix.so' UPDATE_FN='MatrixUpdate' SERIALIZE_FN='MatrixSerialize';",
+
+    "DROP function IF EXISTS matrixcolumn(string, int);",
+    "create function matrixcolumn(string, int) returns string location '%s/libmatrix.so' SYMBOL='MatrixColumn';",
+
+    "DROP function IF EXISTS matrixmemory();",
+    "create function matrixmemory() returns string location '%s/libmatrix.so' SYMBOL='BismarckMemory';",
+
+    #
+    # Poisson bootstrap confidence intervals in one pass: each returns the
+    # estimate, lower and upper bounds and standard error of every
+    # coefficient. Arguments: a unique row id, the data, the number of
+    # replicates, the confidence level and a seed
+    #
+    "DROP aggregate function IF EXISTS bootmean(bigint, double, int, double, bigint);",
+    "create aggregate function bootmean(bigint, double, int, double, bigint) returns string location '%s/libbootstrap.so' INIT_FN='BootInit' UPDATE_FN='BootMeanUpdate' MERGE_FN='BootMerge' FINALIZE_FN='BootFinalize';",
+
+    "DROP aggregate function IF EXISTS bootdiff(bigint, double, boolean, int, double, bigint);",
+    "create aggregate function bootdiff(bigint, double, boolean, int, double, bigint) returns string location '%s/libbootstrap.so' INIT_FN='BootInit' UPDATE_FN='BootDiffUpdate' MERGE_FN='BootMerge' FINALIZE_FN='BootFinalize';",
+
+    "DROP aggregate function IF EXISTS bootlinr(bigint, string, double, int, double, bigint);",
+    "create aggregate function bootlinr(bigint, string, double, int, double, bigint) returns string location '%s/libbootstrap.so' INIT_FN='BootInit' UPDATE_FN='BootLinrUpdate' MERGE_FN='BootMerge' FINALIZE_FN='BootFinalize';",
+
+    "DROP function IF EXISTS bootmemory();",
+    "create function bootmemory() returns string location '%s/libbootstrap.so' SYMBOL='BismarckMemory';",
+
+    #
+    # Univariate screening of every feature against the label: the
+    # correlation, t, F and p-value of each feature, feature after feature.
+    # With a 0/1 label t is the pooled two-sample t-test between the classes
+    #
+    "DROP aggregate function IF EXISTS screen(string, double);",
+    "create aggregate function screen(string, double) returns string location '%s/libscreen.so' INIT_FN='ScreenInit' UPDATE_FN='ScreenUpdate' MERGE_FN='ScreenMerge' FINALIZE_FN='ScreenFinalize';",
+
+    "DROP aggregate function IF EXISTS screensparse(string, double);",
+    "create aggregate function screensparse(string, double) returns string location '%s/libscreen.so' INIT_FN='ScreenInit' UPDATE_FN='ScreenSparseUpdate' MERGE_FN='ScreenMerge' FINALIZE_FN='ScreenFinalize';",
+
+    "DROP function IF EXISTS screenmemory();",
+    "create function screenmemory() returns string location '%s/libscreen.so' SYMBOL='BismarckMemory';",
+
+    #
+    # Skip-gram embeddings with negative sampling. embedalias(item, count)
+    # builds the negative sampling table from item counts; an epoch is
+    # embed(prev_model, alias, center, context, rank, step, negatives, seed)
+    # over pairs, or embedseq(prev_model, alias, tokens, window, rank, step,
+    # negatives, seed) over int32 token arrays, with a new seed every epoch
+    #
+    "DROP aggregate function IF EXISTS embedalias(int, double);",
+    "create aggregate function embedalias(int, double) returns string location '%s/libembed.so' INIT_FN='EmbedAliasInit' UPDATE_FN='EmbedAliasUpdate' MERGE_FN='EmbedAliasMerge' FINALIZE_FN='EmbedAliasFinalize';",
+
+    "DROP aggregate function IF EXISTS embed(string, string, int, int, int, double, int, bigint);",
+    "create aggregate function embed(string, string, int, int, int, double, int, bigint) returns string location '%s/libembed.so' INIT_FN='EmbedInit' UPDATE_FN='EmbedUpdate' MERGE_FN='EmbedMerge' FINALIZE_FN='EmbedFinalize';",
+
+    "DROP aggregate function IF EXISTS embedseq(string, string, string, int, int, double, int, bigint);",
+    "create aggregate function embedseq(string, string, string, int, int, double, int, bigint) returns string location '%s/libembed.so' INIT_FN='EmbedInit' UPDATE_FN='EmbedSeqUpdate' MERGE_FN='EmbedMerge' FINALIZE_FN='EmbedFinalize';",
+
+    "DROP function IF EXISTS embedvector(string, int);",
+    "create function embedvector(string, int) returns string location '%s/libembed.so' SYMBOL='EmbedVector';",
+
+    "DROP function IF EXISTS embedsimilarity(string, int, int);",
+    "create function embedsimilarity(string, int, int) returns double location '%s/libembed.so' SYMBOL='EmbedSimilarity';",
+
+    "DROP function IF EXISTS embedmemory();",
+    "create function embedmemory() returns string location '%s/libembed.so' SYMBOL='BismarckMemory';",
     ]
 
 def main():
@@ -0,0 +1,298 @@
+
+#ifndef HAZY_BISMARCK_BOOTSTRAP_INL_H
+#define HAZY_BISMARCK_BOOTSTRAP_INL_H
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+#include "linalg-inl.h"
+
+// see for documentation
+#include "bootstrap.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state, followed by the weights of the current row (reps
+ * doubles) and the accumulators, reps doubles each. A mean has a count and
+ * a sum per group; a regression has X'y (dim), then the upper triangle of
+ * X'X row by row (dim * (dim + 1) / 2).
+ */
+struct BootHeader {
+  uint32_t kind;
+  uint32_t groups;
+  uint64_t reps;    //!< B + 1, replicate 0 is the point estimate
+  uint64_t dim;     //!< coefficients
+  uint64_t seed;
+  double level;
+  uint64_t rows;
+};
+
+inline BootHeader* BootHead(const bytea &m) {
+  return reinterpret_cast<BootHeader*>(m.str);
+}
+
+inline double* BootScratch(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(BootHeader));
+}
+
+inline double* BootAccumulators(const bytea &m) {
+  return BootScratch(m) + BootHead(m)->reps;
+}
+
+inline uint64_t BootEntries(const BootHeader &h) {
+  if (h.kind == BOOT_MEAN) return 2 * h.groups;
+  return h.dim + h.dim * (h.dim + 1) / 2;
+}
+
+inline size_t BootSize(const BootHeader &h) {
+  return sizeof(BootHeader) + (1 + BootEntries(h)) * h.reps * sizeof(double);
+}
+
+/*! Index of X'X[j][k], j <= k, in the packed upper triangle
+ */
+inline uint64_t BootTri(uint64_t dim, uint64_t j, uint64_t k) {
+  return j * dim - j * (j - 1) / 2 + (k - j);
+}
+
+inline uint64_t BootMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*! A Poisson(1) draw from 64 random bits, by inverting the cdf
+ */
+inline double BootPoisson(uint64_t u) {
+  static const double cdf[] = {
+    0.36787944117144233, 0.73575888234288467, 0.91969860292860584,
+    0.98101184312384626, 0.99634015317265634, 0.99940581518241833,
+    0.99991675885071196, 0.99998975080332531, 0.99999887479740202,
+    0.9999998885745216, 0.9999999899522336, 0.99999999916838922,
+    0.99999999993640221
+  };
+  const int n = sizeof(cdf) / sizeof(cdf[0]);
+  double p = (u >> 11) * (1.0 / 9007199254740992.0);
+  int k = 0;
+  while (k < n && p >= cdf[k]) k++;
+  return k;
+}
+
+inline void BootWeights(int64_t id, uint64_t seed, uint64_t n, double *w) {
+  uint64_t key = BootMix(static_cast<uint64_t>(id) ^ BootMix(seed));
+  if (n > 0) w[0] = 1;
+  for (uint64_t r = 1; r < n; r++) w[r] = BootPoisson(BootMix(key + r));
+}
+
+/*! Allocates the state on the first row
+ */
+template <class CTX>
+void BootStart(CTX* ctx, uint32_t kind, uint32_t groups, uint64_t dim,
+               uint32_t replicates, double level, uint64_t seed, bytea *m) {
+  BootHeader h;
+  memset(&h, 0, sizeof(h));
+  h.kind = kind;
+  h.groups = groups;
+  h.reps = static_cast<uint64_t>(replicates) + 1;
+  h.dim = dim;
+  h.seed = seed;
+  h.level = level;
+  m->len = BootSize(h);
+  m->str = BismarckAllocate<char>(ctx, m->len);
+  memset(m->str, 0, m->len);
+  *BootHead(*m) = h;
+}
+
+template <class CTX>
+void BismarckBoot<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckBoot<CTX>::StepMean(CTX* ctx, int64_t id, double x,
+                                 uint32_t group, uint32_t groups,
+                                 uint32_t replicates, double level,
+                                 uint64_t seed, bytea *m) {
+  if (m->str == NULL) {
+    BootStart(ctx, BOOT_MEAN, std::max<uint32_t>(groups, 1), 1, replicates,
+              level, seed, m);
+  }
+  BootHeader *h = BootHead(*m);
+  if (group >= h->groups) return;
+  h->rows++;
+  double *w = BootScratch(*m);
+  BootWeights(id, h->seed, h->reps, w);
+  double *acc = BootAccumulators(*m) + 2 * group * h->reps;
+  simple_scale_add(acc, w, 1.0, h->reps);
+  simple_scale_add(acc + h->reps, w, x, h->reps);
+}
+
+template <class CTX>
+void BismarckBoot<CTX>::StepLinr(CTX* ctx, int64_t id, const bytea &ex,
+                                 double y, uint32_t replicates, double level,
+                                 uint64_t seed, bytea *m) {
+  uint64_t n = ex.len / sizeof(double);
+  if (m->str == NULL) {
+    BootStart(ctx, BOOT_LINR, 1, n, replicates, level, seed, m);
+  }
+  BootHeader *h = BootHead(*m);
+  h->rows++;
+  uint64_t dim = h->dim, reps = h->reps;
+  n = std::min(n, dim);
+  const double *x = reinterpret_cast<const double*>(ex.str);
+  double *w = BootScratch(*m);
+  BootWeights(id, h->seed, reps, w);
+  double *xty = BootAccumulators(*m);
+  double *xtx = xty + dim * reps;
+  // zero features add nothing to any replicate
+  for (uint64_t j = 0; j < n; j++) {
+    if (x[j] == 0) continue;
+    simple_scale_add(xty + j * reps, w, x[j] * y, reps);
+    for (uint64_t k = j; k < n; k++) {
+      if (x[k] == 0) continue;
+      simple_scale_add(xtx + BootTri(dim, j, k) * reps, w, x[j] * x[k], reps);
+    }
+  }
+}
+
+template <class CTX>
+bool BismarckBoot<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return true;
+  }
+  const BootHeader *sh = BootHead(src);
+  BootHeader *dh = BootHead(*dst);
+  if (sh->kind != dh->kind || sh->groups != dh->groups ||
+      sh->reps != dh->reps || sh->dim != dh->dim || sh->seed != dh->seed) {
+    return false;
+  }
+  dh->rows += sh->rows;
+  simple_scale_add(BootAccumulators(*dst), BootAccumulators(src), 1.0,
+                   BootEntries(*dh) * dh->reps);
+  return true;
+}
+
+/*! Solves the regression of replicate r into beta by Cholesky
+ *
+ * \param a scratch for dim * dim doubles
+ * \return false if X'X is singular
+ */
+inline bool BootSolve(const BootHeader &h, const double *acc, uint64_t r,
+                      double *a, double *beta) {
+  uint64_t d = h.dim, reps = h.reps;
+  const double *xty = acc;
+  const double *xtx = acc + d * reps;
+  for (uint64_t j = 0; j < d; j++) {
+    beta[j] = xty[j * reps + r];
+    for (uint64_t k = j; k < d; k++) {
+      a[j * d + k] = a[k * d + j] = xtx[BootTri(d, j, k) * reps + r];
+    }
+  }
+  // lower triangle of a becomes L, a = L L'
+  for (uint64_t j = 0; j < d; j++) {
+    double diag = a[j * d + j];
+    for (uint64_t k = 0; k < j; k++) diag -= a[j * d + k] * a[j * d + k];
+    if (!(diag > 1e-12 * std::fabs(a[j * d + j]))) return false;
+    diag = std::sqrt(diag);
+    a[j * d + j] = diag;
+    for (uint64_t i = j + 1; i < d; i++) {
+      double v = a[i * d + j];
+      for (uint64_t k = 0; k < j; k++) v -= a[i * d + k] * a[j * d + k];
+      a[i * d + j] = v / diag;
+    }
+  }
+  for (uint64_t j = 0; j < d; j++) {
+    for (uint64_t k = 0; k < j; k++) beta[j] -= a[j * d + k] * beta[k];
+    beta[j] /= a[j * d + j];
+  }
+  for (uint64_t j = d; j-- > 0;) {
+    for (uint64_t k = j + 1; k < d; k++) beta[j] -= a[k * d + j] * beta[k];
+    beta[j] /= a[j * d + j];
+  }
+  return true;
+}
+
+/*! The q quantile of n sorted values, interpolated
+ */
+inline double BootPercentile(const double *sorted, size_t n, double q) {
+  if (n == 0) return std::numeric_limits<double>::quiet_NaN();
+  double pos = q * (n - 1);
+  size_t lo = static_cast<size_t>(pos);
+  if (lo + 1 >= n) return sorted[n - 1];
+  return sorted[lo] + (pos - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+template <class CTX>
+bytea BismarckBoot<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea r = {NULL, 0};
+  if (m.str == NULL) return r;
+  const BootHeader &h = *BootHead(m);
+  const double *acc = BootAccumulators(m);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  uint64_t d = h.dim, reps = h.reps;
+
+  // the estimates of every replicate, coefficient after coefficient
+  double *est = BismarckAllocate<double>(ctx, d * reps);
+  if (h.kind == BOOT_MEAN) {
+    for (uint64_t i = 0; i < reps; i++) {
+      double e = 0;
+      for (uint32_t g = 0; g < h.groups; g++) {
+        double n = acc[2 * g * reps + i], s = acc[(2 * g + 1) * reps + i];
+        e = n > 0 ? (g == 0 ? s / n : e - s / n) : nan;
+      }
+      est[i] = e;
+    }
+  } else {
+    double *a = BismarckAllocate<double>(ctx, d * d);
+    double *beta = BismarckAllocate<double>(ctx, d);
+    for (uint64_t i = 0; i < reps; i++) {
+      bool ok = BootSolve(h, acc, i, a, beta);
+      for (uint64_t j = 0; j < d; j++) est[j * reps + i] = ok ? beta[j] : nan;
+    }
+    BismarckFree(ctx, a);
+    BismarckFree(ctx, beta);
+  }
+
+  r.len = 4 * d * sizeof(double);
+  r.str = BismarckAllocate<char>(ctx, r.len);
+  double *out = reinterpret_cast<double*>(r.str);
+  double *sorted = BismarckAllocate<double>(ctx, reps);
+  double alpha = (1 - h.level) / 2;
+  for (uint64_t j = 0; j < d; j++) {
+    const double *e = est + j * reps;
+    size_t n = 0;
+    double mean = 0;
+    for (uint64_t i = 1; i < reps; i++) {
+      if (std::isnan(e[i])) continue;
+      sorted[n++] = e[i];
+      mean += e[i];
+    }
+    std::sort(sorted, sorted + n);
+    mean /= n;
+    double var = 0;
+    for (size_t i = 0; i < n; i++) {
+      var += (sorted[i] - mean) * (sorted[i] - mean);
+    }
+    out[4 * j] = e[0];
+    out[4 * j + 1] = BootPercentile(sorted, n, alpha);
+    out[4 * j + 2] = BootPercentile(sorted, n, 1 - alpha);
+    out[4 * j + 3] = n > 1 ? std::sqrt(var / (n - 1)) : nan;
+  }
+  BismarckFree(ctx, sorted);
+  BismarckFree(ctx, est);
+  return r;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,125 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "boot"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "bootstrap-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+/*! The defaults: 200 replicates, a 95% interval, seed 0
+ */
+static uint32_t BootReplicates(const IntVal &replicates) {
+  return replicates.is_null || replicates.val < 1 ? 200 : replicates.val;
+}
+
+static double BootLevel(const DoubleVal &level) {
+  return level.is_null || level.val <= 0 || level.val >= 1 ? 0.95 : level.val;
+}
+
+static uint64_t BootSeed(const BigIntVal &seed) {
+  return seed.is_null ? 0 : seed.val;
+}
+
+void BootInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void BootMeanUpdate(FunctionContext* ctx, const BigIntVal &id,
+                    const DoubleVal &x, const IntVal &replicates,
+                    const DoubleVal &level, const BigIntVal &seed,
+                    StringVal *st) {
+  if (id.is_null || x.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckBoot<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckBoot<FunctionContext>::StepMean(ctx, id.val, x.val, 0, 1,
+                                          BootReplicates(replicates),
+                                          BootLevel(level), BootSeed(seed),
+                                          &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+/*! The difference of the means of the treated and untreated rows
+ */
+void BootDiffUpdate(FunctionContext* ctx, const BigIntVal &id,
+                    const DoubleVal &x, const BooleanVal &treated,
+                    const IntVal &replicates, const DoubleVal &level,
+                    const BigIntVal &seed, StringVal *st) {
+  if (id.is_null || x.is_null || treated.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckBoot<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckBoot<FunctionContext>::StepMean(ctx, id.val, x.val,
+                                          treated.val ? 0 : 1, 2,
+                                          BootReplicates(replicates),
+                                          BootLevel(level), BootSeed(seed),
+                                          &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void BootLinrUpdate(FunctionContext* ctx, const BigIntVal &id,
+                    const StringVal &ex, const DoubleVal &y,
+                    const IntVal &replicates, const DoubleVal &level,
+                    const BigIntVal &seed, StringVal *st) {
+  if (id.is_null || ex.is_null || y.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckBoot<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckBoot<FunctionContext>::StepLinr(ctx, id.val, StringValToBytea(ex),
+                                          y.val, BootReplicates(replicates),
+                                          BootLevel(level), BootSeed(seed),
+                                          &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void BootMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckBoot<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                            &dsta)) {
+    ctx->SetError("bootstrap: cannot merge states of different aggregates, "
+                  "replicates, dimensions or seeds");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal BootFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea ci = BismarckBoot<FunctionContext>::Final(ctx, StringValToBytea(st));
+  StringVal r(ctx, ci.len);
+  memcpy(r.ptr, ci.str, ci.len);
+  BismarckFree(ctx, ci.str);
+  return r;
+}
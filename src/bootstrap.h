@@ -0,0 +1,92 @@
+
+#ifndef HAZY_BISMARCK_BOOTSTRAP_H
+#define HAZY_BISMARCK_BOOTSTRAP_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief What a bootstrap state estimates
+ */
+enum BootKind {
+  BOOT_MEAN = 0,   //!< a mean, or the difference of the means of two groups
+  BOOT_LINR = 1    //!< linear regression coefficients
+};
+
+/*! \brief Confidence intervals by Poisson bootstrap, in one pass
+ *
+ * Instead of resampling, every row is given a Poisson(1) weight in each of
+ * B replicates, and each replicate keeps its own weighted accumulators:
+ * counts and sums for a mean, X'X and X'y for linear regression. The
+ * weights are a hash of the seed, the id of the row and the replicate, so
+ * they do not depend on how the rows are split between states, and merged
+ * states equal a single pass over all the rows.
+ *
+ * Replicate 0 weighs every row 1 and gives the point estimate. The
+ * accumulators are stored replicate after replicate for each entry, so a
+ * row adds to an entry of all replicates with one scale-add of the weights.
+ * Final sorts the replicate estimates of each coefficient and interpolates
+ * the percentiles of the interval.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckBoot {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds a value to the mean of its group
+   *
+   * \param ctx the context to allocate memory with
+   * \param id the id of the row, unique
+   * \param x the value
+   * \param group 0, or 1 for the second group
+   * \param groups 1 for a mean, 2 for the difference of the two means
+   * \param replicates B, the number of bootstrap replicates
+   * \param level the confidence level of the interval, e.g. 0.95
+   * \param seed the seed of the weights
+   * \param m the current state, may be re-allocated
+   */
+  static void StepMean(Context* ctx, int64_t id, double x, uint32_t group,
+                       uint32_t groups, uint32_t replicates, double level,
+                       uint64_t seed, bytea *m);
+
+  /*! \brief Adds a row to a linear regression
+   *
+   * \param ex the features (double array), the first row sets their number
+   * \param y the response
+   * The other parameters are those of StepMean.
+   */
+  static void StepLinr(Context* ctx, int64_t id, const bytea &ex, double y,
+                       uint32_t replicates, double level, uint64_t seed,
+                       bytea *m);
+
+  /*! \brief Adds the accumulators of src to dst
+   *
+   * States of a different kind, size or seed are not merged.
+   * \return false if src was not merged
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the estimate, the lower and upper bounds of the
+   * interval and the standard error of each coefficient, as a double array
+   *
+   * Replicates where the estimate is undefined (an empty group, a singular
+   * X'X) are left out of the interval.
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief The weights of a row in replicates 0 .. n - 1
+ */
+void BootWeights(int64_t id, uint64_t seed, uint64_t n, double *w);
+
+}
+}
+#endif
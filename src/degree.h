@@ -3,6 +3,11 @@
 #ifndef HAZY_BISMARCK_DEGREE_INL_H
 #define HAZY_BISMARCK_DEGREE_INL_H
 
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+
 namespace hazy {
 namespace bismarck {
 
@@ -12,69 +17,81 @@ void DegInit(CTX* ctx, bytea *m) {
   m->len = 0;
 }
 
+/*! The state is a count of degrees n followed by room for at least n
+ * degrees, so that the array grows geometrically as larger ids are seen
+ */
+inline uint64_t DegCapacity(const bytea &m) {
+  return m.len > sizeof(uint64_t) ? m.len / sizeof(uint64_t) - 1 : 0;
+}
+
 template <class CTX>
-void DegRealloc(CTX *ctx, bytea *m, size_t len) {
+void DegRealloc(CTX *ctx, bytea *m, size_t cap) {
   size_t dlen;
   uint64_t *d;
-  CoerceBytea(m, d, dlen);
+  CoerceBytea(*m, d, dlen);
 
-  uint64_t *neu = BismarckAllocate<uint64_t>(ctx, len);
+  uint64_t *neu = BismarckAllocate<uint64_t>(ctx, cap + 1);
   // zero it
-  memset(neu, 0, len * sizeof(uint64_t));
+  memset(neu, 0, (cap + 1) * sizeof(uint64_t));
   if (dlen > 0) {
     // copy old contents
-    memcpy(neu, d, dlen*sizeof(uint64_t));
+    memcpy(neu, d, (d[0] + 1) * sizeof(uint64_t));
     BismarckFree(ctx, d);
-    m->str = (char*) neu;
-    m->len = sizeof(uint64_t) * len;
   }
+  m->str = (char*) neu;
+  m->len = sizeof(uint64_t) * (cap + 1);
 }
 
 template <class CTX>
 void DegUpdate(CTX* ctx, bytea *m, size_t n) {
-  size_t dlen;
-  uint64_t *d;
-  CoerceBytea(*m, d, dlen);
-
-  if (n >= dlen) {
+  uint64_t cap = DegCapacity(*m);
+  if (n >= cap) {
     // re-allocate with more memory
-    DegRealloc(ctx, m, n+1);
-    // the pointer d is no longer valid (it was freed), get it again
-    CoerceBytea(m, d, dlen);
+    DegRealloc(ctx, m, std::max<uint64_t>(2 * cap, n + 1));
   }
+  uint64_t *d = reinterpret_cast<uint64_t*>(m->str);
+  if (n >= d[0]) d[0] = n + 1;
 
   // count this one
-  d[n]++;
+  d[n + 1]++;
 }
 
+/*! Returns the array of the degrees, it is moved to the start of the state
+ */
 template <class CTX>
 bytea DegFinal(CTX* ctx, const bytea &m) {
-  // TODO what else to do?
-  return m;
+  if (m.len == 0) return m;
+  uint64_t *d = reinterpret_cast<uint64_t*>(m.str);
+  uint64_t n = d[0];
+  memmove(d, d + 1, n * sizeof(uint64_t));
+  bytea r = {m.str, n * sizeof(uint64_t)};
+  return r;
 }
 
 template <class CTX>
 void DegMerge(CTX* ctx, const bytea &m, bytea *dst) {
+  if (m.len == 0) return;
   // See if dest is big enough, if not, resize
-  size_t dlen, slen;
-  uint64_t *d, *s;
-  CoerceBytea(*dst, d, dlen);
-  CoerceBytea(m, s, slen);
-
-  if (slen > dlen) {
-    DegRealloc(ctx, *dst, slen);
-    // the pointer d is no longer valid (it was freed), get it again
-    CoerceBytea(*dst, d, dlen);
+  uint64_t *s = reinterpret_cast<uint64_t*>(m.str);
+  if (s[0] > DegCapacity(*dst)) {
+    DegRealloc(ctx, dst, s[0]);
   }
 
-  for (size_t i = 0; i < slen; i++) {
+  uint64_t *d = reinterpret_cast<uint64_t*>(dst->str);
+  for (size_t i = 1; i <= s[0]; i++) {
     d[i] += s[i];
   }
+  if (s[0] > d[0]) d[0] = s[0];
 }
 
+/*! Drops the room left for larger ids
+ */
 template <class CTX>
 bytea DegSerial(CTX* ctx, const bytea &m) {
-  return m;
+  if (m.len == 0) return m;
+  bytea r = {m.str, (reinterpret_cast<uint64_t*>(m.str)[0] + 1) *
+                    sizeof(uint64_t)};
+  return r;
 }
 
 }
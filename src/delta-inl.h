@@ -0,0 +1,262 @@
+
+#ifndef HAZY_BISMARCK_DELTA_INL_H
+#define HAZY_BISMARCK_DELTA_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+
+#include "linalg-inl.h"
+
+// see for documentation
+#include "delta.h"
+
+namespace hazy {
+namespace bismarck {
+
+enum DeltaKind {
+  DELTA_TRAIN = 1,   //!< model then base, dim doubles each
+  DELTA_SPARSE = 2,  //!< nnz uint32 indices (padded to 8 bytes), then values
+  DELTA_SUM = 3      //!< dim doubles, the sum of count deltas
+};
+
+struct DeltaHeader {
+  uint32_t kind;
+  uint32_t bits;
+  uint64_t dim;
+  uint64_t nnz;
+  uint64_t count;
+  double keep;
+  double threshold;
+};
+
+inline DeltaHeader* DeltaHead(const bytea &m) {
+  return reinterpret_cast<DeltaHeader*>(m.str);
+}
+
+inline double* DeltaData(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(DeltaHeader));
+}
+
+inline uint32_t* DeltaIndices(const bytea &m) {
+  return reinterpret_cast<uint32_t*>(m.str + sizeof(DeltaHeader));
+}
+
+/*! The values of a sparse delta, after the padded indices
+ */
+inline char* DeltaValues(const bytea &m) {
+  return m.str + sizeof(DeltaHeader) +
+      (DeltaHead(m)->nnz + 1) / 2 * sizeof(uint64_t);
+}
+
+/*! Allocates len bytes, at least a header, and clears the header; returns
+ * false if the memory cannot be allocated
+ */
+template <class CTX>
+bool DeltaAlloc(CTX* ctx, bytea *m, size_t len) {
+  char *str = BismarckAllocate<char>(ctx, len);
+  if (str == NULL) return false;
+  memset(str, 0, std::min(len, sizeof(DeltaHeader)));
+  m->str = str;
+  m->len = len;
+  return true;
+}
+
+template <class CTX>
+bool BismarckDelta<CTX>::Init(CTX* ctx, const bytea &base, size_t dim,
+                              double keep, double threshold, uint32_t bits,
+                              bytea *m) {
+  if (!DeltaAlloc(ctx, m, sizeof(DeltaHeader) + 2 * dim * sizeof(double))) {
+    return false;
+  }
+  DeltaHeader *h = DeltaHead(*m);
+  h->kind = DELTA_TRAIN;
+  h->bits = bits == 8 ? 8 : 64;
+  h->dim = dim;
+  h->count = 1;
+  h->keep = std::min(std::max(keep, 0.0), 1.0);
+  h->threshold = threshold;
+  double *model = DeltaData(*m);
+  if (base.len == dim * sizeof(double)) {
+    memcpy(model, base.str, base.len);
+  } else {
+    memset(model, 0, dim * sizeof(double));
+  }
+  memcpy(model + dim, model, dim * sizeof(double));
+  return true;
+}
+
+template <class CTX>
+bytea BismarckDelta<CTX>::Model(const bytea &m) {
+  bytea model = {reinterpret_cast<char*>(DeltaData(m)),
+                 DeltaHead(m)->dim * sizeof(double)};
+  return model;
+}
+
+/*! Orders coordinates by decreasing magnitude of their change
+ */
+struct DeltaByMagnitude {
+  const double *delta;
+  bool operator()(uint32_t a, uint32_t b) const {
+    return std::abs(delta[a]) > std::abs(delta[b]);
+  }
+};
+
+template <class CTX>
+bytea BismarckDelta<CTX>::Encode(CTX* ctx, const bytea &m, double *residual) {
+  DeltaHeader *h = DeltaHead(m);
+  if (h->kind != DELTA_TRAIN) return m;
+  size_t dim = h->dim;
+
+  // the delta goes to scratch memory, so that the state can be encoded again
+  bytea out = {NULL, 0};
+  double *delta = BismarckAllocate<double>(ctx, dim);
+  uint32_t *order = BismarckAllocate<uint32_t>(ctx, dim);
+  if (delta == NULL || order == NULL) {
+    BismarckFree(ctx, order);
+    BismarckFree(ctx, delta);
+    return out;
+  }
+  memcpy(delta, DeltaData(m), dim * sizeof(double));
+  hazy::simple_scale_add(delta, DeltaData(m) + dim, -1.0, dim);
+
+  size_t nnz = 0;
+  for (size_t i = 0; i < dim; i++) {
+    if (std::abs(delta[i]) > h->threshold) order[nnz++] = i;
+  }
+  size_t k = static_cast<size_t>(std::ceil(h->keep * dim));
+  if (nnz > k) {
+    DeltaByMagnitude by = {delta};
+    std::nth_element(order, order + k, order + nnz, by);
+    nnz = k;
+  }
+  // sorted indices decode with sequential writes
+  std::sort(order, order + nnz);
+
+  size_t values = h->bits == 8 ? sizeof(double) + nnz : nnz * sizeof(double);
+  if (!DeltaAlloc(ctx, &out, sizeof(DeltaHeader) +
+                  (nnz + 1) / 2 * sizeof(uint64_t) + values)) {
+    BismarckFree(ctx, order);
+    BismarckFree(ctx, delta);
+    return out;
+  }
+  DeltaHeader *oh = DeltaHead(out);
+  *oh = *h;
+  oh->kind = DELTA_SPARSE;
+  oh->nnz = nnz;
+  memcpy(DeltaIndices(out), order, nnz * sizeof(uint32_t));
+
+  if (residual != NULL) memcpy(residual, delta, dim * sizeof(double));
+  if (h->bits == 8) {
+    double top = 0;
+    for (size_t j = 0; j < nnz; j++) {
+      top = std::max(top, std::abs(delta[order[j]]));
+    }
+    double scale = top / 127;
+    memcpy(DeltaValues(out), &scale, sizeof(double));
+    int8_t *q = reinterpret_cast<int8_t*>(DeltaValues(out) + sizeof(double));
+    for (size_t j = 0; j < nnz; j++) {
+      q[j] = scale > 0 ?
+          static_cast<int8_t>(std::floor(delta[order[j]] / scale + 0.5)) : 0;
+      if (residual != NULL) residual[order[j]] -= q[j] * scale;
+    }
+  } else {
+    double *v = reinterpret_cast<double*>(DeltaValues(out));
+    for (size_t j = 0; j < nnz; j++) {
+      v[j] = delta[order[j]];
+      if (residual != NULL) residual[order[j]] = 0;
+    }
+  }
+  BismarckFree(ctx, order);
+  BismarckFree(ctx, delta);
+  return out;
+}
+
+/*! Adds the delta of a state of any kind to a dense sum
+ */
+inline void DeltaAddTo(const bytea &m, double *sum) {
+  DeltaHeader *h = DeltaHead(m);
+  if (h->kind == DELTA_TRAIN) {
+    double *model = DeltaData(m);
+    hazy::simple_scale_add(sum, model, 1.0, h->dim);
+    hazy::simple_scale_add(sum, model + h->dim, -1.0, h->dim);
+  } else if (h->kind == DELTA_SUM) {
+    hazy::simple_scale_add(sum, DeltaData(m), 1.0, h->dim);
+  } else {
+    uint32_t *idx = DeltaIndices(m);
+    if (h->bits == 8) {
+      double scale;
+      memcpy(&scale, DeltaValues(m), sizeof(double));
+      int8_t *q = reinterpret_cast<int8_t*>(DeltaValues(m) + sizeof(double));
+      for (size_t j = 0; j < h->nnz; j++) sum[idx[j]] += q[j] * scale;
+    } else {
+      double *v = reinterpret_cast<double*>(DeltaValues(m));
+      for (size_t j = 0; j < h->nnz; j++) sum[idx[j]] += v[j];
+    }
+  }
+}
+
+template <class CTX>
+bool BismarckDelta<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  DeltaHeader *dh = DeltaHead(*dst);
+  if (DeltaHead(src)->dim != dh->dim) return false;
+  if (dh->kind != DELTA_SUM) {
+    bytea sum;
+    if (!DeltaAlloc(ctx, &sum, sizeof(DeltaHeader) +
+                    dh->dim * sizeof(double))) {
+      return false;
+    }
+    *DeltaHead(sum) = *dh;
+    DeltaHead(sum)->kind = DELTA_SUM;
+    DeltaHead(sum)->nnz = 0;
+    memset(DeltaData(sum), 0, dh->dim * sizeof(double));
+    DeltaAddTo(*dst, DeltaData(sum));
+    BismarckFree(ctx, dst->str);
+    *dst = sum;
+    dh = DeltaHead(*dst);
+  }
+  DeltaAddTo(src, DeltaData(*dst));
+  dh->count += DeltaHead(src)->count;
+  return true;
+}
+
+template <class CTX>
+bytea BismarckDelta<CTX>::Final(CTX* ctx, const bytea &m) {
+  DeltaHeader *h = DeltaHead(m);
+  bytea avg;
+  avg.len = h->dim * sizeof(double);
+  avg.str = BismarckAllocate<char>(ctx, avg.len);
+  if (avg.str == NULL) {
+    avg.len = 0;
+    return avg;
+  }
+  double *a = reinterpret_cast<double*>(avg.str);
+  memset(a, 0, avg.len);
+  DeltaAddTo(m, a);
+  if (h->count > 1) hazy::simple_scale(a, 1.0 / h->count, h->dim);
+  return avg;
+}
+
+template <class CTX>
+bytea DeltaApply(CTX* ctx, const bytea &model, const bytea &delta) {
+  bytea out;
+  out.len = delta.len;
+  out.str = BismarckAllocate<char>(ctx, out.len);
+  if (out.str == NULL) {
+    out.len = 0;
+    return out;
+  }
+  memcpy(out.str, delta.str, delta.len);
+  if (model.len == delta.len) {
+    hazy::simple_scale_add(reinterpret_cast<double*>(out.str),
+                           reinterpret_cast<const double*>(model.str), 1.0,
+                           out.len / sizeof(double));
+  }
+  return out;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
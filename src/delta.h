@@ -0,0 +1,75 @@
+
+#ifndef HAZY_BISMARCK_DELTA_H
+#define HAZY_BISMARCK_DELTA_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Ships the models of an IGD aggregate as compressed deltas
+ *
+ * A fragment trains a dense model seeded from the model of the previous
+ * pass (the base). When the state is serialized, only the delta from the
+ * base is encoded: the coordinates with the largest magnitude (at most a
+ * fraction keep of them, and only those above a threshold), optionally
+ * quantized to 8 bits. Merging decodes and sums the deltas; the result of
+ * the aggregate is their average, which is added to the base with Apply.
+ *
+ * States are flat blocks starting with a DeltaHeader and come in three
+ * kinds: the training state (the model then the base, dim doubles each),
+ * an encoded delta, and the dense sum of merged deltas.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckDelta {
+ public:
+  /*! \brief Allocates a training state for a model of dim doubles
+   *
+   * \param base the model to start from, or empty to start from zeros
+   * \param keep the fraction of the coordinates the delta keeps, in (0, 1]
+   * \param threshold coordinates whose change is at most this are dropped
+   * \param bits 8 to quantize the kept coordinates, 64 to keep them exact
+   * \return false if the state cannot be allocated
+   */
+  static bool Init(Context* ctx, const bytea &base, size_t dim, double keep,
+                   double threshold, uint32_t bits, bytea *m);
+
+  /*! \brief The model being trained in a training state, as a double array
+   */
+  static bytea Model(const bytea &m);
+
+  /*! \brief Encodes the delta of a training state
+   *
+   * The state is left unchanged. Other states are returned as is.
+   * \param residual if not NULL, dim doubles that receive what the encoding
+   * lost (the dropped coordinates and the quantization error), to be added
+   * to the next delta of the same worker
+   * \return the encoded delta, with a NULL str if memory cannot be allocated
+   */
+  static bytea Encode(Context* ctx, const bytea &m, double *residual);
+
+  /*! \brief Adds the delta of src to dst, dst may be re-allocated
+   *
+   * Returns false, leaving dst unchanged, if the deltas have different
+   * dimensions or memory cannot be allocated.
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the average of the merged deltas, as a double array,
+   * with a NULL str if memory cannot be allocated
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief Adds a delta returned by Final to a model, into a new model,
+ * with a NULL str if memory cannot be allocated
+ */
+template <class Context>
+bytea DeltaApply(Context* ctx, const bytea &model, const bytea &delta);
+
+}
+}
+#endif
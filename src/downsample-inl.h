@@ -0,0 +1,37 @@
+
+#ifndef HAZY_BISMARCK_DOWNSAMPLE_INL_H
+#define HAZY_BISMARCK_DOWNSAMPLE_INL_H
+
+// see for documentation
+#include "downsample.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! splitmix64 finalizer
+ */
+inline uint64_t DownsampleMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+inline bool DownsampleKeep(int64_t id, bool y, double rate, uint64_t seed) {
+  if (y || rate >= 1) return true;
+  uint64_t r = DownsampleMix(static_cast<uint64_t>(id) ^ DownsampleMix(seed));
+  // uniform in [0, 1)
+  return (r >> 11) * (1.0 / 9007199254740992.0) < rate;
+}
+
+inline double DownsampleWeight(bool y, double rate) {
+  return (y || rate >= 1) ? 1.0 : 1.0 / rate;
+}
+
+inline double DownsampleCalibrate(double p, double rate) {
+  return p * rate / (p * rate + 1 - p);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
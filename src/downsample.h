@@ -0,0 +1,39 @@
+
+#ifndef HAZY_BISMARCK_DOWNSAMPLE_H
+#define HAZY_BISMARCK_DOWNSAMPLE_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Returns true if the row is kept by negative downsampling
+ *
+ * All positives are kept. A negative is kept with probability rate, decided
+ * by a hash of its id and the seed, so the same rows are kept in every pass
+ * and on every node. This only looks at the label and the id, so a rejected
+ * row costs nothing else.
+ * \param id a unique id of the row
+ * \param y the label of the row
+ * \param rate the fraction of negatives kept, in (0, 1]
+ * \param seed changes the negatives kept
+ */
+inline bool DownsampleKeep(int64_t id, bool y, double rate, uint64_t seed);
+
+/*! \brief The importance weight of a kept row, 1 / rate for negatives
+ *
+ * Weighting the kept negatives by 1 / rate makes the expected loss over the
+ * sample equal to the loss over all rows, so the model is unbiased.
+ */
+inline double DownsampleWeight(bool y, double rate);
+
+/*! \brief Corrects a probability predicted by a model trained on
+ * downsampled negatives without the importance weights
+ *
+ * Such a model overestimates the odds by 1 / rate.
+ */
+inline double DownsampleCalibrate(double p, double rate);
+
+}
+}
+#endif
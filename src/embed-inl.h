@@ -0,0 +1,401 @@
+
+#ifndef HAZY_BISMARCK_EMBED_INL_H
+#define HAZY_BISMARCK_EMBED_INL_H
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+#include "linalg-inl.h"
+
+// see for documentation
+#include "embed.h"
+
+namespace hazy {
+namespace bismarck {
+
+const uint32_t kEmbedMaxNegatives = 64;
+
+inline uint64_t EmbedMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*! The alias state is the count of every item, up to dim
+ */
+struct EmbedCountHeader {
+  uint64_t dim;
+  uint64_t cap;
+};
+
+inline EmbedCountHeader* EmbedCountHead(const bytea &m) {
+  return reinterpret_cast<EmbedCountHeader*>(m.str);
+}
+
+inline double* EmbedCounts(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(EmbedCountHeader));
+}
+
+/*! Makes room for the counts of dim items, growing geometrically
+ */
+template <class CTX>
+void EmbedCountReserve(CTX* ctx, bytea *m, uint64_t dim) {
+  uint64_t cap = m->str == NULL ? 0 : EmbedCountHead(*m)->cap;
+  if (dim > cap) {
+    cap = std::max(dim, 2 * cap);
+    bytea g;
+    g.len = sizeof(EmbedCountHeader) + cap * sizeof(double);
+    g.str = BismarckAllocate<char>(ctx, g.len);
+    memset(g.str, 0, g.len);
+    if (m->str != NULL) {
+      *EmbedCountHead(g) = *EmbedCountHead(*m);
+      memcpy(EmbedCounts(g), EmbedCounts(*m),
+             EmbedCountHead(*m)->dim * sizeof(double));
+      BismarckFree(ctx, m->str);
+    }
+    EmbedCountHead(g)->cap = cap;
+    *m = g;
+  }
+  EmbedCountHead(*m)->dim = std::max(EmbedCountHead(*m)->dim, dim);
+}
+
+template <class CTX>
+void BismarckEmbedAlias<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckEmbedAlias<CTX>::Step(CTX* ctx, uint32_t item, double count,
+                                   bytea *m) {
+  if (item >= kEmbedMaxVocab) return;
+  EmbedCountReserve(ctx, m, static_cast<uint64_t>(item) + 1);
+  EmbedCounts(*m)[item] += count;
+}
+
+template <class CTX>
+void BismarckEmbedAlias<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return;
+  }
+  uint64_t dim = EmbedCountHead(src)->dim;
+  EmbedCountReserve(ctx, dst, dim);
+  simple_scale_add(EmbedCounts(*dst), EmbedCounts(src), 1.0, dim);
+}
+
+/*! Builds the table by Vose's method: an item with less than its share
+ * (of 1 / n) is topped up by an item with more
+ */
+template <class CTX>
+bytea BismarckEmbedAlias<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea r = {NULL, 0};
+  if (m.str == NULL) return r;
+  uint64_t n = EmbedCountHead(m)->dim;
+  const double *counts = EmbedCounts(m);
+  double *q = BismarckAllocate<double>(ctx, n);
+  double total = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    q[i] = counts[i] > 0 ? std::pow(counts[i], 0.75) : 0;
+    total += q[i];
+  }
+  if (!(total > 0)) {
+    BismarckFree(ctx, q);
+    return r;
+  }
+
+  r.len = n * sizeof(EmbedAliasEntry);
+  r.str = BismarckAllocate<char>(ctx, r.len);
+  EmbedAliasEntry *table = reinterpret_cast<EmbedAliasEntry*>(r.str);
+  // small from the front, large from the back
+  uint32_t *work = BismarckAllocate<uint32_t>(ctx, n);
+  uint64_t small = 0, large = n;
+  for (uint64_t i = 0; i < n; i++) {
+    q[i] *= n / total;
+    if (q[i] < 1) {
+      work[small++] = i;
+    } else {
+      work[--large] = i;
+    }
+  }
+  while (small > 0 && large < n) {
+    uint32_t s = work[--small], l = work[large];
+    table[s].prob = q[s];
+    table[s].alias = l;
+    q[l] -= 1 - q[s];
+    if (q[l] < 1) {
+      large++;
+      work[small++] = l;
+    }
+  }
+  // the rest is 1 up to rounding
+  for (uint64_t i = 0; i < n; i++) {
+    if (i == small) i = large;
+    if (i == n) break;
+    table[work[i]].prob = 1;
+    table[work[i]].alias = work[i];
+  }
+  BismarckFree(ctx, work);
+  BismarckFree(ctx, q);
+  return r;
+}
+
+inline uint32_t EmbedSample(const EmbedAliasEntry *table, uint64_t n,
+                            uint64_t u) {
+  uint32_t i = ((u >> 32) * n) >> 32;
+  float p = (u & 0xffffffffu) * (1.0f / 4294967296.0f);
+  return p < table[i].prob ? i : table[i].alias;
+}
+
+/*! Header of the model, followed by the input vectors, the output vectors
+ * (vocab * rank doubles each) and rank doubles of scratch
+ */
+struct EmbedHeader {
+  uint64_t vocab;
+  uint64_t rank;
+  uint64_t pairs;   //!< seen since the model was started from prev
+  uint64_t seed;
+};
+
+inline EmbedHeader* EmbedHead(const bytea &m) {
+  return reinterpret_cast<EmbedHeader*>(m.str);
+}
+
+inline double* EmbedIn(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(EmbedHeader));
+}
+
+inline double* EmbedOut(const bytea &m) {
+  return EmbedIn(m) + EmbedHead(m)->vocab * EmbedHead(m)->rank;
+}
+
+inline double* EmbedScratch(const bytea &m) {
+  return EmbedOut(m) + EmbedHead(m)->vocab * EmbedHead(m)->rank;
+}
+
+inline size_t EmbedSize(uint64_t vocab, uint64_t rank) {
+  return sizeof(EmbedHeader) + (2 * vocab + 1) * rank * sizeof(double);
+}
+
+inline bool EmbedFits(uint64_t vocab, uint64_t rank) {
+  // the vocabulary is bounded, so the size cannot overflow
+  return vocab <= kEmbedMaxVocab &&
+      EmbedSize(vocab, rank) <=
+      static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+}
+
+/*! Allocates the state, copying prev if it fits the vocabulary and rank
+ *
+ * \return false if the model does not fit or cannot be allocated, m is
+ * left empty
+ */
+template <class CTX>
+bool EmbedStart(CTX* ctx, const bytea &prev, uint64_t vocab,
+                const EmbedOptions &opt, bytea *m) {
+  uint64_t rank = std::max<uint32_t>(opt.rank, 1);
+  if (!EmbedFits(vocab, rank)) return false;
+  char *str = BismarckAllocate<char>(ctx, EmbedSize(vocab, rank));
+  if (str == NULL) return false;
+  m->str = str;
+  m->len = EmbedSize(vocab, rank);
+  if (prev.len == m->len && EmbedHead(prev)->vocab == vocab &&
+      EmbedHead(prev)->rank == rank) {
+    memcpy(m->str, prev.str, m->len);
+  } else {
+    EmbedHeader h = {vocab, rank, 0, opt.seed};
+    *EmbedHead(*m) = h;
+    double *in = EmbedIn(*m);
+    uint64_t key = EmbedMix(opt.seed);
+    for (uint64_t i = 0; i < vocab * rank; i++) {
+      double u = (EmbedMix(key + i) >> 11) * (1.0 / 9007199254740992.0);
+      in[i] = (u - 0.5) / rank;
+    }
+    memset(EmbedOut(*m), 0, vocab * rank * sizeof(double));
+  }
+  EmbedHead(*m)->pairs = 0;
+  return true;
+}
+
+inline double EmbedSigmoid(double f) {
+  if (f > 30) return 1;
+  if (f < -30) return 0;
+  return 1 / (1 + std::exp(-f));
+}
+
+/*! The paired step of a center and its targets, the first of which is
+ * the context (label 1) and the others negatives (label 0). R is the rank,
+ * or 0 for a rank only known at run time.
+ *
+ * \param grad scratch for rank doubles
+ */
+template <size_t R>
+void EmbedPairStep(double *in, double *out, uint32_t center,
+                   const uint32_t *targets, size_t ntargets, size_t rank,
+                   double step, double *grad) {
+  const size_t n = R ? R : rank;
+  double *vin = in + center * n;
+  memset(grad, 0, n * sizeof(double));
+  for (size_t t = 0; t < ntargets; t++) {
+    double *vout = out + targets[t] * n;
+    double f = unrolled_dot<4>(vin, vout, n);
+    double g = step * ((t == 0 ? 1 : 0) - EmbedSigmoid(f));
+    // the gradient of vin uses vout before its update
+    unrolled_scale_add<4>(grad, vout, g, n);
+    unrolled_scale_add<4>(vout, vin, g, n);
+  }
+  unrolled_scale_add<4>(vin, grad, 1.0, n);
+}
+
+/*! Dispatches to the kernel of the rank
+ */
+inline void EmbedKernel(double *in, double *out, uint32_t center,
+                        const uint32_t *targets, size_t ntargets, size_t rank,
+                        double step, double *grad) {
+  switch (rank) {
+    case 16: EmbedPairStep<16>(in, out, center, targets, ntargets, rank,
+                               step, grad); break;
+    case 32: EmbedPairStep<32>(in, out, center, targets, ntargets, rank,
+                               step, grad); break;
+    case 64: EmbedPairStep<64>(in, out, center, targets, ntargets, rank,
+                               step, grad); break;
+    case 100: EmbedPairStep<100>(in, out, center, targets, ntargets, rank,
+                                 step, grad); break;
+    case 128: EmbedPairStep<128>(in, out, center, targets, ntargets, rank,
+                                 step, grad); break;
+    case 256: EmbedPairStep<256>(in, out, center, targets, ntargets, rank,
+                                 step, grad); break;
+    case 300: EmbedPairStep<300>(in, out, center, targets, ntargets, rank,
+                                 step, grad); break;
+    default: EmbedPairStep<0>(in, out, center, targets, ntargets, rank,
+                              step, grad); break;
+  }
+}
+
+/*! Draws the negatives of a pair and takes its step
+ */
+inline void EmbedPair(const bytea &m, const EmbedAliasEntry *table,
+                      uint32_t center, uint32_t context,
+                      const EmbedOptions &opt) {
+  EmbedHeader *h = EmbedHead(m);
+  uint32_t targets[kEmbedMaxNegatives + 1];
+  size_t ntargets = 1;
+  targets[0] = context;
+  uint32_t negatives = std::min(opt.negatives, kEmbedMaxNegatives);
+  uint64_t key = EmbedMix(opt.seed ^ EmbedMix(h->pairs));
+  key = EmbedMix(key ^ (static_cast<uint64_t>(center) << 32 | context));
+  for (uint32_t k = 0; k < negatives; k++) {
+    uint32_t neg = EmbedSample(table, h->vocab, EmbedMix(key + k));
+    if (neg != context) targets[ntargets++] = neg;
+  }
+  EmbedKernel(EmbedIn(m), EmbedOut(m), center, targets, ntargets, h->rank,
+              opt.step, EmbedScratch(m));
+  h->pairs++;
+}
+
+template <class CTX>
+void BismarckEmbed<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckEmbed<CTX>::Step(CTX* ctx, const bytea &prev, const bytea &alias,
+                              uint32_t center, uint32_t context,
+                              const EmbedOptions &opt, bytea *m) {
+  uint64_t vocab = alias.len / sizeof(EmbedAliasEntry);
+  if (vocab == 0) return;
+  if (m->str == NULL && !EmbedStart(ctx, prev, vocab, opt, m)) return;
+  if (center >= EmbedHead(*m)->vocab || context >= EmbedHead(*m)->vocab) {
+    return;
+  }
+  EmbedPair(*m, reinterpret_cast<const EmbedAliasEntry*>(alias.str), center,
+            context, opt);
+}
+
+template <class CTX>
+void BismarckEmbed<CTX>::StepSequence(CTX* ctx, const bytea &prev,
+                                      const bytea &alias, const bytea &tokens,
+                                      const EmbedOptions &opt, bytea *m) {
+  uint64_t vocab = alias.len / sizeof(EmbedAliasEntry);
+  if (vocab == 0) return;
+  if (m->str == NULL && !EmbedStart(ctx, prev, vocab, opt, m)) return;
+  vocab = EmbedHead(*m)->vocab;
+  const EmbedAliasEntry *table =
+      reinterpret_cast<const EmbedAliasEntry*>(alias.str);
+  const int32_t *t = reinterpret_cast<const int32_t*>(tokens.str);
+  int64_t n = tokens.len / sizeof(int32_t);
+  uint64_t key = EmbedMix(opt.seed ^ EmbedMix(EmbedHead(*m)->pairs));
+  for (int64_t i = 0; i < n; i++) {
+    if (t[i] < 0 || static_cast<uint64_t>(t[i]) >= vocab) continue;
+    int64_t w = opt.window;
+    if (w > 1) w -= EmbedMix(key + i) % w;
+    for (int64_t j = std::max<int64_t>(i - w, 0); j <= i + w && j < n; j++) {
+      if (j == i || t[j] < 0 || static_cast<uint64_t>(t[j]) >= vocab) {
+        continue;
+      }
+      EmbedPair(*m, table, t[i], t[j], opt);
+    }
+  }
+}
+
+template <class CTX>
+bool BismarckEmbed<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  if (dst->str == NULL) {
+    char *str = BismarckAllocate<char>(ctx, src.len);
+    if (str == NULL) return false;
+    memcpy(str, src.str, src.len);
+    dst->str = str;
+    dst->len = src.len;
+    return true;
+  }
+  EmbedHeader *h = EmbedHead(*dst);
+  const EmbedHeader *sh = EmbedHead(src);
+  if (h->vocab != sh->vocab || h->rank != sh->rank) return false;
+  uint64_t pairs = h->pairs + sh->pairs;
+  if (pairs == 0) return true;
+  double a = static_cast<double>(sh->pairs) / pairs;
+  size_t len = 2 * h->vocab * h->rank;
+  simple_scale(EmbedIn(*dst), 1 - a, len);
+  simple_scale_add(EmbedIn(*dst), EmbedIn(src), a, len);
+  h->pairs = pairs;
+  return true;
+}
+
+template <class CTX>
+bytea BismarckEmbed<CTX>::Final(CTX* ctx, const bytea &m) {
+  return m;
+}
+
+template <class CTX>
+const double* BismarckEmbed<CTX>::Vector(const bytea &model, uint64_t item) {
+  if (model.len < sizeof(EmbedHeader)) return NULL;
+  const EmbedHeader *h = EmbedHead(model);
+  if (model.len != EmbedSize(h->vocab, h->rank) || item >= h->vocab) {
+    return NULL;
+  }
+  return EmbedIn(model) + item * h->rank;
+}
+
+template <class CTX>
+double BismarckEmbed<CTX>::Similarity(const bytea &model, uint64_t a,
+                                      uint64_t b) {
+  const double *x = Vector(model, a), *y = Vector(model, b);
+  if (x == NULL || y == NULL) return std::numeric_limits<double>::quiet_NaN();
+  size_t rank = EmbedHead(model)->rank;
+  double xx = simple_dot(x, x, rank), yy = simple_dot(y, y, rank);
+  if (!(xx > 0 && yy > 0)) return std::numeric_limits<double>::quiet_NaN();
+  return simple_dot(x, y, rank) / std::sqrt(xx * yy);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
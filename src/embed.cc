@@ -0,0 +1,192 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "embed"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "embed-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void EmbedAliasInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void EmbedAliasUpdate(FunctionContext* ctx, const IntVal &item,
+                      const DoubleVal &count, StringVal *st) {
+  if (item.is_null || count.is_null || item.val < 0) return;
+  if (static_cast<uint32_t>(item.val) >= kEmbedMaxVocab) {
+    ctx->SetError("embedalias: item ids must be below 16777216");
+    return;
+  }
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckEmbedAlias<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckEmbedAlias<FunctionContext>::Step(ctx, item.val, count.val, &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void EmbedAliasMerge(FunctionContext* ctx, const StringVal &src,
+                     StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckEmbedAlias<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                             &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal EmbedAliasFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea table = BismarckEmbedAlias<FunctionContext>::Final(
+      ctx, StringValToBytea(st));
+  if (table.str == NULL) return StringVal::null();
+  StringVal r(ctx, table.len);
+  memcpy(r.ptr, table.str, table.len);
+  BismarckFree(ctx, table.str);
+  return r;
+}
+
+/*! The defaults: rank 100, 5 negatives, step 0.025, seed 0
+ */
+static EmbedOptions EmbedOpt(const IntVal &window, const IntVal &rank,
+                             const DoubleVal &step, const IntVal &negatives,
+                             const BigIntVal &seed) {
+  EmbedOptions opt;
+  opt.window = window.is_null || window.val < 1 ? 5 : window.val;
+  opt.rank = rank.is_null || rank.val < 1 ? 100 : rank.val;
+  opt.step = step.is_null ? 0.025 : step.val;
+  opt.negatives = negatives.is_null || negatives.val < 0 ? 5 : negatives.val;
+  opt.seed = seed.is_null ? 0 : seed.val;
+  return opt;
+}
+
+/*! Checks the size of the model before the first step allocates it
+ */
+static bool EmbedModelFits(FunctionContext* ctx, const StringVal &alias,
+                           const EmbedOptions &opt, const StringVal &st) {
+  if (!st.is_null) return true;
+  if (EmbedFits(alias.len / sizeof(EmbedAliasEntry), opt.rank)) return true;
+  ctx->SetError("embed: the model of this vocabulary and rank is over 2GB");
+  return false;
+}
+
+void EmbedInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void EmbedUpdate(FunctionContext* ctx, const StringVal &prev_model,
+                 const StringVal &alias, const IntVal &center,
+                 const IntVal &context, const IntVal &rank,
+                 const DoubleVal &step, const IntVal &negatives,
+                 const BigIntVal &seed, StringVal *st) {
+  if (alias.is_null || center.is_null || context.is_null) return;
+  if (center.val < 0 || context.val < 0) return;
+  EmbedOptions opt = EmbedOpt(IntVal::null(), rank, step, negatives, seed);
+  if (!EmbedModelFits(ctx, alias, opt, *st)) return;
+  bytea prev = {NULL, 0};
+  if (!prev_model.is_null) prev = StringValToBytea(prev_model);
+  bytea sta = {NULL, 0};
+  if (!st->is_null) sta = StringValToBytea(*st);
+  BismarckEmbed<FunctionContext>::Step(ctx, prev, StringValToBytea(alias),
+                                       center.val, context.val, opt, &sta);
+  if (sta.str == NULL) return;
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void EmbedSeqUpdate(FunctionContext* ctx, const StringVal &prev_model,
+                    const StringVal &alias, const StringVal &tokens,
+                    const IntVal &window, const IntVal &rank,
+                    const DoubleVal &step, const IntVal &negatives,
+                    const BigIntVal &seed, StringVal *st) {
+  if (alias.is_null || tokens.is_null) return;
+  EmbedOptions opt = EmbedOpt(window, rank, step, negatives, seed);
+  if (!EmbedModelFits(ctx, alias, opt, *st)) return;
+  bytea prev = {NULL, 0};
+  if (!prev_model.is_null) prev = StringValToBytea(prev_model);
+  bytea sta = {NULL, 0};
+  if (!st->is_null) sta = StringValToBytea(*st);
+  BismarckEmbed<FunctionContext>::StepSequence(
+      ctx, prev, StringValToBytea(alias), StringValToBytea(tokens), opt,
+      &sta);
+  if (sta.str == NULL) return;
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void EmbedMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckEmbed<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                             &dsta)) {
+    ctx->SetError("embed: cannot merge models of different vocabularies or "
+                  "ranks, or out of memory");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal EmbedFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  bytea model = BismarckEmbed<FunctionContext>::Final(ctx,
+                                                      StringValToBytea(st));
+  return BismarckResult(model.str, model.len);
+}
+
+/*! The input vector of an item, as a double array
+ */
+StringVal EmbedVector(FunctionContext* ctx, const StringVal &model,
+                      const IntVal &item) {
+  if (model.is_null || item.is_null || item.val < 0) {
+    return StringVal::null();
+  }
+  bytea m = StringValToBytea(model);
+  const double *v = BismarckEmbed<FunctionContext>::Vector(m, item.val);
+  if (v == NULL) return StringVal::null();
+  size_t len = EmbedHead(m)->rank * sizeof(double);
+  StringVal r(ctx, len);
+  memcpy(r.ptr, v, len);
+  return r;
+}
+
+DoubleVal EmbedSimilarity(FunctionContext* ctx, const StringVal &model,
+                          const IntVal &a, const IntVal &b) {
+  if (model.is_null || a.is_null || b.is_null || a.val < 0 || b.val < 0) {
+    return DoubleVal::null();
+  }
+  return DoubleVal(BismarckEmbed<FunctionContext>::Similarity(
+      StringValToBytea(model), a.val, b.val));
+}
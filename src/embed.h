@@ -0,0 +1,152 @@
+
+#ifndef HAZY_BISMARCK_EMBED_H
+#define HAZY_BISMARCK_EMBED_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief An entry of an alias table, item i is drawn with probability
+ * prob, alias otherwise
+ */
+struct EmbedAliasEntry {
+  float prob;
+  uint32_t alias;
+};
+
+/*! \brief The settings of an embedding step
+ */
+struct EmbedOptions {
+  uint32_t rank;        //!< the length of a vector
+  uint32_t negatives;   //!< negative samples per pair, at most 64
+  uint32_t window;      //!< the context of a token in a sequence
+  double step;          //!< the step size
+  uint64_t seed;        //!< of the negatives, change it every epoch
+};
+
+/*! \brief Builds the alias table of the negative sampling distribution
+ *
+ * The input is the number of occurrences of each item, e.g. one row per
+ * item from a group by. Final returns a table of EmbedAliasEntry, one per
+ * item up to the largest seen, drawing item i with probability
+ * proportional to count_i^0.75, in constant time.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckEmbedAlias {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds count occurrences of an item
+   *
+   * Items from kEmbedMaxVocab on are skipped, the state holds a count for
+   * every item up to the largest.
+   */
+  static void Step(Context* ctx, uint32_t item, double count, bytea *m);
+
+  /*! \brief Adds the counts of src to dst
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the alias table, empty if nothing was counted
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief Trains item embeddings by skip-gram with negative sampling
+ *
+ * Every item has an input vector and an output vector, like the row and
+ * column factors of BismarckMF. A (center, context) pair is a paired IGD
+ * step on the logistic loss: the output vector of the context is pulled
+ * towards the input vector of the center, the output vectors of negative
+ * samples drawn from the alias table pushed away, and the input vector of
+ * the center moves by the sum of their gradients. Token arrays are turned
+ * into pairs within a window, shrunk at random for each center as in
+ * word2vec. The kernels are specialized for common ranks, so the vector
+ * loops have a constant length the compiler can unroll and vectorize.
+ *
+ * The vocabulary is the size of the alias table. As with the other IGD
+ * models an epoch starts from the model of the previous one, or from input
+ * vectors hashed from the seed and zero output vectors, so that all the
+ * states of an epoch start alike; merging averages them, weighted by the
+ * pairs each has seen. The model holds 2 * vocabulary * rank doubles, it
+ * is not started if that does not fit a result (see EmbedFits).
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckEmbed {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Takes a step on a (center, context) pair
+   *
+   * \param ctx the context to allocate memory with
+   * \param prev the model to start from (a result of Final), or empty
+   * \param alias the alias table of the negatives
+   * \param center the item whose input vector is trained
+   * \param context the item seen with it
+   * \param opt the settings, the window is not used
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &prev, const bytea &alias,
+                   uint32_t center, uint32_t context,
+                   const EmbedOptions &opt, bytea *m);
+
+  /*! \brief Takes a step on every pair of a token sequence (int32 array)
+   * within the window; tokens outside the vocabulary are skipped
+   */
+  static void StepSequence(Context* ctx, const bytea &prev, const bytea &alias,
+                           const bytea &tokens, const EmbedOptions &opt,
+                           bytea *m);
+
+  /*! \brief Averages two states, weighted by the pairs each has seen
+   *
+   * \return false, and dst is unchanged, if the states are of different
+   * vocabularies or ranks, or the memory cannot be allocated
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the model
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+
+  /*! \brief The input vector of an item, NULL if it is not in the model
+   */
+  static const double* Vector(const bytea &model, uint64_t item);
+
+  /*! \brief The cosine similarity of the input vectors of two items
+   */
+  static double Similarity(const bytea &model, uint64_t a, uint64_t b);
+};
+
+/*! \brief The largest vocabulary of an alias table
+ */
+const uint32_t kEmbedMaxVocab = 1 << 24;
+
+/*! \brief Whether the model of a vocabulary and rank fits in a result,
+ * which is at most 2GB
+ */
+inline bool EmbedFits(uint64_t vocab, uint64_t rank);
+
+/*! \brief Draws an item from an alias table of n entries using 64 random
+ * bits
+ */
+inline uint32_t EmbedSample(const EmbedAliasEntry *table, uint64_t n,
+                            uint64_t u);
+
+}
+}
+#endif
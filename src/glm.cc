@@ -0,0 +1,132 @@
+
+#include <cmath>
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "glm"
+#include "memory-udf.h"
+
+#include "madport/port-dbconnector-inl.h"
+
+#include "bismarck.h"
+
+// MADlib includes
+#include "metaport/modules/glm-inl.h"
+
+// defines basic math operations
+#include "linalg-inl.h"
+
+// see for documentation
+#include "glm.h"
+
+using namespace hazy;
+using namespace madlib;
+using namespace std;
+
+void GlmInit(FunctionContext* context, StringVal* st) {
+  st->is_null = true;
+}
+
+void GlmUpdate(FunctionContext* context, const StringVal& prev_state,
+               const StringVal& val, const DoubleVal &y, const IntVal &family,
+               const IntVal &link, const DoubleVal &power, StringVal* st) {
+  if (val.is_null || y.is_null) return;
+  if (family.is_null || link.is_null) {
+    context->SetError("glm: the family and the link must not be null");
+    return;
+  }
+  PortAllocator pa(context);
+
+  if (st->is_null) {
+    madlib::MemHandle<char> state = madlib::modules::convex::GlmInit(pa);
+    st->is_null = false;
+    st->len = state.size;
+    st->ptr = reinterpret_cast<uint8_t*>(state.ptr);
+  }
+
+  // convert to types that MADlib expects
+  madlib::MemHandle<char> state = {(size_t)st->len, (char*)st->ptr};
+  madlib::MemHandle<char> prev = {0, NULL};
+  if (!prev_state.is_null) {
+    prev.size = prev_state.len;
+    prev.ptr = (char*) prev_state.ptr;
+  }
+  size_t len_val = val.len/sizeof(double);
+  double *v = (double*) val.ptr;
+
+  madlib::MemHandle<char> new_state =
+      madlib::modules::convex::GlmTransition(pa, state, v, len_val, y.val,
+                                             prev, family.val, link.val,
+                                             power.is_null ? 0 : power.val);
+
+  // clean up memory if the transition function re-allocated
+  if (st->ptr != (uint8_t*) new_state.ptr) {
+    pa.Free(st->ptr);
+  }
+  st->ptr = (uint8_t*) new_state.ptr;
+  st->len = new_state.size;
+}
+
+void GlmMerge(FunctionContext* context, const StringVal& src, StringVal* dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(context, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    return;
+  }
+  PortAllocator pa(context);
+  madlib::MemHandle<char> statea = {(size_t)dst->len, (char*)dst->ptr};
+  madlib::MemHandle<char> stateb = {(size_t)src.len, (char*)src.ptr};
+
+  madlib::MemHandle<char> combin =
+      madlib::modules::convex::GlmMerge(pa, statea, stateb);
+  dst->ptr = (uint8_t*) combin.ptr;
+  dst->len = combin.size;
+}
+
+StringVal GlmFinalize(FunctionContext* context, const StringVal& st) {
+  if (st.is_null) {
+    // the UDA was run on an empty table
+    StringVal sv;
+    return sv;
+  }
+
+  // the final state is solved in the state itself
+  BismarckReleaseState(st);
+  PortAllocator pa(context);
+  madlib::MemHandle<char> state = {(size_t)st.len, (char*)st.ptr};
+  madlib::MemHandle<char> fin = madlib::modules::convex::GlmFinal(pa, state);
+
+  StringVal sv((uint8_t*) fin.ptr, fin.size);
+  return sv;
+}
+
+StringVal GlmCoef(FunctionContext* context, const StringVal& st) {
+  if (st.is_null) return StringVal::null();
+  PortAllocator pa(context);
+  madlib::MemHandle<char> state = {(size_t)st.len, (char*)st.ptr};
+  madlib::MemHandle<double> coef = madlib::modules::convex::GlmCoef(pa, state);
+
+  return BismarckCopyResult(context, coef.ptr, coef.size*sizeof(double));
+}
+
+DoubleVal GlmDeviance(FunctionContext* context, const StringVal& st) {
+  if (st.is_null) return DoubleVal::null();
+  madlib::MemHandle<char> state = {(size_t)st.len, (char*)st.ptr};
+  return DoubleVal(madlib::modules::convex::GlmDeviance(state));
+}
+
+DoubleVal GlmPredict(FunctionContext* context, const StringVal& coef,
+                     const StringVal& examp, const IntVal& link) {
+  if (coef.is_null || examp.is_null || link.is_null) return DoubleVal::null();
+  size_t len = coef.len / sizeof(double);
+  double eta = simple_dot(reinterpret_cast<double*>(coef.ptr),
+                          reinterpret_cast<double*>(examp.ptr),
+                          len);
+  DoubleVal dv(link.val == 1 ? std::exp(eta) : eta);
+  return dv;
+}
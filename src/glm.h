@@ -0,0 +1,59 @@
+#ifndef MADLIB_MODULES_IMPALA_GLM_H
+#define MADLIB_MODULES_IMPALA_GLM_H
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+using namespace std;
+
+/*! \brief Initializes the UDA state to NULL
+ */
+void GlmInit(FunctionContext* context, StringVal* st);
+
+/*! \brief Adds an example to the IRLS sums of a Poisson, Gamma or Tweedie GLM
+ *
+ * One run of the UDA is one IRLS iteration; the result of the previous run
+ * is passed as prev_state (NULL for the first run). A handful of runs is
+ * usually enough, see GlmDeviance.
+ * \param prev_state the result of the previous run of the UDA or NULL
+ * \param val a double array of the example vector
+ * \param y the response
+ * \param family 1: Poisson, 2: Gamma, 3: Tweedie
+ * \param link 1: log, 2: identity
+ * \param power the variance power of the Tweedie family, in (1, 2)
+ */
+void GlmUpdate(FunctionContext* context, const StringVal& prev_state,
+               const StringVal& val, const DoubleVal &y, const IntVal &family,
+               const IntVal &link, const DoubleVal &power, StringVal* st);
+
+/*! Combines two GLM states
+ */
+void GlmMerge(FunctionContext* context, const StringVal& src, StringVal* dst);
+
+/*! \brief Takes the IRLS step and returns the new state
+ */
+StringVal GlmFinalize(FunctionContext* context, const StringVal& st);
+
+/*! \brief Returns the coefficient vector of a state (a double array)
+ */
+StringVal GlmCoef(FunctionContext* context, const StringVal& st);
+
+/*! \brief Returns the deviance of the model a run started from
+ *
+ * The deviance of the first run is 0; iterate until it stops changing.
+ */
+DoubleVal GlmDeviance(FunctionContext* context, const StringVal& st);
+
+/*! \brief Predicts the mean response of an example
+ *
+ * Does not allocate memory.
+ * \param coef the coefficients, output of GlmCoef
+ * \param examp a double array of the example vector
+ * \param link the link the model was trained with
+ */
+DoubleVal GlmPredict(FunctionContext* context, const StringVal& coef,
+                     const StringVal& examp, const IntVal& link);
+
+#endif
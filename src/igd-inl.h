@@ -0,0 +1,502 @@
+
+#ifndef HAZY_BISMARCK_IGD_INL_H
+#define HAZY_BISMARCK_IGD_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+
+#include "linalg-inl.h"
+
+// see for documentation
+#include "igd.h"
+
+namespace hazy {
+namespace bismarck {
+
+// Losses, of the prediction p = w.x and the label y. Gradient is the
+// derivative by p, the step on coordinate j is then Gradient * x_j.
+
+struct HingeLoss {
+  static double Loss(double p, double y) {
+    return std::max(1 - (y > 0 ? p : -p), 0.0);
+  }
+  static double Gradient(double p, double y) {
+    double lbl = y > 0 ? 1 : -1;
+    return lbl * p < 1 ? -lbl : 0;
+  }
+};
+
+struct LogisticLoss {
+  static double Loss(double p, double y) {
+    double margin = y > 0 ? p : -p;
+    // log(1 + exp(-margin)) without overflowing for large negative margins
+    return margin > 0 ? log1p(exp(-margin)) : -margin + log1p(exp(margin));
+  }
+  static double Gradient(double p, double y) {
+    double lbl = y > 0 ? 1 : -1;
+    return -lbl / (1 + exp(lbl * p));
+  }
+};
+
+struct SquaredLoss {
+  static double Loss(double p, double y) {
+    return 0.5 * (p - y) * (p - y);
+  }
+  static double Gradient(double p, double y) {
+    return p - y;
+  }
+};
+
+/*! Squared within a residual of 1, absolute beyond it
+ */
+struct HuberLoss {
+  static double Loss(double p, double y) {
+    double r = std::abs(p - y);
+    return r <= 1 ? 0.5 * r * r : r - 0.5;
+  }
+  static double Gradient(double p, double y) {
+    return std::min(std::max(p - y, -1.0), 1.0);
+  }
+};
+
+// Regularizers. Apply regularizes a weight for k steps of size a = step * mu
+// at once, which is what the lazy updates of sparse models need, Dense
+// regularizes all of the weights for one step.
+
+struct NoReg {
+  enum { kNone = 1 };
+  static double Apply(double w, double a, uint64_t k) {
+    return w;
+  }
+  static void Dense(double *w, size_t dim, double a) {
+  }
+};
+
+struct L2Reg {
+  enum { kNone = 0 };
+  /*! The shrink factor, a large (e.g. importance weighted) step shrinks the
+   * weights to zero rather than flipping their sign
+   */
+  static double Factor(double a) {
+    return a < 1 ? 1 - a : 0;
+  }
+  static double Apply(double w, double a, uint64_t k) {
+    double f = Factor(a);
+    return k == 1 ? w * f : w * std::pow(f, static_cast<double>(k));
+  }
+  static void Dense(double *w, size_t dim, double a) {
+    hazy::simple_scale(w, Factor(a), dim);
+  }
+};
+
+/*! Truncated gradient: shrinks towards zero without crossing it
+ */
+struct L1Reg {
+  enum { kNone = 0 };
+  static double Apply(double w, double a, uint64_t k) {
+    double shrink = a * k;
+    if (w > shrink) return w - shrink;
+    if (w < -shrink) return w + shrink;
+    return 0;
+  }
+  static void Dense(double *w, size_t dim, double a) {
+    for (size_t i = 0; i < dim; i++) w[i] = Apply(w[i], a, 1);
+  }
+};
+
+/*! L1Percent percent of mu goes to L1, the rest to L2
+ */
+template <int L1Percent>
+struct ElasticNetReg {
+  enum { kNone = 0 };
+  static double Apply(double w, double a, uint64_t k) {
+    double l1 = a * L1Percent / 100.0;
+    return L1Reg::Apply(L2Reg::Apply(w, a - l1, k), l1, k);
+  }
+  static void Dense(double *w, size_t dim, double a) {
+    for (size_t i = 0; i < dim; i++) w[i] = Apply(w[i], a, 1);
+  }
+};
+
+// Step rules. Rate returns the step of a coordinate given its gradient and
+// accumulates it, Current the step without a new gradient.
+
+struct ConstantStep {
+  enum { kAdaptive = 0 };
+  static double Rate(double step, double *acc, size_t j, double g) {
+    return step;
+  }
+  static double Current(double step, const double *acc, size_t j) {
+    return step;
+  }
+};
+
+/*! The step of a coordinate is divided by the root of the sum of its
+ * squared gradients, plus one so that it starts at the given step
+ */
+struct AdaGradStep {
+  enum { kAdaptive = 1 };
+  static double Rate(double step, double *acc, size_t j, double g) {
+    acc[j] += g * g;
+    return Current(step, acc, j);
+  }
+  static double Current(double step, const double *acc, size_t j) {
+    return step / std::sqrt(1 + acc[j]);
+  }
+};
+
+// Representations of an example. Dim is the dimension the model needs for
+// it, Dot is w.x over the first dim weights and Update takes the step
+// w -= rate_j * g * x_j. Touched calls f(j) on the coordinates the example
+// has non-zeros in, for the lazy regularizer.
+
+template <int Adaptive>
+struct IGDAdaptive {
+};
+
+struct DenseRep {
+  enum { kSparse = 0 };
+  static size_t Dim(const bytea &ex) {
+    return ex.len / sizeof(double);
+  }
+  static double Dot(const double *w, size_t dim, const bytea &ex) {
+    return hazy::simple_dot(w, reinterpret_cast<const double*>(ex.str),
+                            std::min(dim, Dim(ex)));
+  }
+  template <class StepRule>
+  static void Update(double *w, double *acc, size_t dim, const bytea &ex,
+                     double step, double g) {
+    Update<StepRule>(w, acc, dim, ex, step, g,
+                     IGDAdaptive<StepRule::kAdaptive>());
+  }
+  template <class StepRule>
+  static void Update(double *w, double *acc, size_t dim, const bytea &ex,
+                     double step, double g, IGDAdaptive<0>) {
+    hazy::simple_scale_add(w, reinterpret_cast<const double*>(ex.str),
+                           -step * g, std::min(dim, Dim(ex)));
+  }
+  template <class StepRule>
+  static void Update(double *w, double *acc, size_t dim, const bytea &ex,
+                     double step, double g, IGDAdaptive<1>) {
+    const double *x = reinterpret_cast<const double*>(ex.str);
+    size_t n = std::min(dim, Dim(ex));
+    for (size_t j = 0; j < n; j++) {
+      double gj = g * x[j];
+      w[j] -= StepRule::Rate(step, acc, j, gj) * gj;
+    }
+  }
+  template <class F>
+  static void Touched(const bytea &ex, F &f) {
+    for (size_t j = 0; j < Dim(ex); j++) f(j);
+  }
+};
+
+/*! Half the size of a dense example; the model stays in doubles
+ */
+struct FloatRep {
+  enum { kSparse = 0 };
+  static size_t Dim(const bytea &ex) {
+    return ex.len / sizeof(float);
+  }
+  static double Dot(const double *w, size_t dim, const bytea &ex) {
+    const float *x = reinterpret_cast<const float*>(ex.str);
+    size_t n = std::min(dim, Dim(ex));
+    double acc[4] = {0, 0, 0, 0};
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+      for (size_t k = 0; k < 4; k++) acc[k] += w[j + k] * x[j + k];
+    }
+    for (; j < n; j++) acc[0] += w[j] * x[j];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  }
+  template <class StepRule>
+  static void Update(double *w, double *acc, size_t dim, const bytea &ex,
+                     double step, double g) {
+    const float *x = reinterpret_cast<const float*>(ex.str);
+    size_t n = std::min(dim, Dim(ex));
+    for (size_t j = 0; j < n; j++) {
+      double gj = g * x[j];
+      w[j] -= StepRule::Rate(step, acc, j, gj) * gj;
+    }
+  }
+  template <class F>
+  static void Touched(const bytea &ex, F &f) {
+    for (size_t j = 0; j < Dim(ex); j++) f(j);
+  }
+};
+
+struct SparseRep {
+  enum { kSparse = 1 };
+  static size_t Nnz(const bytea &ex) {
+    return ex.len / sizeof(IGDSparseEntry);
+  }
+  static const IGDSparseEntry* Entries(const bytea &ex) {
+    return reinterpret_cast<const IGDSparseEntry*>(ex.str);
+  }
+  static size_t Dim(const bytea &ex) {
+    size_t dim = 0;
+    for (size_t i = 0; i < Nnz(ex); i++) {
+      dim = std::max(dim, static_cast<size_t>(Entries(ex)[i].index) + 1);
+    }
+    return dim;
+  }
+  static double Dot(const double *w, size_t dim, const bytea &ex) {
+    const IGDSparseEntry *e = Entries(ex);
+    double pred = 0;
+    for (size_t i = 0; i < Nnz(ex); i++) {
+      if (e[i].index < dim) pred += w[e[i].index] * e[i].value;
+    }
+    return pred;
+  }
+  template <class StepRule>
+  static void Update(double *w, double *acc, size_t dim, const bytea &ex,
+                     double step, double g) {
+    const IGDSparseEntry *e = Entries(ex);
+    for (size_t i = 0; i < Nnz(ex); i++) {
+      size_t j = e[i].index;
+      if (j >= dim) continue;
+      double gj = g * e[i].value;
+      w[j] -= StepRule::Rate(step, acc, j, gj) * gj;
+    }
+  }
+  template <class F>
+  static void Touched(const bytea &ex, F &f) {
+    for (size_t i = 0; i < Nnz(ex); i++) f(Entries(ex)[i].index);
+  }
+};
+
+struct IGDHeader {
+  uint64_t dim;    //!< the weights in use
+  uint64_t cap;    //!< the weights allocated, the arrays are this long
+  uint64_t steps;  //!< the examples seen, the clock of the lazy regularizer
+  double step;     //!< the step size and regularization of the last example,
+  double mu;       //!< used to catch up on the lazy regularizer
+};
+
+inline IGDHeader* IGDHead(const bytea &m) {
+  return reinterpret_cast<IGDHeader*>(m.str);
+}
+
+/*! The IGD kernel on a model without a header, the step of BismarckSVM
+ */
+template <class Loss, class Reg, class StepRule, class Rep>
+void IGDKernel(double *w, double *acc, size_t dim, const bytea &ex, double y,
+               double step, double mu) {
+  double g = Loss::Gradient(Rep::Dot(w, dim, ex), y);
+  if (g != 0) Rep::template Update<StepRule>(w, acc, dim, ex, step, g);
+  if (Reg::kNone) return;
+  if (StepRule::kAdaptive) {
+    for (size_t j = 0; j < dim; j++) {
+      w[j] = Reg::Apply(w[j], StepRule::Current(step, acc, j) * mu, 1);
+    }
+  } else {
+    Reg::Dense(w, dim, step * mu);
+  }
+}
+
+/*! The layout of the state for a set of policies
+ */
+template <class Rep, class Reg, class StepRule>
+struct IGDLayout {
+  enum {
+    kLazy = Rep::kSparse && !Reg::kNone,
+    kArrays = 1 + StepRule::kAdaptive + kLazy
+  };
+  static size_t Size(size_t cap) {
+    return sizeof(IGDHeader) + kArrays * cap * sizeof(double);
+  }
+  static double* Weights(const bytea &m) {
+    return reinterpret_cast<double*>(m.str + sizeof(IGDHeader));
+  }
+  static double* Acc(const bytea &m) {
+    return StepRule::kAdaptive ? Weights(m) + IGDHead(m)->cap : NULL;
+  }
+  /*! The step at which each weight was last regularized
+   */
+  static uint64_t* Last(const bytea &m) {
+    if (!kLazy) return NULL;
+    return reinterpret_cast<uint64_t*>(
+        Weights(m) + (1 + StepRule::kAdaptive) * IGDHead(m)->cap);
+  }
+};
+
+/*! Brings the weights in m up to date with the lazy regularizer
+ */
+template <class Rep, class Reg, class StepRule>
+struct IGDCatchUp {
+  const bytea &m;
+  void operator()(size_t j) {
+    typedef IGDLayout<Rep, Reg, StepRule> L;
+    IGDHeader *h = IGDHead(m);
+    uint64_t *last = L::Last(m);
+    if (j >= h->dim || last[j] >= h->steps) return;
+    double *acc = L::Acc(m);
+    L::Weights(m)[j] = Reg::Apply(
+        L::Weights(m)[j], StepRule::Current(h->step, acc, j) * h->mu,
+        h->steps - last[j]);
+    last[j] = h->steps;
+  }
+};
+
+/*! Allocates a state for cap weights, keeping the content of the old one;
+ * a new state uses all of them
+ */
+template <class Context, class Rep, class Reg, class StepRule>
+void IGDResize(Context* ctx, size_t cap, bytea *m) {
+  typedef IGDLayout<Rep, Reg, StepRule> L;
+  bytea old = *m;
+  m->len = L::Size(cap);
+  m->str = BismarckAllocate<char>(ctx, m->len);
+  memset(m->str, 0, m->len);
+  IGDHeader *h = IGDHead(*m);
+  if (old.str == NULL) {
+    h->dim = h->cap = cap;
+    return;
+  }
+  *h = *IGDHead(old);
+  h->cap = cap;
+  memcpy(L::Weights(*m), L::Weights(old), h->dim * sizeof(double));
+  if (StepRule::kAdaptive) {
+    memcpy(L::Acc(*m), L::Acc(old), h->dim * sizeof(double));
+  }
+  if (L::kLazy) {
+    memcpy(L::Last(*m), L::Last(old), h->dim * sizeof(uint64_t));
+    // the new weights are zero, and stay zero under the regularizers
+    for (size_t j = h->dim; j < cap; j++) L::Last(*m)[j] = h->steps;
+  }
+  BismarckFree(ctx, old.str);
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+void BismarckIGD<Context, Rep, Loss, Reg, StepRule>::Init(Context* ctx,
+                                                          bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+void BismarckIGD<Context, Rep, Loss, Reg, StepRule>::Step(
+    Context* ctx, const bytea &prev, const bytea &ex, double y, double step,
+    double mu, bytea *m, double weight) {
+  typedef IGDLayout<Rep, Reg, StepRule> L;
+  size_t dim = Rep::Dim(ex);
+  if (m->str == NULL) {
+    size_t prev_dim = prev.len / sizeof(double);
+    IGDResize<Context, Rep, Reg, StepRule>(ctx, std::max(dim, prev_dim), m);
+    if (prev_dim > 0) {
+      memcpy(L::Weights(*m), prev.str, prev_dim * sizeof(double));
+    }
+  } else if (dim > IGDHead(*m)->cap) {
+    // grow geometrically, sparse examples may reach new indices often
+    IGDResize<Context, Rep, Reg, StepRule>(
+        ctx, std::max(dim, 2 * static_cast<size_t>(IGDHead(*m)->cap)), m);
+  }
+
+  IGDHeader *h = IGDHead(*m);
+  h->dim = std::max(static_cast<size_t>(h->dim), dim);
+  double *w = L::Weights(*m);
+  double *acc = L::Acc(*m);
+  step *= weight;
+  if (!L::kLazy) {
+    IGDKernel<Loss, Reg, StepRule, Rep>(w, acc, h->dim, ex, y, step, mu);
+    h->steps++;
+    h->step = step;
+    h->mu = mu;
+    return;
+  }
+
+  // catch up on the weights the example reads, under the previous step size
+  IGDCatchUp<Rep, Reg, StepRule> catch_up = {*m};
+  Rep::Touched(ex, catch_up);
+  double g = Loss::Gradient(Rep::Dot(w, h->dim, ex), y);
+  if (g != 0) Rep::template Update<StepRule>(w, acc, h->dim, ex, step, g);
+  h->steps++;
+  h->step = step;
+  h->mu = mu;
+  Rep::Touched(ex, catch_up);
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+void BismarckIGD<Context, Rep, Loss, Reg, StepRule>::Merge(
+    Context* ctx, const bytea &src, bytea *dst) {
+  typedef IGDLayout<Rep, Reg, StepRule> L;
+  if (src.str == NULL) return;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return;
+  }
+  if (IGDHead(src)->dim > IGDHead(*dst)->cap) {
+    IGDResize<Context, Rep, Reg, StepRule>(ctx, IGDHead(src)->dim, dst);
+  }
+
+  IGDHeader *h = IGDHead(*dst);
+  const IGDHeader *sh = IGDHead(src);
+  h->dim = std::max(h->dim, sh->dim);
+  uint64_t steps = h->steps + sh->steps;
+  if (steps == 0) return;
+  double a = static_cast<double>(h->steps) / steps;
+  double *w = L::Weights(*dst), *sw = L::Weights(src);
+  double *acc = L::Acc(*dst), *sacc = L::Acc(src);
+  for (size_t j = 0; j < h->dim; j++) {
+    double dw = w[j], s = 0, sa = 0;
+    if (j < sh->dim) {
+      s = sw[j];
+      if (StepRule::kAdaptive) sa = sacc[j];
+    }
+    if (L::kLazy) {
+      dw = Reg::Apply(dw, StepRule::Current(h->step, acc, j) * h->mu,
+                      h->steps - L::Last(*dst)[j]);
+      if (j < sh->dim) {
+        s = Reg::Apply(s, StepRule::Current(sh->step, sacc, j) * sh->mu,
+                       sh->steps - L::Last(src)[j]);
+      }
+      L::Last(*dst)[j] = steps;
+    }
+    w[j] = a * dw + (1 - a) * s;
+    if (StepRule::kAdaptive) acc[j] = a * acc[j] + (1 - a) * sa;
+  }
+  h->steps = steps;
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+bytea BismarckIGD<Context, Rep, Loss, Reg, StepRule>::Final(
+    Context* ctx, const bytea &m) {
+  typedef IGDLayout<Rep, Reg, StepRule> L;
+  bytea model = {NULL, 0};
+  if (m.str == NULL) return model;
+  const IGDHeader *h = IGDHead(m);
+  model.len = h->dim * sizeof(double);
+  model.str = BismarckAllocate<char>(ctx, model.len);
+  double *w = reinterpret_cast<double*>(model.str);
+  memcpy(w, L::Weights(m), model.len);
+  if (L::kLazy) {
+    const double *acc = L::Acc(m);
+    for (size_t j = 0; j < h->dim; j++) {
+      w[j] = Reg::Apply(w[j], StepRule::Current(h->step, acc, j) * h->mu,
+                        h->steps - L::Last(m)[j]);
+    }
+  }
+  return model;
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+double BismarckIGD<Context, Rep, Loss, Reg, StepRule>::ExampleLoss(
+    const bytea &model, const bytea &ex, double y) {
+  return Loss::Loss(Predict(model, ex), y);
+}
+
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+double BismarckIGD<Context, Rep, Loss, Reg, StepRule>::Predict(
+    const bytea &model, const bytea &ex) {
+  return Rep::Dot(reinterpret_cast<const double*>(model.str),
+                  model.len / sizeof(double), ex);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
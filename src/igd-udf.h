@@ -0,0 +1,73 @@
+
+#ifndef HAZY_BISMARCK_IGD_UDF_H
+#define HAZY_BISMARCK_IGD_UDF_H
+
+#include "igd-inl.h"
+
+/*! \brief Defines the Impala functions of an IGD model
+ *
+ * Expands to the aggregate Prefix##Init/Update/Merge/Finalize, where Update
+ * takes (prev_model, ex, label, step_size, mu), and to the scalar functions
+ * Prefix##Predict(model, ex) and Prefix##Loss(model, ex, label). Model is a
+ * BismarckIGD<FunctionContext, ...>, typically a typedef, and the file
+ * expanding it defines StringValToBytea and the FunctionContext allocators,
+ * like the other glue files.
+ */
+#define BISMARCK_IGD_ENTRY_POINTS(Prefix, Model)                              \
+void Prefix##Init(FunctionContext* ctx, StringVal *st) {                      \
+  st->is_null = true;                                                         \
+}                                                                             \
+                                                                              \
+void Prefix##Update(FunctionContext* ctx, const StringVal &prev_model,        \
+                    const StringVal &ex, const DoubleVal &label,              \
+                    const DoubleVal &step_size, const DoubleVal &mu,          \
+                    StringVal *st) {                                          \
+  if (ex.is_null || label.is_null) return;                                    \
+  bytea prev = {NULL, 0};                                                     \
+  if (!prev_model.is_null) prev = StringValToBytea(prev_model);               \
+  bytea sta = {NULL, 0};                                                      \
+  if (!st->is_null) sta = StringValToBytea(*st);                              \
+  Model::Step(ctx, prev, StringValToBytea(ex), label.val, step_size.val,      \
+              mu.is_null ? 0.0 : mu.val, &sta);                               \
+  st->ptr = (uint8_t*) sta.str;                                               \
+  st->len = sta.len;                                                          \
+  st->is_null = false;                                                        \
+}                                                                             \
+                                                                              \
+void Prefix##Merge(FunctionContext* ctx, const StringVal &src,                \
+                   StringVal *dst) {                                          \
+  if (src.is_null) return;                                                    \
+  if (dst->is_null) {                                                         \
+    *dst = BismarckStringVal(ctx, src.len);                                   \
+    memcpy(dst->ptr, src.ptr, src.len);                                       \
+    dst->is_null = false;                                                     \
+    return;                                                                   \
+  }                                                                           \
+  bytea dsta = StringValToBytea(*dst);                                        \
+  Model::Merge(ctx, StringValToBytea(src), &dsta);                            \
+  dst->ptr = (uint8_t*) dsta.str;                                             \
+  dst->len = dsta.len;                                                        \
+}                                                                             \
+                                                                              \
+StringVal Prefix##Finalize(FunctionContext* ctx, const StringVal &st) {       \
+  if (st.is_null) return StringVal::null();                                   \
+  BismarckReleaseState(st);                                                   \
+  bytea model = Model::Final(ctx, StringValToBytea(st));                      \
+  return BismarckResult(model.str, model.len);                                \
+}                                                                             \
+                                                                              \
+DoubleVal Prefix##Predict(FunctionContext* ctx, const StringVal &model,       \
+                          const StringVal &ex) {                              \
+  if (model.is_null || ex.is_null) return DoubleVal::null();                  \
+  return DoubleVal(Model::Predict(StringValToBytea(model),                    \
+                                  StringValToBytea(ex)));                     \
+}                                                                             \
+                                                                              \
+DoubleVal Prefix##Loss(FunctionContext* ctx, const StringVal &model,          \
+                       const StringVal &ex, const DoubleVal &label) {         \
+  if (model.is_null || ex.is_null || label.is_null) return DoubleVal::null(); \
+  return DoubleVal(Model::ExampleLoss(StringValToBytea(model),                \
+                                      StringValToBytea(ex), label.val));      \
+}
+
+#endif
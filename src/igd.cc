@@ -0,0 +1,72 @@
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "igd"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include <cstdio>
+#include "igd-udf.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+// A new model is a typedef and one expansion of BISMARCK_IGD_ENTRY_POINTS
+
+typedef BismarckIGD<FunctionContext, DenseRep, HingeLoss, L1Reg,
+                    ConstantStep> SVML1Model;
+BISMARCK_IGD_ENTRY_POINTS(SVML1, SVML1Model)
+
+typedef BismarckIGD<FunctionContext, DenseRep, LogisticLoss, L2Reg,
+                    ConstantStep> LogrModel;
+BISMARCK_IGD_ENTRY_POINTS(IGDLogr, LogrModel)
+
+typedef BismarckIGD<FunctionContext, SparseRep, LogisticLoss, L2Reg,
+                    AdaGradStep> LogrSparseModel;
+BISMARCK_IGD_ENTRY_POINTS(LogrSparse, LogrSparseModel)
+
+typedef BismarckIGD<FunctionContext, FloatRep, LogisticLoss, L2Reg,
+                    ConstantStep> LogrFloatModel;
+BISMARCK_IGD_ENTRY_POINTS(LogrFloat, LogrFloatModel)
+
+typedef BismarckIGD<FunctionContext, DenseRep, SquaredLoss, L2Reg,
+                    ConstantStep> RidgeModel;
+BISMARCK_IGD_ENTRY_POINTS(Ridge, RidgeModel)
+
+typedef BismarckIGD<FunctionContext, DenseRep, HuberLoss, ElasticNetReg<50>,
+                    AdaGradStep> HuberModel;
+BISMARCK_IGD_ENTRY_POINTS(HuberNet, HuberModel)
+
+StringVal ToSparse(FunctionContext* ctx, const StringVal &arr) {
+  if (arr.is_null) return StringVal::null();
+  const double *x = reinterpret_cast<const double*>(arr.ptr);
+  size_t n = arr.len / sizeof(double), nnz = 0;
+  for (size_t i = 0; i < n; i++) nnz += x[i] != 0;
+  StringVal s(ctx, nnz * sizeof(IGDSparseEntry));
+  IGDSparseEntry *e = reinterpret_cast<IGDSparseEntry*>(s.ptr);
+  for (size_t i = 0; i < n; i++) {
+    if (x[i] == 0) continue;
+    e->index = i;
+    e->value = x[i];
+    e++;
+  }
+  return s;
+}
+
+StringVal ToFloat(FunctionContext* ctx, const StringVal &arr) {
+  if (arr.is_null) return StringVal::null();
+  const double *x = reinterpret_cast<const double*>(arr.ptr);
+  size_t n = arr.len / sizeof(double);
+  StringVal s(ctx, n * sizeof(float));
+  float *f = reinterpret_cast<float*>(s.ptr);
+  for (size_t i = 0; i < n; i++) f[i] = x[i];
+  return s;
+}
@@ -0,0 +1,85 @@
+
+#ifndef HAZY_BISMARCK_IGD_H
+#define HAZY_BISMARCK_IGD_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Trains a linear model by IGD, composed from policies
+ *
+ * Each policy is a struct of static inline functions, so the composed step
+ * is one inlined kernel with no dispatch per row:
+ * - Rep, how an example is stored: DenseRep (double array), FloatRep (float
+ *   array) or SparseRep (IGDSparseEntry array, the model grows to the
+ *   largest index seen)
+ * - Loss, of the prediction w.x and the label: HingeLoss, LogisticLoss
+ *   (labels > 0 are positive, the others negative), SquaredLoss, HuberLoss
+ * - Reg, the regularizer scaled by mu: NoReg, L2Reg, L1Reg (truncated
+ *   gradient) or ElasticNetReg<P> (P percent L1)
+ * - StepRule, the step size of a coordinate: ConstantStep or AdaGradStep
+ *
+ * With a sparse representation the regularizer is applied lazily: a
+ * coordinate remembers the step it was last regularized at and catches up
+ * when an example touches it again, or when the model is merged or
+ * finalized. A step then costs the non-zeros of the example, not the
+ * dimension of the model.
+ *
+ * The state is a flat block: an IGDHeader, the weights, then the AdaGrad
+ * sums and the lazy step counters when the policies need them. Final
+ * returns the weights alone, a double array like the model of BismarckSVM.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context, class Rep, class Loss, class Reg, class StepRule>
+class BismarckIGD {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Takes an IGD step using the given example
+   *
+   * \param ctx the context to allocate memory with
+   * \param prev the weights to start from (a result of Final), or empty
+   * \param ex the example, in the representation Rep
+   * \param y the label of the example
+   * \param step the step size
+   * \param mu the regularization
+   * \param m the current state, may be re-allocated
+   * \param weight the importance of the example
+   */
+  static void Step(Context* ctx, const bytea &prev, const bytea &ex, double y,
+                   double step, double mu, bytea *m, double weight = 1.0);
+
+  /*! \brief Averages two states, weighted by the examples each has seen
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the weights of the model, as a new double array
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+
+  /*! \brief The loss of the weights returned by Final on an example
+   */
+  static double ExampleLoss(const bytea &model, const bytea &ex, double y);
+
+  /*! \brief The prediction w.x of the weights returned by Final
+   */
+  static double Predict(const bytea &model, const bytea &ex);
+};
+
+/*! \brief A non-zero of a sparse example
+ */
+struct IGDSparseEntry {
+  uint32_t index;
+  float value;
+};
+
+}
+}
+#endif
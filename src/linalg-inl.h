@@ -3,22 +3,60 @@
 #define HAZY_BISMARCK_LINALG_INL_H
 
 #include "linalg.h"
+#include "tune.h"
 
 namespace hazy {
 
+template <size_t U, class T>
+T unrolled_dot(const T *x, const T *y, size_t len) {
+  if (U == 1) {
+    T prod = 0;
+    for (size_t i = 0; i < len; i++) {
+      prod += x[i] * y[i];
+    }
+    return prod;
+  }
+  // U independent accumulators, so that the additions do not form one
+  // dependency chain
+  T acc[U];
+  for (size_t k = 0; k < U; k++) acc[k] = 0;
+  // the remainder starts at a bound of its own, so that it folds away for
+  // a len known to be a multiple of U
+  size_t end = len - len % U;
+  for (size_t i = 0; i < end; i += U) {
+    for (size_t k = 0; k < U; k++) acc[k] += x[i + k] * y[i + k];
+  }
+  for (size_t i = end; i < len; i++) acc[0] += x[i] * y[i];
+  T prod = 0;
+  for (size_t k = 0; k < U; k++) prod += acc[k];
+  return prod;
+}
+
+template <size_t U, class T, class V>
+void unrolled_scale_add(T *x, const T *y, V a, size_t len) {
+  size_t end = len - len % U;
+  for (size_t i = 0; i < end; i += U) {
+    for (size_t k = 0; k < U; k++) x[i + k] += a * y[i + k];
+  }
+  for (size_t i = end; i < len; i++) x[i] += a * y[i];
+}
+
 template <class T>
 T simple_dot(const T *x, const T *y, size_t len) {
-  T prod = 0;
-  for (size_t i = 0; i < len; i++) {
-    prod += x[i] * y[i];
+  switch (Tuning().dot_unroll) {
+    case 4: return unrolled_dot<4>(x, y, len);
+    case 8: return unrolled_dot<8>(x, y, len);
+    default: return unrolled_dot<1>(x, y, len);
   }
-  return prod;
 }
 
 template <class T, class V>
 void simple_scale_add(T *x, const T *y, V a, size_t len) {
-  for (size_t i = 0; i < len; i++)
-    x[i] += a * y[i];
+  switch (Tuning().axpy_unroll) {
+    case 4: unrolled_scale_add<4>(x, y, a, len); break;
+    case 8: unrolled_scale_add<8>(x, y, a, len); break;
+    default: unrolled_scale_add<1>(x, y, a, len); break;
+  }
 }
 
 template <class T, class V>
@@ -28,4 +66,8 @@ void simple_scale(T *x, V a, size_t len) {
 }
 
 } // namespace hazy
+
+// defines Tuning(), after the kernels it benchmarks
+#include "tune-inl.h"
+
 #endif
@@ -2,6 +2,7 @@
 #ifndef HAZY_BISMARCK_LINALG_H
 #define HAZY_BISMARCK_LINALG_H
 
+#include <stddef.h>
 #include <cmath>
 
 #include <algorithm>
@@ -9,14 +10,31 @@
 namespace hazy {
 
 
+/*! \brief Computes the dot product of two vectors with U accumulators
+ *
+ * U = 1 is the plain loop. The other factors break the dependency chain of
+ * the additions, which pays off or not depending on the host.
+ */
+template <size_t U, class T>
+T unrolled_dot(const T *x, const T *y, size_t len);
+
+
+/*! \brief Computes x = x + a * y, unrolled by U
+ */
+template <size_t U, class T, class V>
+void unrolled_scale_add(T *x, const T *y, V a, size_t len);
+
+
 /*! \brief Computes the dot product of two vectors
+ *
+ * Dispatches to the unrolled_dot chosen for the host (see tune.h).
  */
 template <class T>
 T simple_dot(const T *x, const T *y, size_t len);
 
 
 /*! \brief Preforms a simple scale-and-add operation
- * This is x = x + a * y
+ * This is x = x + a * y, dispatched like simple_dot
  */
 template <class T, class V>
 void simple_scale_add(T *x, const T *y, V a, size_t len);
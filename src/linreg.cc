@@ -5,11 +5,8 @@
 
 using namespace impala_udf;
 
-template <class T>
-T* BismarckAllocate(FunctionContext* ctx, size_t len) {
-  len *= sizeof(T);
-  return (T*) ctx->Allocate(len);
-}
+#define BISMARCK_MEMORY_ACCOUNT "linr"
+#include "memory-udf.h"
 
 #include "madport/port-dbconnector-inl.h"
 
@@ -74,7 +71,7 @@ void LinrMerge(FunctionContext* context, const StringVal& src, StringVal* dst) {
   if (src.is_null) return;
   if (dst->is_null) {
     // create a new dst
-      new (dst) StringVal(context, src.len);
+      *dst = BismarckStringVal(context, src.len);
       memcpy(dst->ptr, src.ptr, src.len);
       return;
   }
@@ -97,6 +94,7 @@ StringVal LinrFinalize(FunctionContext* context, const StringVal& input) {
     return sv;
   }
 
+  BismarckReleaseState(input);
   PortAllocator pa(context);
 
   // convert to types that MADlib expects
@@ -105,8 +103,7 @@ StringVal LinrFinalize(FunctionContext* context, const StringVal& input) {
   madlib::MemHandle<double> coef =
       madlib::modules::regress::LinrFinal(pa, state);
 
-  StringVal sv((uint8_t*) coef.ptr, coef.size*sizeof(double));
-  return sv;
+  return BismarckResult(coef.ptr, coef.size*sizeof(double));
 }
 
 DoubleVal LinrPredict(FunctionContext* context, const StringVal& model,
@@ -28,7 +28,8 @@ double BismarckLogr<CTX>::Loss(const bytea &v,
 template <class CTX>
 void BismarckLogr<CTX>::Step(CTX* ctx, 
                    const bytea& val, const bool &y,
-                   bytea *input, double step, double mu) {
+                   bytea *input, double step, double mu,
+                   double weight) {
   size_t len_val, model_len;
   double *v, *model;
   CoerceBytea(val, v, len_val);
@@ -52,7 +53,7 @@ void BismarckLogr<CTX>::Step(CTX* ctx,
 
   double scal = (- 1.0 / (1.0 + ebx) + lbl);
 
-  hazy::simple_scale_add(model, v, step * scal, model_len);
+  hazy::simple_scale_add(model, v, step * weight * scal, model_len);
 }
 
 template <class CTX>
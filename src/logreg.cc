@@ -5,15 +5,14 @@
 
 using namespace impala_udf;
 
-template <class T>
-T* BismarckAllocate(FunctionContext* ctx, size_t len) {
-  len *= sizeof(T);
-  return (T*) ctx->Allocate(len);
-}
+#define BISMARCK_MEMORY_ACCOUNT "logr"
+#include "memory-udf.h"
 
 
 #include "bismarck.h"
 #include "logreg-inl.h"
+#include "downsample-inl.h"
+#include "delta-inl.h"
 
 using namespace hazy::bismarck;
 
@@ -38,7 +37,7 @@ void LogrUpdate(FunctionContext* ctx,  const StringVal &prev_model,
   if (model->is_null) {
     if (!prev_model.is_null) {
       // Case #2: we have a previous model to seed from
-      new (model) StringVal(ctx, prev_model.len);
+      *model = BismarckStringVal(ctx, prev_model.len);
       memcpy(model->ptr, prev_model.ptr, prev_model.len);
     }
     model->is_null = false;
@@ -56,12 +55,46 @@ void LogrUpdate(FunctionContext* ctx,  const StringVal &prev_model,
   model->len = modela.len;
 }
 
+void LogrSampledUpdate(FunctionContext* ctx, const StringVal &prev_model,
+                       const BigIntVal &id, const StringVal &ex,
+                       const BooleanVal &label, const DoubleVal &step_size,
+                       const DoubleVal &mu, const DoubleVal &rate,
+                       const BigIntVal &seed, StringVal *model) {
+  // reject before touching the example or the model
+  if (id.is_null || label.is_null) return;
+  double r = rate.is_null ? 1.0 : rate.val;
+  uint64_t sd = seed.is_null ? 0 : seed.val;
+  if (!DownsampleKeep(id.val, label.val, r, sd)) return;
+
+  // If first tuple, the model will be NULL
+  if (model->is_null) {
+    if (!prev_model.is_null) {
+      // Case #2: we have a previous model to seed from
+      *model = BismarckStringVal(ctx, prev_model.len);
+      memcpy(model->ptr, prev_model.ptr, prev_model.len);
+    }
+    model->is_null = false;
+  }
+
+  // Take the gradient step, weighted by the inverse sampling rate
+  bytea modela = StringValToBytea(*model);
+  BismarckLogr<FunctionContext>::Step(ctx,
+                                     StringValToBytea(ex),
+                                     label.val,
+                                     &modela,
+                                     step_size.val,
+                                     mu.val,
+                                     DownsampleWeight(label.val, r));
+  model->ptr = (uint8_t*) modela.str;
+  model->len = modela.len;
+}
+
 void LogrMerge(FunctionContext* ctx, const StringVal &src,
               StringVal *dst) {
   if (src.is_null) return;
   if (dst->is_null) {
     // create a new dst
-    new (dst) StringVal(ctx, src.len);
+    *dst = BismarckStringVal(ctx, src.len);
     memcpy(dst->ptr, src.ptr, src.len);
     dst->is_null = false;
   } else {
@@ -70,6 +103,7 @@ void LogrMerge(FunctionContext* ctx, const StringVal &src,
 }
 
 StringVal LogrFinalize(FunctionContext* ctx, const StringVal &model) {
+  BismarckReleaseState(model);
   return model;
 }
 
@@ -97,4 +131,112 @@ DoubleVal LogrLoss(FunctionContext* ctx, const StringVal &model, const StringVal
   return r;
 }
 
+DoubleVal LogrSampledLoss(FunctionContext* ctx, const StringVal &model,
+                          const StringVal &ex, const BooleanVal &lbl,
+                          const BigIntVal &id, const DoubleVal &rate,
+                          const BigIntVal &seed) {
+  if (model.is_null || ex.is_null || lbl.is_null || id.is_null) return DoubleVal::null();
+  double r = rate.is_null ? 1.0 : rate.val;
+  // summed over all rows, estimates the loss over all rows
+  if (!DownsampleKeep(id.val, lbl.val, r, seed.is_null ? 0 : seed.val)) {
+    return DoubleVal(0);
+  }
+  bytea mod = StringValToBytea(model);
+  bytea e = StringValToBytea(ex);
+  return DoubleVal(DownsampleWeight(lbl.val, r) *
+                   BismarckLogr<FunctionContext>::Loss(e, lbl.val, mod));
+}
 
+DoubleVal LogrCalibrate(FunctionContext* ctx, const DoubleVal &p,
+                        const DoubleVal &rate) {
+  if (p.is_null || rate.is_null) return DoubleVal::null();
+  return DoubleVal(DownsampleCalibrate(p.val, rate.val));
+}
+
+void LogrDeltaUpdate(FunctionContext* ctx, const StringVal &prev_model,
+                     const StringVal &ex, const BooleanVal &label,
+                     const DoubleVal &step_size, const DoubleVal &mu,
+                     const DoubleVal &keep, const DoubleVal &threshold,
+                     const IntVal &bits, StringVal *st) {
+  if (ex.is_null || label.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    bytea prev = {NULL, 0};
+    if (!prev_model.is_null) prev = StringValToBytea(prev_model);
+    if (!BismarckDelta<FunctionContext>::Init(
+            ctx, prev, ex.len / sizeof(double), keep.is_null ? 1.0 : keep.val,
+            threshold.is_null ? 0.0 : threshold.val,
+            bits.is_null ? 64 : bits.val, &sta)) {
+      ctx->SetError("logrdelta: out of memory");
+      return;
+    }
+    st->ptr = (uint8_t*) sta.str;
+    st->len = sta.len;
+    st->is_null = false;
+  }
+
+  // Take the gradient step on the model part of the state
+  bytea modela = BismarckDelta<FunctionContext>::Model(sta);
+  BismarckLogr<FunctionContext>::Step(ctx,
+                                     StringValToBytea(ex),
+                                     label.val,
+                                     &modela,
+                                     step_size.val,
+                                     mu.val);
+}
+
+const StringVal LogrDeltaSerialize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return st;
+  BismarckReleaseState(st);
+  bytea enc = BismarckDelta<FunctionContext>::Encode(ctx, StringValToBytea(st),
+                                                     NULL);
+  if (enc.str == NULL) {
+    ctx->SetError("logrdelta: out of memory");
+    return StringVal::null();
+  }
+  return BismarckResult(enc.str, enc.len);
+}
+
+void LogrDeltaMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckDelta<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                             &dsta)) {
+    ctx->SetError("logrdelta: cannot merge deltas of different dimensions, or "
+                  "out of memory");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal LogrDeltaFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea avg = BismarckDelta<FunctionContext>::Final(ctx, StringValToBytea(st));
+  if (avg.str == NULL) {
+    ctx->SetError("logrdelta: out of memory");
+    return StringVal::null();
+  }
+  return BismarckResult(avg.str, avg.len);
+}
+
+StringVal LogrDeltaApply(FunctionContext* ctx, const StringVal &model,
+                         const StringVal &delta) {
+  if (delta.is_null) return model;
+  bytea mod = {NULL, 0};
+  if (!model.is_null) mod = StringValToBytea(model);
+  bytea r = DeltaApply(ctx, mod, StringValToBytea(delta));
+  if (r.str == NULL) {
+    ctx->SetError("logrdeltaapply: out of memory");
+    return StringVal::null();
+  }
+  // called once per row, the new model is copied out of the working buffer
+  return BismarckCopyResult(ctx, r.str, r.len);
+}
@@ -37,10 +37,12 @@ class BismarckLogr {
    * \param val the example 
    * \param y the label for the example
    * \param input the current model
+   * \param weight the importance of the example, see DownsampleWeight
    */
   static void Step(Context* ctx, 
                    const bytea& val, const bool &y,
-                   bytea *input, double step, double mu);
+                   bytea *input, double step, double mu,
+                   double weight = 1.0);
 
   /*! \brief Combines 2 Logistic models together
    */
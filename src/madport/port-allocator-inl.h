@@ -4,6 +4,9 @@
 #include <impala_udf/udf.h>
 #include <assert.h>
 
+// accounted against the library like the Bismarck states
+#include "../memory-udf.h"
+
 namespace madlib {
 namespace port {
 namespace dbconn {
@@ -39,7 +42,7 @@ class PortAllocator {
       //printf(":: rogue alloc\n");
       p = malloc(s);
     } else {
-      p = static_cast<void*>(udfctx_->Allocate(s));
+      p = BismarckAccountedAllocate(udfctx_, s);
     }
     //printf("(new %04lu) %lx\n", s, reinterpret_cast<uint64_t>(p));
     return p;
@@ -57,7 +60,7 @@ class PortAllocator {
       /* madlib may still use this path some how... */
       free(v);
     else
-      udfctx_->Free(static_cast<uint8_t*>(v));
+      BismarckAccountedFree(udfctx_, v);
     }
 
   // Do not use
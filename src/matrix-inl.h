@@ -0,0 +1,198 @@
+
+#ifndef HAZY_BISMARCK_MATRIX_INL_H
+#define HAZY_BISMARCK_MATRIX_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+
+#include "spill-inl.h"
+
+// see for documentation
+#include "matrix.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state, followed by the buffered columns (cap * rows
+ * doubles). The first cols - nbuf columns are in the spill file.
+ */
+struct MatrixHeader {
+  uint64_t rows;
+  uint64_t cols;   //!< spilled and buffered
+  uint64_t nbuf;   //!< columns in the buffer
+  uint64_t cap;    //!< room in the buffer, in columns
+  SpillFile spill;
+};
+
+inline MatrixHeader* MatrixHead(const bytea &m) {
+  return reinterpret_cast<MatrixHeader*>(m.str);
+}
+
+inline double* MatrixColumns(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(MatrixHeader));
+}
+
+inline size_t MatrixSize(uint64_t rows, uint64_t cols) {
+  return sizeof(MatrixHeader) + rows * cols * sizeof(double);
+}
+
+/*! The columns of a spill chunk, about 4MB of them
+ */
+inline uint64_t MatrixChunkCols(uint64_t rows) {
+  uint64_t cols = (4 << 20) / (sizeof(double) * std::max<uint64_t>(rows, 1));
+  return std::max<uint64_t>(cols, 1);
+}
+
+/*! Allocates a state with room for cap columns, copying the old one
+ */
+template <class CTX>
+void MatrixRealloc(CTX* ctx, bytea *m, uint64_t cap) {
+  MatrixHeader h = *MatrixHead(*m);
+  size_t len = MatrixSize(h.rows, cap);
+  char *str = BismarckAllocate<char>(ctx, len);
+  memcpy(str, m->str, MatrixSize(h.rows, h.nbuf));
+  BismarckFree(ctx, m->str);
+  m->str = str;
+  m->len = len;
+  MatrixHead(*m)->cap = cap;
+}
+
+/*! Appends the buffer to the spill file, opening it first
+ *
+ * \return false if it could not, the buffer is kept
+ */
+inline bool MatrixSeal(const bytea &m) {
+  MatrixHeader *h = MatrixHead(m);
+  if (h->spill.fd < 0 && !SpillOpen(&h->spill)) return false;
+  if (!SpillAppend(&h->spill, reinterpret_cast<char*>(MatrixColumns(m)),
+                   h->nbuf * h->rows * sizeof(double), true)) {
+    return false;
+  }
+  h->nbuf = 0;
+  return true;
+}
+
+/*! Makes room for one more column, by spilling the buffer or growing it
+ */
+template <class CTX>
+double* MatrixNextColumn(CTX* ctx, bytea *m) {
+  MatrixHeader *h = MatrixHead(*m);
+  if (h->nbuf == h->cap) {
+    uint64_t chunk = MatrixChunkCols(h->rows);
+    bool spill = SpillDir() != NULL;
+    if (!spill || h->cap < chunk || !MatrixSeal(*m)) {
+      uint64_t cap = std::max<uint64_t>(2 * h->cap, 1);
+      // grow up to a chunk, then seal it
+      if (spill && h->cap < chunk) cap = std::min(cap, chunk);
+      MatrixRealloc(ctx, m, cap);
+    }
+  }
+  h = MatrixHead(*m);
+  h->cols++;
+  return MatrixColumns(*m) + h->rows * h->nbuf++;
+}
+
+/*! Copies a column of n doubles into col, padded or truncated to rows
+ */
+inline void MatrixCopyColumn(double *col, uint64_t rows, const double *x,
+                             uint64_t n) {
+  n = std::min(n, rows);
+  memcpy(col, x, n * sizeof(double));
+  std::fill(col + n, col + rows, 0.0);
+}
+
+template <class CTX>
+void BismarckMatrix<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckMatrix<CTX>::Step(CTX* ctx, const bytea &ex, bytea *m) {
+  uint64_t n = ex.len / sizeof(double);
+  if (m->str == NULL) {
+    MatrixHeader h;
+    memset(&h, 0, sizeof(h));
+    h.rows = n;
+    h.cap = std::min<uint64_t>(16, MatrixChunkCols(n));
+    SpillInit(&h.spill);
+    m->len = MatrixSize(h.rows, h.cap);
+    m->str = BismarckAllocate<char>(ctx, m->len);
+    *MatrixHead(*m) = h;
+  }
+  double *col = MatrixNextColumn(ctx, m);
+  MatrixCopyColumn(col, MatrixHead(*m)->rows,
+                   reinterpret_cast<const double*>(ex.str), n);
+}
+
+template <class CTX>
+bool BismarckMatrix<CTX>::Serialize(CTX* ctx, bytea *m) {
+  if (m->str == NULL) return true;
+  MatrixHeader *h = MatrixHead(*m);
+  if (h->spill.fd < 0) {
+    h->cap = h->nbuf;
+    m->len = MatrixSize(h->rows, h->nbuf);
+    return true;
+  }
+
+  bytea s;
+  s.len = MatrixSize(h->rows, h->cols);
+  s.str = BismarckAllocate<char>(ctx, s.len);
+  MatrixHeader *sh = MatrixHead(s);
+  *sh = *h;
+  bool ok = SpillRead(h->spill, reinterpret_cast<char*>(MatrixColumns(s)));
+  memcpy(MatrixColumns(s) + h->rows * (h->cols - h->nbuf), MatrixColumns(*m),
+         h->rows * h->nbuf * sizeof(double));
+  SpillClose(&h->spill);
+  SpillInit(&sh->spill);
+  sh->nbuf = sh->cap = sh->cols;
+  BismarckFree(ctx, m->str);
+  *m = s;
+  return ok;
+}
+
+template <class CTX>
+void BismarckMatrix<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return;
+  }
+  const MatrixHeader *sh = MatrixHead(src);
+  const double *x = MatrixColumns(src);
+  for (uint64_t j = 0; j < sh->nbuf; j++, x += sh->rows) {
+    double *col = MatrixNextColumn(ctx, dst);
+    MatrixCopyColumn(col, MatrixHead(*dst)->rows, x, sh->rows);
+  }
+}
+
+template <class CTX>
+bytea BismarckMatrix<CTX>::Final(CTX* ctx, bytea *m) {
+  bytea r = {NULL, 0};
+  if (m->str == NULL) return r;
+  MatrixHeader *h = MatrixHead(*m);
+  uint64_t spilled = h->cols - h->nbuf;
+  r.len = (2 + h->rows * h->cols) * sizeof(double);
+  r.str = BismarckAllocate<char>(ctx, r.len);
+  double *out = reinterpret_cast<double*>(r.str);
+  out[0] = h->rows;
+  out[1] = h->cols;
+  bool ok = SpillRead(h->spill, reinterpret_cast<char*>(out + 2));
+  memcpy(out + 2 + h->rows * spilled, MatrixColumns(*m),
+         h->rows * h->nbuf * sizeof(double));
+  SpillClose(&h->spill);
+  if (!ok) {
+    BismarckFree(ctx, r.str);
+    r.str = NULL;
+    r.len = 0;
+  }
+  return r;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
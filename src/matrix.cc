@@ -0,0 +1,90 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "matrix"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "matrix-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void MatrixInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void MatrixUpdate(FunctionContext* ctx, const StringVal &ex, StringVal *st) {
+  if (ex.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckMatrix<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckMatrix<FunctionContext>::Step(ctx, StringValToBytea(ex), &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+const StringVal MatrixSerialize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return st;
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  if (!BismarckMatrix<FunctionContext>::Serialize(ctx, &sta)) {
+    ctx->SetError("matrixagg: cannot read back the spilled columns");
+  }
+  return BismarckResult(sta.str, sta.len);
+}
+
+void MatrixMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckMatrix<FunctionContext>::Merge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal MatrixFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  bytea matrix = BismarckMatrix<FunctionContext>::Final(ctx, &sta);
+  if (matrix.str == NULL) {
+    ctx->SetError("matrixagg: cannot read back the spilled columns");
+    return StringVal::null();
+  }
+  // the columns are read back straight into the result, not copied again
+  return BismarckResult(matrix.str, matrix.len);
+}
+
+/*! Column j of a matrix built by matrixagg, like MADlib's matrix_column
+ */
+StringVal MatrixColumn(FunctionContext* ctx, const StringVal &matrix,
+                       const IntVal &j) {
+  if (matrix.is_null || j.is_null) return StringVal::null();
+  const double *m = reinterpret_cast<const double*>(matrix.ptr);
+  uint64_t rows = m[0], cols = m[1];
+  if (j.val < 0 || static_cast<uint64_t>(j.val) >= cols) {
+    return StringVal::null();
+  }
+  StringVal r(ctx, rows * sizeof(double));
+  memcpy(r.ptr, m + 2 + rows * j.val, rows * sizeof(double));
+  return r;
+}
@@ -0,0 +1,67 @@
+
+#ifndef HAZY_BISMARCK_MATRIX_H
+#define HAZY_BISMARCK_MATRIX_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Builds a matrix from column vectors, like MADlib's matrix_agg
+ *
+ * Every example (double array) is a column; shorter ones are padded with
+ * zeros and longer ones truncated to the length of the first. The result
+ * is laid out like the MADlib state: the number of rows, the number of
+ * columns, then the columns one after the other.
+ *
+ * The state buffers columns in memory, growing geometrically. If
+ * BISMARCK_SPILL_DIR is set, a buffer of about 4MB is sealed into a chunk
+ * of a SpillFile instead of growing further, so the memory held while
+ * aggregating stays bounded and the columns are written at disk bandwidth.
+ * Serialize and Final stream the chunks back through mmap, straight into
+ * the serialized state or the result, so the matrix is held once.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckMatrix {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Appends a column
+   *
+   * \param ctx the context to allocate memory with
+   * \param ex the column (double array)
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &ex, bytea *m);
+
+  /*! \brief Reads the spilled columns back into the state
+   *
+   * A state must be serialized before it leaves the process, its spill
+   * file is local. Afterwards the state holds all its columns and no
+   * spare room.
+   * \return false if the spill file could not be read back
+   */
+  static bool Serialize(Context* ctx, bytea *m);
+
+  /*! \brief Appends the columns of src, a serialized state, to dst
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the matrix, the state can no longer be used
+   *
+   * \return rows, cols and the columns as doubles, freshly allocated, or
+   * NULL if the spill file could not be read back
+   */
+  static bytea Final(Context* ctx, bytea *m);
+};
+
+}
+}
+#endif
@@ -0,0 +1,95 @@
+
+#ifndef HAZY_BISMARCK_MEMORY_INL_H
+#define HAZY_BISMARCK_MEMORY_INL_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+
+// see for documentation
+#include "memory.h"
+
+namespace hazy {
+namespace bismarck {
+
+namespace {
+
+inline MemoryAccount& MemoryLibraryAccount() {
+  static MemoryAccount a = {0, 0, 0, -1, 0};
+  return a;
+}
+
+} // namespace
+
+inline int64_t MemoryParseBytes(const char *s) {
+  if (s == NULL) return 0;
+  char *end;
+  double v = strtod(s, &end);
+  switch (*end) {
+    case 'g': case 'G': v *= 1024;  // fall through
+    case 'm': case 'M': v *= 1024;  // fall through
+    case 'k': case 'K': v *= 1024;
+    default: break;
+  }
+  return v > 0 ? static_cast<int64_t>(v) : 0;
+}
+
+inline int64_t MemoryBudget() {
+  MemoryAccount &a = MemoryLibraryAccount();
+  int64_t b = a.budget;
+  if (b >= 0) return b;
+  b = MemoryParseBytes(getenv("BISMARCK_MEMORY_BUDGET"));
+  __sync_bool_compare_and_swap(&a.budget, -1, b);
+  return a.budget;
+}
+
+inline void MemorySetBudget(int64_t bytes) {
+  MemoryAccount &a = MemoryLibraryAccount();
+  a.budget = bytes > 0 ? bytes : 0;
+  a.over = a.budget > 0 && a.current > a.budget;
+}
+
+inline bool MemoryCharge(int64_t bytes) {
+  MemoryAccount &a = MemoryLibraryAccount();
+  int64_t current = __sync_add_and_fetch(&a.current, bytes);
+  __sync_add_and_fetch(&a.allocs, 1);
+  int64_t peak = a.peak;
+  while (current > peak &&
+         !__sync_bool_compare_and_swap(&a.peak, peak, current)) {
+    peak = a.peak;
+  }
+  int64_t budget = MemoryBudget();
+  return budget > 0 && current > budget &&
+      __sync_bool_compare_and_swap(&a.over, 0, 1);
+}
+
+inline void MemoryRelease(int64_t bytes) {
+  MemoryAccount &a = MemoryLibraryAccount();
+  int64_t current = __sync_sub_and_fetch(&a.current, bytes);
+  if (current <= MemoryBudget()) __sync_bool_compare_and_swap(&a.over, 1, 0);
+}
+
+inline bool MemoryOverBudget() {
+  int64_t budget = MemoryBudget();
+  return budget > 0 && MemoryLibraryAccount().current > budget;
+}
+
+inline size_t MemoryReport(const char *name, char *buf, size_t len) {
+  MemoryAccount &a = MemoryLibraryAccount();
+  int64_t budget = MemoryBudget();
+  int n = snprintf(buf, len, "%s: %.1fMB held, %.1fMB peak, %llu allocations",
+                   name, a.current / 1048576.0, a.peak / 1048576.0,
+                   static_cast<unsigned long long>(a.allocs));
+  if (budget > 0 && n >= 0 && static_cast<size_t>(n) < len) {
+    n += snprintf(buf + n, len - n, ", budget %.1fMB%s", budget / 1048576.0,
+                  a.current > budget ? " (over)" : "");
+  }
+  if (n < 0) return 0;
+  return std::min(static_cast<size_t>(n), len - 1);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,136 @@
+
+#ifndef HAZY_BISMARCK_MEMORY_UDF_H
+#define HAZY_BISMARCK_MEMORY_UDF_H
+
+#include <cstdio>
+#include <cstring>
+
+#include <impala_udf/udf.h>
+
+#include "memory-inl.h"
+
+/*! \file
+ * \brief The allocator of the UDF libraries, with memory accounting
+ *
+ * Defines BismarckAllocate and BismarckFree for a FunctionContext. Every
+ * allocation carries its size in front of it, so that frees are accounted
+ * too, and the first allocation that takes the library over its budget adds
+ * a warning to the query. BISMARCK_MEMORY_ACCOUNT names the library in
+ * warnings and in BismarckMemory.
+ *
+ * Memory freed with BismarckFree must come from BismarckAllocate, so UDA
+ * states are created with BismarckStringVal rather than StringVal(ctx, len).
+ *
+ * Impala frees UDA states and results itself, after Serialize and Finalize
+ * and once a UDF result is used, so the library releases their charge as
+ * they leave it: Serialize and Finalize call BismarckReleaseState on the
+ * state, and results in memory from BismarckAllocate are returned with
+ * BismarckResult. Functions called once per row or group that build their
+ * result in a working buffer copy it out with BismarckCopyResult instead,
+ * so the buffer does not stay allocated until the fragment closes.
+ */
+
+#ifndef BISMARCK_MEMORY_ACCOUNT
+#define BISMARCK_MEMORY_ACCOUNT "bismarck"
+#endif
+
+/*! The size of an allocation, in front of it; 16 bytes keep the
+ * allocation aligned for doubles
+ */
+struct BismarckMemoryTag {
+  int64_t bytes;
+  int64_t pad;
+};
+
+inline void* BismarckAccountedAllocate(impala_udf::FunctionContext* ctx,
+                                       size_t bytes) {
+  uint8_t *p = ctx->Allocate(bytes + sizeof(BismarckMemoryTag));
+  if (p == NULL) return NULL;
+  reinterpret_cast<BismarckMemoryTag*>(p)->bytes = bytes;
+  if (hazy::bismarck::MemoryCharge(bytes)) {
+    char msg[256];
+    int n = snprintf(msg, sizeof(msg), "over the memory budget, ");
+    hazy::bismarck::MemoryReport(BISMARCK_MEMORY_ACCOUNT, msg + n,
+                                 sizeof(msg) - n);
+    ctx->AddWarning(msg);
+  }
+  return p + sizeof(BismarckMemoryTag);
+}
+
+inline void BismarckAccountedFree(impala_udf::FunctionContext* ctx, void *p) {
+  if (p == NULL) return;
+  uint8_t *base = static_cast<uint8_t*>(p) - sizeof(BismarckMemoryTag);
+  hazy::bismarck::MemoryRelease(
+      reinterpret_cast<BismarckMemoryTag*>(base)->bytes);
+  ctx->Free(base);
+}
+
+/*! Releases the charge of memory from BismarckAllocate without freeing
+ * it; the size is cleared so that the charge is only released once
+ */
+inline void BismarckAccountedRelease(void *p) {
+  if (p == NULL) return;
+  BismarckMemoryTag *tag = reinterpret_cast<BismarckMemoryTag*>(
+      static_cast<uint8_t*>(p) - sizeof(BismarckMemoryTag));
+  hazy::bismarck::MemoryRelease(tag->bytes);
+  tag->bytes = 0;
+}
+
+template <class T>
+T* BismarckAllocate(impala_udf::FunctionContext* ctx, size_t len) {
+  return static_cast<T*>(BismarckAccountedAllocate(ctx, len * sizeof(T)));
+}
+
+template <class T>
+void BismarckFree(impala_udf::FunctionContext* ctx, T* p) {
+  BismarckAccountedFree(ctx, p);
+}
+
+/*! \brief A new UDA state of len bytes
+ */
+inline impala_udf::StringVal BismarckStringVal(
+    impala_udf::FunctionContext* ctx, size_t len) {
+  return impala_udf::StringVal(BismarckAllocate<uint8_t>(ctx, len), len);
+}
+
+/*! \brief Releases the charge of a UDA state that Impala takes over, from
+ * Serialize or Finalize
+ */
+inline void BismarckReleaseState(const impala_udf::StringVal &st) {
+  if (!st.is_null) BismarckAccountedRelease(st.ptr);
+}
+
+/*! \brief A result in memory from BismarckAllocate, which Impala frees
+ */
+inline impala_udf::StringVal BismarckResult(void *p, size_t len) {
+  BismarckAccountedRelease(p);
+  return impala_udf::StringVal(static_cast<uint8_t*>(p), len);
+}
+
+/*! \brief Copies a result into a StringVal(ctx, len), which Impala frees
+ * with the row batch, and frees the working buffer from BismarckAllocate
+ */
+inline impala_udf::StringVal BismarckCopyResult(
+    impala_udf::FunctionContext* ctx, void *p, size_t len) {
+  impala_udf::StringVal r(ctx, len);
+  memcpy(r.ptr, p, len);
+  BismarckAccountedFree(ctx, p);
+  return r;
+}
+
+/*! \brief Reports the memory held by the states of this library
+ *
+ * Nothing in the library calls it, Impala looks it up by its symbol, so it
+ * is emitted although it is inline.
+ */
+inline __attribute__((used)) impala_udf::StringVal BismarckMemory(
+    impala_udf::FunctionContext* ctx) {
+  char buf[256];
+  size_t n = hazy::bismarck::MemoryReport(BISMARCK_MEMORY_ACCOUNT, buf,
+                                          sizeof(buf));
+  impala_udf::StringVal r(ctx, n);
+  memcpy(r.ptr, buf, n);
+  return r;
+}
+
+#endif
@@ -0,0 +1,75 @@
+
+#ifndef HAZY_BISMARCK_MEMORY_H
+#define HAZY_BISMARCK_MEMORY_H
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief The memory held by the UDA states of a library
+ *
+ * Each UDF library is loaded on its own, so it keeps its own account: the
+ * bytes currently allocated through BismarckAllocate, the peak and the
+ * number of allocations. The counters are updated atomically, fragments of
+ * the same query run in threads of one process.
+ */
+struct MemoryAccount {
+  int64_t current;
+  int64_t peak;
+  uint64_t allocs;
+  int64_t budget;  //!< in bytes, 0 for no budget, -1 until read
+  int32_t over;    //!< set while current is above the budget
+};
+
+namespace {
+
+/*! \brief The account of this library
+ *
+ * Every UDF library is one translation unit, so internal linkage gives each
+ * its own account. A static in a function with external linkage would be
+ * one STB_GNU_UNIQUE object, shared by all the libraries of the process.
+ */
+MemoryAccount& MemoryLibraryAccount();
+
+} // namespace
+
+/*! \brief The budget of each library, in bytes, 0 for none
+ *
+ * Read once from the BISMARCK_MEMORY_BUDGET environment variable of the
+ * process, a number of bytes with an optional K, M or G suffix.
+ */
+int64_t MemoryBudget();
+
+/*! \brief Overrides the budget, 0 for none
+ */
+void MemorySetBudget(int64_t bytes);
+
+/*! \brief Records an allocation
+ *
+ * \return true if this allocation crossed the budget, so that the caller
+ * can warn once per crossing
+ */
+bool MemoryCharge(int64_t bytes);
+
+/*! \brief Records a free
+ */
+void MemoryRelease(int64_t bytes);
+
+/*! \brief True while the library holds more than its budget
+ *
+ * Features that buffer rows consult this to stop growing their buffers:
+ * they fall back to smaller blocks at the cost of some speed or accuracy.
+ */
+bool MemoryOverBudget();
+
+/*! \brief Writes a human readable summary of the account of this library
+ *
+ * \return the length written, at most len - 1
+ */
+size_t MemoryReport(const char *name, char *buf, size_t len);
+
+}
+}
+#endif
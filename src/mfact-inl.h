@@ -135,7 +135,7 @@ void BismarckMF<CTX>::Step(CTX* ctx,
   double *swap = BismarckAllocate<double>(ctx, rank);
 
   MFIGDStep(Li, Ri, val, mean, mu, step, rank, rowd[row], cold[col], swap);
-  // TODO free swap
+  BismarckFree(ctx, swap);
   
 }
 
@@ -0,0 +1,124 @@
+
+#ifndef HAZY_BISMARCK_MODELCACHE_INL_H
+#define HAZY_BISMARCK_MODELCACHE_INL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+
+// see for documentation
+#include "modelcache.h"
+
+namespace hazy {
+namespace bismarck {
+
+template <class T>
+T* BismarckAllocate(ProcessContext* ctx, size_t len) {
+  return static_cast<T*>(malloc(len * sizeof(T)));
+}
+
+template <class T>
+void BismarckFree(ProcessContext* ctx, T* p) {
+  free(p);
+}
+
+/*! The entries of the library, a list as there are only a few models
+ * per query
+ */
+struct ModelCacheRegistry {
+  pthread_mutex_t lock;
+  SharedModel *head;
+};
+
+namespace {
+
+/*! The registry of this library, internal like MemoryLibraryAccount
+ */
+inline ModelCacheRegistry& ModelCacheGlobal() {
+  static ModelCacheRegistry r = {PTHREAD_MUTEX_INITIALIZER, NULL};
+  return r;
+}
+
+} // namespace
+
+/*! FNV-1a, mixed so that nearby contents spread out
+ */
+inline uint64_t ModelCacheHash(const bytea &content) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < content.len; i++) {
+    h ^= static_cast<unsigned char>(content.str[i]);
+    h *= 1099511628211ULL;
+  }
+  h ^= content.len;
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  return h ^ (h >> 31);
+}
+
+inline SharedModel* ModelCacheAcquire(const bytea &content,
+                                      ModelBuildFn build,
+                                      ModelDestroyFn destroy) {
+  uint64_t hash = ModelCacheHash(content);
+  ModelCacheRegistry &r = ModelCacheGlobal();
+  pthread_mutex_lock(&r.lock);
+  for (SharedModel *m = r.head; m != NULL; m = m->next) {
+    if (m->hash == hash && m->build == build &&
+        m->content.len == content.len &&
+        memcmp(m->content.str, content.str, content.len) == 0) {
+      m->refs++;
+      pthread_mutex_unlock(&r.lock);
+      return m;
+    }
+  }
+
+  ProcessContext pc;
+  SharedModel *m = BismarckAllocate<SharedModel>(&pc, 1);
+  m->hash = hash;
+  m->content.len = content.len;
+  m->content.str = BismarckAllocate<char>(&pc, content.len);
+  memcpy(m->content.str, content.str, content.len);
+  m->build = build;
+  m->destroy = destroy;
+  m->decoded = build(m->content);
+  m->refs = 1;
+  m->next = r.head;
+  r.head = m;
+  pthread_mutex_unlock(&r.lock);
+  return m;
+}
+
+inline void ModelCacheRelease(SharedModel *model) {
+  if (model == NULL) return;
+  ModelCacheRegistry &r = ModelCacheGlobal();
+  pthread_mutex_lock(&r.lock);
+  if (--model->refs > 0) {
+    pthread_mutex_unlock(&r.lock);
+    return;
+  }
+  for (SharedModel **p = &r.head; *p != NULL; p = &(*p)->next) {
+    if (*p == model) {
+      *p = model->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&r.lock);
+
+  ProcessContext pc;
+  model->destroy(model->decoded);
+  BismarckFree(&pc, model->content.str);
+  BismarckFree(&pc, model);
+}
+
+inline size_t ModelCacheSize() {
+  ModelCacheRegistry &r = ModelCacheGlobal();
+  pthread_mutex_lock(&r.lock);
+  size_t n = 0;
+  for (SharedModel *m = r.head; m != NULL; m = m->next) n++;
+  pthread_mutex_unlock(&r.lock);
+  return n;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
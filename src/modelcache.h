@@ -0,0 +1,76 @@
+
+#ifndef HAZY_BISMARCK_MODELCACHE_H
+#define HAZY_BISMARCK_MODELCACHE_H
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Allocates from the process heap instead of a fragment
+ *
+ * Objects shared between fragments cannot live in the memory pool of any
+ * one of them, so they are built with this context.
+ */
+struct ProcessContext {
+};
+
+template <class T>
+T* BismarckAllocate(ProcessContext* ctx, size_t len);
+
+template <class T>
+void BismarckFree(ProcessContext* ctx, T* p);
+
+/*! \brief Builds the decoded form of a model from its content
+ *
+ * The content stays valid, and unchanged, as long as the decoded form.
+ */
+typedef void* (*ModelBuildFn)(const bytea &content);
+typedef void (*ModelDestroyFn)(void *decoded);
+
+/*! \brief A decoded model shared by all the fragments of a library in the
+ * process
+ */
+struct SharedModel {
+  uint64_t hash;
+  bytea content;       //!< the cache's own copy of the content
+  ModelBuildFn build;  //!< with the content, identifies the entry
+  ModelDestroyFn destroy;
+  void *decoded;
+  uint32_t refs;
+  SharedModel *next;
+};
+
+/*! \brief Returns the decoded model for the content, building it if no
+ * fragment holds it yet
+ *
+ * Entries are keyed by a hash of the content and by the builder, and
+ * checked against the content byte by byte, so two fragments only share a
+ * model that is the same. The decoded model is read-only: every fragment
+ * holding it may read it concurrently. It is built under the cache lock, so
+ * a fragment asking for a model being built waits for it instead of
+ * building its own copy.
+ *
+ * Every call hashes and compares the whole content, so it is meant for
+ * constant arguments, from the prepare function of the UDF (see
+ * FunctionContext::IsArgConstant), or for arguments that seldom change,
+ * acquired again only when the content differs from the held model's. Each call must be matched by a
+ * ModelCacheRelease, typically from the close function of the UDF.
+ */
+inline SharedModel* ModelCacheAcquire(const bytea &content,
+                                      ModelBuildFn build,
+                                      ModelDestroyFn destroy);
+
+/*! \brief Drops a reference; the last one frees the model and its content,
+ * so the memory goes away with the last query using it
+ */
+inline void ModelCacheRelease(SharedModel *model);
+
+/*! \brief Number of models in the cache
+ */
+inline size_t ModelCacheSize();
+
+}
+}
+#endif
@@ -0,0 +1,207 @@
+
+#ifndef HAZY_BISMARCK_PAGERANK_INL_H
+#define HAZY_BISMARCK_PAGERANK_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+
+#include "linalg-inl.h"
+
+// see for documentation
+#include "pagerank.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! An edge of the edge list, ordered by destination first
+ */
+struct CSREdge {
+  uint64_t dst;
+  uint64_t src;
+
+  bool operator<(const CSREdge &o) const {
+    return dst < o.dst || (dst == o.dst && src < o.src);
+  }
+};
+
+/*! Edge list state: nedges, capacity, then the edges
+ */
+template <class CTX>
+void CSRReserve(CTX* ctx, bytea *m, uint64_t extra) {
+  uint64_t *hdr = reinterpret_cast<uint64_t*>(m->str);
+  uint64_t nedges = hdr == NULL ? 0 : hdr[0];
+  uint64_t cap = hdr == NULL ? 0 : hdr[1];
+  if (nedges + extra <= cap) return;
+
+  uint64_t neucap = std::max(2 * cap, std::max(nedges + extra,
+                                               static_cast<uint64_t>(1024)));
+  size_t len = 2 + 2 * neucap;
+  uint64_t *neu = BismarckAllocate<uint64_t>(ctx, len);
+  neu[0] = nedges;
+  neu[1] = neucap;
+  if (hdr != NULL) {
+    memcpy(&neu[2], &hdr[2], nedges * sizeof(CSREdge));
+    BismarckFree(ctx, m->str);
+  }
+  m->str = reinterpret_cast<char*>(neu);
+  m->len = len * sizeof(uint64_t);
+}
+
+template <class CTX>
+void BismarckCSR<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckCSR<CTX>::Step(CTX* ctx, uint64_t src, uint64_t dst, bytea *m) {
+  CSRReserve(ctx, m, 1);
+  uint64_t *hdr = reinterpret_cast<uint64_t*>(m->str);
+  CSREdge *edges = reinterpret_cast<CSREdge*>(&hdr[2]);
+  edges[hdr[0]].dst = dst;
+  edges[hdr[0]].src = src;
+  hdr[0]++;
+}
+
+template <class CTX>
+void BismarckCSR<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  const uint64_t *shdr = reinterpret_cast<const uint64_t*>(src.str);
+  CSRReserve(ctx, dst, shdr[0]);
+  uint64_t *dhdr = reinterpret_cast<uint64_t*>(dst->str);
+  memcpy(&dhdr[2 + 2 * dhdr[0]], &shdr[2], shdr[0] * sizeof(CSREdge));
+  dhdr[0] += shdr[0];
+}
+
+template <class CTX>
+bytea BismarckCSR<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea block = {NULL, 0};
+  if (m.str == NULL) return block;
+
+  uint64_t *hdr = reinterpret_cast<uint64_t*>(m.str);
+  CSREdge *edges = reinterpret_cast<CSREdge*>(&hdr[2]);
+  uint64_t nnz = hdr[0];
+  std::sort(edges, edges + nnz);
+
+  uint64_t nrows = 0;
+  for (uint64_t i = 0; i < nnz; i++) {
+    if (i == 0 || edges[i].dst != edges[i - 1].dst) nrows++;
+  }
+
+  size_t len = 2 + nrows + (nrows + 1) + nnz;
+  uint64_t *out = BismarckAllocate<uint64_t>(ctx, len);
+  out[0] = nrows;
+  out[1] = nnz;
+  uint64_t *rows = &out[2];
+  uint64_t *ptr = rows + nrows;
+  uint64_t *cols = ptr + nrows + 1;
+  uint64_t r = 0;
+  for (uint64_t i = 0; i < nnz; i++) {
+    if (i == 0 || edges[i].dst != edges[i - 1].dst) {
+      rows[r] = edges[i].dst;
+      ptr[r] = i;
+      r++;
+    }
+    cols[i] = edges[i].src;
+  }
+  ptr[nrows] = nnz;
+
+  block.str = reinterpret_cast<char*>(out);
+  block.len = len * sizeof(uint64_t);
+  return block;
+}
+
+template <class CTX>
+void BismarckPageRank<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckPageRank<CTX>::Step(CTX* ctx, const bytea &block,
+                                 const bytea &rank, const bytea &deg,
+                                 bytea *m) {
+  size_t n, ndeg;
+  double *r;
+  uint64_t *d;
+  CoerceBytea(rank, r, n);
+  CoerceBytea(deg, d, ndeg);
+
+  // Check of the state is null and needs to be set
+  if (m->str == NULL) {
+    m->str = (char*) BismarckAllocate<double>(ctx, n);
+    m->len = n * sizeof(double);
+    memset(m->str, 0, m->len);
+  }
+  double *contrib = reinterpret_cast<double*>(m->str);
+
+  const uint64_t *hdr = reinterpret_cast<const uint64_t*>(block.str);
+  uint64_t nrows = hdr[0];
+  const uint64_t *rows = &hdr[2];
+  const uint64_t *ptr = rows + nrows;
+  const uint64_t *cols = ptr + nrows + 1;
+
+  // pull the mass of the in-edges of each destination
+  for (uint64_t i = 0; i < nrows; i++) {
+    double sum = 0;
+    for (uint64_t k = ptr[i]; k < ptr[i + 1]; k++) {
+      uint64_t u = cols[k];
+      if (u < n && u < ndeg && d[u] > 0) sum += r[u] / d[u];
+    }
+    if (rows[i] < n) contrib[rows[i]] += sum;
+  }
+}
+
+template <class CTX>
+void BismarckPageRank<CTX>::Merge(CTX* ctx, const bytea &src,
+                                  const bytea &dst) {
+  hazy::simple_scale_add((double*) dst.str, (double*) src.str, 1.0,
+                         dst.len/sizeof(double));
+}
+
+template <class CTX>
+bytea BismarckPageRank<CTX>::Next(CTX* ctx, const bytea &state,
+                                  const bytea &rank, const bytea &teleport,
+                                  double damping) {
+  size_t n, nrank, ntele;
+  double *contrib, *r, *t;
+  CoerceBytea(state, contrib, n);
+  CoerceBytea(rank, r, nrank);
+  CoerceBytea(teleport, t, ntele);
+
+  double total = 0, pushed = 0;
+  for (size_t i = 0; i < nrank; i++) total += r[i];
+  for (size_t i = 0; i < n; i++) pushed += contrib[i];
+  double dangling = std::max(total - pushed, 0.0);
+
+  bytea out;
+  out.str = (char*) BismarckAllocate<double>(ctx, n);
+  out.len = n * sizeof(double);
+  double *next = reinterpret_cast<double*>(out.str);
+  for (size_t i = 0; i < n; i++) {
+    double tele = t == NULL ? 1.0 / n : t[i];
+    next[i] = damping * (contrib[i] + dangling * tele) +
+        (1 - damping) * total * tele;
+  }
+  return out;
+}
+
+template <class CTX>
+double BismarckPageRank<CTX>::Delta(const bytea &a, const bytea &b) {
+  size_t na, nb;
+  double *x, *y;
+  CoerceBytea(a, x, na);
+  CoerceBytea(b, y, nb);
+  double delta = 0;
+  for (size_t i = 0; i < std::min(na, nb); i++) {
+    delta += std::fabs(x[i] - y[i]);
+  }
+  return delta;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,177 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "pagerank"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "degree.h"
+#include "pagerank-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+StringVal ByteaToStringVal(FunctionContext* ctx, const bytea &b) {
+  if (b.str == NULL) return StringVal::null();
+  return BismarckCopyResult(ctx, b.str, b.len);
+}
+
+//
+// Out-degrees
+//
+
+void DegreeInit(FunctionContext* ctx, StringVal *deg) {
+  deg->is_null = true;
+}
+
+void DegreeUpdate(FunctionContext* ctx, const BigIntVal &src, StringVal *deg) {
+  if (src.is_null) return;
+  bytea dega = StringValToBytea(*deg);
+  if (deg->is_null) DegInit(ctx, &dega);
+  DegUpdate(ctx, &dega, src.val);
+  deg->ptr = (uint8_t*) dega.str;
+  deg->len = dega.len;
+  deg->is_null = false;
+}
+
+void DegreeMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  DegMerge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+const StringVal DegreeSerialize(FunctionContext* ctx, const StringVal &deg) {
+  if (deg.is_null) return deg;
+  bytea d = DegSerial(ctx, StringValToBytea(deg));
+  return BismarckCopyResult(ctx, d.str, d.len);
+}
+
+StringVal DegreeFinalize(FunctionContext* ctx, const StringVal &deg) {
+  if (deg.is_null) return deg;
+  bytea d = DegFinal(ctx, StringValToBytea(deg));
+  return BismarckCopyResult(ctx, d.str, d.len);
+}
+
+//
+// CSR blocks
+//
+
+void CSRInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void CSRUpdate(FunctionContext* ctx, const BigIntVal &src, const BigIntVal &dst,
+               StringVal *st) {
+  if (src.is_null || dst.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) BismarckCSR<FunctionContext>::Init(ctx, &sta);
+  BismarckCSR<FunctionContext>::Step(ctx, src.val, dst.val, &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void CSRMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckCSR<FunctionContext>::Merge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal CSRFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  return ByteaToStringVal(
+      ctx, BismarckCSR<FunctionContext>::Final(ctx, StringValToBytea(st)));
+}
+
+//
+// PageRank
+//
+
+void PageRankInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void PageRankUpdate(FunctionContext* ctx, const StringVal &block,
+                    const StringVal &rank, const StringVal &deg,
+                    StringVal *st) {
+  if (block.is_null || rank.is_null || deg.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) BismarckPageRank<FunctionContext>::Init(ctx, &sta);
+  BismarckPageRank<FunctionContext>::Step(ctx, StringValToBytea(block),
+                                          StringValToBytea(rank),
+                                          StringValToBytea(deg), &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void PageRankMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+  } else {
+    BismarckPageRank<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                             StringValToBytea(*dst));
+  }
+}
+
+StringVal PageRankFinalize(FunctionContext* ctx, const StringVal &st) {
+  BismarckReleaseState(st);
+  return st;
+}
+
+StringVal PageRankNext(FunctionContext* ctx, const StringVal &st,
+                       const StringVal &rank, const StringVal &teleport,
+                       const DoubleVal &damping) {
+  if (st.is_null || rank.is_null || damping.is_null) return StringVal::null();
+  bytea tele = {NULL, 0};
+  if (!teleport.is_null) {
+    if (teleport.len != st.len) {
+      ctx->SetError("pagerank: the teleport vector must have one entry per "
+                    "vertex");
+      return StringVal::null();
+    }
+    tele = StringValToBytea(teleport);
+  }
+  return ByteaToStringVal(ctx, BismarckPageRank<FunctionContext>::Next(
+      ctx, StringValToBytea(st), StringValToBytea(rank), tele, damping.val));
+}
+
+DoubleVal PageRankDelta(FunctionContext* ctx, const StringVal &a,
+                        const StringVal &b) {
+  if (a.is_null || b.is_null) return DoubleVal::null();
+  return DoubleVal(BismarckPageRank<FunctionContext>::Delta(
+      StringValToBytea(a), StringValToBytea(b)));
+}
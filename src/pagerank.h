@@ -0,0 +1,90 @@
+
+#ifndef HAZY_BISMARCK_PAGERANK_H
+#define HAZY_BISMARCK_PAGERANK_H
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Builds a CSR block from an edge list
+ *
+ * The block stores the in-edges of the destination vertices it covers, so a
+ * PageRank step over a block is a pull-based SpMV. Layout (uint64 words):
+ * nrows, nnz, rows[nrows] (destination ids, ascending), ptr[nrows + 1],
+ * cols[nnz] (source ids, ascending within a row).
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckCSR {
+ public:
+  /*! \brief Initializes an empty edge list
+   *
+   * The memory will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds the edge src -> dst, m may be re-allocated
+   */
+  static void Step(Context* ctx, uint64_t src, uint64_t dst, bytea *m);
+
+  /*! \brief Appends the edges of src to dst, dst may be re-allocated
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Sorts the edges and returns the CSR block
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief Implements (personalized) PageRank over CSR blocks
+ *
+ * The state is the vector of rank mass pushed along the edges, one double
+ * per vertex: contrib[v] = sum over edges u -> v of rank[u] / outdeg[u].
+ * The out-degrees are the output of the degree UDA (see degree.h).
+ */
+template <class Context>
+class BismarckPageRank {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds the mass pushed along the edges of a block
+   *
+   * \param ctx the context to allocate memory with
+   * \param block a CSR block built by BismarckCSR
+   * \param rank the current rank vector (double array)
+   * \param deg the out-degree of each vertex (uint64 array)
+   * \param m the state
+   */
+  static void Step(Context* ctx, const bytea &block, const bytea &rank,
+                   const bytea &deg, bytea *m);
+
+  /*! \brief Adds two states together
+   */
+  static void Merge(Context* ctx, const bytea &src, const bytea &dst);
+
+  /*! \brief Computes the next rank vector
+   *
+   * The mass of dangling vertices (no out-edges) is whatever did not get
+   * pushed along an edge; it is redistributed like the teleport mass.
+   * \param state the final state of the iteration
+   * \param rank the rank vector the iteration started from
+   * \param teleport the teleport distribution (double array summing to 1,
+   * one entry per vertex of the state), uniform if teleport.str is NULL
+   * \param damping the probability of following an edge
+   */
+  static bytea Next(Context* ctx, const bytea &state, const bytea &rank,
+                    const bytea &teleport, double damping);
+
+  /*! \brief L1 distance between two rank vectors, for convergence checks
+   */
+  static double Delta(const bytea &a, const bytea &b);
+};
+
+}
+}
+#endif
@@ -0,0 +1,311 @@
+
+#ifndef HAZY_BISMARCK_QUANTILE_INL_H
+#define HAZY_BISMARCK_QUANTILE_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+// see for documentation
+#include "quantile.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state, followed by the staged rows (k * nfeat doubles,
+ * row-major), the counts of the levels (nfeat * levels uint64s) and the
+ * levels (nfeat * levels * k doubles, feature-major)
+ */
+struct QuantileHeader {
+  uint32_t k;
+  uint32_t bins;
+  uint64_t nfeat;
+  uint64_t levels;
+  uint64_t nstaged;
+  uint64_t compactions;  //!< draws the offsets of the compactions
+};
+
+inline QuantileHeader* QuantileHead(const bytea &m) {
+  return reinterpret_cast<QuantileHeader*>(m.str);
+}
+
+inline double* QuantileStaged(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(QuantileHeader));
+}
+
+inline uint64_t* QuantileCounts(const bytea &m) {
+  const QuantileHeader *h = QuantileHead(m);
+  return reinterpret_cast<uint64_t*>(QuantileStaged(m) + h->k * h->nfeat);
+}
+
+inline double* QuantileLevel(const bytea &m, uint64_t f, uint64_t level) {
+  const QuantileHeader *h = QuantileHead(m);
+  double *levels = reinterpret_cast<double*>(QuantileCounts(m) +
+                                             h->nfeat * h->levels);
+  return levels + (f * h->levels + level) * h->k;
+}
+
+inline uint64_t& QuantileCount(const bytea &m, uint64_t f, uint64_t level) {
+  return QuantileCounts(m)[f * QuantileHead(m)->levels + level];
+}
+
+inline size_t QuantileSize(uint64_t k, uint64_t nfeat, uint64_t levels) {
+  return sizeof(QuantileHeader) +
+      (k * nfeat + nfeat * levels + nfeat * levels * k) * sizeof(double);
+}
+
+/*! splitmix64, one bit of it picks the offset of a compaction
+ */
+inline uint64_t QuantileMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*! Re-allocates the state with more levels per feature
+ */
+template <class CTX>
+void QuantileGrow(CTX* ctx, bytea *m, uint64_t levels) {
+  bytea old = *m;
+  const QuantileHeader *oh = QuantileHead(old);
+  m->len = QuantileSize(oh->k, oh->nfeat, levels);
+  m->str = BismarckAllocate<char>(ctx, m->len);
+  memcpy(m->str, old.str, sizeof(QuantileHeader) +
+         oh->k * oh->nfeat * sizeof(double));
+  QuantileHead(*m)->levels = levels;
+  for (uint64_t f = 0; f < oh->nfeat; f++) {
+    for (uint64_t l = 0; l < levels; l++) {
+      uint64_t n = l < oh->levels ? QuantileCount(old, f, l) : 0;
+      QuantileCount(*m, f, l) = n;
+      if (n > 0) {
+        memcpy(QuantileLevel(*m, f, l), QuantileLevel(old, f, l),
+               n * sizeof(double));
+      }
+    }
+  }
+  BismarckFree(ctx, old.str);
+}
+
+/*! Adds n values to a level of feature f, compacting it into the next
+ * level once it holds k values or more
+ */
+template <class CTX>
+void QuantilePush(CTX* ctx, bytea *m, uint64_t f, uint64_t level,
+                  const double *items, uint64_t n) {
+  if (level >= QuantileHead(*m)->levels) QuantileGrow(ctx, m, level + 1);
+  QuantileHeader *h = QuantileHead(*m);
+  uint64_t c = QuantileCount(*m, f, level);
+  double *lvl = QuantileLevel(*m, f, level);
+  if (c + n < h->k) {
+    memcpy(lvl + c, items, n * sizeof(double));
+    QuantileCount(*m, f, level) = c + n;
+    return;
+  }
+
+  uint64_t total = c + n;
+  double *tmp = BismarckAllocate<double>(ctx, total);
+  memcpy(tmp, lvl, c * sizeof(double));
+  memcpy(tmp + c, items, n * sizeof(double));
+  std::sort(tmp, tmp + total);
+  // an odd value out stays, the others are halved into the next level
+  uint64_t even = total & ~1ULL;
+  QuantileCount(*m, f, level) = total - even;
+  if (total != even) lvl[0] = tmp[even];
+  uint64_t offset = QuantileMix(h->compactions++) & 1;
+  for (uint64_t i = 0; i < even / 2; i++) tmp[i] = tmp[2 * i + offset];
+  QuantilePush(ctx, m, f, level + 1, tmp, even / 2);
+  BismarckFree(ctx, tmp);
+}
+
+/*! Sorts the staged rows into the sketches
+ */
+template <class CTX>
+void QuantileFlush(CTX* ctx, bytea *m) {
+  QuantileHeader *h = QuantileHead(*m);
+  uint64_t nstaged = h->nstaged, nfeat = h->nfeat;
+  if (nstaged == 0) return;
+  double *col = BismarckAllocate<double>(ctx, nstaged);
+  for (uint64_t f = 0; f < nfeat; f++) {
+    const double *staged = QuantileStaged(*m);
+    uint64_t n = 0;
+    for (uint64_t r = 0; r < nstaged; r++) {
+      double v = staged[r * nfeat + f];
+      if (v == v) col[n++] = v;
+    }
+    if (n > 0) QuantilePush(ctx, m, f, 0, col, n);
+  }
+  QuantileHead(*m)->nstaged = 0;
+  BismarckFree(ctx, col);
+}
+
+/*! Stages a row, NaN for the features it is missing
+ */
+template <class CTX>
+void QuantileAddRow(CTX* ctx, bytea *m, const double *x, uint64_t len) {
+  QuantileHeader *h = QuantileHead(*m);
+  double *row = QuantileStaged(*m) + h->nstaged * h->nfeat;
+  uint64_t n = std::min(len, h->nfeat);
+  memcpy(row, x, n * sizeof(double));
+  for (uint64_t f = n; f < h->nfeat; f++) {
+    row[f] = std::numeric_limits<double>::quiet_NaN();
+  }
+  if (++h->nstaged == h->k) QuantileFlush(ctx, m);
+}
+
+template <class CTX>
+void BismarckQuantile<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckQuantile<CTX>::Step(CTX* ctx, const bytea &ex, uint32_t bins,
+                                 uint32_t k, bytea *m) {
+  if (m->str == NULL) {
+    QuantileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.k = std::max<uint32_t>(k, 2);
+    h.bins = std::max<uint32_t>(bins, 1);
+    h.nfeat = ex.len / sizeof(double);
+    h.levels = 1;
+    m->len = QuantileSize(h.k, h.nfeat, h.levels);
+    m->str = BismarckAllocate<char>(ctx, m->len);
+    memset(m->str, 0, m->len);
+    *QuantileHead(*m) = h;
+  }
+  QuantileAddRow(ctx, m, reinterpret_cast<const double*>(ex.str),
+                 ex.len / sizeof(double));
+}
+
+template <class CTX>
+bool BismarckQuantile<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return true;
+  }
+  const QuantileHeader *sh = QuantileHead(src);
+  if (sh->nfeat != QuantileHead(*dst)->nfeat ||
+      sh->k != QuantileHead(*dst)->k) {
+    return false;
+  }
+  for (uint64_t r = 0; r < sh->nstaged; r++) {
+    QuantileAddRow(ctx, dst, QuantileStaged(src) + r * sh->nfeat, sh->nfeat);
+  }
+  for (uint64_t f = 0; f < sh->nfeat; f++) {
+    for (uint64_t l = 0; l < sh->levels; l++) {
+      uint64_t n = QuantileCount(src, f, l);
+      if (n > 0) QuantilePush(ctx, dst, f, l, QuantileLevel(src, f, l), n);
+    }
+  }
+  return true;
+}
+
+struct QuantileItem {
+  double value;
+  double weight;
+};
+
+inline bool QuantileByValue(const QuantileItem &a, const QuantileItem &b) {
+  return a.value < b.value;
+}
+
+/*! The values of feature f with their weights, sorted, returns how many
+ */
+template <class CTX>
+uint64_t QuantileCollect(CTX* ctx, const bytea &m, uint64_t f,
+                         QuantileItem **out) {
+  const QuantileHeader *h = QuantileHead(m);
+  uint64_t n = h->nstaged;
+  for (uint64_t l = 0; l < h->levels; l++) n += QuantileCount(m, f, l);
+  QuantileItem *items = BismarckAllocate<QuantileItem>(ctx, n);
+  uint64_t i = 0;
+  for (uint64_t r = 0; r < h->nstaged; r++) {
+    double v = QuantileStaged(m)[r * h->nfeat + f];
+    if (v != v) continue;
+    items[i].value = v;
+    items[i++].weight = 1;
+  }
+  double weight = 1;
+  for (uint64_t l = 0; l < h->levels; l++, weight *= 2) {
+    const double *lvl = QuantileLevel(m, f, l);
+    for (uint64_t j = 0; j < QuantileCount(m, f, l); j++) {
+      items[i].value = lvl[j];
+      items[i++].weight = weight;
+    }
+  }
+  std::sort(items, items + i, QuantileByValue);
+  *out = items;
+  return i;
+}
+
+/*! The first value whose cumulative weight reaches q of the total
+ */
+inline double QuantileAt(const QuantileItem *items, uint64_t n, double q) {
+  if (n == 0) return std::numeric_limits<double>::quiet_NaN();
+  double total = 0;
+  for (uint64_t i = 0; i < n; i++) total += items[i].weight;
+  double target = std::min(std::max(q, 0.0), 1.0) * total;
+  double cum = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    cum += items[i].weight;
+    if (cum >= target) return items[i].value;
+  }
+  return items[n - 1].value;
+}
+
+template <class CTX>
+double BismarckQuantile<CTX>::Quantile(CTX* ctx, const bytea &m,
+                                       uint64_t feature, double q) {
+  if (m.str == NULL || feature >= QuantileHead(m)->nfeat) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  QuantileItem *items;
+  uint64_t n = QuantileCollect(ctx, m, feature, &items);
+  double r = QuantileAt(items, n, q);
+  BismarckFree(ctx, items);
+  return r;
+}
+
+template <class CTX>
+bytea BismarckQuantile<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea cuts = {NULL, 0};
+  if (m.str == NULL) return cuts;
+  const QuantileHeader *h = QuantileHead(m);
+  uint64_t ncuts = h->bins - 1;
+  cuts.len = h->nfeat * ncuts * sizeof(double);
+  cuts.str = BismarckAllocate<char>(ctx, cuts.len);
+  double *out = reinterpret_cast<double*>(cuts.str);
+  for (uint64_t f = 0; f < h->nfeat; f++) {
+    QuantileItem *items;
+    uint64_t n = QuantileCollect(ctx, m, f, &items);
+    for (uint64_t b = 0; b < ncuts; b++) {
+      out[f * ncuts + b] = QuantileAt(items, n,
+                                      static_cast<double>(b + 1) / h->bins);
+    }
+    BismarckFree(ctx, items);
+  }
+  return cuts;
+}
+
+inline size_t QuantileBin(const double *cuts, size_t ncuts, double x) {
+  if (ncuts == 0) return 0;
+  // halving without a branch on the comparison, which compiles to a cmov
+  const double *base = cuts;
+  size_t n = ncuts;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = base[half - 1] <= x ? base + half : base;
+    n -= half;
+  }
+  return (base - cuts) + (*base <= x);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
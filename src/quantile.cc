@@ -0,0 +1,86 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "quantile"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "quantile-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void QuantileInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void QuantileUpdate(FunctionContext* ctx, const StringVal &ex,
+                    const IntVal &bins, const IntVal &k, StringVal *st) {
+  if (ex.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckQuantile<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckQuantile<FunctionContext>::Step(ctx, StringValToBytea(ex),
+                                          bins.is_null ? 10 : bins.val,
+                                          k.is_null ? 256 : k.val, &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void QuantileMerge(FunctionContext* ctx, const StringVal &src,
+                   StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckQuantile<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                                &dsta)) {
+    ctx->SetError("quantilecuts: cannot merge states of different numbers of "
+                  "features or k");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal QuantileFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea cuts = BismarckQuantile<FunctionContext>::Final(ctx,
+                                                        StringValToBytea(st));
+  return BismarckResult(cuts.str, cuts.len);
+}
+
+/*! The bin of every feature of ex, as a double array
+ */
+StringVal QuantileBins(FunctionContext* ctx, const StringVal &cuts,
+                       const StringVal &ex) {
+  if (cuts.is_null || ex.is_null) return StringVal::null();
+  size_t nfeat = ex.len / sizeof(double);
+  if (nfeat == 0) return StringVal(ctx, 0);
+  size_t ncuts = cuts.len / sizeof(double) / nfeat;
+  const double *c = reinterpret_cast<const double*>(cuts.ptr);
+  const double *x = reinterpret_cast<const double*>(ex.ptr);
+  StringVal r(ctx, nfeat * sizeof(double));
+  double *bins = reinterpret_cast<double*>(r.ptr);
+  for (size_t f = 0; f < nfeat; f++) {
+    bins[f] = QuantileBin(c + f * ncuts, ncuts, x[f]);
+  }
+  return r;
+}
@@ -0,0 +1,74 @@
+
+#ifndef HAZY_BISMARCK_QUANTILE_H
+#define HAZY_BISMARCK_QUANTILE_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Sketches the quantiles of every feature of an array in one scan
+ *
+ * Each feature has a KLL-style sketch: levels of at most k values, the
+ * values of level h standing for 2^h inputs each. A full level is sorted
+ * and every other value, from a random offset, moves up a level. A feature
+ * that has seen fewer than k values is kept exactly.
+ *
+ * The rows themselves are first staged row-major, k rows of every feature,
+ * so adding a dense row is one copy. Once the staging is full each
+ * feature's column is sorted into its sketch. NaN, and the features
+ * missing from short rows, are skipped.
+ *
+ * The state is one flat block: a header, the staged rows, the level counts
+ * and the levels, k values for each level of each feature. Sketches merge
+ * by pushing the values of src into the same levels of dst.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckQuantile {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds a row
+   *
+   * \param ctx the context to allocate memory with
+   * \param ex the features (double array), the first row sets their number
+   * \param bins the number of bins Final cuts each feature into
+   * \param k the size of a level, the error of a quantile is about 1/k
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &ex, uint32_t bins, uint32_t k,
+                   bytea *m);
+
+  /*! \brief Adds the values of src to dst
+   *
+   * States with a different number of features or k are not merged, and
+   * false is returned.
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the q quantile of a feature, NaN if it has no values
+   */
+  static double Quantile(Context* ctx, const bytea &m, uint64_t feature,
+                         double q);
+
+  /*! \brief Returns the bins - 1 boundaries of each feature, feature after
+   * feature, as a double array
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief The bin of x given the sorted boundaries, the number of
+ * boundaries <= x
+ */
+inline size_t QuantileBin(const double *cuts, size_t ncuts, double x);
+
+}
+}
+#endif
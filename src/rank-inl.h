@@ -0,0 +1,467 @@
+
+#ifndef HAZY_BISMARCK_RANK_INL_H
+#define HAZY_BISMARCK_RANK_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "linalg-inl.h"
+#include "memory-inl.h"
+
+// see for documentation
+#include "rank.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the training state, followed by the model (dim doubles), the
+ * labels of the buffered rows (cap doubles) and the rows (cap * dim doubles)
+ */
+struct RankHeader {
+  uint64_t dim;
+  uint64_t cap;
+  uint64_t nbuf;
+  int64_t query;
+  uint64_t nqueries;  //!< queries the model was trained on
+  uint64_t loss;
+  uint64_t max_pairs;
+  uint64_t pad;
+  double step;
+  double mu;
+};
+
+inline RankHeader* RankHead(const bytea &m) {
+  return reinterpret_cast<RankHeader*>(m.str);
+}
+
+inline double* RankModel(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(RankHeader));
+}
+
+inline double* RankLabels(const bytea &m) {
+  return RankModel(m) + RankHead(m)->dim;
+}
+
+inline double* RankRows(const bytea &m) {
+  return RankLabels(m) + RankHead(m)->cap;
+}
+
+/*! splitmix64, the pairs sampled from a query only depend on the query
+ */
+inline uint64_t RankMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*! One IGD step on the pair (i, j), where row i should rank above row j
+ */
+inline void RankPairStep(const RankHeader &h, double *model, const double *xi,
+                         const double *xj) {
+  size_t d = h.dim;
+  double s = hazy::simple_dot(model, xi, d) - hazy::simple_dot(model, xj, d);
+  double g;
+  if (h.loss == RANK_LOGISTIC) {
+    g = 1.0 / (1.0 + std::exp(s));
+  } else {
+    // hinge active
+    g = s < 1 ? 1.0 : 0.0;
+  }
+  if (g > 0) {
+    hazy::simple_scale_add(model, xi, h.step * g, d);
+    hazy::simple_scale_add(model, xj, -h.step * g, d);
+  }
+  hazy::simple_scale(model, 1 - h.step * h.mu, d);
+}
+
+/*! Orders row indices by decreasing label
+ */
+struct RankByLabelIndex {
+  const double *labels;
+  bool operator()(uint64_t a, uint64_t b) const {
+    return labels[a] > labels[b];
+  }
+};
+
+/*! Trains the model on the pairs of one query. Returns false if the scratch
+ * space cannot be allocated.
+ *
+ * The rows are sorted by decreasing label, so that every row of a group of
+ * equal labels ranks above all the rows after the group: the pairs are
+ * counted per group in O(n log n), and pair p is found by a binary search
+ * over the number of pairs before each group. Rows with a NaN label are in
+ * no pair.
+ */
+template <class CTX>
+bool RankTrainQuery(CTX* ctx, const RankHeader &h, double *model,
+                    const double *labels, const double *rows) {
+  uint64_t n = h.nbuf;
+  size_t d = h.dim;
+  if (n < 2) return true;
+  // the rows by label, the start of each group and the pairs before it
+  uint64_t *order = BismarckAllocate<uint64_t>(ctx, 3 * n + 2);
+  if (order == NULL) return false;
+  uint64_t *start = order + n;
+  uint64_t *before = start + n + 1;
+  uint64_t m = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    if (labels[i] == labels[i]) order[m++] = i;
+  }
+  RankByLabelIndex by_label = {labels};
+  std::stable_sort(order, order + m, by_label);
+
+  uint64_t ngroups = 0, npairs = 0;
+  for (uint64_t i = 0, e; i < m; i = e) {
+    for (e = i + 1; e < m && labels[order[e]] == labels[order[i]]; e++) { }
+    start[ngroups] = i;
+    before[ngroups] = npairs;
+    npairs += (e - i) * (m - e);
+    ngroups++;
+  }
+  start[ngroups] = m;
+  before[ngroups] = npairs;
+
+  if (npairs <= h.max_pairs) {
+    for (uint64_t g = 0; g < ngroups; g++) {
+      for (uint64_t a = start[g]; a < start[g + 1]; a++) {
+        for (uint64_t b = start[g + 1]; b < m; b++) {
+          RankPairStep(h, model, rows + order[a] * d, rows + order[b] * d);
+        }
+      }
+    }
+  } else {
+    // draw max_pairs of the pairs by their index
+    uint64_t r = RankMix(static_cast<uint64_t>(h.query));
+    for (uint64_t t = 0; t < h.max_pairs; t++) {
+      r = RankMix(r);
+      uint64_t p = r % npairs;
+      uint64_t g = std::upper_bound(before, before + ngroups, p) - before - 1;
+      uint64_t below = m - start[g + 1];
+      uint64_t off = p - before[g];
+      RankPairStep(h, model, rows + order[start[g] + off / below] * d,
+                   rows + order[start[g + 1] + off % below] * d);
+    }
+  }
+  BismarckFree(ctx, order);
+  return true;
+}
+
+/*! Trains on the buffered query and empties the buffer
+ */
+template <class CTX>
+bool RankTrainBuffer(CTX* ctx, const bytea &m) {
+  RankHeader *h = RankHead(m);
+  if (h->nbuf == 0) return true;
+  if (!RankTrainQuery(ctx, *h, RankModel(m), RankLabels(m), RankRows(m))) {
+    return false;
+  }
+  h->nqueries++;
+  h->nbuf = 0;
+  return true;
+}
+
+template <class CTX>
+bool RankAlloc(CTX* ctx, bytea *m, uint64_t dim, uint64_t cap) {
+  size_t len = sizeof(RankHeader) + (dim + cap + cap * dim) * sizeof(double);
+  char *str = BismarckAllocate<char>(ctx, len);
+  if (str == NULL) return false;
+  memset(str, 0, sizeof(RankHeader) + dim * sizeof(double));
+  m->str = str;
+  m->len = len;
+  RankHead(*m)->dim = dim;
+  RankHead(*m)->cap = cap;
+  return true;
+}
+
+template <class CTX>
+void BismarckRank<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+bool BismarckRank<CTX>::Step(CTX* ctx, const bytea &prev, int64_t query,
+                             const bytea &val, double label, double step,
+                             double mu, int loss, uint32_t max_pairs,
+                             bytea *m) {
+  size_t len_val;
+  double *v;
+  CoerceBytea(val, v, len_val);
+
+  if (m->str == NULL) {
+    if (!RankAlloc(ctx, m, len_val, 16)) return false;
+    if (prev.len == len_val * sizeof(double)) {
+      memcpy(RankModel(*m), prev.str, prev.len);
+    }
+  }
+  RankHeader *h = RankHead(*m);
+  h->step = step;
+  h->mu = mu;
+  h->loss = loss;
+  h->max_pairs = max_pairs;
+  if (len_val != h->dim) return true;
+
+  if (h->query != query && !RankTrainBuffer(ctx, *m)) return false;
+  h->query = query;
+
+  if (h->nbuf == h->cap && h->nbuf > 0 && MemoryOverBudget()) {
+    // over the memory budget: train the rows so far as a query of their own
+    // rather than growing the buffer
+    if (!RankTrainBuffer(ctx, *m)) return false;
+  }
+  if (h->nbuf == h->cap) {
+    uint64_t cap = std::max<uint64_t>(2 * h->cap, 16);
+    bytea grown;
+    if (!RankAlloc(ctx, &grown, h->dim, cap)) return false;
+    memcpy(grown.str, m->str, sizeof(RankHeader) + h->dim * sizeof(double));
+    RankHead(grown)->cap = cap;
+    memcpy(RankLabels(grown), RankLabels(*m), h->nbuf * sizeof(double));
+    memcpy(RankRows(grown), RankRows(*m), h->nbuf * h->dim * sizeof(double));
+    BismarckFree(ctx, m->str);
+    *m = grown;
+    h = RankHead(*m);
+  }
+
+  RankLabels(*m)[h->nbuf] = label;
+  memcpy(RankRows(*m) + h->nbuf * h->dim, v, h->dim * sizeof(double));
+  h->nbuf++;
+  return true;
+}
+
+template <class CTX>
+bool BismarckRank<CTX>::Flush(CTX* ctx, bytea *m) {
+  if (m->str == NULL) return true;
+  if (!RankTrainBuffer(ctx, *m)) return false;
+  RankHeader *h = RankHead(*m);
+  // the buffer is empty, only the header and the model need to be shipped
+  h->cap = 0;
+  m->len = sizeof(RankHeader) + h->dim * sizeof(double);
+  return true;
+}
+
+template <class CTX>
+bool BismarckRank<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  if (!Flush(ctx, dst)) return false;
+  const RankHeader *sh = RankHead(src);
+  RankHeader *dh = RankHead(*dst);
+  if (sh->dim != dh->dim) return true;
+
+  double *smodel = RankModel(src);
+  uint64_t snq = sh->nqueries;
+  double *scratch = NULL;
+  if (sh->nbuf > 0) {
+    // src is not ours to modify, train its last query on a copy
+    scratch = BismarckAllocate<double>(ctx, sh->dim);
+    if (scratch == NULL) return false;
+    memcpy(scratch, smodel, sh->dim * sizeof(double));
+    if (!RankTrainQuery(ctx, *sh, scratch, RankLabels(src), RankRows(src))) {
+      BismarckFree(ctx, scratch);
+      return false;
+    }
+    smodel = scratch;
+    snq++;
+  }
+
+  double w = (snq + dh->nqueries) == 0 ? 0.5 :
+      static_cast<double>(snq) / (snq + dh->nqueries);
+  hazy::simple_scale(RankModel(*dst), 1 - w, dh->dim);
+  hazy::simple_scale_add(RankModel(*dst), smodel, w, dh->dim);
+  dh->nqueries += snq;
+  if (scratch != NULL) BismarckFree(ctx, scratch);
+  return true;
+}
+
+template <class CTX>
+bytea BismarckRank<CTX>::Final(const bytea &m) {
+  bytea model = {NULL, 0};
+  if (m.str == NULL) return model;
+  model.str = reinterpret_cast<char*>(RankModel(m));
+  model.len = RankHead(m)->dim * sizeof(double);
+  return model;
+}
+
+inline double RankScore(const bytea &model, const bytea &ex) {
+  size_t model_len, v_len;
+  double *modelp, *vp;
+  CoerceBytea(model, modelp, model_len);
+  CoerceBytea(ex, vp, v_len);
+  return hazy::simple_dot(modelp, vp, std::min(model_len, v_len));
+}
+
+/*! Header of the evaluation state, followed by cap RankItems
+ */
+struct RankEvalHeader {
+  uint64_t cap;
+  uint64_t nbuf;
+  int64_t query;
+  uint64_t metric;
+  uint64_t k;
+  uint64_t nqueries;  //!< queries counted in sum
+  double sum;
+  uint64_t pad;
+};
+
+struct RankItem {
+  double score;
+  double label;
+};
+
+inline RankEvalHeader* RankEvalHead(const bytea &m) {
+  return reinterpret_cast<RankEvalHeader*>(m.str);
+}
+
+inline RankItem* RankItems(const bytea &m) {
+  return reinterpret_cast<RankItem*>(m.str + sizeof(RankEvalHeader));
+}
+
+/*! Higher scores first; ties are broken pessimistically, so that a constant
+ * score is not rewarded
+ */
+inline bool RankByScore(const RankItem &a, const RankItem &b) {
+  return a.score > b.score || (a.score == b.score && a.label < b.label);
+}
+
+inline bool RankByLabel(const RankItem &a, const RankItem &b) {
+  return a.label > b.label;
+}
+
+/*! Scores one query, reordering the items. Returns false if the query has
+ * no relevant row.
+ */
+inline bool RankQueryMetric(RankItem *items, uint64_t n, uint64_t metric,
+                            uint64_t k, double *value) {
+  std::sort(items, items + n, RankByScore);
+  if (metric == RANK_MAP) {
+    double hits = 0, precision = 0;
+    for (uint64_t i = 0; i < n; i++) {
+      if (items[i].label > 0) {
+        hits++;
+        precision += hits / (i + 1);
+      }
+    }
+    if (hits == 0) return false;
+    *value = precision / hits;
+    return true;
+  }
+
+  uint64_t cut = (k == 0 || k > n) ? n : k;
+  double dcg = 0, ideal = 0;
+  for (uint64_t i = 0; i < cut; i++) {
+    dcg += (std::pow(2.0, items[i].label) - 1) / std::log2(i + 2.0);
+  }
+  std::sort(items, items + n, RankByLabel);
+  for (uint64_t i = 0; i < cut; i++) {
+    ideal += (std::pow(2.0, items[i].label) - 1) / std::log2(i + 2.0);
+  }
+  if (!(ideal > 0)) return false;
+  *value = dcg / ideal;
+  return true;
+}
+
+/*! Scores the buffered query and empties the buffer
+ */
+inline void RankEvalScoreBuffer(const bytea &m) {
+  RankEvalHeader *h = RankEvalHead(m);
+  double value;
+  if (h->nbuf > 0 &&
+      RankQueryMetric(RankItems(m), h->nbuf, h->metric, h->k, &value)) {
+    h->sum += value;
+    h->nqueries++;
+  }
+  h->nbuf = 0;
+}
+
+template <class CTX>
+void BismarckRankEval<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+bool RankEvalAlloc(CTX* ctx, bytea *m, uint64_t cap) {
+  size_t len = sizeof(RankEvalHeader) + cap * sizeof(RankItem);
+  char *str = BismarckAllocate<char>(ctx, len);
+  if (str == NULL) return false;
+  memset(str, 0, sizeof(RankEvalHeader));
+  m->str = str;
+  m->len = len;
+  RankEvalHead(*m)->cap = cap;
+  return true;
+}
+
+template <class CTX>
+bool BismarckRankEval<CTX>::Step(CTX* ctx, int64_t query, double score,
+                                 double label, int metric, uint32_t k,
+                                 bytea *m) {
+  if (m->str == NULL && !RankEvalAlloc(ctx, m, 64)) return false;
+  RankEvalHeader *h = RankEvalHead(*m);
+  h->metric = metric;
+  h->k = k;
+  if (h->query != query) RankEvalScoreBuffer(*m);
+  h->query = query;
+
+  if (h->nbuf == h->cap) {
+    uint64_t cap = std::max<uint64_t>(2 * h->cap, 64);
+    bytea grown;
+    if (!RankEvalAlloc(ctx, &grown, cap)) return false;
+    memcpy(grown.str, m->str, sizeof(RankEvalHeader) +
+           h->nbuf * sizeof(RankItem));
+    RankEvalHead(grown)->cap = cap;
+    BismarckFree(ctx, m->str);
+    *m = grown;
+    h = RankEvalHead(*m);
+  }
+  RankItem item = {score, label};
+  RankItems(*m)[h->nbuf++] = item;
+  return true;
+}
+
+template <class CTX>
+void BismarckRankEval<CTX>::Flush(CTX* ctx, bytea *m) {
+  if (m->str == NULL) return;
+  RankEvalScoreBuffer(*m);
+  RankEvalHead(*m)->cap = 0;
+  m->len = sizeof(RankEvalHeader);
+}
+
+template <class CTX>
+bool BismarckRankEval<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  Flush(ctx, dst);
+  const RankEvalHeader *sh = RankEvalHead(src);
+  RankEvalHeader *dh = RankEvalHead(*dst);
+  dh->sum += sh->sum;
+  dh->nqueries += sh->nqueries;
+  if (sh->nbuf == 0) return true;
+
+  // src is not ours to reorder, score its last query on a copy
+  RankItem *items = BismarckAllocate<RankItem>(ctx, sh->nbuf);
+  if (items == NULL) return false;
+  memcpy(items, RankItems(src), sh->nbuf * sizeof(RankItem));
+  double value;
+  if (RankQueryMetric(items, sh->nbuf, sh->metric, sh->k, &value)) {
+    dh->sum += value;
+    dh->nqueries++;
+  }
+  BismarckFree(ctx, items);
+  return true;
+}
+
+template <class CTX>
+double BismarckRankEval<CTX>::Final(CTX* ctx, bytea *m) {
+  if (m->str == NULL) return std::numeric_limits<double>::quiet_NaN();
+  Flush(ctx, m);
+  RankEvalHeader *h = RankEvalHead(*m);
+  if (h->nqueries == 0) return std::numeric_limits<double>::quiet_NaN();
+  return h->sum / h->nqueries;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,157 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "rank"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "rank-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void RankInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void RankUpdate(FunctionContext* ctx, const StringVal &prev_model,
+                const BigIntVal &query, const StringVal &ex,
+                const DoubleVal &label, const DoubleVal &step_size,
+                const DoubleVal &mu, const IntVal &loss,
+                const IntVal &max_pairs, StringVal *st) {
+  if (query.is_null || ex.is_null || label.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckRank<FunctionContext>::Init(ctx, &sta);
+  }
+  bytea prev = {NULL, 0};
+  if (!prev_model.is_null) prev = StringValToBytea(prev_model);
+  if (!BismarckRank<FunctionContext>::Step(
+          ctx, prev, query.val, StringValToBytea(ex), label.val,
+          step_size.val, mu.val, loss.is_null ? RANK_HINGE : loss.val,
+          max_pairs.is_null ? 1000 : max_pairs.val, &sta)) {
+    ctx->SetError("rank: out of memory");
+    return;
+  }
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+const StringVal RankSerialize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return st;
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  if (!BismarckRank<FunctionContext>::Flush(ctx, &sta)) {
+    ctx->SetError("rank: out of memory");
+  }
+  return BismarckResult(sta.str, sta.len);
+}
+
+void RankMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckRank<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                            &dsta)) {
+    ctx->SetError("rank: out of memory");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal RankFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  if (!BismarckRank<FunctionContext>::Flush(ctx, &sta)) {
+    ctx->SetError("rank: out of memory");
+    return StringVal::null();
+  }
+  bytea model = BismarckRank<FunctionContext>::Final(sta);
+  StringVal r(ctx, model.len);
+  memcpy(r.ptr, model.str, model.len);
+  return r;
+}
+
+DoubleVal RankScore(FunctionContext* ctx, const StringVal &model,
+                    const StringVal &ex) {
+  if (model.is_null || ex.is_null) return DoubleVal::null();
+  return DoubleVal(RankScore(StringValToBytea(model), StringValToBytea(ex)));
+}
+
+void RankEvalInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void RankEvalUpdate(FunctionContext* ctx, const BigIntVal &query,
+                    const DoubleVal &score, const DoubleVal &label,
+                    const IntVal &metric, const IntVal &k, StringVal *st) {
+  if (query.is_null || score.is_null || label.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckRankEval<FunctionContext>::Init(ctx, &sta);
+  }
+  if (!BismarckRankEval<FunctionContext>::Step(
+          ctx, query.val, score.val, label.val,
+          metric.is_null ? RANK_NDCG : metric.val, k.is_null ? 0 : k.val,
+          &sta)) {
+    ctx->SetError("rankeval: out of memory");
+    return;
+  }
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+const StringVal RankEvalSerialize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return st;
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  BismarckRankEval<FunctionContext>::Flush(ctx, &sta);
+  return BismarckResult(sta.str, sta.len);
+}
+
+void RankEvalMerge(FunctionContext* ctx, const StringVal &src,
+                   StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckRankEval<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                                &dsta)) {
+    ctx->SetError("rankeval: out of memory");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+DoubleVal RankEvalFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return DoubleVal::null();
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  double r = BismarckRankEval<FunctionContext>::Final(ctx, &sta);
+  if (r != r) return DoubleVal::null();
+  return DoubleVal(r);
+}
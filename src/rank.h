@@ -0,0 +1,132 @@
+
+#ifndef HAZY_BISMARCK_RANK_H
+#define HAZY_BISMARCK_RANK_H
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief The pairwise losses BismarckRank can train
+ */
+enum RankLoss {
+  RANK_HINGE = 0,    //!< RankSVM, max(0, 1 - (w.x_i - w.x_j))
+  RANK_LOGISTIC = 1  //!< RankNet, log(1 + exp(-(w.x_i - w.x_j)))
+};
+
+/*! \brief Trains a linear pairwise ranking model with Bismarck
+ *
+ * The input must be clustered by query. The state buffers the rows of the
+ * current query; when a row of another query arrives, the IGD steps for the
+ * pairs (i, j) of the buffered query with label_i > label_j are taken and
+ * the buffer is emptied. A query with more than max_pairs such pairs only
+ * gets max_pairs pairs drawn at random, so the cost of a query is bounded.
+ * The pairs are counted and drawn from the rows sorted by label, in
+ * O(n log n) for a query of n rows.
+ *
+ * The UDA state is one flat block: a header, the model and the buffered
+ * rows. Merging averages the models, weighted by the number of queries each
+ * was trained on. A query split between two fragments is trained as two
+ * queries, and so is a query that fills the buffer while the library is over
+ * its memory budget.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckRank {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Buffers a row, training on the previous query if this row
+   * starts a new one
+   *
+   * \param ctx the context to allocate memory with
+   * \param prev a model to start from (e.g. from the previous epoch), or
+   * empty to start from zeros
+   * \param query the query of the row
+   * \param val the example (double array)
+   * \param label the graded relevance of the row, higher is better
+   * \param step the step size
+   * \param mu the l2 regularization
+   * \param loss a RankLoss
+   * \param max_pairs the most pairs trained per query
+   * \param m the current state, may be re-allocated
+   * \return false if memory cannot be allocated
+   */
+  static bool Step(Context* ctx, const bytea &prev, int64_t query,
+                   const bytea &val, double label, double step, double mu,
+                   int loss, uint32_t max_pairs, bytea *m);
+
+  /*! \brief Trains on the buffered query and drops the buffer
+   *
+   * After Flush the state only holds the header and the model, which is what
+   * should be shipped between nodes. Returns false if memory cannot be
+   * allocated.
+   */
+  static bool Flush(Context* ctx, bytea *m);
+
+  /*! \brief Averages the model of src into dst, both are flushed first;
+   * returns false if memory cannot be allocated
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the model (double array) of a flushed state
+   */
+  static bytea Final(const bytea &m);
+};
+
+/*! \brief Returns the ranking score of the example, higher ranks first
+ */
+inline double RankScore(const bytea &model, const bytea &ex);
+
+/*! \brief The metrics BismarckRankEval can compute
+ */
+enum RankMetric {
+  RANK_NDCG = 0,  //!< NDCG@k with the gains 2^label - 1
+  RANK_MAP = 1    //!< mean average precision, label > 0 is relevant
+};
+
+/*! \brief Evaluates a ranking, averaged over the queries
+ *
+ * Like BismarckRank, the input must be clustered by query: the (score,
+ * label) pairs of the current query are buffered and scored when the next
+ * query starts. Queries without any relevant row are not counted.
+ * \tparam Context the bismarck context type, as in BismarckRank
+ */
+template <class Context>
+class BismarckRankEval {
+ public:
+  /*! \brief Initializes an empty state
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Buffers the score and label of a row
+   *
+   * \param metric a RankMetric
+   * \param k the cutoff of NDCG, 0 for no cutoff
+   * \return false if memory cannot be allocated
+   */
+  static bool Step(Context* ctx, int64_t query, double score, double label,
+                   int metric, uint32_t k, bytea *m);
+
+  /*! \brief Scores the buffered query and drops the buffer
+   */
+  static void Flush(Context* ctx, bytea *m);
+
+  /*! \brief Adds the queries of src to dst, both are flushed first;
+   * returns false if memory cannot be allocated
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the metric averaged over the queries, or NaN if no
+   * query counted
+   */
+  static double Final(Context* ctx, bytea *m);
+};
+
+}
+}
+#endif
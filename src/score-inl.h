@@ -0,0 +1,233 @@
+
+#ifndef HAZY_BISMARCK_SCORE_INL_H
+#define HAZY_BISMARCK_SCORE_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+
+#include "linalg-inl.h"
+#include "memory-inl.h"
+
+// see for documentation
+#include "score.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state. Unless flushed it is followed by the model (dim
+ * doubles), the ids of the buffered rows (block int64s) and the buffered
+ * rows column-major (dim * block doubles). Then come the scored pairs (cap
+ * ScorePairs).
+ */
+struct ScoreHeader {
+  uint32_t link;
+  uint32_t flushed;
+  uint64_t dim;
+  uint64_t block;    //!< rows per block
+  uint64_t nbuf;     //!< rows in the block
+  uint64_t nscored;
+  uint64_t cap;
+};
+
+inline ScoreHeader* ScoreHead(const bytea &m) {
+  return reinterpret_cast<ScoreHeader*>(m.str);
+}
+
+inline double* ScoreModel(const bytea &m) {
+  return reinterpret_cast<double*>(m.str + sizeof(ScoreHeader));
+}
+
+inline int64_t* ScoreIds(const bytea &m) {
+  return reinterpret_cast<int64_t*>(ScoreModel(m) + ScoreHead(m)->dim);
+}
+
+inline double* ScoreColumns(const bytea &m) {
+  return reinterpret_cast<double*>(ScoreIds(m) + ScoreHead(m)->block);
+}
+
+inline size_t ScoreBufferSize(const ScoreHeader &h) {
+  if (h.flushed) return 0;
+  return (h.dim + h.block + h.dim * h.block) * sizeof(double);
+}
+
+inline ScorePair* ScorePairs(const bytea &m) {
+  return reinterpret_cast<ScorePair*>(m.str + sizeof(ScoreHeader) +
+                                      ScoreBufferSize(*ScoreHead(m)));
+}
+
+/*! About 1MB of buffered examples per block, the smallest block while the
+ * library is over its memory budget
+ */
+inline uint64_t ScoreBlockRows(uint64_t dim) {
+  if (MemoryOverBudget()) return 8;
+  uint64_t rows = (1 << 20) / (sizeof(double) * std::max<uint64_t>(dim, 1));
+  return std::min<uint64_t>(std::max<uint64_t>(rows, 8), 512);
+}
+
+inline double ScoreApplyLink(double s, uint32_t link) {
+  switch (link) {
+    case SCORE_LOGISTIC: return 1 / (1 + std::exp(-s));
+    case SCORE_SIGN: return s > 0 ? 1 : 0;
+    default: return s;
+  }
+}
+
+/*! Scores the n buffered rows of a state into out
+ *
+ * out = X w, as the sum over features of w_j times column j of the block.
+ */
+inline void ScoreBlock(const bytea &m, ScorePair *out) {
+  const ScoreHeader &h = *ScoreHead(m);
+  const double *w = ScoreModel(m);
+  const double *cols = ScoreColumns(m);
+  const int64_t *ids = ScoreIds(m);
+  size_t n = h.nbuf;
+  double *scores = reinterpret_cast<double*>(out);
+  // accumulate in the first n doubles of out, which stay in L1, then spread
+  // them into the pairs from the back so no score is overwritten early
+  for (size_t b = 0; b < n; b++) scores[b] = 0;
+  for (size_t j = 0; j < h.dim; j++) {
+    if (w[j] == 0) continue;
+    hazy::simple_scale_add(scores, cols + j * h.block, w[j], n);
+  }
+  for (size_t b = n; b-- > 0; ) {
+    double s = scores[b];
+    out[b].id = ids[b];
+    out[b].score = ScoreApplyLink(s, h.link);
+  }
+}
+
+/*! Allocates a state with room for cap pairs, copying the old one
+ */
+template <class CTX>
+void ScoreRealloc(CTX* ctx, bytea *m, uint64_t cap) {
+  ScoreHeader h = *ScoreHead(*m);
+  size_t len = sizeof(ScoreHeader) + ScoreBufferSize(h) +
+      cap * sizeof(ScorePair);
+  char *str = BismarckAllocate<char>(ctx, len);
+  memcpy(str, m->str, sizeof(ScoreHeader) + ScoreBufferSize(h) +
+         h.nscored * sizeof(ScorePair));
+  BismarckFree(ctx, m->str);
+  m->str = str;
+  m->len = len;
+  ScoreHead(*m)->cap = cap;
+}
+
+/*! Makes room for n more pairs, growing geometrically
+ */
+template <class CTX>
+void ScoreReserve(CTX* ctx, bytea *m, uint64_t n) {
+  ScoreHeader *h = ScoreHead(*m);
+  if (h->nscored + n <= h->cap) return;
+  ScoreRealloc(ctx, m, std::max(h->nscored + n, 2 * h->cap));
+}
+
+template <class CTX>
+void BismarckScore<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckScore<CTX>::Step(CTX* ctx, const bytea &model, int64_t id,
+                              const bytea &ex, int link, bytea *m) {
+  if (m->str == NULL) {
+    ScoreHeader h;
+    memset(&h, 0, sizeof(h));
+    h.link = link;
+    h.dim = model.len / sizeof(double);
+    h.block = ScoreBlockRows(h.dim);
+    h.cap = h.block;
+    m->len = sizeof(ScoreHeader) + ScoreBufferSize(h) +
+        h.cap * sizeof(ScorePair);
+    m->str = BismarckAllocate<char>(ctx, m->len);
+    *ScoreHead(*m) = h;
+    memcpy(ScoreModel(*m), model.str, h.dim * sizeof(double));
+  }
+
+  ScoreHeader *h = ScoreHead(*m);
+  const double *x = reinterpret_cast<const double*>(ex.str);
+  size_t n = std::min<size_t>(ex.len / sizeof(double), h->dim);
+  double *col = ScoreColumns(*m) + h->nbuf;
+  for (size_t j = 0; j < n; j++) col[j * h->block] = x[j];
+  for (size_t j = n; j < h->dim; j++) col[j * h->block] = 0;
+  ScoreIds(*m)[h->nbuf++] = id;
+  if (h->nbuf < h->block) return;
+
+  ScoreReserve(ctx, m, h->nbuf);
+  h = ScoreHead(*m);
+  ScoreBlock(*m, ScorePairs(*m) + h->nscored);
+  h->nscored += h->nbuf;
+  h->nbuf = 0;
+}
+
+template <class CTX>
+void BismarckScore<CTX>::Flush(CTX* ctx, bytea *m) {
+  if (m->str == NULL || ScoreHead(*m)->flushed) return;
+  ScoreReserve(ctx, m, ScoreHead(*m)->nbuf);
+  ScoreHeader *h = ScoreHead(*m);
+  ScoreBlock(*m, ScorePairs(*m) + h->nscored);
+  h->nscored += h->nbuf;
+  h->nbuf = 0;
+
+  // keep only the pairs
+  ScorePair *pairs = ScorePairs(*m);
+  h->flushed = 1;
+  h->cap = h->nscored;
+  memmove(ScorePairs(*m), pairs, h->nscored * sizeof(ScorePair));
+  m->len = sizeof(ScoreHeader) + h->nscored * sizeof(ScorePair);
+}
+
+template <class CTX>
+void BismarckScore<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  if (dst->str == NULL) {
+    dst->str = BismarckAllocate<char>(ctx, src.len);
+    dst->len = src.len;
+    memcpy(dst->str, src.str, src.len);
+    return;
+  }
+  Flush(ctx, dst);
+  const ScoreHeader *sh = ScoreHead(src);
+  ScoreReserve(ctx, dst, sh->nscored + sh->nbuf);
+  ScoreHeader *dh = ScoreHead(*dst);
+  ScorePair *out = ScorePairs(*dst) + dh->nscored;
+  memcpy(out, ScorePairs(src), sh->nscored * sizeof(ScorePair));
+  // src is not ours to flush, score its block straight into dst
+  if (!sh->flushed) ScoreBlock(src, out + sh->nscored);
+  dh->nscored += sh->nscored + sh->nbuf;
+}
+
+inline bool ScoreById(const ScorePair &a, const ScorePair &b) {
+  return a.id < b.id;
+}
+
+template <class CTX>
+bytea BismarckScore<CTX>::Final(CTX* ctx, bytea *m) {
+  bytea r = {NULL, 0};
+  if (m->str == NULL) return r;
+  Flush(ctx, m);
+  ScoreHeader *h = ScoreHead(*m);
+  ScorePair *pairs = ScorePairs(*m);
+  std::stable_sort(pairs, pairs + h->nscored, ScoreById);
+  r.str = reinterpret_cast<char*>(pairs);
+  r.len = h->nscored * sizeof(ScorePair);
+  return r;
+}
+
+inline bool ScoreLookup(const bytea &scores, int64_t id, double *score) {
+  const ScorePair *pairs = reinterpret_cast<const ScorePair*>(scores.str);
+  size_t n = scores.len / sizeof(ScorePair);
+  ScorePair key = {id, 0};
+  const ScorePair *p = std::lower_bound(pairs, pairs + n, key, ScoreById);
+  if (p == pairs + n || p->id != id) return false;
+  *score = p->score;
+  return true;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,95 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "score"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "score-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void ScoreInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void ScoreUpdate(FunctionContext* ctx, const StringVal &model,
+                 const BigIntVal &id, const StringVal &ex,
+                 const IntVal &link, StringVal *st) {
+  if (model.is_null || id.is_null || ex.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckScore<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckScore<FunctionContext>::Step(ctx, StringValToBytea(model), id.val,
+                                       StringValToBytea(ex),
+                                       link.is_null ? SCORE_LINEAR : link.val,
+                                       &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+const StringVal ScoreSerialize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return st;
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  BismarckScore<FunctionContext>::Flush(ctx, &sta);
+  return BismarckResult(sta.str, sta.len);
+}
+
+void ScoreMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckScore<FunctionContext>::Merge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal ScoreFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea sta = StringValToBytea(st);
+  bytea pairs = BismarckScore<FunctionContext>::Final(ctx, &sta);
+  StringVal r(ctx, pairs.len);
+  memcpy(r.ptr, pairs.str, pairs.len);
+  return r;
+}
+
+DoubleVal ScoreGet(FunctionContext* ctx, const StringVal &scores,
+                   const BigIntVal &id) {
+  if (scores.is_null || id.is_null) return DoubleVal::null();
+  double s;
+  if (!ScoreLookup(StringValToBytea(scores), id.val, &s)) {
+    return DoubleVal::null();
+  }
+  return DoubleVal(s);
+}
+
+StringVal ScoreValues(FunctionContext* ctx, const StringVal &scores) {
+  if (scores.is_null) return StringVal::null();
+  const ScorePair *pairs = reinterpret_cast<const ScorePair*>(scores.ptr);
+  size_t n = scores.len / sizeof(ScorePair);
+  StringVal r(ctx, n * sizeof(double));
+  double *v = reinterpret_cast<double*>(r.ptr);
+  for (size_t i = 0; i < n; i++) v[i] = pairs[i].score;
+  return r;
+}
@@ -0,0 +1,87 @@
+
+#ifndef HAZY_BISMARCK_SCORE_H
+#define HAZY_BISMARCK_SCORE_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief How BismarckScore turns w.x into a score
+ */
+enum ScoreLink {
+  SCORE_LINEAR = 0,    //!< w.x, for linear regression and SVM margins
+  SCORE_LOGISTIC = 1,  //!< 1 / (1 + exp(-w.x)), the probability of logr
+  SCORE_SIGN = 2       //!< 1 if w.x > 0 else 0, like svmpredict
+};
+
+/*! \brief A scored row, Final returns these ordered by id
+ */
+struct ScorePair {
+  int64_t id;
+  double score;
+};
+
+/*! \brief Scores many rows against one linear model (double array)
+ *
+ * Scoring a row at a time reads the whole model for every row. Instead the
+ * state buffers a block of rows, stored column-major as they arrive, and
+ * scores the block with one pass over the model: feature j adds
+ * w_j * (column j) to the block's scores, so each weight is read once per
+ * block and the scores being summed stay in L1. The block holds about 1MB
+ * of examples, between 8 and 512 rows.
+ *
+ * The state is one flat block: a header, the model, the buffered block and
+ * the (id, score) pairs of the rows already scored. After Flush only the
+ * header and the pairs are left, which is what should be shipped between
+ * nodes. The ids order the output; rows reach the aggregate in no
+ * particular order.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckScore {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Buffers a row, scoring the block once it is full
+   *
+   * \param ctx the context to allocate memory with
+   * \param model the model, read on the first row only
+   * \param id the position of the row in the output
+   * \param ex the example (double array), missing features are zeros
+   * \param link a ScoreLink
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &model, int64_t id,
+                   const bytea &ex, int link, bytea *m);
+
+  /*! \brief Scores the buffered rows and drops the model and the buffer
+   */
+  static void Flush(Context* ctx, bytea *m);
+
+  /*! \brief Adds the scores of src to dst, dst is flushed first
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the ScorePair array ordered by id
+   *
+   * The pairs are sorted in place, the result points into m.
+   */
+  static bytea Final(Context* ctx, bytea *m);
+};
+
+/*! \brief Finds the score of a row in the result of Final
+ *
+ * \return false if the row was not scored
+ */
+inline bool ScoreLookup(const bytea &scores, int64_t id, double *score);
+
+}
+}
+#endif
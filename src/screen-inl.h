@@ -0,0 +1,288 @@
+#ifndef HAZY_BISMARCK_SCREEN_INL_H
+#define HAZY_BISMARCK_SCREEN_INL_H
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+#include "igd.h"
+
+// see for documentation
+#include "screen.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state, followed by kScreenArrays arrays of cap doubles:
+ * for each feature the number of rows it was seen in, the mean of x, the
+ * centered sum of squares of x, the mean of y and the co-moment of x and
+ * y over those rows. The rows a feature was not seen in are zeros.
+ */
+struct ScreenHeader {
+  uint64_t dim;
+  uint64_t cap;
+  double n;
+  double my;
+  double m2y;
+};
+
+enum {
+  kScreenCount = 0,
+  kScreenMeanX,
+  kScreenM2X,
+  kScreenMeanY,
+  kScreenCoXY,
+  kScreenArrays
+};
+
+inline ScreenHeader* ScreenHead(const bytea &m) {
+  return reinterpret_cast<ScreenHeader*>(m.str);
+}
+
+inline double* ScreenArray(const bytea &m, int k) {
+  return reinterpret_cast<double*>(m.str + sizeof(ScreenHeader)) +
+         k * ScreenHead(m)->cap;
+}
+
+inline size_t ScreenSize(uint64_t cap) {
+  return sizeof(ScreenHeader) + kScreenArrays * cap * sizeof(double);
+}
+
+/*! Makes room for dim features, growing geometrically. Returns false, and
+ * leaves the state as it was, if the memory cannot be allocated
+ */
+template <class CTX>
+bool ScreenReserve(CTX* ctx, bytea *m, uint64_t dim) {
+  if (m->str == NULL) {
+    size_t len = ScreenSize(dim);
+    char *str = BismarckAllocate<char>(ctx, len);
+    if (str == NULL) return false;
+    memset(str, 0, len);
+    m->str = str;
+    m->len = len;
+    ScreenHead(*m)->dim = ScreenHead(*m)->cap = dim;
+    return true;
+  }
+  ScreenHeader *h = ScreenHead(*m);
+  if (dim > h->cap) {
+    uint64_t cap = std::max(dim, 2 * h->cap);
+    bytea g;
+    g.len = ScreenSize(cap);
+    g.str = BismarckAllocate<char>(ctx, g.len);
+    if (g.str == NULL) return false;
+    memset(g.str, 0, g.len);
+    *ScreenHead(g) = *h;
+    ScreenHead(g)->cap = cap;
+    for (int k = 0; k < kScreenArrays; k++) {
+      memcpy(ScreenArray(g, k), ScreenArray(*m, k), h->dim * sizeof(double));
+    }
+    BismarckFree(ctx, m->str);
+    *m = g;
+    h = ScreenHead(*m);
+  }
+  h->dim = std::max(h->dim, dim);
+  return true;
+}
+
+inline void ScreenLabel(ScreenHeader *h, double y) {
+  h->n += 1;
+  double d = y - h->my;
+  h->my += d / h->n;
+  h->m2y += d * (y - h->my);
+}
+
+/*! Welford's update of feature j with the value v of a row labeled y
+ */
+inline void ScreenFeature(const bytea &m, uint64_t j, double v, double y) {
+  double *cnt = ScreenArray(m, kScreenCount);
+  double *mx = ScreenArray(m, kScreenMeanX), *my = ScreenArray(m, kScreenMeanY);
+  double c = cnt[j] += 1;
+  double dx = v - mx[j];
+  mx[j] += dx / c;
+  my[j] += (y - my[j]) / c;
+  ScreenArray(m, kScreenM2X)[j] += dx * (v - mx[j]);
+  ScreenArray(m, kScreenCoXY)[j] += dx * (y - my[j]);
+}
+
+template <class CTX>
+void BismarckScreen<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+bool BismarckScreen<CTX>::Step(CTX* ctx, const bytea &ex, double y,
+                               bytea *m) {
+  uint64_t n = ex.len / sizeof(double);
+  if (!ScreenReserve(ctx, m, n)) return false;
+  ScreenLabel(ScreenHead(*m), y);
+  const double *x = reinterpret_cast<const double*>(ex.str);
+  for (uint64_t j = 0; j < n; j++) ScreenFeature(*m, j, x[j], y);
+  return true;
+}
+
+template <class CTX>
+bool BismarckScreen<CTX>::StepSparse(CTX* ctx, const bytea &ex, double y,
+                                     bytea *m) {
+  const IGDSparseEntry *e = reinterpret_cast<const IGDSparseEntry*>(ex.str);
+  size_t nnz = ex.len / sizeof(IGDSparseEntry);
+  uint64_t dim = 0;
+  for (size_t i = 0; i < nnz; i++) {
+    dim = std::max<uint64_t>(dim, e[i].index + 1);
+  }
+  if (!ScreenReserve(ctx, m, dim)) return false;
+  ScreenLabel(ScreenHead(*m), y);
+  for (size_t i = 0; i < nnz; i++) {
+    ScreenFeature(*m, e[i].index, e[i].value, y);
+  }
+  return true;
+}
+
+/*! Chan's merge of the count, means and centered moments of b into a
+ */
+inline void ScreenChan(double *na, double *mxa, double *m2xa, double *mya,
+                       double *cxya, double nb, double mxb, double m2xb,
+                       double myb, double cxyb) {
+  if (nb == 0) return;
+  double n = *na + nb, w = *na * nb / n;
+  double dx = mxb - *mxa, dy = myb - *mya;
+  *m2xa += m2xb + dx * dx * w;
+  *cxya += cxyb + dx * dy * w;
+  *mxa += dx * nb / n;
+  *mya += dy * nb / n;
+  *na = n;
+}
+
+template <class CTX>
+bool BismarckScreen<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return true;
+  if (dst->str == NULL) {
+    char *str = BismarckAllocate<char>(ctx, src.len);
+    if (str == NULL) return false;
+    memcpy(str, src.str, src.len);
+    dst->str = str;
+    dst->len = src.len;
+    return true;
+  }
+  const ScreenHeader *sh = ScreenHead(src);
+  if (!ScreenReserve(ctx, dst, sh->dim)) return false;
+  ScreenHeader *dh = ScreenHead(*dst);
+  if (sh->n > 0) {
+    double n = dh->n + sh->n, d = sh->my - dh->my;
+    dh->m2y += sh->m2y + d * d * dh->n * sh->n / n;
+    dh->my += d * sh->n / n;
+    dh->n = n;
+  }
+  double *d[kScreenArrays];
+  const double *s[kScreenArrays];
+  for (int k = 0; k < kScreenArrays; k++) {
+    d[k] = ScreenArray(*dst, k);
+    s[k] = ScreenArray(src, k);
+  }
+  for (uint64_t j = 0; j < sh->dim; j++) {
+    ScreenChan(d[kScreenCount] + j, d[kScreenMeanX] + j, d[kScreenM2X] + j,
+               d[kScreenMeanY] + j, d[kScreenCoXY] + j, s[kScreenCount][j],
+               s[kScreenMeanX][j], s[kScreenM2X][j], s[kScreenMeanY][j],
+               s[kScreenCoXY][j]);
+  }
+  return true;
+}
+
+/*! The continued fraction of the incomplete beta function, by Lentz's
+ * method
+ */
+inline double ScreenBetaFraction(double a, double b, double x) {
+  const double tiny = 1e-300, eps = 1e-15;
+  double c = 1, d = 1 - (a + b) * x / (a + 1);
+  if (std::fabs(d) < tiny) d = tiny;
+  d = 1 / d;
+  double f = d;
+  for (int k = 1; k <= 300; k++) {
+    // the even term, then the odd one
+    double num = k * (b - k) * x / ((a + 2 * k - 1) * (a + 2 * k));
+    d = 1 + num * d;
+    c = 1 + num / c;
+    if (std::fabs(d) < tiny) d = tiny;
+    if (std::fabs(c) < tiny) c = tiny;
+    d = 1 / d;
+    f *= d * c;
+    num = -(a + k) * (a + b + k) * x / ((a + 2 * k) * (a + 2 * k + 1));
+    d = 1 + num * d;
+    c = 1 + num / c;
+    if (std::fabs(d) < tiny) d = tiny;
+    if (std::fabs(c) < tiny) c = tiny;
+    d = 1 / d;
+    double delta = d * c;
+    f *= delta;
+    if (std::fabs(delta - 1) < eps) break;
+  }
+  return f;
+}
+
+/*! The regularized incomplete beta function I_x(a, b)
+ */
+inline double ScreenBetaInc(double a, double b, double x) {
+  if (x <= 0) return 0;
+  if (x >= 1) return 1;
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+                          std::lgamma(b) + a * std::log(x) +
+                          b * std::log1p(-x));
+  // the fraction converges quickly on the side of the mean
+  if (x < (a + 1) / (a + b + 2)) return front * ScreenBetaFraction(a, b, x) / a;
+  return 1 - front * ScreenBetaFraction(b, a, 1 - x) / b;
+}
+
+inline double ScreenTPValue(double t, double df) {
+  if (std::isnan(t) || !(df > 0)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (std::isinf(t)) return 0;
+  return ScreenBetaInc(df / 2, 0.5, df / (df + t * t));
+}
+
+template <class CTX>
+bytea BismarckScreen<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea r = {NULL, 0};
+  if (m.str == NULL) return r;
+  const ScreenHeader &h = *ScreenHead(m);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double *cnt = ScreenArray(m, kScreenCount);
+  const double *mx = ScreenArray(m, kScreenMeanX);
+  const double *m2x = ScreenArray(m, kScreenM2X);
+  const double *my = ScreenArray(m, kScreenMeanY);
+  const double *cxy = ScreenArray(m, kScreenCoXY);
+  double n = h.n, df = n - 2, syy = h.m2y;
+  r.len = 4 * h.dim * sizeof(double);
+  r.str = BismarckAllocate<char>(ctx, r.len);
+  if (r.str == NULL) {
+    r.len = 0;
+    return r;
+  }
+  double *out = reinterpret_cast<double*>(r.str);
+  for (uint64_t j = 0; j < h.dim; j++) {
+    // merge in the rows the feature was not seen in, as zeros
+    double xx = m2x[j] + mx[j] * mx[j] * cnt[j] * (n - cnt[j]) / n;
+    double xy = cxy[j] + mx[j] * (my[j] - h.my) * cnt[j];
+    double corr = nan, t = nan;
+    if (xx > 0 && syy > 0) {
+      corr = std::max(-1.0, std::min(1.0, xy / std::sqrt(xx * syy)));
+      double rest = 1 - corr * corr;
+      t = rest > 0 ? corr * std::sqrt(df / rest)
+                   : std::copysign(std::numeric_limits<double>::infinity(),
+                                   corr);
+      if (!(df > 0)) t = nan;
+    }
+    out[4 * j] = corr;
+    out[4 * j + 1] = t;
+    out[4 * j + 2] = t * t;
+    out[4 * j + 3] = ScreenTPValue(t, df);
+  }
+  return r;
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
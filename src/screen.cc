@@ -0,0 +1,93 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "screen"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "screen-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void ScreenInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void ScreenUpdate(FunctionContext* ctx, const StringVal &ex,
+                  const DoubleVal &y, StringVal *st) {
+  if (ex.is_null || y.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckScreen<FunctionContext>::Init(ctx, &sta);
+  }
+  if (!BismarckScreen<FunctionContext>::Step(ctx, StringValToBytea(ex),
+                                             y.val, &sta)) {
+    ctx->SetError("screen: out of memory");
+    return;
+  }
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void ScreenSparseUpdate(FunctionContext* ctx, const StringVal &ex,
+                        const DoubleVal &y, StringVal *st) {
+  if (ex.is_null || y.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckScreen<FunctionContext>::Init(ctx, &sta);
+  }
+  if (!BismarckScreen<FunctionContext>::StepSparse(ctx, StringValToBytea(ex),
+                                                   y.val, &sta)) {
+    ctx->SetError("screensparse: out of memory for the largest feature "
+                  "index");
+    return;
+  }
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void ScreenMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  if (!BismarckScreen<FunctionContext>::Merge(ctx, StringValToBytea(src),
+                                              &dsta)) {
+    ctx->SetError("screen: out of memory");
+  }
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal ScreenFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea stats = BismarckScreen<FunctionContext>::Final(ctx,
+                                                       StringValToBytea(st));
+  if (stats.str == NULL) {
+    ctx->SetError("screen: out of memory");
+    return StringVal::null();
+  }
+  StringVal r(ctx, stats.len);
+  memcpy(r.ptr, stats.str, stats.len);
+  BismarckFree(ctx, stats.str);
+  return r;
+}
@@ -0,0 +1,75 @@
+
+#ifndef HAZY_BISMARCK_SCREEN_H
+#define HAZY_BISMARCK_SCREEN_H
+
+#include <stdint.h>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Screens every feature against the label in one pass
+ *
+ * For each feature the state keeps, over the rows it was seen in, their
+ * number, the means of x and y and the centered moments of x and of x y,
+ * updated by Welford's method and merged by Chan's; the mean and centered
+ * sum of squares of y are shared. A sparse row (IGDSparseEntry array) only
+ * touches its non-zeros, the features a row is missing count as zeros and
+ * are merged in by Final. The number of features grows to the longest row
+ * or largest index seen.
+ *
+ * Final gives, for each feature, the Pearson correlation r with the label,
+ * the t statistic of the univariate regression, t = r sqrt((n - 2) /
+ * (1 - r^2)), its F statistic t^2 and the two-sided p-value of t with n - 2
+ * degrees of freedom. With a 0/1 label t is the pooled two-sample t-test
+ * of the feature between the classes, and F the one-way ANOVA of the two.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckScreen {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Adds a dense row
+   *
+   * \param ctx the context to allocate memory with
+   * \param ex the features (double array)
+   * \param y the label
+   * \param m the current state, may be re-allocated
+   * \return false, and m is unchanged, if the memory cannot be allocated
+   */
+  static bool Step(Context* ctx, const bytea &ex, double y, bytea *m);
+
+  /*! \brief Adds a sparse row (IGDSparseEntry array)
+   *
+   * The state grows to the largest index of the row, false if it cannot.
+   */
+  static bool StepSparse(Context* ctx, const bytea &ex, double y, bytea *m);
+
+  /*! \brief Merges the moments of src into dst
+   *
+   * \return false, and dst is unchanged, if the memory cannot be allocated
+   */
+  static bool Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns r, t, F and the p-value of each feature, feature after
+   * feature, as a double array
+   *
+   * The statistics of a constant feature are NaN. The str of the result
+   * is NULL if it cannot be allocated.
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief The two-sided p-value of t with df degrees of freedom
+ */
+double ScreenTPValue(double t, double df);
+
+}
+}
+#endif
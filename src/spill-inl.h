@@ -0,0 +1,259 @@
+
+#ifndef HAZY_BISMARCK_SPILL_INL_H
+#define HAZY_BISMARCK_SPILL_INL_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// see for documentation
+#include "spill.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! In front of every chunk, the body is padded to 8 bytes
+ */
+struct SpillChunkHeader {
+  uint64_t len;    //!< of the body, unpadded
+  uint64_t raw;
+  uint32_t codec;
+  uint32_t pad;
+};
+
+/*! A SPILL_ZERO_RUNS body is a sequence of runs: zeros zero words, then
+ * literals words stored as is
+ */
+struct SpillRun {
+  uint32_t zeros;
+  uint32_t literals;
+};
+
+const uint32_t kSpillMaxRun = 0xffffffffu;
+
+inline size_t SpillPadded(size_t len) {
+  return (len + 7) & ~static_cast<size_t>(7);
+}
+
+inline const char* SpillDir() {
+  const char *dir = getenv("BISMARCK_SPILL_DIR");
+  if (dir == NULL || dir[0] == '\0') return NULL;
+  return dir;
+}
+
+inline void SpillInit(SpillFile *f) {
+  f->fd = -1;
+  f->chunks = 0;
+  f->bytes = 0;
+  f->raw = 0;
+}
+
+namespace {
+
+/*! The count of open spill files of this library, internal like
+ * MemoryLibraryAccount
+ */
+inline int* SpillOpenCount() {
+  static int count = 0;
+  return &count;
+}
+
+} // namespace
+
+inline int SpillOpenFiles() {
+  return __sync_add_and_fetch(SpillOpenCount(), 0);
+}
+
+inline bool SpillOpen(SpillFile *f) {
+  SpillInit(f);
+  const char *dir = SpillDir();
+  if (dir == NULL) return false;
+  char path[4096];
+  int n = snprintf(path, sizeof(path), "%s/bismarck-spill-XXXXXX", dir);
+  if (n < 0 || static_cast<size_t>(n) >= sizeof(path)) return false;
+  if (__sync_add_and_fetch(SpillOpenCount(), 1) > kSpillMaxOpen) {
+    __sync_sub_and_fetch(SpillOpenCount(), 1);
+    return false;
+  }
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    __sync_sub_and_fetch(SpillOpenCount(), 1);
+    return false;
+  }
+  unlink(path);
+  f->fd = fd;
+  return true;
+}
+
+/*! The next run of w[i..n), advances i
+ */
+inline SpillRun SpillNextRun(const uint64_t *w, size_t n, size_t *i) {
+  SpillRun r = {0, 0};
+  while (*i < n && w[*i] == 0 && r.zeros < kSpillMaxRun) {
+    ++*i;
+    ++r.zeros;
+  }
+  while (*i < n && w[*i] != 0 && r.literals < kSpillMaxRun) {
+    ++*i;
+    ++r.literals;
+  }
+  return r;
+}
+
+/*! The size of n words encoded with SPILL_ZERO_RUNS
+ */
+inline size_t SpillZeroRunsSize(const uint64_t *w, size_t n) {
+  size_t size = 0, i = 0;
+  while (i < n) {
+    SpillRun r = SpillNextRun(w, n, &i);
+    size += sizeof(SpillRun) + r.literals * sizeof(uint64_t);
+  }
+  return size;
+}
+
+/*! Buffers small writes into large sequential pwrites
+ */
+struct SpillWriter {
+  int fd;
+  uint64_t offset;
+  size_t n;
+  bool ok;
+  char buf[1 << 16];
+};
+
+inline bool SpillWriteAll(int fd, const char *p, size_t len, uint64_t offset) {
+  while (len > 0) {
+    ssize_t w = pwrite(fd, p, len, offset);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return false;
+    p += w;
+    len -= w;
+    offset += w;
+  }
+  return true;
+}
+
+inline void SpillWriterFlush(SpillWriter *w) {
+  if (w->ok && w->n > 0) {
+    w->ok = SpillWriteAll(w->fd, w->buf, w->n, w->offset);
+  }
+  w->offset += w->n;
+  w->n = 0;
+}
+
+inline void SpillWriterPut(SpillWriter *w, const char *p, size_t len) {
+  if (w->n + len > sizeof(w->buf)) SpillWriterFlush(w);
+  if (len > sizeof(w->buf)) {
+    if (w->ok) w->ok = SpillWriteAll(w->fd, p, len, w->offset);
+    w->offset += len;
+    return;
+  }
+  memcpy(w->buf + w->n, p, len);
+  w->n += len;
+}
+
+inline bool SpillAppend(SpillFile *f, const char *data, size_t len,
+                        bool compress) {
+  if (f->fd < 0) return false;
+  SpillChunkHeader h = {len, len, SPILL_RAW, 0};
+  const uint64_t *words = reinterpret_cast<const uint64_t*>(data);
+  size_t nwords = len / sizeof(uint64_t);
+  if (compress && len % sizeof(uint64_t) == 0) {
+    size_t encoded = SpillZeroRunsSize(words, nwords);
+    if (encoded < len) {
+      h.len = encoded;
+      h.codec = SPILL_ZERO_RUNS;
+    }
+  }
+
+  // the writer is too large for the stacks of some query threads
+  SpillWriter *w = static_cast<SpillWriter*>(malloc(sizeof(SpillWriter)));
+  if (w == NULL) return false;
+  w->fd = f->fd;
+  w->offset = f->bytes;
+  w->n = 0;
+  w->ok = true;
+  SpillWriterPut(w, reinterpret_cast<const char*>(&h), sizeof(h));
+  if (h.codec == SPILL_RAW) {
+    SpillWriterPut(w, data, len);
+  } else {
+    size_t i = 0;
+    while (i < nwords) {
+      size_t start = i;
+      SpillRun r = SpillNextRun(words, nwords, &i);
+      SpillWriterPut(w, reinterpret_cast<const char*>(&r), sizeof(r));
+      SpillWriterPut(w, reinterpret_cast<const char*>(words + start + r.zeros),
+                     r.literals * sizeof(uint64_t));
+    }
+  }
+  const char zeros[8] = {0};
+  SpillWriterPut(w, zeros, SpillPadded(h.len) - h.len);
+  SpillWriterFlush(w);
+  bool ok = w->ok;
+  free(w);
+
+  // a failed chunk is not counted, the next one is written over it
+  if (!ok) return false;
+  f->chunks++;
+  f->bytes += sizeof(h) + SpillPadded(h.len);
+  f->raw += len;
+  return true;
+}
+
+/*! Decodes the body of a SPILL_ZERO_RUNS chunk of raw bytes into out
+ */
+inline void SpillDecodeZeroRuns(const char *body, size_t raw, char *out) {
+  char *end = out + raw;
+  while (out < end) {
+    SpillRun r;
+    memcpy(&r, body, sizeof(r));
+    body += sizeof(r);
+    size_t zeros = r.zeros * sizeof(uint64_t);
+    size_t literals = r.literals * sizeof(uint64_t);
+    memset(out, 0, zeros);
+    memcpy(out + zeros, body, literals);
+    body += literals;
+    out += zeros + literals;
+  }
+}
+
+inline bool SpillRead(const SpillFile &f, char *out) {
+  if (f.fd < 0) return f.bytes == 0;
+  if (f.bytes == 0) return true;
+  void *map = mmap(NULL, f.bytes, PROT_READ, MAP_PRIVATE, f.fd, 0);
+  if (map == MAP_FAILED) return false;
+  madvise(map, f.bytes, MADV_SEQUENTIAL);
+  const char *p = static_cast<const char*>(map);
+  for (uint32_t c = 0; c < f.chunks; c++) {
+    SpillChunkHeader h;
+    memcpy(&h, p, sizeof(h));
+    p += sizeof(h);
+    if (h.codec == SPILL_ZERO_RUNS) {
+      SpillDecodeZeroRuns(p, h.raw, out);
+    } else {
+      memcpy(out, p, h.raw);
+    }
+    p += SpillPadded(h.len);
+    out += h.raw;
+  }
+  munmap(map, f.bytes);
+  return true;
+}
+
+inline void SpillClose(SpillFile *f) {
+  if (f->fd >= 0) {
+    close(f->fd);
+    __sync_sub_and_fetch(SpillOpenCount(), 1);
+  }
+  SpillInit(f);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,87 @@
+
+#ifndef HAZY_BISMARCK_SPILL_H
+#define HAZY_BISMARCK_SPILL_H
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief How a chunk is stored in a spill file
+ */
+enum SpillCodec {
+  SPILL_RAW = 0,        //!< as is
+  SPILL_ZERO_RUNS = 1   //!< runs of zero words (8 bytes) are counted
+};
+
+/*! \brief A local scratch file of sealed chunks
+ *
+ * Aggregates that buffer their input can seal a full buffer into a chunk
+ * and append it to a spill file instead of growing the buffer. Chunks are
+ * written sequentially, and read back in order through mmap once, at
+ * Serialize or Final. Spilling is enabled by setting BISMARCK_SPILL_DIR to
+ * a local directory.
+ *
+ * The file is unlinked as soon as it is created, so its space is returned
+ * when the descriptor is closed. Only Serialize and Final close it: Impala
+ * has no teardown hook for aggregates, so the descriptor of a cancelled
+ * query, and the disk space behind it, is held until the process exits.
+ * At most kSpillMaxOpen files are open in a library, aggregates keep their
+ * buffers in memory beyond that, which bounds what cancelled queries hold.
+ * A spill file lives inside a UDA state, so states holding one must be
+ * serialized before they are shipped to another node.
+ */
+struct SpillFile {
+  int32_t fd;       //!< -1 when closed
+  uint32_t chunks;
+  uint64_t bytes;   //!< in the file, chunk headers included
+  uint64_t raw;     //!< appended, before encoding
+};
+
+/*! \brief The most spill files open at once in a library
+ */
+const int kSpillMaxOpen = 64;
+
+/*! \brief The directory to spill to, NULL if spilling is disabled
+ */
+const char* SpillDir();
+
+/*! \brief Marks f as closed, before its first SpillOpen
+ */
+void SpillInit(SpillFile *f);
+
+/*! \brief The spill files open in this library
+ */
+int SpillOpenFiles();
+
+/*! \brief Creates the scratch file of f in SpillDir()
+ *
+ * \return false if spilling is disabled, kSpillMaxOpen files are open or
+ * the file cannot be created
+ */
+bool SpillOpen(SpillFile *f);
+
+/*! \brief Appends a chunk of len bytes
+ *
+ * With compress the chunk is stored with SPILL_ZERO_RUNS if that makes it
+ * smaller, which pays for sparse data. A chunk that fails to write is
+ * dropped, the chunks before it are kept.
+ * \return false if the chunk could not be written
+ */
+bool SpillAppend(SpillFile *f, const char *data, size_t len, bool compress);
+
+/*! \brief Decodes all chunks, in order, into out (f.raw bytes)
+ *
+ * The file is mapped and read sequentially.
+ * \return false if the file could not be mapped
+ */
+bool SpillRead(const SpillFile &f, char *out);
+
+/*! \brief Closes the file, which removes it
+ */
+void SpillClose(SpillFile *f);
+
+}
+}
+#endif
@@ -0,0 +1,263 @@
+
+#ifndef HAZY_BISMARCK_STRATA_INL_H
+#define HAZY_BISMARCK_STRATA_INL_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+
+// see for documentation
+#include "strata.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! Header of the state, followed by nslots StrataSlots and nblocks blocks of
+ * k StrataEntries
+ */
+struct StrataHeader {
+  uint64_t nslots; //!< always a power of two
+  uint64_t nused;
+  uint64_t k;
+  uint64_t seed;
+  uint64_t nblocks;
+  uint64_t pad[3];
+};
+
+/*! One stratum; count == 0 marks a free slot
+ */
+struct StrataSlot {
+  uint64_t hash;
+  uint64_t block; //!< index of the reservoir of the stratum
+  uint64_t count; //!< rows in the reservoir, at most k
+  uint64_t pad;
+};
+
+/*! A sampled row, the reservoir is a min-heap on the priority
+ */
+struct StrataEntry {
+  double priority;
+  int64_t id;
+};
+
+inline StrataHeader* StrataHead(const bytea &m) {
+  return reinterpret_cast<StrataHeader*>(m.str);
+}
+
+inline StrataSlot* StrataSlots(const bytea &m) {
+  return reinterpret_cast<StrataSlot*>(m.str + sizeof(StrataHeader));
+}
+
+inline StrataEntry* StrataBlock(const bytea &m, uint64_t block) {
+  StrataHeader *h = StrataHead(m);
+  StrataEntry *e = reinterpret_cast<StrataEntry*>(
+      m.str + sizeof(StrataHeader) + h->nslots * sizeof(StrataSlot));
+  return e + block * h->k;
+}
+
+/*! splitmix64 finalizer
+ */
+inline uint64_t StrataMix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+inline uint64_t StrataHash(const bytea &key) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.len; i++) {
+    h ^= static_cast<unsigned char>(key.str[i]);
+    h *= 1099511628211ULL;
+  }
+  return StrataMix(h);
+}
+
+template <class CTX>
+void StrataAlloc(CTX* ctx, bytea *m, uint64_t nslots, uint64_t nblocks,
+                 uint64_t k, uint64_t seed) {
+  m->len = sizeof(StrataHeader) + nslots * sizeof(StrataSlot) +
+      nblocks * k * sizeof(StrataEntry);
+  m->str = BismarckAllocate<char>(ctx, m->len);
+  memset(m->str, 0, sizeof(StrataHeader) + nslots * sizeof(StrataSlot));
+  StrataHeader *h = StrataHead(*m);
+  h->nslots = nslots;
+  h->nblocks = nblocks;
+  h->k = k;
+  h->seed = seed;
+}
+
+/*! Returns the slot of a stratum, creating it if needed; there must be a
+ * free slot and a free block
+ */
+inline StrataSlot* StrataFind(const bytea &m, uint64_t hash) {
+  StrataHeader *h = StrataHead(m);
+  StrataSlot *slots = StrataSlots(m);
+  uint64_t mask = h->nslots - 1;
+  for (uint64_t i = hash & mask; ; i = (i + 1) & mask) {
+    StrataSlot &s = slots[i];
+    if (s.count == 0) {
+      s.hash = hash;
+      s.block = h->nused++;
+      return &s;
+    }
+    if (s.hash == hash) return &s;
+  }
+}
+
+/*! Re-allocates the state so that it can take one more stratum
+ */
+template <class CTX>
+void StrataReserve(CTX* ctx, bytea *m) {
+  StrataHeader *h = StrataHead(*m);
+  bool full_slots = (h->nused + 1) * 2 > h->nslots;
+  bool full_blocks = h->nused + 1 > h->nblocks;
+  if (!full_slots && !full_blocks) return;
+
+  bytea grown;
+  StrataAlloc(ctx, &grown, full_slots ? 2 * h->nslots : h->nslots,
+              full_blocks ? 2 * h->nblocks : h->nblocks, h->k, h->seed);
+  StrataSlot *slots = StrataSlots(*m);
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    if (slots[i].count == 0) continue;
+    StrataSlot *s = StrataFind(grown, slots[i].hash);
+    s->count = slots[i].count;
+    memcpy(StrataBlock(grown, s->block), StrataBlock(*m, slots[i].block),
+           s->count * sizeof(StrataEntry));
+  }
+  BismarckFree(ctx, m->str);
+  *m = grown;
+}
+
+/*! Offers a row to a reservoir
+ */
+inline void StrataOffer(StrataEntry *heap, uint64_t *count, uint64_t k,
+                        const StrataEntry &e) {
+  uint64_t i;
+  if (*count < k) {
+    // sift up
+    i = (*count)++;
+    while (i > 0 && heap[(i - 1) / 2].priority > e.priority) {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    heap[i] = e;
+    return;
+  }
+  if (e.priority <= heap[0].priority) return;
+  // replace the lowest priority and sift down
+  i = 0;
+  for (;;) {
+    uint64_t c = 2 * i + 1;
+    if (c >= k) break;
+    if (c + 1 < k && heap[c + 1].priority < heap[c].priority) c++;
+    if (heap[c].priority >= e.priority) break;
+    heap[i] = heap[c];
+    i = c;
+  }
+  heap[i] = e;
+}
+
+template <class CTX>
+void StrataAdd(CTX* ctx, bytea *m, uint64_t hash, const StrataEntry &e) {
+  StrataReserve(ctx, m);
+  StrataSlot *s = StrataFind(*m, hash);
+  StrataOffer(StrataBlock(*m, s->block), &s->count, StrataHead(*m)->k, e);
+}
+
+template <class CTX>
+void BismarckStrata<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckStrata<CTX>::Step(CTX* ctx, const bytea &key, int64_t id,
+                               double weight, uint32_t k, uint64_t seed,
+                               bytea *m) {
+  if (m->str == NULL) {
+    StrataAlloc(ctx, m, 64, 32, std::max<uint32_t>(k, 1), seed);
+  }
+  if (!(weight > 0)) return;
+
+  StrataHeader *h = StrataHead(*m);
+  uint64_t hash = StrataHash(key);
+  uint64_t r = StrataMix(hash ^ StrataMix(h->seed ^ static_cast<uint64_t>(id)));
+  // uniform in (0, 1]
+  double u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+  StrataEntry e;
+  e.priority = std::log(u) / weight;
+  e.id = id;
+  StrataAdd(ctx, m, hash, e);
+}
+
+template <class CTX>
+void BismarckStrata<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  StrataHeader *h = StrataHead(src);
+  if (dst->str == NULL) {
+    StrataAlloc(ctx, dst, h->nslots, h->nblocks, h->k, h->seed);
+  }
+  StrataSlot *slots = StrataSlots(src);
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    if (slots[i].count == 0) continue;
+    StrataEntry *block = StrataBlock(src, slots[i].block);
+    for (uint64_t j = 0; j < slots[i].count; j++) {
+      StrataAdd(ctx, dst, slots[i].hash, block[j]);
+    }
+  }
+}
+
+/*! A row of the sample
+ */
+struct StrataRow {
+  uint64_t hash;
+  uint64_t id;
+
+  bool operator<(const StrataRow &o) const {
+    return hash < o.hash || (hash == o.hash && id < o.id);
+  }
+};
+
+template <class CTX>
+bytea BismarckStrata<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea sample = {NULL, 0};
+  if (m.str == NULL) return sample;
+
+  StrataHeader *h = StrataHead(m);
+  StrataSlot *slots = StrataSlots(m);
+  uint64_t nrows = 0;
+  for (uint64_t i = 0; i < h->nslots; i++) nrows += slots[i].count;
+  if (nrows == 0) return sample;
+
+  StrataRow *rows = BismarckAllocate<StrataRow>(ctx, nrows);
+  uint64_t r = 0;
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    StrataEntry *block = StrataBlock(m, slots[i].block);
+    for (uint64_t j = 0; j < slots[i].count; j++) {
+      rows[r].hash = slots[i].hash;
+      rows[r].id = static_cast<uint64_t>(block[j].id);
+      r++;
+    }
+  }
+  std::sort(rows, rows + nrows);
+
+  sample.str = reinterpret_cast<char*>(rows);
+  sample.len = nrows * sizeof(StrataRow);
+  return sample;
+}
+
+inline bool StrataContains(const bytea &sample, const bytea &key,
+                           int64_t id) {
+  const StrataRow *rows = reinterpret_cast<const StrataRow*>(sample.str);
+  size_t nrows = sample.len / sizeof(StrataRow);
+  StrataRow row = {StrataHash(key), static_cast<uint64_t>(id)};
+  return std::binary_search(rows, rows + nrows, row);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,78 @@
+
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "strata"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "strata-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void StrataInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void StrataUpdate(FunctionContext* ctx, const StringVal &key,
+                  const BigIntVal &id, const DoubleVal &weight,
+                  const IntVal &k, const BigIntVal &seed, StringVal *st) {
+  if (key.is_null || id.is_null || k.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckStrata<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckStrata<FunctionContext>::Step(ctx, StringValToBytea(key), id.val,
+                                        weight.is_null ? 1.0 : weight.val,
+                                        k.val, seed.is_null ? 0 : seed.val,
+                                        &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void StrataMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckStrata<FunctionContext>::Merge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal StrataFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea sample =
+      BismarckStrata<FunctionContext>::Final(ctx, StringValToBytea(st));
+  if (sample.str == NULL) return StringVal::null();
+  return BismarckResult(sample.str, sample.len);
+}
+
+BooleanVal StrataContains(FunctionContext* ctx, const StringVal &sample,
+                          const StringVal &key, const BigIntVal &id) {
+  if (sample.is_null || key.is_null || id.is_null) return BooleanVal(false);
+  return BooleanVal(StrataContains(StringValToBytea(sample),
+                                   StringValToBytea(key), id.val));
+}
+
+BigIntVal StrataSize(FunctionContext* ctx, const StringVal &sample) {
+  if (sample.is_null) return BigIntVal(0);
+  return BigIntVal(sample.len / sizeof(StrataRow));
+}
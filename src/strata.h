@@ -0,0 +1,70 @@
+
+#ifndef HAZY_BISMARCK_STRATA_H
+#define HAZY_BISMARCK_STRATA_H
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Draws up to k rows per stratum in one aggregate
+ *
+ * Every stratum has its own bounded reservoir. Rows are sampled with
+ * probability proportional to their weight without replacement
+ * (Efraimidis-Spirakis): a row gets the priority log(u) / weight and each
+ * reservoir keeps the k highest priorities, so two reservoirs merge exactly
+ * by keeping the k highest of both. The uniform u is a hash of the stratum,
+ * the row id and a seed, so the sample does not depend on how the rows are
+ * split between fragments.
+ *
+ * Strata are identified by a 64 bit hash of their key. The UDA state is one
+ * flat block (an open-addressing hash table of strata followed by k entries
+ * per stratum), so it can be shipped between nodes as is.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckStrata {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Offers a row to the reservoir of its stratum
+   *
+   * \param ctx the context to allocate memory with
+   * \param key the stratum of the row
+   * \param id the id of the row, what the sample is made of
+   * \param weight rows with a weight <= 0 are never sampled
+   * \param k the size of the reservoirs, fixed by the first row
+   * \param seed changes the sample drawn
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &key, int64_t id, double weight,
+                   uint32_t k, uint64_t seed, bytea *m);
+
+  /*! \brief Merges the reservoirs of src into dst, dst may be re-allocated
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Returns the sample
+   *
+   * The sample is an array of (stratum hash, row id) uint64 pairs, sorted,
+   * see StrataContains.
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief The 64 bit hash strata are identified by
+ */
+inline uint64_t StrataHash(const bytea &key);
+
+/*! \brief Returns true if the row is in a sample returned by Final
+ */
+inline bool StrataContains(const bytea &sample, const bytea &key,
+                           int64_t id);
+
+}
+}
+#endif
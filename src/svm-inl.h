@@ -3,6 +3,7 @@
 #define IMPALA_BISMARCK_SVM_INL_H
 
 #include "linalg-inl.h"
+#include "igd-inl.h"
 
 // see for documentation
 #include "svm.h"
@@ -18,15 +19,13 @@ double BismarckSVM<CTX>::Loss(const bytea &v, bool y,
   CoerceBytea(model, modelp, model_len);
   CoerceBytea(v, vp, v_len);
   double pred = hazy::simple_dot(modelp, vp, model_len);
-  double lbl = y ? 1 : -1;
-  pred *= lbl;
-  double loss = std::max(1 - pred, static_cast<double>(0.0));
-  return loss;
+  return HingeLoss::Loss(pred, y ? 1 : -1);
 }
 
 template <class CTX>
 void BismarckSVM<CTX>::Step(CTX* ctx, bytea val, bool y, 
-                            bytea *input, double step_size, double mu) { 
+                            bytea *input, double step_size, double mu,
+                            double weight) { 
   size_t len_val, model_len;
   double *v, *model;
   CoerceBytea(val, v, len_val);
@@ -43,15 +42,9 @@ void BismarckSVM<CTX>::Step(CTX* ctx, bytea val, bool y,
   }
 
   CoerceBytea(*input, model, model_len);
-  double lbl = y ? 1 : -1;
-  // take the SVM IGD Step
-  double pred = hazy::simple_dot(model, v, model_len);
-  pred *= lbl;
-
-  if (pred < 1)
-    // hinge active
-    hazy::simple_scale_add(model, v, step_size * lbl, model_len);
-  hazy::simple_scale(model, 1 - (step_size * mu), model_len);
+  // take the SVM IGD Step: hinge loss, L2 applied to the whole model
+  IGDKernel<HingeLoss, L2Reg, ConstantStep, DenseRep>(
+      model, NULL, model_len, val, y ? 1 : -1, step_size * weight, mu);
 }
 
 template <class CTX>
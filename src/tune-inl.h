@@ -0,0 +1,172 @@
+
+#ifndef HAZY_BISMARCK_TUNE_INL_H
+#define HAZY_BISMARCK_TUNE_INL_H
+
+#include <unistd.h>
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+
+// the kernels being tuned
+#include "linalg-inl.h"
+
+// see for documentation
+#include "tune.h"
+
+namespace hazy {
+
+inline HostInfo TuneHostInfo() {
+  HostInfo h;
+  long l1 = -1, l2 = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  h.l1_bytes = l1 > 0 ? l1 : 32 * 1024;
+  h.l2_bytes = l2 > 0 ? l2 : 256 * 1024;
+  h.vector_bytes = 16;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  if (__builtin_cpu_supports("avx512f")) {
+    h.vector_bytes = 64;
+  } else if (__builtin_cpu_supports("avx")) {
+    h.vector_bytes = 32;
+  }
+#endif
+  return h;
+}
+
+inline double TuneNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*! Best of a few timings of reps calls to the dot product kernel
+ */
+template <size_t U>
+double TuneTimeDot(const double *x, const double *y, size_t len, int reps) {
+  double best = 1e300;
+  volatile double sink = 0;
+  for (int trial = 0; trial < 3; trial++) {
+    double start = TuneNow();
+    for (int r = 0; r < reps; r++) {
+      sink = sink + unrolled_dot<U>(x, y, len);
+    }
+    best = std::min(best, TuneNow() - start);
+  }
+  return best;
+}
+
+template <size_t U>
+double TuneTimeAxpy(double *x, const double *y, size_t len, int reps) {
+  double best = 1e300;
+  for (int trial = 0; trial < 3; trial++) {
+    double start = TuneNow();
+    for (int r = 0; r < reps; r++) {
+      // alternate signs so that x stays bounded
+      double a = (r & 1) ? -1e-3 : 1e-3;
+      unrolled_scale_add<U>(x, y, a, len);
+    }
+    best = std::min(best, TuneNow() - start);
+  }
+  return best;
+}
+
+inline KernelTuning TuneDefault(const HostInfo &host) {
+  KernelTuning t;
+  t.host = host;
+  t.dot_unroll = 1;
+  t.axpy_unroll = 1;
+  return t;
+}
+
+inline KernelTuning TuneRun(const HostInfo &host) {
+  KernelTuning t;
+  t.host = host;
+
+  // two operands that together take half of L1
+  size_t len = std::max<size_t>(host.l1_bytes / (4 * sizeof(double)), 64);
+  double *x = new double[len];
+  double *y = new double[len];
+  for (size_t i = 0; i < len; i++) {
+    x[i] = 1.0 / (i + 1);
+    y[i] = 1.0 - x[i];
+  }
+  const int reps = 200;
+
+  double d1 = TuneTimeDot<1>(x, y, len, reps);
+  double d4 = TuneTimeDot<4>(x, y, len, reps);
+  double d8 = TuneTimeDot<8>(x, y, len, reps);
+  t.dot_unroll = (d1 <= d4 && d1 <= d8) ? 1 : (d4 <= d8 ? 4 : 8);
+
+  double a1 = TuneTimeAxpy<1>(x, y, len, reps);
+  double a4 = TuneTimeAxpy<4>(x, y, len, reps);
+  double a8 = TuneTimeAxpy<8>(x, y, len, reps);
+  t.axpy_unroll = (a1 <= a4 && a1 <= a8) ? 1 : (a4 <= a8 ? 4 : 8);
+
+  delete [] x;
+  delete [] y;
+  return t;
+}
+
+inline bool TuneLoad(const char *path, const HostInfo &host, KernelTuning *t) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+  KernelTuning read;
+  int n = fscanf(f, "l1 %u l2 %u vector %u dot_unroll %u axpy_unroll %u",
+                 &read.host.l1_bytes, &read.host.l2_bytes,
+                 &read.host.vector_bytes, &read.dot_unroll,
+                 &read.axpy_unroll);
+  fclose(f);
+  if (n != 5) return false;
+  if (read.host.l1_bytes != host.l1_bytes ||
+      read.host.l2_bytes != host.l2_bytes ||
+      read.host.vector_bytes != host.vector_bytes) return false;
+  *t = read;
+  return true;
+}
+
+inline bool TuneSave(const char *path, const KernelTuning &t) {
+  // written next to the file and renamed over it, so that a process
+  // loading it concurrently reads either the old or the new parameters
+  char tmp[4096];
+  int n = snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long) getpid());
+  if (n < 0 || (size_t) n >= sizeof(tmp)) return false;
+  FILE *f = fopen(tmp, "w");
+  if (f == NULL) return false;
+  fprintf(f, "l1 %u\nl2 %u\nvector %u\ndot_unroll %u\naxpy_unroll %u\n",
+          t.host.l1_bytes, t.host.l2_bytes, t.host.vector_bytes,
+          t.dot_unroll, t.axpy_unroll);
+  if (fclose(f) != 0 || rename(tmp, path) != 0) {
+    unlink(tmp);
+    return false;
+  }
+  return true;
+}
+
+inline KernelTuning TuneInit() {
+  HostInfo host = TuneHostInfo();
+  KernelTuning t;
+  const char *path = getenv("HAZY_TUNE_FILE");
+  if (path == NULL) return TuneDefault(host);
+  if (TuneLoad(path, host, &t)) return t;
+  t = TuneRun(host);
+  // failing to write the cache only costs a re-tune in the next process
+  TuneSave(path, t);
+  return t;
+}
+
+namespace {
+
+inline const KernelTuning& Tuning() {
+  static const KernelTuning t = TuneInit();
+  return t;
+}
+
+} // namespace
+
+} // namespace hazy
+#endif
@@ -0,0 +1,74 @@
+
+#ifndef HAZY_BISMARCK_TUNE_H
+#define HAZY_BISMARCK_TUNE_H
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace hazy {
+
+/*! \brief What the kernel parameters were tuned for
+ *
+ * Cached parameters are only reused on a host with the same description.
+ */
+struct HostInfo {
+  uint32_t l1_bytes;      //!< L1 data cache size
+  uint32_t l2_bytes;      //!< L2 cache size
+  uint32_t vector_bytes;  //!< widest SIMD register (16, 32 or 64)
+};
+
+/*! \brief Kernel parameters chosen for the host
+ */
+struct KernelTuning {
+  HostInfo host;
+  uint32_t dot_unroll;   //!< accumulators of the dot product, 1 is the plain loop
+  uint32_t axpy_unroll;  //!< unroll factor of scale-and-add, 1 is the plain loop
+};
+
+/*! \brief Describes the host this process runs on
+ */
+inline HostInfo TuneHostInfo();
+
+/*! \brief The parameters used when the kernels are not tuned
+ *
+ * The plain loops, which sum in the order the kernels always did, so that
+ * untuned models keep their results.
+ */
+inline KernelTuning TuneDefault(const HostInfo &host);
+
+/*! \brief Microbenchmarks the candidate kernels on vectors that fit in L1
+ * and returns the fastest configuration
+ *
+ * The choice depends on timings, so it may differ from run to run.
+ */
+inline KernelTuning TuneRun(const HostInfo &host);
+
+/*! \brief Reads the parameters cached in a file
+ * \return false if the file is missing, malformed or tuned for another host
+ */
+inline bool TuneLoad(const char *path, const HostInfo &host, KernelTuning *t);
+
+/*! \brief Writes the parameters to a file, returns false on failure
+ *
+ * The file is replaced at once by a rename, never seen half written.
+ */
+inline bool TuneSave(const char *path, const KernelTuning &t);
+
+namespace {
+
+/*! \brief The parameters the kernels dispatch on
+ *
+ * Computed once per library, the first time a kernel needs them; like
+ * bismarck::MemoryLibraryAccount, it has internal linkage. They are
+ * the TuneDefault plain loops, so that every process sums in the same
+ * order and gets the same results. If the environment variable
+ * HAZY_TUNE_FILE is set, the parameters are read from that file, or tuned
+ * by TuneRun and written to it when it does not match this host; all the
+ * processes sharing the file then use the parameters of the first one.
+ */
+inline const KernelTuning& Tuning();
+
+} // namespace
+
+} // namespace hazy
+#endif
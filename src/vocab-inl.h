@@ -0,0 +1,307 @@
+
+#ifndef HAZY_BISMARCK_VOCAB_INL_H
+#define HAZY_BISMARCK_VOCAB_INL_H
+
+#include <stdint.h>
+#include <cctype>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+// see for documentation
+#include "vocab.h"
+
+namespace hazy {
+namespace bismarck {
+
+/*! longest token kept, in bytes */
+const size_t kVocabMaxToken = 64;
+
+/*! One entry of the token frequency hash table, count == 0 marks a free slot
+ */
+struct VocabSlot {
+  uint64_t hash;
+  uint64_t count;
+  uint32_t offset; //!< start of the token in the character area
+  uint32_t len;
+};
+
+/*! Header of the state, followed by nslots VocabSlots and arena_cap bytes of
+ * token characters
+ */
+struct VocabHeader {
+  uint64_t nslots; //!< always a power of two
+  uint64_t nused;
+  uint64_t arena_used;
+  uint64_t arena_cap;
+  uint64_t min_count;
+  uint64_t pad[3];
+};
+
+inline VocabHeader* VocabHead(const bytea &m) {
+  return reinterpret_cast<VocabHeader*>(m.str);
+}
+
+inline VocabSlot* VocabSlots(const bytea &m) {
+  return reinterpret_cast<VocabSlot*>(m.str + sizeof(VocabHeader));
+}
+
+inline char* VocabArena(const bytea &m) {
+  return m.str + sizeof(VocabHeader) + VocabHead(m)->nslots * sizeof(VocabSlot);
+}
+
+/*! FNV-1a hash of a token
+ */
+inline uint64_t VocabHash(const char *tok, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= static_cast<unsigned char>(tok[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/*! Finds the next token of s starting at *pos and copies it, lower cased,
+ * into buf (of kVocabMaxToken bytes). Returns false when s is exhausted.
+ */
+inline bool VocabNextToken(const char *s, size_t len, size_t *pos,
+                           char *buf, size_t *tok_len) {
+  size_t i = *pos;
+  while (i < len) {
+    // skip separators
+    while (i < len && !isalnum(static_cast<unsigned char>(s[i]))) i++;
+    size_t start = i;
+    while (i < len && isalnum(static_cast<unsigned char>(s[i]))) i++;
+    if (i == start) break;
+    if (i - start > kVocabMaxToken) continue;
+    for (size_t k = start; k < i; k++)
+      buf[k - start] = tolower(static_cast<unsigned char>(s[k]));
+    *tok_len = i - start;
+    *pos = i;
+    return true;
+  }
+  *pos = len;
+  return false;
+}
+
+template <class CTX>
+void VocabAlloc(CTX* ctx, bytea *m, uint64_t nslots, uint64_t arena_cap,
+                uint64_t min_count) {
+  m->len = sizeof(VocabHeader) + nslots * sizeof(VocabSlot) + arena_cap;
+  m->str = BismarckAllocate<char>(ctx, m->len);
+  memset(m->str, 0, sizeof(VocabHeader) + nslots * sizeof(VocabSlot));
+  VocabHeader *h = VocabHead(*m);
+  h->nslots = nslots;
+  h->arena_cap = arena_cap;
+  h->min_count = min_count;
+}
+
+/*! Adds count occurrences of a token, the table must have a free slot and
+ * room for the token characters
+ */
+inline void VocabInsert(const bytea &m, uint64_t hash, const char *tok,
+                        size_t len, uint64_t count) {
+  VocabHeader *h = VocabHead(m);
+  VocabSlot *slots = VocabSlots(m);
+  char *arena = VocabArena(m);
+  uint64_t mask = h->nslots - 1;
+  for (uint64_t i = hash & mask; ; i = (i + 1) & mask) {
+    VocabSlot &s = slots[i];
+    if (s.count == 0) {
+      s.hash = hash;
+      s.count = count;
+      s.offset = h->arena_used;
+      s.len = len;
+      memcpy(arena + h->arena_used, tok, len);
+      h->arena_used += len;
+      h->nused++;
+      return;
+    }
+    if (s.hash == hash && s.len == len &&
+        memcmp(arena + s.offset, tok, len) == 0) {
+      s.count += count;
+      return;
+    }
+  }
+}
+
+/*! Re-allocates the state so that it can take one more token of len bytes
+ */
+template <class CTX>
+void VocabReserve(CTX* ctx, bytea *m, size_t len) {
+  VocabHeader *h = VocabHead(*m);
+  bool full_slots = (h->nused + 1) * 2 > h->nslots;
+  bool full_arena = h->arena_used + len > h->arena_cap;
+  if (!full_slots && !full_arena) return;
+
+  bytea grown;
+  VocabAlloc(ctx, &grown, full_slots ? 2 * h->nslots : h->nslots,
+             std::max(2 * h->arena_cap, h->arena_used + len), h->min_count);
+  VocabSlot *slots = VocabSlots(*m);
+  char *arena = VocabArena(*m);
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    if (slots[i].count == 0) continue;
+    VocabInsert(grown, slots[i].hash, arena + slots[i].offset, slots[i].len,
+                slots[i].count);
+  }
+  BismarckFree(ctx, m->str);
+  *m = grown;
+}
+
+template <class CTX>
+void VocabAdd(CTX* ctx, bytea *m, const char *tok, size_t len,
+              uint64_t count) {
+  VocabReserve(ctx, m, len);
+  VocabInsert(*m, VocabHash(tok, len), tok, len, count);
+}
+
+template <class CTX>
+void BismarckVocab<CTX>::Init(CTX* ctx, bytea *m) {
+  m->str = NULL;
+  m->len = 0;
+}
+
+template <class CTX>
+void BismarckVocab<CTX>::Step(CTX* ctx, const bytea &text,
+                              uint64_t min_count, bytea *m) {
+  if (m->str == NULL) {
+    VocabAlloc(ctx, m, 1024, 8192, min_count);
+  }
+
+  char buf[kVocabMaxToken];
+  size_t pos = 0, len;
+  while (VocabNextToken(text.str, text.len, &pos, buf, &len)) {
+    VocabAdd(ctx, m, buf, len, 1);
+  }
+}
+
+template <class CTX>
+void BismarckVocab<CTX>::Merge(CTX* ctx, const bytea &src, bytea *dst) {
+  if (src.str == NULL) return;
+  VocabHeader *h = VocabHead(src);
+  if (dst->str == NULL) {
+    VocabAlloc(ctx, dst, h->nslots, h->arena_cap, h->min_count);
+  }
+  VocabSlot *slots = VocabSlots(src);
+  char *arena = VocabArena(src);
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    if (slots[i].count == 0) continue;
+    VocabReserve(ctx, dst, slots[i].len);
+    VocabInsert(*dst, slots[i].hash, arena + slots[i].offset, slots[i].len,
+                slots[i].count);
+  }
+}
+
+/*! Orders the slots of a state by their token
+ */
+struct VocabSlotLess {
+  const char *arena;
+  bool operator()(const VocabSlot &a, const VocabSlot &b) const {
+    int c = memcmp(arena + a.offset, arena + b.offset, std::min(a.len, b.len));
+    return c < 0 || (c == 0 && a.len < b.len);
+  }
+};
+
+template <class CTX>
+bytea BismarckVocab<CTX>::Final(CTX* ctx, const bytea &m) {
+  bytea dict = {NULL, 0};
+  if (m.str == NULL) return dict;
+
+  VocabHeader *h = VocabHead(m);
+  VocabSlot *slots = VocabSlots(m);
+  std::vector<VocabSlot> kept;
+  size_t bytes = 0;
+  for (uint64_t i = 0; i < h->nslots; i++) {
+    if (slots[i].count == 0 || slots[i].count < h->min_count) continue;
+    kept.push_back(slots[i]);
+    bytes += slots[i].len + 1;
+  }
+  if (kept.empty()) return dict;
+
+  VocabSlotLess less = {VocabArena(m)};
+  std::sort(kept.begin(), kept.end(), less);
+
+  dict.len = bytes - 1;
+  dict.str = BismarckAllocate<char>(ctx, bytes);
+  char *out = dict.str;
+  for (size_t i = 0; i < kept.size(); i++) {
+    if (i != 0) *out++ = ' ';
+    memcpy(out, less.arena + kept[i].offset, kept[i].len);
+    out += kept[i].len;
+  }
+  return dict;
+}
+
+template <class CTX>
+void VocabIndexInit(CTX* ctx, const bytea &dict, VocabIndex *idx) {
+  idx->dict = dict.str;
+  idx->size = 0;
+  if (dict.len > 0) {
+    idx->size = 1 + std::count(dict.str, dict.str + dict.len, ' ');
+  }
+  idx->offsets = BismarckAllocate<uint32_t>(ctx, idx->size + 1);
+
+  size_t k = 0;
+  if (dict.len > 0) idx->offsets[k++] = 0;
+  for (size_t i = 0; i < dict.len; i++) {
+    if (dict.str[i] == ' ') idx->offsets[k++] = i + 1;
+  }
+  // as if the dictionary ended with a separator
+  idx->offsets[k] = dict.len + 1;
+}
+
+inline int32_t VocabLookup(const VocabIndex &idx, const char *tok,
+                           size_t len) {
+  size_t lo = 0, hi = idx.size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const char *cand = idx.dict + idx.offsets[mid];
+    size_t cand_len = idx.offsets[mid + 1] - idx.offsets[mid] - 1;
+    int c = memcmp(cand, tok, std::min(cand_len, len));
+    if (c == 0 && cand_len == len) return mid;
+    if (c < 0 || (c == 0 && cand_len < len))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
+
+template <class CTX>
+void VocabTokenize(CTX* ctx, const VocabIndex &idx, const bytea &text,
+                   bytea *words, bytea *counts) {
+  std::vector<int32_t> ids;
+  char buf[kVocabMaxToken];
+  size_t pos = 0, len;
+  while (VocabNextToken(text.str, text.len, &pos, buf, &len)) {
+    int32_t id = VocabLookup(idx, buf, len);
+    if (id >= 0) ids.push_back(id);
+  }
+  std::sort(ids.begin(), ids.end());
+  size_t nunique = 0;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (i == 0 || ids[i] != ids[i - 1]) nunique++;
+  }
+
+  // run-length encode the sorted ids
+  int32_t *w = BismarckAllocate<int32_t>(ctx, nunique);
+  int32_t *c = BismarckAllocate<int32_t>(ctx, nunique);
+  size_t k = 0;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (i == 0 || ids[i] != ids[i - 1]) {
+      w[k] = ids[i];
+      c[k] = 0;
+      k++;
+    }
+    c[k - 1]++;
+  }
+  words->str = reinterpret_cast<char*>(w);
+  words->len = nunique * sizeof(int32_t);
+  counts->str = reinterpret_cast<char*>(c);
+  counts->len = nunique * sizeof(int32_t);
+}
+
+} // namespace bismarck
+} // namespace hazy
+#endif
@@ -0,0 +1,271 @@
+
+#include <pthread.h>
+#include <cstdio>
+
+#include <impala_udf/udf.h>
+
+using namespace impala_udf;
+
+#define BISMARCK_MEMORY_ACCOUNT "vocab"
+#include "memory-udf.h"
+
+#include "bismarck.h"
+#include "vocab-inl.h"
+#include "modelcache-inl.h"
+
+using namespace hazy::bismarck;
+
+bytea StringValToBytea(const StringVal &v) {
+  bytea ba;
+  ba.str = (char*) v.ptr;
+  ba.len = v.len;
+  return ba;
+}
+
+void VocabInit(FunctionContext* ctx, StringVal *st) {
+  st->is_null = true;
+}
+
+void VocabUpdate(FunctionContext* ctx, const StringVal &text,
+                 const BigIntVal &min_count, StringVal *st) {
+  if (text.is_null) return;
+  bytea sta = StringValToBytea(*st);
+  if (st->is_null) {
+    BismarckVocab<FunctionContext>::Init(ctx, &sta);
+  }
+  BismarckVocab<FunctionContext>::Step(ctx, StringValToBytea(text),
+                                       min_count.is_null ? 1 : min_count.val,
+                                       &sta);
+  st->ptr = (uint8_t*) sta.str;
+  st->len = sta.len;
+  st->is_null = false;
+}
+
+void VocabMerge(FunctionContext* ctx, const StringVal &src, StringVal *dst) {
+  if (src.is_null) return;
+  if (dst->is_null) {
+    // create a new dst
+    *dst = BismarckStringVal(ctx, src.len);
+    memcpy(dst->ptr, src.ptr, src.len);
+    dst->is_null = false;
+    return;
+  }
+  bytea dsta = StringValToBytea(*dst);
+  BismarckVocab<FunctionContext>::Merge(ctx, StringValToBytea(src), &dsta);
+  dst->ptr = (uint8_t*) dsta.str;
+  dst->len = dsta.len;
+}
+
+StringVal VocabFinalize(FunctionContext* ctx, const StringVal &st) {
+  if (st.is_null) return StringVal::null();
+  BismarckReleaseState(st);
+  bytea dict = BismarckVocab<FunctionContext>::Final(ctx, StringValToBytea(st));
+  if (dict.str == NULL) return StringVal::null();
+  return BismarckResult(dict.str, dict.len);
+}
+
+/*! \brief An index and the number it was built under
+ *
+ * An index may be freed and another built at the same address, the serial
+ * number tells them apart.
+ */
+struct VocabShared {
+  VocabIndex index;
+  uint64_t serial;
+};
+
+static uint64_t vocab_serial = 0;
+
+void* VocabIndexBuild(const bytea &dict) {
+  ProcessContext pc;
+  VocabShared *s = BismarckAllocate<VocabShared>(&pc, 1);
+  VocabIndexInit(&pc, dict, &s->index);
+  s->serial = __sync_add_and_fetch(&vocab_serial, 1);
+  return s;
+}
+
+void VocabIndexDestroy(void *p) {
+  ProcessContext pc;
+  VocabShared *s = reinterpret_cast<VocabShared*>(p);
+  BismarckFree(&pc, s->index.offsets);
+  BismarckFree(&pc, s);
+}
+
+/*! \brief The index a fragment tokenizes with
+ *
+ * A constant dictionary is acquired once, in VocabPrepare. A dictionary
+ * that is not constant is usually the same on every row, e.g. joined from
+ * a one-row table, so the index of the last one is kept and acquired again
+ * only when the bytes of the dictionary change.
+ */
+struct VocabFragment {
+  SharedModel *index;
+  bool constant;
+};
+
+/*! \brief The word ids and counts of the last text tokenized by a thread
+ *
+ * vocabwords and vocabcounts are evaluated one after the other on a row,
+ * so the second finds the text the first tokenized here. The text is kept
+ * to compare against, the index by its serial number. The entries of all
+ * the threads are listed so that the last fragment to close frees them.
+ */
+struct VocabLastDoc {
+  uint64_t serial;
+  bytea text;
+  bytea words;
+  bytea counts;
+  VocabLastDoc *next;
+};
+
+static pthread_mutex_t vocab_docs_lock = PTHREAD_MUTEX_INITIALIZER;
+static VocabLastDoc *vocab_docs = NULL;
+static uint32_t vocab_fragments = 0;
+// bumped when the entries are freed, a thread whose entry is of an older
+// generation drops its pointer without touching the entry
+static uint64_t vocab_generation = 0;
+
+static __thread VocabLastDoc *vocab_last = NULL;
+static __thread uint64_t vocab_last_generation = 0;
+
+static void VocabDocClear(VocabLastDoc *doc) {
+  ProcessContext pc;
+  BismarckFree(&pc, doc->text.str);
+  BismarckFree(&pc, doc->words.str);
+  BismarckFree(&pc, doc->counts.str);
+  doc->text.str = doc->words.str = doc->counts.str = NULL;
+}
+
+/*! \brief Frees the entries of all the threads once no fragment is open
+ */
+static void VocabFragmentClosed() {
+  ProcessContext pc;
+  pthread_mutex_lock(&vocab_docs_lock);
+  if (--vocab_fragments == 0) {
+    while (vocab_docs != NULL) {
+      VocabLastDoc *doc = vocab_docs;
+      vocab_docs = doc->next;
+      VocabDocClear(doc);
+      BismarckFree(&pc, doc);
+    }
+    vocab_generation++;
+  }
+  pthread_mutex_unlock(&vocab_docs_lock);
+}
+
+/*! \brief Returns the word ids and counts of a text, tokenizing it only
+ * if it is not the last text the thread tokenized with the same index
+ */
+static const VocabLastDoc* VocabDocument(const VocabShared &s,
+                                         const StringVal &text) {
+  // the generation only changes while no fragment is open, so it is stable
+  // while this one runs
+  if (vocab_last_generation != vocab_generation) vocab_last = NULL;
+  if (vocab_last != NULL && vocab_last->serial == s.serial &&
+      vocab_last->text.len == (size_t) text.len &&
+      memcmp(vocab_last->text.str, text.ptr, text.len) == 0) {
+    return vocab_last;
+  }
+  ProcessContext pc;
+  if (vocab_last == NULL) {
+    vocab_last = BismarckAllocate<VocabLastDoc>(&pc, 1);
+    pthread_mutex_lock(&vocab_docs_lock);
+    vocab_last->next = vocab_docs;
+    vocab_docs = vocab_last;
+    vocab_last_generation = vocab_generation;
+    pthread_mutex_unlock(&vocab_docs_lock);
+  } else {
+    VocabDocClear(vocab_last);
+  }
+  vocab_last->serial = s.serial;
+  vocab_last->text.len = text.len;
+  vocab_last->text.str = BismarckAllocate<char>(&pc, text.len);
+  memcpy(vocab_last->text.str, text.ptr, text.len);
+  VocabTokenize(&pc, s.index, StringValToBytea(text), &vocab_last->words,
+                &vocab_last->counts);
+  return vocab_last;
+}
+
+/*! \brief Acquires the index of a constant dictionary once per fragment
+ *
+ * The index is shared by all the fragments of the process that use the
+ * same dictionary; the fragment keeps its reference in the function state.
+ */
+void VocabPrepare(FunctionContext* ctx,
+                  FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::FRAGMENT_LOCAL) return;
+  ProcessContext pc;
+  VocabFragment *f = BismarckAllocate<VocabFragment>(&pc, 1);
+  f->index = NULL;
+  f->constant = false;
+  if (ctx->IsArgConstant(0)) {
+    StringVal *dict = reinterpret_cast<StringVal*>(ctx->GetConstantArg(0));
+    if (dict != NULL && !dict->is_null) {
+      f->index = ModelCacheAcquire(StringValToBytea(*dict), VocabIndexBuild,
+                                   VocabIndexDestroy);
+      f->constant = true;
+    }
+  }
+  ctx->SetFunctionState(FunctionContext::FRAGMENT_LOCAL, f);
+  pthread_mutex_lock(&vocab_docs_lock);
+  vocab_fragments++;
+  pthread_mutex_unlock(&vocab_docs_lock);
+}
+
+/*! \brief Returns the index of the dictionary, acquiring it again if the
+ * dictionary is not constant and changed since the last row
+ */
+static const VocabShared* GetVocabIndex(FunctionContext* ctx,
+                                        const StringVal &dict) {
+  VocabFragment *f = reinterpret_cast<VocabFragment*>(
+      ctx->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
+  if (!f->constant &&
+      (f->index == NULL || f->index->content.len != (size_t) dict.len ||
+       memcmp(f->index->content.str, dict.ptr, dict.len) != 0)) {
+    ModelCacheRelease(f->index);
+    f->index = ModelCacheAcquire(StringValToBytea(dict), VocabIndexBuild,
+                                 VocabIndexDestroy);
+  }
+  return reinterpret_cast<VocabShared*>(f->index->decoded);
+}
+
+void VocabClose(FunctionContext* ctx,
+                FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::FRAGMENT_LOCAL) return;
+  VocabFragment *f = reinterpret_cast<VocabFragment*>(
+      ctx->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
+  if (f == NULL) return;
+  ProcessContext pc;
+  ModelCacheRelease(f->index);
+  BismarckFree(&pc, f);
+  ctx->SetFunctionState(FunctionContext::FRAGMENT_LOCAL, NULL);
+  VocabFragmentClosed();
+}
+
+/*! \brief Copies the words or the counts of a text into the result
+ */
+static StringVal VocabArray(FunctionContext* ctx, const StringVal &dict,
+                            const StringVal &text, bool words) {
+  const VocabLastDoc *doc = VocabDocument(*GetVocabIndex(ctx, dict), text);
+  const bytea &a = words ? doc->words : doc->counts;
+  StringVal r(ctx, a.len);
+  memcpy(r.ptr, a.str, a.len);
+  return r;
+}
+
+StringVal VocabWords(FunctionContext* ctx, const StringVal &dict,
+                     const StringVal &text) {
+  if (dict.is_null || text.is_null) return StringVal::null();
+  return VocabArray(ctx, dict, text, true);
+}
+
+StringVal VocabCounts(FunctionContext* ctx, const StringVal &dict,
+                      const StringVal &text) {
+  if (dict.is_null || text.is_null) return StringVal::null();
+  return VocabArray(ctx, dict, text, false);
+}
+
+BigIntVal VocabSize(FunctionContext* ctx, const StringVal &dict) {
+  if (dict.is_null) return BigIntVal::null();
+  return BigIntVal(GetVocabIndex(ctx, dict)->index.size);
+}
@@ -0,0 +1,83 @@
+
+#ifndef HAZY_BISMARCK_VOCAB_H
+#define HAZY_BISMARCK_VOCAB_H
+
+namespace hazy {
+namespace bismarck {
+
+/*! \brief Builds the vocabulary of a text corpus
+ *
+ * Tokens are maximal runs of ASCII letters and digits, lower cased; longer
+ * tokens than kVocabMaxToken are dropped. The UDA state is one flat block
+ * (an open-addressing hash table of token frequencies followed by the token
+ * characters), so it can be shipped between nodes as is.
+ *
+ * The final dictionary is the list of kept tokens in byte order separated by
+ * single spaces; the word id of a token is its position in that list. This
+ * is the word id LDA expects in its words arrays.
+ * \tparam Context the bismarck context type, used for memory allocation,
+ * there should exist T* BismarckAllocate<T>(Context *c, size_t len) and
+ * void BismarckFree(Context *c, T* p).
+ */
+template <class Context>
+class BismarckVocab {
+ public:
+  /*! \brief Initializes an empty state
+   *
+   * The memory for the state will be allocated on the first call to Step
+   */
+  static void Init(Context* ctx, bytea *m);
+
+  /*! \brief Counts the tokens of a text
+   *
+   * \param ctx the context to allocate memory with
+   * \param text the text to tokenize
+   * \param min_count tokens seen fewer times are dropped by Final
+   * \param m the current state, may be re-allocated
+   */
+  static void Step(Context* ctx, const bytea &text, uint64_t min_count,
+                   bytea *m);
+
+  /*! \brief Adds the token counts of src to dst, dst may be re-allocated
+   */
+  static void Merge(Context* ctx, const bytea &src, bytea *dst);
+
+  /*! \brief Prunes rare tokens and returns the dictionary
+   */
+  static bytea Final(Context* ctx, const bytea &m);
+};
+
+/*! \brief Positions of the tokens of a dictionary, built once per dictionary
+ *
+ * offsets[i] is the start of token i in the dictionary and offsets[size]
+ * is one past the end of the dictionary.
+ */
+struct VocabIndex {
+  const char *dict;
+  size_t size;
+  uint32_t *offsets;
+};
+
+/*! \brief Builds the index of a dictionary returned by BismarckVocab::Final
+ */
+template <class Context>
+void VocabIndexInit(Context* ctx, const bytea &dict, VocabIndex *idx);
+
+/*! \brief Returns the word id of a token, or -1 if it is not in the index
+ */
+inline int32_t VocabLookup(const VocabIndex &idx, const char *tok,
+                           size_t len);
+
+/*! \brief Turns a text into the unique word-id array and the count array
+ * used by LDA
+ *
+ * Both arrays are int32 arrays sorted by word id; tokens that are not in the
+ * dictionary are skipped.
+ */
+template <class Context>
+void VocabTokenize(Context* ctx, const VocabIndex &idx, const bytea &text,
+                   bytea *words, bytea *counts);
+
+}
+}
+#endif
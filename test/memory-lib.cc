@@ -0,0 +1,36 @@
+/* A library for test-memorylib.cc, which loads two copies of it. Like a UDF
+ * library, it is one translation unit including the bismarck headers.
+ */
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#include "bismarck-common.h"
+
+#include "linalg-inl.h"
+#include "memory-inl.h"
+#include "modelcache-inl.h"
+#include "spill-inl.h"
+
+using namespace hazy;
+
+extern "C" {
+
+void MemoryLibCharge(int64_t bytes) {
+  bismarck::MemoryCharge(bytes);
+}
+
+int64_t MemoryLibCurrent() {
+  return bismarck::MemoryLibraryAccount().current;
+}
+
+/*! The objects a library keeps to itself, in the order of kMemoryLibStatics
+ */
+void MemoryLibStatics(const void **out) {
+  out[0] = &bismarck::MemoryLibraryAccount();
+  out[1] = &Tuning();
+  out[2] = &bismarck::ModelCacheGlobal();
+  out[3] = bismarck::SpillOpenCount();
+}
+
+}
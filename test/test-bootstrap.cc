@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "bootstrap-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckBoot<void*> Boot;
+
+/*! A value in [0, 10), by id
+ */
+double Value(int64_t id) {
+  return (bismarck::BootMix(id) >> 11) * (10.0 / 9007199254740992.0);
+}
+
+/*! The weights are Poisson(1) and only depend on the row and the seed
+ */
+int TEST_Bootweights() {
+  const int n = 200001;
+  double *w = new double[n], *v = new double[n];
+  bismarck::BootWeights(42, 7, n, w);
+  bismarck::BootWeights(42, 7, n, v);
+  EXPECT_EQ(memcmp(w, v, n * sizeof(double)), 0);
+  EXPECT_EQ(w[0], 1);
+  double mean = 0, var = 0, zeros = 0;
+  for (int r = 1; r < n; r++) {
+    mean += w[r];
+    zeros += w[r] == 0;
+  }
+  mean /= n - 1;
+  for (int r = 1; r < n; r++) var += (w[r] - mean) * (w[r] - mean);
+  var /= n - 2;
+  EXPECT_NEAR(mean, 1, 0.01);
+  EXPECT_NEAR(var, 1, 0.02);
+  EXPECT_NEAR(zeros / (n - 1), exp(-1), 0.005);
+  bismarck::BootWeights(43, 7, n, v);
+  EXPECT_EQ((memcmp(w, v, n * sizeof(double)) != 0), true);
+  delete [] w;
+  delete [] v;
+  return 1;
+}
+
+bismarck::bytea Mean(int64_t from, int64_t to, uint32_t groups) {
+  bismarck::bytea m;
+  Boot::Init(NULL, &m);
+  for (int64_t id = from; id < to; id++) {
+    uint32_t g = groups == 1 ? 0 : id % 2;
+    Boot::StepMean(NULL, id, Value(id) + g, g, groups, 400, 0.9, 3, &m);
+  }
+  return m;
+}
+
+/*! The interval of a mean brackets it, about as wide as the normal one
+ */
+int TEST_Bootmean() {
+  const int n = 10000;
+  bismarck::bytea m = Mean(0, n, 1);
+  bismarck::bytea r = Boot::Final(NULL, m);
+  EXPECT_EQ(r.len, 4 * sizeof(double));
+  const double *ci = DP(r.str);
+  double mean = 0, var = 0;
+  for (int i = 0; i < n; i++) mean += Value(i);
+  mean /= n;
+  for (int i = 0; i < n; i++) var += (Value(i) - mean) * (Value(i) - mean);
+  double se = sqrt(var / (n - 1) / n);
+  EXPECT_NEAR(ci[0], mean, 1e-9);
+  EXPECT_EQ((ci[1] < mean && mean < ci[2]), true);
+  EXPECT_NEAR(ci[3], se, 0.15 * se);
+  EXPECT_NEAR(ci[2] - ci[1], 2 * 1.645 * se, 0.3 * se);
+  delete [] r.str;
+  delete [] m.str;
+  return 1;
+}
+
+/*! The difference of two means, the second group is shifted by one
+ */
+int TEST_Bootdiff() {
+  bismarck::bytea m = Mean(0, 10000, 2);
+  bismarck::bytea r = Boot::Final(NULL, m);
+  const double *ci = DP(r.str);
+  EXPECT_NEAR(ci[0], -1, 0.15);
+  EXPECT_EQ((ci[1] < ci[0] && ci[0] < ci[2]), true);
+  delete [] r.str;
+  delete [] m.str;
+  return 1;
+}
+
+bismarck::bytea Linr(int64_t from, int64_t to) {
+  bismarck::bytea m;
+  Boot::Init(NULL, &m);
+  for (int64_t id = from; id < to; id++) {
+    double x[3] = {1, Value(id), id % 3 == 0 ? 0 : Value(id + 1000000)};
+    double y = 1 + 2 * x[1] - x[2] + Value(id + 2000000) - 5;
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    Boot::StepLinr(NULL, id, ex, y, 100, 0.95, 11, &m);
+  }
+  return m;
+}
+
+/*! Merged states equal one pass, the estimate is least squares
+ */
+int TEST_Bootlinr() {
+  bismarck::bytea all = Linr(0, 3000);
+  bismarck::bytea a = Linr(0, 1000), b = Linr(1000, 3000), c;
+  Boot::Init(NULL, &c);
+  EXPECT_EQ(Boot::Merge(NULL, a, &c), true);
+  EXPECT_EQ(Boot::Merge(NULL, b, &c), true);
+  EXPECT_EQ(bismarck::BootHead(c)->rows, 3000);
+  // a state of another seed is refused
+  bismarck::bytea d;
+  Boot::Init(NULL, &d);
+  double f[3] = {1, 0.5, 0.25};
+  bismarck::bytea ex = {(char*) f, sizeof(f)};
+  Boot::StepLinr(NULL, 0, ex, 1, 100, 0.95, 12, &d);
+  EXPECT_EQ(Boot::Merge(NULL, d, &c), false);
+  EXPECT_EQ(bismarck::BootHead(c)->rows, 3000);
+  delete [] d.str;
+  const double *x = bismarck::BootAccumulators(all);
+  const double *y = bismarck::BootAccumulators(c);
+  size_t len = bismarck::BootEntries(*bismarck::BootHead(all)) * 101;
+  for (size_t i = 0; i < len; i++) EXPECT_NEAR(x[i], y[i], 1e-6);
+
+  bismarck::bytea r = Boot::Final(NULL, c);
+  EXPECT_EQ(r.len, 12 * sizeof(double));
+  const double *ci = DP(r.str);
+  // the noise is uniform on [-5, 5)
+  double truth[3] = {1, 2, -1};
+  for (int j = 0; j < 3; j++) {
+    EXPECT_NEAR(ci[4 * j], truth[j], 0.5);
+    EXPECT_EQ((ci[4 * j + 1] < ci[4 * j] && ci[4 * j] < ci[4 * j + 2]), true);
+    EXPECT_EQ((ci[4 * j + 3] > 0), true);
+  }
+  delete [] r.str;
+
+  // a constant feature makes every replicate singular
+  bismarck::bytea s;
+  Boot::Init(NULL, &s);
+  for (int64_t id = 0; id < 100; id++) {
+    double f[2] = {1, 1};
+    bismarck::bytea ex = {(char*) f, sizeof(f)};
+    Boot::StepLinr(NULL, id, ex, Value(id), 50, 0.95, 0, &s);
+  }
+  r = Boot::Final(NULL, s);
+  EXPECT_EQ(std::isnan(DP(r.str)[0]), true);
+  EXPECT_EQ(std::isnan(DP(r.str)[1]), true);
+  delete [] r.str;
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Bootweights);
+  RUNTEST(TEST_Bootmean);
+  RUNTEST(TEST_Bootdiff);
+  RUNTEST(TEST_Bootlinr);
+}
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "delta-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckDelta<void*> Delta;
+
+/*! Trains a state from base by adding step to every coordinate i
+ */
+bismarck::bytea Trained(const bismarck::bytea &base, double keep,
+                        double threshold, uint32_t bits, const double *step) {
+  bismarck::bytea m;
+  Delta::Init(NULL, base, 8, keep, threshold, bits, &m);
+  bismarck::bytea model = Delta::Model(m);
+  for (int i = 0; i < 8; i++) DP(model.str)[i] += step[i];
+  return m;
+}
+
+/*! Top-k keeps the largest changes exactly, the rest is the residual
+ */
+int TEST_Deltatopk() {
+  double basea[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+  double step[8] = {0.1, -3, 0.2, 0, 2, -0.3, 0, 0.05};
+  bismarck::bytea base = {(char*) basea, sizeof(basea)};
+  bismarck::bytea m = Trained(base, 0.25, 0, 64, step);
+
+  double residual[8];
+  bismarck::bytea enc = Delta::Encode(NULL, m, residual);
+  EXPECT_EQ(bismarck::DeltaHead(enc)->nnz, 2);
+  // 2 indices and 2 doubles instead of 8 doubles
+  EXPECT_EQ(enc.len - sizeof(bismarck::DeltaHeader), 3 * sizeof(double));
+
+  bismarck::bytea avg = Delta::Final(NULL, enc);
+  for (int i = 0; i < 8; i++) {
+    double sent = (i == 1 || i == 4) ? step[i] : 0;
+    EXPECT_NEAR(DP(avg.str)[i], sent, 1e-12);
+    EXPECT_NEAR((residual[i] + sent), step[i], 1e-12);
+  }
+
+  bismarck::bytea next = bismarck::DeltaApply<void*>(NULL, base, avg);
+  EXPECT_NEAR(DP(next.str)[1], -2, 1e-12);
+  EXPECT_NEAR(DP(next.str)[2], 1, 1e-12);
+
+  // encoding leaves the state as it was, a second encoding is the same
+  bismarck::bytea again = Delta::Encode(NULL, m, NULL);
+  EXPECT_EQ(again.len, enc.len);
+  EXPECT_EQ(memcmp(again.str, enc.str, enc.len), 0);
+  EXPECT_NEAR(DP(Delta::Model(m).str)[1], -2, 1e-12);
+  return 1;
+}
+
+/*! The threshold drops small changes, 8 bit values are within half a step
+ */
+int TEST_Deltaquantize() {
+  double step[8] = {0.1, -3, 0.2, 0, 2, -0.3, 0, 0.05};
+  bismarck::bytea empty = {NULL, 0};
+  bismarck::bytea m = Trained(empty, 1.0, 0.15, 8, step);
+
+  double residual[8];
+  bismarck::bytea enc = Delta::Encode(NULL, m, residual);
+  EXPECT_EQ(bismarck::DeltaHead(enc)->nnz, 4);
+  bismarck::bytea avg = Delta::Final(NULL, enc);
+  double half = 3.0 / 127 / 2;
+  for (int i = 0; i < 8; i++) {
+    bool sent = std::abs(step[i]) > 0.15;
+    if (sent) {
+      EXPECT_NEAR(DP(avg.str)[i], step[i], half);
+    } else {
+      EXPECT_EQ(DP(avg.str)[i], 0);
+    }
+    EXPECT_NEAR((residual[i] + DP(avg.str)[i]), step[i], 1e-12);
+  }
+  return 1;
+}
+
+/*! Merging encoded, summed and raw states averages their deltas
+ */
+int TEST_Deltamerge() {
+  double a[8] = {1, 0, 0, 0, 0, 0, 0, 0};
+  double b[8] = {0, 2, 0, 0, 0, 0, 0, 0};
+  double c[8] = {0, 0, 3, 0, 0, 0, 0, 0};
+  bismarck::bytea empty = {NULL, 0};
+  bismarck::bytea dst = Delta::Encode(NULL, Trained(empty, 0.5, 0, 64, a),
+                                      NULL);
+  bismarck::bytea encb = Delta::Encode(NULL, Trained(empty, 0.5, 0, 64, b),
+                                       NULL);
+  EXPECT_EQ(Delta::Merge(NULL, encb, &dst), true);
+  EXPECT_EQ(Delta::Merge(NULL, Trained(empty, 0.5, 0, 64, c), &dst), true);
+  EXPECT_EQ(bismarck::DeltaHead(dst)->count, 3);
+
+  // a delta of another dimension is refused and leaves dst as it was
+  bismarck::bytea other;
+  Delta::Init(NULL, empty, 4, 1.0, 0, 64, &other);
+  EXPECT_EQ(Delta::Merge(NULL, other, &dst), false);
+  EXPECT_EQ(bismarck::DeltaHead(dst)->count, 3);
+
+  bismarck::bytea avg = Delta::Final(NULL, dst);
+  EXPECT_NEAR(DP(avg.str)[0], (1 / 3.0), 1e-12);
+  EXPECT_NEAR(DP(avg.str)[1], (2 / 3.0), 1e-12);
+  EXPECT_NEAR(DP(avg.str)[2], 1, 1e-12);
+  EXPECT_EQ(DP(avg.str)[3], 0);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Deltatopk);
+  RUNTEST(TEST_Deltaquantize);
+  RUNTEST(TEST_Deltamerge);
+}
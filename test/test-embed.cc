@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "embed-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckEmbed<void*> Embed;
+typedef bismarck::BismarckEmbedAlias<void*> Alias;
+
+/*! The alias table of the counts, built over two merged states
+ */
+bismarck::bytea Table(const double *counts, uint32_t n) {
+  bismarck::bytea a, b;
+  Alias::Init(NULL, &a);
+  Alias::Init(NULL, &b);
+  for (uint32_t i = 0; i < n; i++) {
+    Alias::Step(NULL, i, counts[i] / 2, &a);
+    Alias::Step(NULL, n - 1 - i, counts[n - 1 - i] / 2, &b);
+  }
+  Alias::Merge(NULL, b, &a);
+  bismarck::bytea t = Alias::Final(NULL, a);
+  delete [] a.str;
+  delete [] b.str;
+  return t;
+}
+
+/*! Items are drawn in proportion to count^0.75
+ */
+int TEST_Embedalias() {
+  double counts[6] = {1000, 10, 0, 300, 1, 5000};
+  bismarck::bytea t = Table(counts, 6);
+  EXPECT_EQ(t.len, 6 * sizeof(bismarck::EmbedAliasEntry));
+  const bismarck::EmbedAliasEntry *table =
+      reinterpret_cast<const bismarck::EmbedAliasEntry*>(t.str);
+  const int draws = 1000000;
+  double seen[6] = {0}, total = 0;
+  for (int i = 0; i < draws; i++) {
+    seen[bismarck::EmbedSample(table, 6, bismarck::EmbedMix(i))]++;
+  }
+  for (int i = 0; i < 6; i++) total += pow(counts[i], 0.75);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_NEAR(seen[i] / draws, pow(counts[i], 0.75) / total, 0.003);
+  }
+  EXPECT_EQ(seen[2], 0);
+  delete [] t.str;
+
+  bismarck::bytea empty;
+  Alias::Init(NULL, &empty);
+  Alias::Step(NULL, 3, 0, &empty);
+  EXPECT_EQ((Alias::Final(NULL, empty).str == NULL), true);
+  delete [] empty.str;
+
+  // ids past the vocabulary bound are skipped rather than allocated for
+  bismarck::bytea big;
+  Alias::Init(NULL, &big);
+  Alias::Step(NULL, bismarck::kEmbedMaxVocab, 1, &big);
+  EXPECT_EQ((big.str == NULL), true);
+  EXPECT_EQ(bismarck::EmbedFits(bismarck::kEmbedMaxVocab, 4), true);
+  EXPECT_EQ(bismarck::EmbedFits(bismarck::kEmbedMaxVocab, 16), false);
+  EXPECT_EQ(bismarck::EmbedFits(bismarck::kEmbedMaxVocab + 1, 1), false);
+  return 1;
+}
+
+/*! The kernel of a rank is the generic one
+ */
+int TEST_Embedkernel() {
+  const size_t rank = 32, vocab = 4;
+  double in[2][vocab * rank], out[2][vocab * rank], grad[rank];
+  for (size_t i = 0; i < vocab * rank; i++) {
+    in[0][i] = in[1][i] = sin(i);
+    out[0][i] = out[1][i] = cos(i) / 4;
+  }
+  uint32_t targets[3] = {1, 2, 3};
+  bismarck::EmbedPairStep<32>(in[0], out[0], 0, targets, 3, rank, 0.1, grad);
+  bismarck::EmbedPairStep<0>(in[1], out[1], 0, targets, 3, rank, 0.1, grad);
+  EXPECT_EQ(memcmp(in[0], in[1], sizeof(in[0])), 0);
+  EXPECT_EQ(memcmp(out[0], out[1], sizeof(out[0])), 0);
+  // only the vectors of the center and the targets move
+  EXPECT_EQ(in[0][rank], sin(rank));
+  EXPECT_EQ((out[0][rank + 1] != cos(rank + 1) / 4), true);
+  return 1;
+}
+
+/*! Two groups of items, sequences only mix items of a group
+ */
+bismarck::bytea Train(const bismarck::bytea &prev,
+                      const bismarck::bytea &alias, int from, int to,
+                      uint64_t seed) {
+  bismarck::EmbedOptions opt = {16, 5, 3, 0.05, seed};
+  bismarck::bytea m;
+  Embed::Init(NULL, &m);
+  for (int s = from; s < to; s++) {
+    int32_t tokens[12];
+    for (int i = 0; i < 12; i++) {
+      tokens[i] = (s % 2) * 10 + bismarck::EmbedMix(s * 12 + i) % 10;
+    }
+    bismarck::bytea ex = {(char*) tokens, sizeof(tokens)};
+    Embed::StepSequence(NULL, prev, alias, ex, opt, &m);
+  }
+  return m;
+}
+
+int TEST_Embedgroups() {
+  double counts[20];
+  for (int i = 0; i < 20; i++) counts[i] = 100;
+  bismarck::bytea alias = Table(counts, 20);
+  bismarck::bytea model = {NULL, 0};
+  for (int epoch = 0; epoch < 5; epoch++) {
+    // two states of an epoch start alike and are averaged
+    bismarck::bytea a = Train(model, alias, 0, 400, epoch);
+    bismarck::bytea b = Train(model, alias, 400, 1000, epoch);
+    EXPECT_EQ((bismarck::EmbedHead(a)->pairs > 0), true);
+    EXPECT_EQ(Embed::Merge(NULL, b, &a), true);
+    delete [] b.str;
+    delete [] model.str;
+    model = Embed::Final(NULL, a);
+  }
+  EXPECT_EQ(model.len, bismarck::EmbedSize(20, 16));
+  double within = 0, across = 0;
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 10; j++) {
+      if (i != j) within += Embed::Similarity(model, i, j) / 90;
+      across += Embed::Similarity(model, i, 10 + j) / 100;
+    }
+  }
+  EXPECT_EQ((within > 0.5), true);
+  EXPECT_EQ((across < within - 0.5), true);
+  EXPECT_EQ((Embed::Vector(model, 20) == NULL), true);
+  EXPECT_EQ(std::isnan(Embed::Similarity(model, 0, 25)), true);
+  // a state of another rank is refused, and the model is unchanged
+  bismarck::EmbedOptions opt = {8, 5, 3, 0.05, 0};
+  bismarck::bytea none = {NULL, 0}, other;
+  Embed::Init(NULL, &other);
+  Embed::Step(NULL, none, alias, 0, 1, opt, &other);
+  EXPECT_EQ(other.len, bismarck::EmbedSize(20, 8));
+  double sim = Embed::Similarity(model, 0, 1);
+  EXPECT_EQ(Embed::Merge(NULL, other, &model), false);
+  EXPECT_EQ(model.len, bismarck::EmbedSize(20, 16));
+  EXPECT_EQ(Embed::Similarity(model, 0, 1), sim);
+  delete [] other.str;
+  delete [] model.str;
+  delete [] alias.str;
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Embedalias);
+  RUNTEST(TEST_Embedkernel);
+  RUNTEST(TEST_Embedgroups);
+}
@@ -0,0 +1,75 @@
+#include <cmath>
+#include <cstdio>
+
+#include <impala_udf/uda-test-harness.h>
+#include "madport/port-dbconnector-inl.h"
+#include "test-macros.h"
+#include "src/glm.h"
+
+using namespace impala_udf;
+using namespace std;
+
+/* A Poisson GLM with the log link, the first run of the UDA
+ */
+void GlmPoissonUpdate(FunctionContext* context, const StringVal& val,
+                      const DoubleVal &y, StringVal* st) {
+  GlmUpdate(context, StringVal::null(), val, y, IntVal(1), IntVal(1),
+            DoubleVal::null(), st);
+}
+
+/* The state holds dimension, family, link, power and the iteration count
+ * before the coefficients, 8 + (dimension + 2 + 32) * dimension doubles
+ */
+bool GlmCoefNear(const StringVal& state, const StringVal& coef) {
+  size_t dim = coef.len / sizeof(double);
+  if (state.len != (int) ((8 + (dim + 2 + 32) * dim) * sizeof(double))) {
+    return false;
+  }
+  const double *s = reinterpret_cast<const double*>(state.ptr);
+  const double *c = reinterpret_cast<const double*>(coef.ptr);
+  if (s[0] != dim) return false;
+  for (size_t i = 0; i < dim; i++) {
+    if (fabs(s[5 + i] - c[i]) > 1e-9) return false;
+  }
+  return true;
+}
+
+/* Runs the first IRLS step on a 2x2 example, repeated so that the rows are
+ * split across states that are merged
+ *
+ * The first step starts from mu = y + 0.1, the working response of a row is
+ * then log(mu) - 0.1 / mu, which the two rows fit exactly.
+ */
+int TEST_glm() {
+  UdaTestHarness2<StringVal, StringVal, StringVal, DoubleVal> test1(
+      GlmInit, GlmPoissonUpdate,
+      GlmMerge,
+      NULL, GlmFinalize);
+  test1.SetResultComparator(GlmCoefNear);
+  vector<StringVal> no_nulls;
+  vector<DoubleVal> labels;
+
+  double ex1[2] = {1.0, 3.0};
+  double ex2[2] = {5.0, 7.0};
+  for (int i = 0; i < 4; i++) {
+    no_nulls.push_back(StringVal((uint8_t*) (i % 2 ? ex2 : ex1),
+                                 2 * sizeof(double)));
+    labels.push_back(DoubleVal(i % 2 ? 19.0 : 7.0));
+  }
+
+  // create the expected coefficients
+  double z1 = log(7.1) - 0.1 / 7.1, z2 = log(19.1) - 0.1 / 19.1;
+  double coef[2];
+  coef[1] = (5 * z1 - z2) / 8;
+  coef[0] = z1 - 3 * coef[1];
+  StringVal ans((uint8_t*) coef, sizeof(coef));
+
+  //test it
+  bool b = test1.Execute(no_nulls, labels, ans);
+  if (!b) printf("%s\n", test1.GetErrorMsg().c_str());
+  return (int)b;
+}
+
+int main(int argc, char** argv) {
+  RUNTEST(TEST_glm);
+}
@@ -0,0 +1,182 @@
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "svm-inl.h"
+#include "igd-inl.h"
+
+
+using namespace hazy;
+using namespace hazy::bismarck;
+
+typedef BismarckIGD<void*, DenseRep, HingeLoss, L2Reg, ConstantStep> SVM;
+typedef BismarckIGD<void*, SparseRep, HingeLoss, L2Reg, ConstantStep>
+    SparseSVM;
+
+static const bytea kEmpty = {NULL, 0};
+
+/*! Example i of a small separable set with 6 features, one or two
+ * non-zeros each
+ */
+void Example(int i, double *x, double *y) {
+  for (int j = 0; j < 6; j++) x[j] = 0;
+  x[i % 6] = 1 + (i % 3);
+  if (i % 4 == 0) x[(i + 3) % 6] = -0.5;
+  *y = (i % 6) < 3 ? 1 : -1;
+}
+
+bytea Sparse(const double *x, IGDSparseEntry *e) {
+  size_t nnz = 0;
+  for (int j = 0; j < 6; j++) {
+    if (x[j] == 0) continue;
+    e[nnz].index = j;
+    e[nnz].value = x[j];
+    nnz++;
+  }
+  bytea ex = {(char*) e, nnz * sizeof(IGDSparseEntry)};
+  return ex;
+}
+
+/*! Hinge, L2 and a constant step on dense examples is BismarckSVM
+ */
+int TEST_IGDsvm() {
+  bytea m, svm;
+  SVM::Init(NULL, &m);
+  BismarckSVM<void*>::Init(NULL, &svm);
+  double x[6], y;
+  for (int i = 0; i < 40; i++) {
+    Example(i, x, &y);
+    bytea ex = {(char*) x, sizeof(x)};
+    SVM::Step(NULL, kEmpty, ex, y, 0.1, 0.05, &m);
+    BismarckSVM<void*>::Step(NULL, ex, y > 0, &svm, 0.1, 0.05);
+  }
+  bytea w = SVM::Final(NULL, m);
+  EXPECT_EQ(w.len, svm.len);
+  for (int j = 0; j < 6; j++) EXPECT_EQ(DP(w.str)[j], DP(svm.str)[j]);
+
+  Example(1, x, &y);
+  bytea ex = {(char*) x, sizeof(x)};
+  EXPECT_EQ(SVM::ExampleLoss(w, ex, y), BismarckSVM<void*>::Loss(ex, true, svm));
+  EXPECT_EQ((SVM::Predict(w, ex) > 0), true);
+  return 1;
+}
+
+/*! The lazy regularizer of sparse examples ends at the dense model
+ */
+int TEST_IGDlazy() {
+  bytea dense, sparse;
+  SVM::Init(NULL, &dense);
+  SparseSVM::Init(NULL, &sparse);
+  double x[6], y;
+  IGDSparseEntry e[6];
+  for (int i = 0; i < 60; i++) {
+    Example(i, x, &y);
+    bytea ex = {(char*) x, sizeof(x)};
+    SVM::Step(NULL, kEmpty, ex, y, 0.1, 0.05, &dense);
+    SparseSVM::Step(NULL, kEmpty, Sparse(x, e), y, 0.1, 0.05, &sparse);
+  }
+  bytea wd = SVM::Final(NULL, dense);
+  bytea ws = SparseSVM::Final(NULL, sparse);
+  // the sparse model grows to the largest index seen
+  EXPECT_EQ(ws.len, wd.len);
+  for (int j = 0; j < 6; j++) {
+    EXPECT_NEAR(DP(ws.str)[j], DP(wd.str)[j], 1e-12);
+  }
+  return 1;
+}
+
+/*! Merging averages the states by the examples each has seen, and catches
+ * up on the lazy regularizer of both
+ */
+int TEST_IGDmerge() {
+  typedef BismarckIGD<void*, SparseRep, SquaredLoss, L1Reg, ConstantStep> M;
+  IGDSparseEntry a = {0, 1}, b = {3, 1};
+  bytea exa = {(char*) &a, sizeof(a)}, exb = {(char*) &b, sizeof(b)};
+  bytea ma, mb;
+  M::Init(NULL, &ma);
+  M::Init(NULL, &mb);
+  M::Step(NULL, kEmpty, exa, 1, 0.5, 0.1, &ma);
+  M::Step(NULL, kEmpty, exa, 1, 0.5, 0.1, &ma);
+  M::Step(NULL, kEmpty, exa, 1, 0.5, 0.1, &ma);
+  M::Step(NULL, kEmpty, exb, 2, 0.5, 0.1, &mb);
+  EXPECT_EQ(IGDHead(mb)->dim, 4);
+
+  bytea wa = M::Final(NULL, ma);
+  bytea wb = M::Final(NULL, mb);
+  // a: 0.5 - 0.05, then 0.45 + 0.275 - 0.05 = 0.675, 0.675 + 0.1625 - 0.05
+  EXPECT_NEAR(DP(wa.str)[0], 0.7875, 1e-12);
+  EXPECT_NEAR(DP(wb.str)[3], 0.95, 1e-12);
+
+  M::Merge(NULL, mb, &ma);
+  EXPECT_EQ(IGDHead(ma)->steps, 4);
+  bytea w = M::Final(NULL, ma);
+  EXPECT_EQ(w.len, 4 * sizeof(double));
+  EXPECT_NEAR(DP(w.str)[0], (0.75 * 0.7875), 1e-12);
+  EXPECT_NEAR(DP(w.str)[3], (0.25 * 0.95), 1e-12);
+  EXPECT_EQ(DP(w.str)[1], 0);
+  return 1;
+}
+
+/*! AdaGrad with Huber and elastic net fits y = 2 x0 - x1 despite an
+ * outlier, on float examples
+ */
+int TEST_IGDhuber() {
+  typedef BismarckIGD<void*, FloatRep, HuberLoss, ElasticNetReg<50>,
+                      AdaGradStep> M;
+  bytea m;
+  M::Init(NULL, &m);
+  float x[3];
+  bytea ex = {(char*) x, sizeof(x)};
+  for (int i = 0; i < 3000; i++) {
+    x[0] = (i % 7) / 7.0;
+    x[1] = (i % 5) / 5.0;
+    x[2] = 0;
+    double y = 2 * x[0] - x[1];
+    if (i % 100 == 0) y += 50;
+    M::Step(NULL, kEmpty, ex, y, 0.5, 1e-5, &m);
+  }
+  bytea w = M::Final(NULL, m);
+  EXPECT_NEAR(DP(w.str)[0], 2, 0.1);
+  EXPECT_NEAR(DP(w.str)[1], -1, 0.1);
+  EXPECT_EQ(DP(w.str)[2], 0);
+  return 1;
+}
+
+/*! A previous model seeds the state
+ */
+int TEST_IGDprev() {
+  typedef BismarckIGD<void*, DenseRep, LogisticLoss, NoReg, ConstantStep> M;
+  double prev[2] = {1, -1};
+  double x[2] = {1, 1};
+  bytea p = {(char*) prev, sizeof(prev)}, ex = {(char*) x, sizeof(x)};
+  bytea m;
+  M::Init(NULL, &m);
+  M::Step(NULL, p, ex, 1, 1, 0, &m);
+  bytea w = M::Final(NULL, m);
+  // the prediction was 0, so the gradient is -1/2
+  EXPECT_NEAR(DP(w.str)[0], 1.5, 1e-12);
+  EXPECT_NEAR(DP(w.str)[1], -0.5, 1e-12);
+  EXPECT_NEAR(M::ExampleLoss(w, ex, 1), log(1 + exp(-1.0)), 1e-12);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_IGDsvm);
+  RUNTEST(TEST_IGDlazy);
+  RUNTEST(TEST_IGDmerge);
+  RUNTEST(TEST_IGDhuber);
+  RUNTEST(TEST_IGDprev);
+}
@@ -9,6 +9,7 @@ T* BismarckAllocate(void* ignore, size_t len) {
 }
 
 #include "logreg-inl.h"
+#include "downsample-inl.h"
 
 
 using namespace hazy;
@@ -43,7 +44,18 @@ int TEST_LogrAlloc() {
 }
 
 
+/*! Calibrating undoes the odds inflated by downsampling the negatives
+ */
+int TEST_Logrcalibrate() {
+  // with rate 0.25 the model sees odds 4 times too high
+  double p = 0.8;
+  EXPECT_NEAR(bismarck::DownsampleCalibrate(p, 0.25), 0.5, 1e-12);
+  EXPECT_NEAR(bismarck::DownsampleCalibrate(p, 1.0), p, 1e-12);
+  return 1;
+}
+
 int main() {
   RUNTEST(TEST_Logrinit);
   RUNTEST(TEST_LogrAlloc);
+  RUNTEST(TEST_Logrcalibrate);
 }
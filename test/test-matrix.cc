@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "matrix-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckMatrix<void*> Matrix;
+
+/*! Column j, sparse so the spill file compresses
+ */
+void Column(int j, double *x, int rows) {
+  for (int i = 0; i < rows; i++) x[i] = (i + j) % 5 == 0 ? i * 1000 + j : 0;
+}
+
+/*! Checks the result of Final against Column
+ */
+int CheckMatrix(const bismarck::bytea &r, int rows, int cols) {
+  EXPECT_EQ(r.len, (2 + rows * cols) * sizeof(double));
+  const double *m = DP(r.str);
+  EXPECT_EQ(m[0], rows);
+  EXPECT_EQ(m[1], cols);
+  double *x = new double[rows];
+  for (int j = 0; j < cols; j++) {
+    Column(j, x, rows);
+    EXPECT_EQ(memcmp(m + 2 + j * rows, x, rows * sizeof(double)), 0);
+  }
+  delete [] x;
+  return 1;
+}
+
+bismarck::bytea Build(int from, int to, int rows) {
+  bismarck::bytea m;
+  Matrix::Init(NULL, &m);
+  double *x = new double[rows];
+  for (int j = from; j < to; j++) {
+    Column(j, x, rows);
+    bismarck::bytea ex = {(char*) x, rows * sizeof(double)};
+    Matrix::Step(NULL, ex, &m);
+  }
+  delete [] x;
+  return m;
+}
+
+/*! Without a spill directory the columns stay in memory
+ */
+int TEST_Matrixmemory() {
+  unsetenv("BISMARCK_SPILL_DIR");
+  bismarck::bytea m = Build(0, 1000, 30);
+  EXPECT_EQ(bismarck::MatrixHead(m)->spill.fd, -1);
+  EXPECT_EQ(bismarck::MatrixHead(m)->nbuf, 1000);
+
+  // short columns are padded, long ones truncated
+  double x[40] = {1, 2, 3};
+  bismarck::bytea ex = {(char*) x, 3 * sizeof(double)};
+  Matrix::Step(NULL, ex, &m);
+  ex.len = sizeof(x);
+  Matrix::Step(NULL, ex, &m);
+  bismarck::bytea r = Matrix::Final(NULL, &m);
+  EXPECT_EQ(DP(r.str)[1], 1002);
+  const double *last = DP(r.str) + 2 + 1000 * 30;
+  EXPECT_EQ(last[2], 3);
+  EXPECT_EQ(last[29], 0);
+  EXPECT_EQ(last[30], 1);
+  return 1;
+}
+
+/*! Full chunks go to disk, Final and Serialize read them back
+ */
+int TEST_Matrixspill() {
+  static char dir[] = "/tmp/bismarck-matrix-test-XXXXXX";
+  EXPECT_EQ((mkdtemp(dir) != NULL), true);
+  setenv("BISMARCK_SPILL_DIR", dir, 1);
+
+  // 1024 rows, 512 columns a chunk
+  EXPECT_EQ(bismarck::MatrixChunkCols(1024), 512);
+  bismarck::bytea m = Build(0, 1500, 1024);
+  bismarck::MatrixHeader *h = bismarck::MatrixHead(m);
+  EXPECT_EQ(h->cap, 512);
+  EXPECT_EQ(h->spill.chunks, 2);
+  EXPECT_EQ(h->nbuf, 1500 - 1024);
+  EXPECT_EQ((h->spill.bytes < h->spill.raw / 2), true);
+  if (!CheckMatrix(Matrix::Final(NULL, &m), 1024, 1500)) return 0;
+
+  m = Build(0, 1500, 1024);
+  EXPECT_EQ(Matrix::Serialize(NULL, &m), true);
+  h = bismarck::MatrixHead(m);
+  EXPECT_EQ(h->spill.fd, -1);
+  EXPECT_EQ(h->nbuf, 1500);
+  EXPECT_EQ(m.len, bismarck::MatrixSize(1024, 1500));
+  if (!CheckMatrix(Matrix::Final(NULL, &m), 1024, 1500)) return 0;
+  unsetenv("BISMARCK_SPILL_DIR");
+  rmdir(dir);
+  return 1;
+}
+
+/*! Merging appends the columns of serialized states
+ */
+int TEST_Matrixmerge() {
+  bismarck::bytea a = Build(0, 300, 64);
+  bismarck::bytea b = Build(300, 700, 64);
+  bismarck::bytea c;
+  Matrix::Init(NULL, &c);
+  Matrix::Serialize(NULL, &a);
+  Matrix::Serialize(NULL, &b);
+  Matrix::Merge(NULL, a, &c);
+  Matrix::Merge(NULL, b, &c);
+  return CheckMatrix(Matrix::Final(NULL, &c), 64, 700);
+}
+
+int main() {
+  RUNTEST(TEST_Matrixmemory);
+  RUNTEST(TEST_Matrixspill);
+  RUNTEST(TEST_Matrixmerge);
+}
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "memory-inl.h"
+#include "score-inl.h"
+
+
+using namespace hazy;
+
+/*! Charges and releases move the current bytes, the peak stays
+ */
+int TEST_Memorycharge() {
+  bismarck::MemorySetBudget(0);
+  bismarck::MemoryAccount &a = bismarck::MemoryLibraryAccount();
+  uint64_t allocs = a.allocs;
+  EXPECT_EQ(bismarck::MemoryCharge(1000), false);
+  EXPECT_EQ(bismarck::MemoryCharge(500), false);
+  bismarck::MemoryRelease(1000);
+  EXPECT_EQ(a.current, 500);
+  EXPECT_EQ(a.peak, 1500);
+  EXPECT_EQ(a.allocs, allocs + 2);
+  bismarck::MemoryRelease(500);
+  EXPECT_EQ(a.current, 0);
+  EXPECT_EQ(bismarck::MemoryOverBudget(), false);
+  return 1;
+}
+
+/*! Only the charge that crosses the budget reports it, until the account
+ * is back under
+ */
+int TEST_Memorybudget() {
+  bismarck::MemorySetBudget(1 << 20);
+  EXPECT_EQ(bismarck::MemoryCharge(1 << 19), false);
+  EXPECT_EQ(bismarck::ScoreBlockRows(5), 512);
+  EXPECT_EQ(bismarck::MemoryCharge(1 << 20), true);
+  EXPECT_EQ(bismarck::MemoryCharge(1 << 10), false);
+  EXPECT_EQ(bismarck::MemoryOverBudget(), true);
+  EXPECT_EQ(bismarck::ScoreBlockRows(5), 8);
+
+  char buf[256];
+  size_t n = bismarck::MemoryReport("test", buf, sizeof(buf));
+  EXPECT_EQ(n, strlen(buf));
+  EXPECT_EQ((strstr(buf, "(over)") != NULL), true);
+
+  bismarck::MemoryRelease((1 << 20) + (1 << 10));
+  EXPECT_EQ(bismarck::MemoryOverBudget(), false);
+  EXPECT_EQ(bismarck::MemoryCharge(1 << 20), true);
+  bismarck::MemoryRelease((1 << 20) + (1 << 19));
+  bismarck::MemorySetBudget(0);
+  return 1;
+}
+
+int TEST_Memoryparse() {
+  EXPECT_EQ(bismarck::MemoryParseBytes(NULL), 0);
+  EXPECT_EQ(bismarck::MemoryParseBytes("4096"), 4096);
+  EXPECT_EQ(bismarck::MemoryParseBytes("64k"), 64 << 10);
+  EXPECT_EQ(bismarck::MemoryParseBytes("1.5M"), 3 << 19);
+  EXPECT_EQ(bismarck::MemoryParseBytes("2G"), int64_t(2) << 30);
+  EXPECT_EQ(bismarck::MemoryParseBytes("none"), 0);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Memorycharge);
+  RUNTEST(TEST_Memorybudget);
+  RUNTEST(TEST_Memoryparse);
+}
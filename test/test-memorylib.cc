@@ -0,0 +1,57 @@
+#include <dlfcn.h>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+
+#include "test-macros.h"
+
+typedef void (*ChargeFn)(int64_t bytes);
+typedef int64_t (*CurrentFn)();
+typedef void (*StaticsFn)(const void **out);
+
+const int kMemoryLibStatics = 4;
+
+/*! Two copies of memory-lib.cc, next to this binary
+ */
+std::string MemoryLibPath(const char *argv0, const char *name) {
+  std::string dir(argv0);
+  size_t slash = dir.rfind('/');
+  dir = slash == std::string::npos ? "." : dir.substr(0, slash);
+  return dir + "/" + name;
+}
+
+std::string lib_a, lib_b;
+
+/*! Libraries loaded like Impala loads UDF libraries keep their own memory
+ * account, tuning, model cache and count of spill files
+ */
+int TEST_Memorylibraries() {
+  void *a = dlopen(lib_a.c_str(), RTLD_NOW | RTLD_LOCAL);
+  void *b = dlopen(lib_b.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (a == NULL || b == NULL) std::cout << dlerror() << std::endl;
+  EXPECT_EQ((a != NULL && b != NULL), true);
+
+  ChargeFn charge_a = (ChargeFn) dlsym(a, "MemoryLibCharge");
+  CurrentFn current_a = (CurrentFn) dlsym(a, "MemoryLibCurrent");
+  CurrentFn current_b = (CurrentFn) dlsym(b, "MemoryLibCurrent");
+  charge_a(1000);
+  EXPECT_EQ(current_a(), 1000);
+  EXPECT_EQ(current_b(), 0);
+
+  const void *statics_a[kMemoryLibStatics], *statics_b[kMemoryLibStatics];
+  ((StaticsFn) dlsym(a, "MemoryLibStatics"))(statics_a);
+  ((StaticsFn) dlsym(b, "MemoryLibStatics"))(statics_b);
+  for (int i = 0; i < kMemoryLibStatics; i++) {
+    EXPECT_EQ((statics_a[i] != statics_b[i]), true);
+  }
+  dlclose(b);
+  dlclose(a);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  lib_a = MemoryLibPath(argv[0], "libmemorya.so");
+  lib_b = MemoryLibPath(argv[0], "libmemoryb.so");
+  RUNTEST(TEST_Memorylibraries);
+}
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+#include "modelcache-inl.h"
+
+
+using namespace hazy;
+
+static int builds = 0;
+static int destroys = 0;
+
+/*! Decodes a model into the sum of its bytes
+ */
+void* SumBuild(const bismarck::bytea &content) {
+  builds++;
+  int64_t *sum = new int64_t(0);
+  for (size_t i = 0; i < content.len; i++) *sum += content.str[i];
+  return sum;
+}
+
+void SumDestroy(void *p) {
+  destroys++;
+  delete reinterpret_cast<int64_t*>(p);
+}
+
+bismarck::bytea Content(const char *s) {
+  bismarck::bytea b = {(char*) s, strlen(s)};
+  return b;
+}
+
+/*! Equal contents share one model, which is freed with the last reference
+ */
+int TEST_ModelCacheshare() {
+  builds = destroys = 0;
+  // two fragments with their own copy of the same model
+  char a[] = "model one", b[] = "model one";
+  bismarck::SharedModel *ma =
+      bismarck::ModelCacheAcquire(Content(a), SumBuild, SumDestroy);
+  bismarck::SharedModel *mb =
+      bismarck::ModelCacheAcquire(Content(b), SumBuild, SumDestroy);
+  EXPECT_EQ(ma == mb, true);
+  EXPECT_EQ(builds, 1);
+  EXPECT_EQ(bismarck::ModelCacheSize(), 1);
+
+  bismarck::SharedModel *mc =
+      bismarck::ModelCacheAcquire(Content("model two"), SumBuild, SumDestroy);
+  EXPECT_EQ(ma == mc, false);
+  EXPECT_EQ(bismarck::ModelCacheSize(), 2);
+
+  bismarck::ModelCacheRelease(ma);
+  EXPECT_EQ(destroys, 0);
+  bismarck::ModelCacheRelease(mb);
+  bismarck::ModelCacheRelease(mc);
+  EXPECT_EQ(destroys, 2);
+  EXPECT_EQ(bismarck::ModelCacheSize(), 0);
+  return 1;
+}
+
+void* Fragment(void *arg) {
+  bismarck::SharedModel *m =
+      bismarck::ModelCacheAcquire(Content("a large model"), SumBuild,
+                                  SumDestroy);
+  *reinterpret_cast<bismarck::SharedModel**>(arg) = m;
+  return NULL;
+}
+
+/*! Fragments starting together build the model only once
+ */
+int TEST_ModelCachethreads() {
+  builds = destroys = 0;
+  const int n = 16;
+  pthread_t threads[n];
+  bismarck::SharedModel *models[n];
+  for (int i = 0; i < n; i++) {
+    pthread_create(&threads[i], NULL, Fragment, &models[i]);
+  }
+  for (int i = 0; i < n; i++) pthread_join(threads[i], NULL);
+  EXPECT_EQ(builds, 1);
+  for (int i = 0; i < n; i++) {
+    EXPECT_EQ(models[i] == models[0], true);
+    bismarck::ModelCacheRelease(models[i]);
+  }
+  EXPECT_EQ(destroys, 1);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_ModelCacheshare);
+  RUNTEST(TEST_ModelCachethreads);
+}
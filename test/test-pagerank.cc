@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "degree.h"
+#include "pagerank-inl.h"
+
+
+using namespace hazy;
+
+/*! Build a block from two partial edge lists
+ */
+int TEST_CSRbuild() {
+  bismarck::bytea a, b;
+  bismarck::BismarckCSR<void*>::Init(NULL, &a);
+  bismarck::BismarckCSR<void*>::Init(NULL, &b);
+  bismarck::BismarckCSR<void*>::Step(NULL, 2, 1, &a);
+  bismarck::BismarckCSR<void*>::Step(NULL, 0, 1, &a);
+  bismarck::BismarckCSR<void*>::Step(NULL, 1, 0, &b);
+  bismarck::BismarckCSR<void*>::Merge(NULL, b, &a);
+
+  bismarck::bytea block = bismarck::BismarckCSR<void*>::Final(NULL, a);
+  uint64_t *blk = (uint64_t*) block.str;
+  // nrows, nnz, rows, ptr, cols
+  uint64_t expect[] = {2, 3, 0, 1, 0, 1, 3, 1, 0, 2};
+  EXPECT_EQ(block.len, sizeof(expect));
+  for (size_t i = 0; i < sizeof(expect) / sizeof(uint64_t); i++) {
+    EXPECT_EQ(blk[i], expect[i]);
+  }
+  return 1;
+}
+
+/*! Count out-degrees of ids seen in increasing order in two states
+ */
+int TEST_Degree() {
+  bismarck::bytea a, b;
+  bismarck::DegInit<void*>(NULL, &a);
+  bismarck::DegInit<void*>(NULL, &b);
+  for (size_t i = 0; i < 1000; i++) {
+    bismarck::DegUpdate<void*>(NULL, &a, i);
+  }
+  // the state grows geometrically, not by one id at a time
+  EXPECT_EQ((a.len < 2100 * sizeof(uint64_t)), true);
+  bismarck::DegUpdate<void*>(NULL, &b, 3);
+  bismarck::DegUpdate<void*>(NULL, &b, 1500);
+  bismarck::bytea bs = bismarck::DegSerial<void*>(NULL, b);
+  EXPECT_EQ(bs.len, 1502 * sizeof(uint64_t));
+  bismarck::DegMerge<void*>(NULL, bs, &a);
+
+  bismarck::bytea deg = bismarck::DegFinal<void*>(NULL, a);
+  EXPECT_EQ(deg.len, 1501 * sizeof(uint64_t));
+  uint64_t *d = (uint64_t*) deg.str;
+  EXPECT_EQ(d[0], 1);
+  EXPECT_EQ(d[3], 2);
+  EXPECT_EQ(d[999], 1);
+  EXPECT_EQ(d[1000], 0);
+  EXPECT_EQ(d[1500], 1);
+  delete [] a.str;
+  delete [] b.str;
+  return 1;
+}
+
+/*! Run PageRank to convergence on a small graph with a dangling vertex
+ */
+int TEST_PageRank() {
+  // 0 -> 1, 0 -> 2, 1 -> 2, 2 -> 0, 3 -> 2; vertex 4 is dangling
+  uint64_t src[] = {0, 0, 1, 2, 3};
+  uint64_t dst[] = {1, 2, 2, 0, 2};
+
+  bismarck::bytea edges, deg;
+  bismarck::BismarckCSR<void*>::Init(NULL, &edges);
+  bismarck::DegInit<void*>(NULL, &deg);
+  for (int i = 0; i < 5; i++) {
+    bismarck::BismarckCSR<void*>::Step(NULL, src[i], dst[i], &edges);
+    bismarck::DegUpdate<void*>(NULL, &deg, src[i]);
+  }
+  bismarck::bytea block = bismarck::BismarckCSR<void*>::Final(NULL, edges);
+  deg = bismarck::DegFinal<void*>(NULL, deg);
+
+  double r0[5] = {0.2, 0.2, 0.2, 0.2, 0.2};
+  bismarck::bytea rank = {(char*) r0, sizeof(r0)};
+  bismarck::bytea tele = {NULL, 0};
+  double delta = 1;
+  for (int it = 0; it < 100 && delta > 1e-12; it++) {
+    bismarck::bytea st;
+    bismarck::BismarckPageRank<void*>::Init(NULL, &st);
+    bismarck::BismarckPageRank<void*>::Step(NULL, block, rank, deg, &st);
+    bismarck::bytea next =
+        bismarck::BismarckPageRank<void*>::Next(NULL, st, rank, tele, 0.85);
+    delta = bismarck::BismarckPageRank<void*>::Delta(next, rank);
+    rank = next;
+  }
+  EXPECT_EQ(delta < 1e-12, true);
+
+  double *r = DP(rank.str);
+  double total = 0;
+  for (int i = 0; i < 5; i++) total += r[i];
+  EXPECT_NEAR(total, 1.0, 1e-9);
+  // fixed point of r = 0.85 * (M r + dangling / 5) + 0.15 / 5
+  EXPECT_NEAR(r[2], (0.85 * (r[0] / 2 + r[1] + r[3] + r[4] / 5) + 0.03), 1e-9);
+  EXPECT_NEAR(r[3], (0.85 * r[4] / 5 + 0.03), 1e-9);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_CSRbuild);
+  RUNTEST(TEST_Degree);
+  RUNTEST(TEST_PageRank);
+}
@@ -0,0 +1,103 @@
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "quantile-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckQuantile<void*> Quantile;
+
+/*! Row i: feature 0 is a permutation of 0..n-1, feature 1 its negation,
+ * feature 2 is constant and missing on odd rows
+ */
+void Row(uint64_t i, uint64_t n, double *x) {
+  x[0] = (i * 7919) % n;
+  x[1] = -x[0];
+  x[2] = 5;
+}
+
+bismarck::bytea Sketch(uint64_t from, uint64_t to, uint64_t n, uint32_t k) {
+  bismarck::bytea m;
+  Quantile::Init(NULL, &m);
+  double x[3];
+  for (uint64_t i = from; i < to; i++) {
+    Row(i, n, x);
+    bismarck::bytea ex = {(char*) x, (i % 2 ? 2 : 3) * sizeof(double)};
+    Quantile::Step(NULL, ex, 4, k, &m);
+  }
+  return m;
+}
+
+/*! Fewer values than k are kept exactly
+ */
+int TEST_Quantileexact() {
+  bismarck::bytea m = Sketch(0, 100, 100, 256);
+  EXPECT_EQ(Quantile::Quantile(NULL, m, 0, 0.5), 49);
+  EXPECT_EQ(Quantile::Quantile(NULL, m, 0, 0), 0);
+  EXPECT_EQ(Quantile::Quantile(NULL, m, 0, 1), 99);
+  EXPECT_EQ(Quantile::Quantile(NULL, m, 1, 0.25), -75);
+  EXPECT_EQ(Quantile::Quantile(NULL, m, 2, 0.9), 5);
+
+  bismarck::bytea cuts = Quantile::Final(NULL, m);
+  EXPECT_EQ(cuts.len, 9 * sizeof(double));
+  EXPECT_EQ(DP(cuts.str)[0], 24);
+  EXPECT_EQ(DP(cuts.str)[1], 49);
+  EXPECT_EQ(DP(cuts.str)[2], 74);
+  return 1;
+}
+
+/*! Beyond k the ranks stay within a few percent, also across a merge
+ */
+int TEST_Quantileapprox() {
+  uint64_t n = 100000;
+  bismarck::bytea a = Sketch(0, n / 2, n, 128);
+  bismarck::bytea b = Sketch(n / 2, n, n, 128);
+  EXPECT_EQ((bismarck::QuantileHead(a)->levels > 5), true);
+  EXPECT_EQ(Quantile::Merge(NULL, b, &a), true);
+  // a sketch with another k is refused
+  bismarck::bytea c = Sketch(0, 10, 10, 64);
+  EXPECT_EQ(Quantile::Merge(NULL, c, &a), false);
+  for (int i = 1; i < 10; i++) {
+    double q = i / 10.0;
+    EXPECT_NEAR(Quantile::Quantile(NULL, a, 0, q), (q * n), (0.03 * n));
+    EXPECT_NEAR(Quantile::Quantile(NULL, a, 1, q), (-(1 - q) * n),
+                (0.03 * n));
+  }
+  EXPECT_EQ(Quantile::Quantile(NULL, a, 2, 0.5), 5);
+  return 1;
+}
+
+/*! The bin is the number of boundaries at or below the value
+ */
+int TEST_Quantilebin() {
+  double cuts[7] = {1, 2, 2, 4, 8, 9, 10};
+  for (size_t n = 0; n <= 7; n++) {
+    for (double x = 0; x <= 11; x += 0.5) {
+      size_t expect = 0;
+      for (size_t i = 0; i < n; i++) expect += cuts[i] <= x;
+      EXPECT_EQ(bismarck::QuantileBin(cuts, n, x), expect);
+    }
+  }
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Quantileexact);
+  RUNTEST(TEST_Quantileapprox);
+  RUNTEST(TEST_Quantilebin);
+}
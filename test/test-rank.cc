@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "rank-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckRank<void*> Rank;
+typedef bismarck::BismarckRankEval<void*> RankEval;
+
+/*! Rows of different queries are never paired
+ */
+int TEST_Rankqueries() {
+  double exa[2][2] = {{1, 0}, {0, 1}};
+  bismarck::bytea empty = {NULL, 0};
+  bismarck::bytea m;
+  Rank::Init(NULL, &m);
+  for (int q = 0; q < 2; q++) {
+    bismarck::bytea ex = {(char*) exa[q], 2 * sizeof(double)};
+    Rank::Step(NULL, empty, q, ex, q, 0.5, 0.0, bismarck::RANK_HINGE, 100, &m);
+  }
+  Rank::Flush(NULL, &m);
+  bismarck::bytea model = Rank::Final(m);
+  EXPECT_EQ(DP(model.str)[0], 0);
+  EXPECT_EQ(DP(model.str)[1], 0);
+
+  // one pair in one query: the hinge step moves the model by step * (xi - xj)
+  Rank::Init(NULL, &m);
+  for (int i = 0; i < 2; i++) {
+    bismarck::bytea ex = {(char*) exa[i], 2 * sizeof(double)};
+    Rank::Step(NULL, empty, 7, ex, i, 0.5, 0.0, bismarck::RANK_HINGE, 100, &m);
+  }
+  Rank::Flush(NULL, &m);
+  model = Rank::Final(m);
+  EXPECT_EQ(DP(model.str)[0], -0.5);
+  EXPECT_EQ(DP(model.str)[1], 0.5);
+  return 1;
+}
+
+/*! The relevance is the first feature, the second one is noise: both losses
+ * learn to rank by the first feature, with and without pair sampling
+ */
+int TEST_Ranklearn() {
+  bismarck::bytea empty = {NULL, 0};
+  for (int loss = 0; loss < 2; loss++) {
+    for (int max_pairs = 5; max_pairs <= 1000; max_pairs += 995) {
+      bismarck::bytea m, e;
+      Rank::Init(NULL, &m);
+      RankEval::Init(NULL, &e);
+      uint64_t r = 1;
+      for (int q = 0; q < 200; q++) {
+        for (int i = 0; i < 10; i++) {
+          r = bismarck::RankMix(r);
+          double ex[2] = {static_cast<double>(i % 3),
+                          static_cast<double>(r % 1000) / 500.0};
+          bismarck::bytea v = {(char*) ex, 2 * sizeof(double)};
+          Rank::Step(NULL, empty, q, v, i % 3, 0.05, 0.0, loss, max_pairs, &m);
+        }
+      }
+      Rank::Flush(NULL, &m);
+      bismarck::bytea model = Rank::Final(m);
+      EXPECT_EQ(DP(model.str)[0] > 10 * std::abs(DP(model.str)[1]), true);
+
+      for (int i = 0; i < 10; i++) {
+        r = bismarck::RankMix(r);
+        double ex[2] = {static_cast<double>(i % 3),
+                        static_cast<double>(r % 1000) / 500.0};
+        bismarck::bytea v = {(char*) ex, 2 * sizeof(double)};
+        RankEval::Step(NULL, 0, bismarck::RankScore(model, v), i % 3,
+                       bismarck::RANK_NDCG, 0, &e);
+      }
+      EXPECT_NEAR(RankEval::Final(NULL, &e), 1.0, 1e-12);
+    }
+  }
+  return 1;
+}
+
+/*! Merging weights the models by the queries they were trained on
+ */
+int TEST_Rankmerge() {
+  double exa[2][1] = {{1}, {0}};
+  bismarck::bytea empty = {NULL, 0};
+  bismarck::bytea a, b;
+  Rank::Init(NULL, &a);
+  Rank::Init(NULL, &b);
+  for (int q = 0; q < 3; q++) {
+    for (int i = 0; i < 2; i++) {
+      bismarck::bytea ex = {(char*) exa[i], sizeof(double)};
+      // a learns the pairs, b only sees ties
+      Rank::Step(NULL, empty, q, ex, 1 - i, 0.25, 0.0, bismarck::RANK_HINGE,
+                 100, &a);
+      Rank::Step(NULL, empty, q, ex, 0, 0.25, 0.0, bismarck::RANK_HINGE, 100,
+                 &b);
+    }
+  }
+  // b keeps its last query buffered, a is flushed as if serialized
+  Rank::Flush(NULL, &a);
+  EXPECT_EQ(DP(Rank::Final(a).str)[0], 0.75);
+  Rank::Merge(NULL, b, &a);
+  EXPECT_EQ(DP(Rank::Final(a).str)[0], 0.375);
+  return 1;
+}
+
+/*! One relevant row among 1000 ties: every sampled pair is one of the 999
+ * pairs of that row, so the hinge steps add up exactly
+ */
+int TEST_Ranksample() {
+  bismarck::bytea empty = {NULL, 0};
+  bismarck::bytea m;
+  Rank::Init(NULL, &m);
+  for (int i = 0; i < 1000; i++) {
+    double ex[2] = {i == 500 ? 1.0 : 0.0, i == 500 ? 0.0 : 1.0};
+    bismarck::bytea v = {(char*) ex, 2 * sizeof(double)};
+    Rank::Step(NULL, empty, 3, v, i == 500, 0.01, 0.0, bismarck::RANK_HINGE,
+               10, &m);
+  }
+  Rank::Flush(NULL, &m);
+  bismarck::bytea model = Rank::Final(m);
+  EXPECT_NEAR(DP(model.str)[0], 0.1, 1e-12);
+  EXPECT_NEAR(DP(model.str)[1], -0.1, 1e-12);
+  return 1;
+}
+
+/*! NDCG and MAP of hand-computed rankings
+ */
+int TEST_Rankeval() {
+  double scores[3] = {3, 2, 1};
+  double labels[3] = {0, 1, 2};
+  for (int metric = 0; metric < 2; metric++) {
+    bismarck::bytea a, b;
+    RankEval::Init(NULL, &a);
+    RankEval::Init(NULL, &b);
+    // query 1 is reversed, query 2 is perfect, query 3 has no relevant row
+    for (int i = 0; i < 3; i++) {
+      RankEval::Step(NULL, 1, scores[i], labels[i], metric, 0, &a);
+    }
+    for (int i = 0; i < 3; i++) {
+      RankEval::Step(NULL, 2, scores[i], labels[2 - i], metric, 0, &b);
+    }
+    for (int i = 0; i < 3; i++) {
+      RankEval::Step(NULL, 3, scores[i], 0, metric, 0, &b);
+    }
+    RankEval::Merge(NULL, b, &a);
+    double first = metric == bismarck::RANK_MAP ? (0.5 + 2.0 / 3) / 2 :
+        (1 / std::log2(3.0) + 3 / 2.0) / (3 + 1 / std::log2(3.0));
+    EXPECT_NEAR(RankEval::Final(NULL, &a), ((first + 1) / 2), 1e-12);
+  }
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Rankqueries);
+  RUNTEST(TEST_Ranklearn);
+  RUNTEST(TEST_Rankmerge);
+  RUNTEST(TEST_Ranksample);
+  RUNTEST(TEST_Rankeval);
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "score-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckScore<void*> Score;
+
+static double w[5] = {0.5, -1, 0, 2, 0.25};
+static const bismarck::bytea kModel = {(char*) w, sizeof(w)};
+
+/*! Row i, its id is a permutation of i so the rows arrive out of order
+ */
+int64_t Row(int i, double *x) {
+  for (int j = 0; j < 5; j++) x[j] = ((i * 7 + j * 3) % 11) - 5;
+  return (i * 389) % 1201;
+}
+
+double Dot(const double *x) {
+  double s = 0;
+  for (int j = 0; j < 5; j++) s += w[j] * x[j];
+  return s;
+}
+
+/*! Scores over several blocks and a partial one match row at a time
+ * scoring, and come out ordered by id
+ */
+int TEST_Scoreblocks() {
+  EXPECT_EQ(bismarck::ScoreBlockRows(5), 512);
+  bismarck::bytea m;
+  Score::Init(NULL, &m);
+  double x[5];
+  for (int i = 0; i < 1201; i++) {
+    int64_t id = Row(i, x);
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    Score::Step(NULL, kModel, id, ex, bismarck::SCORE_LINEAR, &m);
+  }
+  EXPECT_EQ(bismarck::ScoreHead(m)->nscored, 1024);
+
+  bismarck::bytea scores = Score::Final(NULL, &m);
+  EXPECT_EQ(scores.len, 1201 * sizeof(bismarck::ScorePair));
+  const bismarck::ScorePair *p =
+      reinterpret_cast<const bismarck::ScorePair*>(scores.str);
+  for (int i = 0; i < 1201; i++) {
+    int64_t id = Row(i, x);
+    EXPECT_EQ(p[id].id, id);
+    EXPECT_NEAR(p[id].score, Dot(x), 1e-12);
+  }
+  return 1;
+}
+
+/*! Short examples are padded with zeros, links apply to the margin
+ */
+int TEST_Scorelink() {
+  double x[2] = {2, 1};
+  bismarck::bytea ex = {(char*) x, sizeof(x)};
+  bismarck::bytea a, b;
+  Score::Init(NULL, &a);
+  Score::Init(NULL, &b);
+  Score::Step(NULL, kModel, 7, ex, bismarck::SCORE_LOGISTIC, &a);
+  Score::Step(NULL, kModel, 7, ex, bismarck::SCORE_SIGN, &b);
+  double s;
+  EXPECT_EQ(bismarck::ScoreLookup(Score::Final(NULL, &a), 7, &s), true);
+  EXPECT_NEAR(s, 0.5, 1e-12);
+  EXPECT_EQ(bismarck::ScoreLookup(Score::Final(NULL, &b), 7, &s), true);
+  EXPECT_EQ(s, 0);
+  EXPECT_EQ(bismarck::ScoreLookup(Score::Final(NULL, &b), 8, &s), false);
+  return 1;
+}
+
+/*! Merging takes the scored pairs and scores the block of src
+ */
+int TEST_Scoremerge() {
+  bismarck::bytea a, b;
+  Score::Init(NULL, &a);
+  Score::Init(NULL, &b);
+  double x[5];
+  for (int i = 0; i < 600; i++) {
+    int64_t id = Row(i, x);
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    Score::Step(NULL, kModel, id, ex, bismarck::SCORE_LINEAR,
+                i % 3 == 0 ? &a : &b);
+  }
+  Score::Flush(NULL, &a);
+  EXPECT_EQ(a.len, (sizeof(bismarck::ScoreHeader) +
+                    200 * sizeof(bismarck::ScorePair)));
+  Score::Merge(NULL, b, &a);
+  bismarck::bytea scores = Score::Final(NULL, &a);
+  EXPECT_EQ(scores.len, 600 * sizeof(bismarck::ScorePair));
+  for (int i = 0; i < 600; i++) {
+    int64_t id = Row(i, x);
+    double s;
+    EXPECT_EQ(bismarck::ScoreLookup(scores, id, &s), true);
+    EXPECT_NEAR(s, Dot(x), 1e-12);
+  }
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Scoreblocks);
+  RUNTEST(TEST_Scorelink);
+  RUNTEST(TEST_Scoremerge);
+}
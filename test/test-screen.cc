@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "screen-inl.h"
+
+
+using namespace hazy;
+
+typedef bismarck::BismarckScreen<void*> Screen;
+
+/*! The p-value against the closed forms of 1 and 2 degrees of freedom,
+ * and the normal limit
+ */
+int TEST_Screenpvalue() {
+  double ts[] = {0, 0.3, 1, 2.5, 10, -4};
+  for (size_t i = 0; i < sizeof(ts) / sizeof(ts[0]); i++) {
+    double t = fabs(ts[i]);
+    EXPECT_NEAR(bismarck::ScreenTPValue(ts[i], 1), (1 - 2 / M_PI * atan(t)),
+                1e-12);
+    EXPECT_NEAR(bismarck::ScreenTPValue(ts[i], 2), (1 - t / sqrt(2 + t * t)),
+                1e-12);
+    EXPECT_NEAR(bismarck::ScreenTPValue(ts[i], 1e7), erfc(t / sqrt(2)), 1e-6);
+  }
+  EXPECT_EQ(std::isnan(bismarck::ScreenTPValue(1, 0)), true);
+  return 1;
+}
+
+/*! Feature j of row i, feature 0 is the label plus noise, 3 is constant
+ */
+double Feature(int i, int j) {
+  double noise = ((i * 7919 + j * 104729) % 1000) / 1000.0 - 0.5;
+  switch (j) {
+    case 0: return (i % 2) + noise;
+    case 3: return 2;
+    default: return noise * j;
+  }
+}
+
+/*! Correlation and t against a direct computation, and the pooled
+ * two-sample t-test of a 0/1 label
+ */
+int TEST_Screendense() {
+  const int n = 500, p = 5;
+  bismarck::bytea m;
+  Screen::Init(NULL, &m);
+  double x[p];
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < p; j++) x[j] = Feature(i, j);
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    Screen::Step(NULL, ex, i % 2, &m);
+  }
+  bismarck::bytea r = Screen::Final(NULL, m);
+  EXPECT_EQ(r.len, 4 * p * sizeof(double));
+  const double *s = DP(r.str);
+  for (int j = 0; j < p; j++) {
+    if (j == 3) {
+      EXPECT_EQ(std::isnan(s[4 * j]), true);
+      EXPECT_EQ(std::isnan(s[4 * j + 3]), true);
+      continue;
+    }
+    double mx = 0, my = 0;
+    for (int i = 0; i < n; i++) {
+      mx += Feature(i, j) / n;
+      my += (i % 2) / (double) n;
+    }
+    double xx = 0, yy = 0, xy = 0;
+    for (int i = 0; i < n; i++) {
+      double dx = Feature(i, j) - mx, dy = (i % 2) - my;
+      xx += dx * dx;
+      yy += dy * dy;
+      xy += dx * dy;
+    }
+    double corr = xy / sqrt(xx * yy);
+    EXPECT_NEAR(s[4 * j], corr, 1e-9);
+
+    // pooled two-sample t of class 1 against class 0
+    double m1 = 0, m0 = 0, v = 0;
+    for (int i = 0; i < n; i++) (i % 2 ? m1 : m0) += Feature(i, j) / (n / 2);
+    for (int i = 0; i < n; i++) {
+      double d = Feature(i, j) - (i % 2 ? m1 : m0);
+      v += d * d / (n - 2);
+    }
+    double t = (m1 - m0) / sqrt(v * (2.0 / (n / 2)));
+    EXPECT_NEAR(s[4 * j + 1], t, 1e-6 * (1 + fabs(t)));
+    EXPECT_NEAR(s[4 * j + 2], t * t, 1e-6 * (1 + t * t));
+  }
+  // the label feature is significant, the noise is not
+  EXPECT_EQ((s[3] < 1e-10), true);
+  EXPECT_EQ((s[4 + 3] > 1e-3), true);
+  delete [] r.str;
+  delete [] m.str;
+  return 1;
+}
+
+/*! Sparse rows, dense rows and merged states agree
+ */
+int TEST_Screensparse() {
+  const int n = 300;
+  bismarck::bytea dense, a, b, c;
+  Screen::Init(NULL, &dense);
+  Screen::Init(NULL, &a);
+  Screen::Init(NULL, &b);
+  Screen::Init(NULL, &c);
+  for (int i = 0; i < n; i++) {
+    // a row has the features i % 7 and 9, the others are zero
+    double x[10] = {0};
+    bismarck::IGDSparseEntry e[2];
+    e[0].index = i % 7;
+    e[0].value = x[i % 7] = Feature(i, 0);
+    e[1].index = 9;
+    e[1].value = x[9] = 1 + (i % 3);
+    double y = 0.5 * x[9] + Feature(i, 1);
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    bismarck::bytea sp = {(char*) e, sizeof(e)};
+    Screen::Step(NULL, ex, y, &dense);
+    Screen::StepSparse(NULL, sp, y, i < n / 3 ? &a : &b);
+  }
+  EXPECT_EQ(Screen::Merge(NULL, a, &c), true);
+  EXPECT_EQ(Screen::Merge(NULL, b, &c), true);
+  EXPECT_EQ(bismarck::ScreenHead(c)->dim, 10);
+  bismarck::bytea rd = Screen::Final(NULL, dense);
+  bismarck::bytea rs = Screen::Final(NULL, c);
+  EXPECT_EQ(rd.len, rs.len);
+  for (int k = 0; k < 40; k++) {
+    if (std::isnan(DP(rd.str)[k])) {
+      EXPECT_EQ(std::isnan(DP(rs.str)[k]), true);
+    } else {
+      EXPECT_NEAR(DP(rs.str)[k], DP(rd.str)[k],
+                  1e-6 * (1 + fabs(DP(rd.str)[k])));
+    }
+  }
+  // features 7 and 8 are never set
+  EXPECT_EQ(std::isnan(DP(rs.str)[4 * 7]), true);
+  EXPECT_EQ((DP(rs.str)[4 * 9 + 3] < 1e-10), true);
+  delete [] rd.str;
+  delete [] rs.str;
+  return 1;
+}
+
+/*! A feature far from zero screens as the same feature shifted to zero,
+ * row by row and merged in parts
+ */
+int TEST_Screenoffset() {
+  const int n = 400;
+  bismarck::bytea near, far, parts[3], merged;
+  Screen::Init(NULL, &near);
+  Screen::Init(NULL, &far);
+  Screen::Init(NULL, &merged);
+  for (int k = 0; k < 3; k++) Screen::Init(NULL, &parts[k]);
+  for (int i = 0; i < n; i++) {
+    double x[2] = {Feature(i, 0), Feature(i, 1)};
+    double y = 1e9 + (i % 2);
+    bismarck::bytea ex = {(char*) x, sizeof(x)};
+    Screen::Step(NULL, ex, i % 2, &near);
+    x[0] += 1e9;
+    x[1] += 1e9;
+    EXPECT_EQ(Screen::Step(NULL, ex, y, &far), true);
+    Screen::Step(NULL, ex, y, &parts[i % 3]);
+  }
+  for (int k = 0; k < 3; k++) {
+    EXPECT_EQ(Screen::Merge(NULL, parts[k], &merged), true);
+  }
+  bismarck::bytea rn = Screen::Final(NULL, near);
+  bismarck::bytea rf = Screen::Final(NULL, far);
+  bismarck::bytea rm = Screen::Final(NULL, merged);
+  for (int k = 0; k < 8; k++) {
+    EXPECT_EQ(std::isnan(DP(rf.str)[k]) || std::isnan(DP(rm.str)[k]), false);
+    EXPECT_NEAR(DP(rf.str)[k], DP(rn.str)[k], 1e-4 * (1 + fabs(DP(rn.str)[k])));
+    EXPECT_NEAR(DP(rm.str)[k], DP(rn.str)[k], 1e-4 * (1 + fabs(DP(rn.str)[k])));
+  }
+  EXPECT_EQ((DP(rf.str)[3] < 1e-10), true);
+  delete [] rn.str;
+  delete [] rf.str;
+  delete [] rm.str;
+  delete [] near.str;
+  delete [] far.str;
+  delete [] merged.str;
+  for (int k = 0; k < 3; k++) delete [] parts[k].str;
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Screenpvalue);
+  RUNTEST(TEST_Screendense);
+  RUNTEST(TEST_Screensparse);
+  RUNTEST(TEST_Screenoffset);
+}
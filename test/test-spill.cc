@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+#include "spill-inl.h"
+
+
+using namespace hazy;
+
+/*! A scratch directory for the spill files of this test
+ */
+void SpillHere() {
+  static char dir[] = "/tmp/bismarck-spill-test-XXXXXX";
+  static bool made = false;
+  if (!made) made = mkdtemp(dir) != NULL;
+  setenv("BISMARCK_SPILL_DIR", dir, 1);
+}
+
+/*! Raw and zero run chunks read back in order
+ */
+int TEST_Spillchunks() {
+  SpillHere();
+  bismarck::SpillFile f;
+  EXPECT_EQ(bismarck::SpillOpen(&f), true);
+
+  double dense[100], sparse[1000];
+  for (int i = 0; i < 100; i++) dense[i] = i + 0.5;
+  memset(sparse, 0, sizeof(sparse));
+  for (int i = 0; i < 1000; i += 97) sparse[i] = -i;
+  sparse[999] = 7;
+  char odd[13] = "not a double";
+
+  EXPECT_EQ(bismarck::SpillAppend(&f, (char*) dense, sizeof(dense), true),
+            true);
+  EXPECT_EQ(bismarck::SpillAppend(&f, (char*) sparse, sizeof(sparse), true),
+            true);
+  EXPECT_EQ(bismarck::SpillAppend(&f, odd, sizeof(odd), true), true);
+  EXPECT_EQ(bismarck::SpillAppend(&f, (char*) sparse, sizeof(sparse), false),
+            true);
+  EXPECT_EQ(f.chunks, 4);
+  EXPECT_EQ(f.raw, sizeof(dense) + 2 * sizeof(sparse) + sizeof(odd));
+  // the compressed copy of sparse is much smaller than the raw one
+  EXPECT_EQ((f.bytes < sizeof(dense) + sizeof(sparse) + 1000), true);
+
+  char *out = new char[f.raw];
+  EXPECT_EQ(bismarck::SpillRead(f, out), true);
+  EXPECT_EQ(memcmp(out, dense, sizeof(dense)), 0);
+  out += sizeof(dense);
+  EXPECT_EQ(memcmp(out, sparse, sizeof(sparse)), 0);
+  out += sizeof(sparse);
+  EXPECT_EQ(memcmp(out, odd, sizeof(odd)), 0);
+  out += sizeof(odd);
+  EXPECT_EQ(memcmp(out, sparse, sizeof(sparse)), 0);
+
+  bismarck::SpillClose(&f);
+  EXPECT_EQ(f.fd, -1);
+  return 1;
+}
+
+/*! Only zeros, and no chunks at all
+ */
+int TEST_Spillempty() {
+  SpillHere();
+  bismarck::SpillFile f;
+  EXPECT_EQ(bismarck::SpillOpen(&f), true);
+  double x[2] = {0, 0};
+  EXPECT_EQ(bismarck::SpillRead(f, (char*) x), true);
+  EXPECT_EQ(bismarck::SpillAppend(&f, (char*) x, sizeof(x), true), true);
+  EXPECT_EQ(f.bytes, sizeof(bismarck::SpillChunkHeader) +
+            sizeof(bismarck::SpillRun));
+  x[1] = 3;
+  EXPECT_EQ(bismarck::SpillRead(f, (char*) x), true);
+  EXPECT_EQ(x[1], 0);
+  bismarck::SpillClose(&f);
+  return 1;
+}
+
+int TEST_Spilldisabled() {
+  unsetenv("BISMARCK_SPILL_DIR");
+  bismarck::SpillFile f;
+  EXPECT_EQ(bismarck::SpillOpen(&f), false);
+  EXPECT_EQ(bismarck::SpillAppend(&f, "x", 1, false), false);
+  return 1;
+}
+
+/*! Cancelled queries leave their files open, so the files are bounded
+ */
+int TEST_Spillmaxopen() {
+  SpillHere();
+  bismarck::SpillFile f[bismarck::kSpillMaxOpen + 1];
+  for (int i = 0; i < bismarck::kSpillMaxOpen; i++) {
+    EXPECT_EQ(bismarck::SpillOpen(&f[i]), true);
+  }
+  EXPECT_EQ(bismarck::SpillOpenFiles(), bismarck::kSpillMaxOpen);
+  EXPECT_EQ(bismarck::SpillOpen(&f[bismarck::kSpillMaxOpen]), false);
+  bismarck::SpillClose(&f[0]);
+  EXPECT_EQ(bismarck::SpillOpen(&f[bismarck::kSpillMaxOpen]), true);
+  for (int i = 1; i <= bismarck::kSpillMaxOpen; i++) {
+    bismarck::SpillClose(&f[i]);
+  }
+  EXPECT_EQ(bismarck::SpillOpenFiles(), 0);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Spillchunks);
+  RUNTEST(TEST_Spillempty);
+  RUNTEST(TEST_Spilldisabled);
+  RUNTEST(TEST_Spillmaxopen);
+  SpillHere();
+  rmdir(getenv("BISMARCK_SPILL_DIR"));
+}
@@ -0,0 +1,364 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "madport/port-dbconnector-inl.h"
+#include "test-macros.h"
+
+// MADlib includes; the UDFs are declared once, the headers declaring them
+// are included again by every .cpp
+#include "dbconnector/dbconnector.hpp"
+#include "modules/prob/boost.hpp"
+#include "modules/prob/kolmogorov.hpp"
+#include "modules/stats/chi_squared_test.hpp"
+#include "modules/stats/mann_whitney_test.hpp"
+#include "modules/stats/wilcoxon_signed_rank_test.hpp"
+#include "modules/stats/kolmogorov_smirnov_test.hpp"
+#undef DECLARE_UDF
+#define DECLARE_UDF(_module, _name)
+#include "modules/prob/kolmogorov.cpp"
+#include "modules/stats/chi_squared_test.cpp"
+#include "modules/stats/mann_whitney_test.cpp"
+#include "modules/stats/wilcoxon_signed_rank_test.cpp"
+#include "modules/stats/kolmogorov_smirnov_test.cpp"
+
+using namespace madlib;
+using namespace madlib::modules::stats;
+using namespace std;
+
+/* A state of the aggregates, n doubles that start as zeros like the
+ * initial condition; merged states are lists of runs and grow
+ */
+struct StatsState {
+  vector<double> v;
+  ArrayType arr;
+  StatsState(size_t len) : v(len, 0.) { }
+  // states are copied, so the array is made where it is used
+  AnyType Any() {
+    arr = port::dbconn::MakeArray(&v[0], v.size());
+    return MutableArrayHandle<double>(&arr);
+  }
+};
+
+/* Runs f on args and copies the state it returns into st
+ */
+template <class UDF>
+void StatsRun(AnyType &args, StatsState *st) {
+  UDF f;
+  AnyType r = f.run(args);
+  ArrayHandle<double> h = r.getAs<ArrayHandle<double> >();
+  if (h.ptr() != &st->v[0]) st->v.assign(h.ptr(), h.ptr() + h.size());
+}
+
+/* Merges b into a, in the given order
+ */
+template <class UDF>
+void StatsMerge(StatsState *a, StatsState *b) {
+  AnyType args;
+  args << a->Any() << b->Any();
+  StatsRun<UDF>(args, a);
+}
+
+/* The double fields of the result of the final function
+ */
+template <class UDF>
+vector<double> StatsFinal(StatsState *st, const vector<int> &fields) {
+  UDF f;
+  AnyType args;
+  args << st->Any();
+  AnyType r = f.run(args);
+  vector<double> out;
+  for (size_t i = 0; i < fields.size(); i++)
+    out.push_back(r[fields[i]].getAs<double>());
+  return out;
+}
+
+/* Merges the parts in every order, folding them one by one and, for four
+ * parts, pairwise; each must give the result of a single run
+ */
+template <class Merge, class Final>
+int StatsCheckMerges(const vector<StatsState> &parts,
+                     const vector<double> &all, const vector<int> &fields) {
+  vector<size_t> perm;
+  for (size_t i = 0; i < parts.size(); i++) perm.push_back(i);
+  do {
+    StatsState seq = parts[perm[0]];
+    for (size_t i = 1; i < perm.size(); i++) {
+      StatsState b = parts[perm[i]];
+      StatsMerge<Merge>(&seq, &b);
+    }
+    vector<double> r = StatsFinal<Final>(&seq, fields);
+    for (size_t i = 0; i < r.size(); i++) EXPECT_NEAR(r[i], all[i], 1e-9);
+    if (perm.size() == 4) {
+      StatsState a = parts[perm[0]], b = parts[perm[1]];
+      StatsState c = parts[perm[2]], d = parts[perm[3]];
+      StatsMerge<Merge>(&a, &b);
+      StatsMerge<Merge>(&c, &d);
+      StatsMerge<Merge>(&a, &c);
+      r = StatsFinal<Final>(&a, fields);
+      for (size_t i = 0; i < r.size(); i++) EXPECT_NEAR(r[i], all[i], 1e-9);
+    }
+  } while (next_permutation(perm.begin(), perm.end()));
+  return 1;
+}
+
+/* The cuts of the splits into two, three and four parts that are checked;
+ * most cut a group of ties, some leave a part empty
+ */
+vector<vector<size_t> > StatsCuts(size_t n) {
+  vector<vector<size_t> > cuts;
+  for (size_t k = 0; k <= n; k++) cuts.push_back(vector<size_t>(1, k));
+  for (size_t k = 0; k + 5 <= n; k += 5) {
+    vector<size_t> c;
+    c.push_back(k);
+    c.push_back(k + 5);
+    cuts.push_back(c);
+    c.push_back(k + 5 + (n - k - 5) / 2);
+    cuts.push_back(c);
+  }
+  vector<size_t> empty(3, n / 2);
+  cuts.push_back(empty);
+  return cuts;
+}
+
+/* Two samples with many ties, in ascending order of the values
+ */
+vector<pair<double, bool> > StatsSamples() {
+  vector<pair<double, bool> > rows;
+  for (int i = 0; i < 40; i++) {
+    rows.push_back(make_pair(double((i * 7) % 13), i % 3 == 0));
+  }
+  sort(rows.begin(), rows.end());
+  return rows;
+}
+
+StatsState MWRun(const vector<pair<double, bool> > &rows, size_t from,
+                 size_t to) {
+  StatsState st(10);
+  for (size_t i = from; i < to; i++) {
+    AnyType args;
+    args << st.Any() << rows[i].second << rows[i].first;
+    StatsRun<mw_test_transition>(args, &st);
+  }
+  return st;
+}
+
+/* Every split of the sorted rows into runs, merged in any order, gives the
+ * result of a single run
+ */
+int TEST_MWmerge() {
+  vector<pair<double, bool> > rows = StatsSamples();
+  vector<int> fields;
+  for (int i = 0; i < 4; i++) fields.push_back(i);
+  StatsState all = MWRun(rows, 0, rows.size());
+  vector<double> expected = StatsFinal<mw_test_final>(&all, fields);
+  vector<vector<size_t> > cuts = StatsCuts(rows.size());
+  for (size_t c = 0; c < cuts.size(); c++) {
+    vector<StatsState> parts;
+    for (size_t i = 0; i <= cuts[c].size(); i++) {
+      parts.push_back(MWRun(rows, i ? cuts[c][i - 1] : 0,
+                            i < cuts[c].size() ? cuts[c][i] : rows.size()));
+    }
+    if (!StatsCheckMerges<mw_test_merge_states, mw_test_final>(
+            parts, expected, fields))
+      return 0;
+  }
+  return 1;
+}
+
+StatsState WSRRun(const vector<double> &values, size_t from, size_t to) {
+  StatsState st(13);
+  for (size_t i = from; i < to; i++) {
+    AnyType args;
+    args << st.Any() << values[i] << 0.0;
+    StatsRun<wsr_test_transition>(args, &st);
+  }
+  return st;
+}
+
+bool WSRAbsLess(double a, double b) {
+  return fabs(a) < fabs(b);
+}
+
+int TEST_WSRmerge() {
+  vector<double> values;
+  for (int i = 0; i < 40; i++) values.push_back((i * 7) % 13 - 6.0);
+  stable_sort(values.begin(), values.end(), WSRAbsLess);
+  // the statistic, the rank sums and the z statistic; the count is an int
+  vector<int> fields;
+  fields.push_back(0);
+  fields.push_back(1);
+  fields.push_back(2);
+  fields.push_back(4);
+  StatsState all = WSRRun(values, 0, values.size());
+  vector<double> expected = StatsFinal<wsr_test_final>(&all, fields);
+  vector<vector<size_t> > cuts = StatsCuts(values.size());
+  for (size_t c = 0; c < cuts.size(); c++) {
+    vector<StatsState> parts;
+    for (size_t i = 0; i <= cuts[c].size(); i++) {
+      parts.push_back(WSRRun(values, i ? cuts[c][i - 1] : 0,
+                             i < cuts[c].size() ? cuts[c][i] : values.size()));
+    }
+    if (!StatsCheckMerges<wsr_test_merge_states, wsr_test_final>(
+            parts, expected, fields))
+      return 0;
+  }
+  return 1;
+}
+
+StatsState KSRun(const vector<pair<double, bool> > &rows, size_t from,
+                 size_t to, int64_t n0, int64_t n1) {
+  StatsState st(12);
+  for (size_t i = from; i < to; i++) {
+    AnyType args;
+    args << st.Any() << rows[i].second << rows[i].first << n0 << n1;
+    StatsRun<ks_test_transition>(args, &st);
+  }
+  return st;
+}
+
+int TEST_KSmerge() {
+  vector<pair<double, bool> > rows = StatsSamples();
+  int64_t n0 = 0, n1 = 0;
+  for (size_t i = 0; i < rows.size(); i++) (rows[i].second ? n0 : n1)++;
+  vector<int> fields;
+  for (int i = 0; i < 3; i++) fields.push_back(i);
+  StatsState all = KSRun(rows, 0, rows.size(), n0, n1);
+  vector<double> expected = StatsFinal<ks_test_final>(&all, fields);
+  EXPECT_EQ((expected[0] > 0), true);
+  vector<vector<size_t> > cuts = StatsCuts(rows.size());
+  for (size_t c = 0; c < cuts.size(); c++) {
+    vector<StatsState> parts;
+    for (size_t i = 0; i <= cuts[c].size(); i++) {
+      parts.push_back(KSRun(rows, i ? cuts[c][i - 1] : 0,
+                            i < cuts[c].size() ? cuts[c][i] : rows.size(),
+                            n0, n1));
+    }
+    if (!StatsCheckMerges<ks_test_merge_states, ks_test_final>(
+            parts, expected, fields))
+      return 0;
+  }
+  return 1;
+}
+
+/* Runs whose ranges overlap cannot be merged; the final function finds out
+ */
+int TEST_Statsoverlap() {
+  vector<pair<double, bool> > rows = StatsSamples();
+  StatsState a = MWRun(rows, 0, 30), b = MWRun(rows, 10, 40);
+  StatsMerge<mw_test_merge_states>(&a, &b);
+  EXPECT_EQ(a.v.size(), 20);
+  bool thrown = false;
+  try {
+    StatsFinal<mw_test_final>(&a, vector<int>(1, 0));
+  } catch (const std::invalid_argument &e) {
+    thrown = true;
+  }
+  EXPECT_EQ(thrown, true);
+  return 1;
+}
+
+/* Observations (a, b, count) of the test of independence
+ */
+struct Chi2Obs {
+  int64_t a, b, count;
+};
+
+StatsState Chi2Run(const vector<Chi2Obs> &obs, size_t from, size_t to) {
+  StatsState st(3);
+  for (size_t i = from; i < to; i++) {
+    AnyType args;
+    args << st.Any() << obs[i].a << obs[i].b << obs[i].count;
+    StatsRun<chi2_indep_test_transition>(args, &st);
+  }
+  return st;
+}
+
+/* Pearson's statistic of the dense table, the same pair may occur more
+ * than once
+ */
+double Chi2Dense(const vector<Chi2Obs> &obs, int rows, int cols) {
+  vector<double> table(rows * cols, 0.), row(rows, 0.), col(cols, 0.);
+  double n = 0;
+  for (size_t i = 0; i < obs.size(); i++) {
+    table[obs[i].a * cols + obs[i].b] += obs[i].count;
+    row[obs[i].a] += obs[i].count;
+    col[obs[i].b] += obs[i].count;
+    n += obs[i].count;
+  }
+  double x = 0;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      double e = row[i] * col[j] / n;
+      x += (table[i * cols + j] - e) * (table[i * cols + j] - e) / e;
+    }
+  }
+  return x;
+}
+
+/* A 2x2 table: the expected counts are 12, 18, 28 and 42, so Pearson's
+ * statistic is 4 (1/12 + 1/18 + 1/28 + 1/42) = 200/252
+ */
+int TEST_Chi2indep() {
+  vector<Chi2Obs> obs;
+  Chi2Obs o[] = {{0, 0, 10}, {0, 1, 20}, {1, 0, 30}, {1, 1, 40}};
+  obs.assign(o, o + 4);
+  StatsState st = Chi2Run(obs, 0, obs.size());
+  AnyType args;
+  args << st.Any();
+  chi2_indep_test_final f;
+  AnyType r = f.run(args);
+  double x = 200. / 252.;
+  EXPECT_NEAR(r[0].getAs<double>(), x, 1e-12);
+  EXPECT_NEAR(r[0].getAs<double>(), Chi2Dense(obs, 2, 2), 1e-12);
+  // one degree of freedom, the p-value is erfc(sqrt(x / 2))
+  EXPECT_NEAR(r[1].getAs<double>(), erfc(sqrt(x / 2)), 1e-12);
+  EXPECT_EQ(r[2].getAs<int64_t>(), 1);
+  EXPECT_NEAR(r[3].getAs<double>(), 0.8043486460964835, 1e-12);
+  EXPECT_NEAR(r[5].getAs<double>(), sqrt(x / 100), 1e-12);
+  return 1;
+}
+
+/* More pairs than half of the initial 64 slots, some seen twice, and the
+ * same rows split in three and merged in every order; the 77 pairs grow
+ * the table twice, past 32 and past 64 pairs
+ */
+int TEST_Chi2indepgrow() {
+  vector<Chi2Obs> obs;
+  for (int i = 0; i < 90; i++) {
+    Chi2Obs o = {(i * 5) % 11, (i * 3) % 7, 1 + i % 4};
+    obs.push_back(o);
+  }
+  StatsState all = Chi2Run(obs, 0, obs.size());
+  EXPECT_EQ(all.v[1], 256);
+  // all 77 pairs of the 11 x 7 table occur
+  EXPECT_EQ(all.v[2], 77);
+  EXPECT_EQ(all.v.size(), 3 + 3 * 256);
+  vector<int> fields;
+  fields.push_back(0);
+  fields.push_back(3);
+  fields.push_back(5);
+  vector<double> expected = StatsFinal<chi2_indep_test_final>(&all, fields);
+  EXPECT_NEAR(expected[0], Chi2Dense(obs, 11, 7), 1e-9);
+
+  vector<StatsState> parts;
+  parts.push_back(Chi2Run(obs, 0, 20));
+  parts.push_back(Chi2Run(obs, 20, 70));
+  parts.push_back(Chi2Run(obs, 70, 90));
+  parts.push_back(Chi2Run(obs, 90, 90));
+  return StatsCheckMerges<chi2_indep_test_merge_states,
+                          chi2_indep_test_final>(parts, expected, fields);
+}
+
+int main(int argc, char** argv) {
+  RUNTEST(TEST_MWmerge);
+  RUNTEST(TEST_WSRmerge);
+  RUNTEST(TEST_KSmerge);
+  RUNTEST(TEST_Statsoverlap);
+  RUNTEST(TEST_Chi2indep);
+  RUNTEST(TEST_Chi2indepgrow);
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "strata-inl.h"
+
+
+using namespace hazy;
+
+bismarck::bytea Key(const char *s) {
+  bismarck::bytea b = {(char*) s, strlen(s)};
+  return b;
+}
+
+/*! Small strata are kept whole, large ones are capped at k
+ */
+int TEST_Stratacap() {
+  bismarck::bytea m;
+  bismarck::BismarckStrata<void*>::Init(NULL, &m);
+  // enough strata to grow the table and the reservoirs
+  char key[16];
+  for (int s = 0; s < 500; s++) {
+    sprintf(key, "s%d", s);
+    for (int i = 0; i <= s % 5; i++) {
+      bismarck::BismarckStrata<void*>::Step(NULL, Key(key), s * 100 + i, 1.0,
+                                            3, 7, &m);
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    bismarck::BismarckStrata<void*>::Step(NULL, Key("big"), 100000 + i, 1.0,
+                                          3, 7, &m);
+  }
+
+  bismarck::bytea sample = bismarck::BismarckStrata<void*>::Final(NULL, m);
+  size_t n = 0;
+  for (int s = 0; s < 500; s++) n += std::min(s % 5 + 1, 3);
+  EXPECT_EQ(sample.len / (2 * sizeof(uint64_t)), n + 3);
+  EXPECT_EQ(bismarck::StrataContains(sample, Key("s1"), 100), true);
+  EXPECT_EQ(bismarck::StrataContains(sample, Key("s1"), 101), true);
+  EXPECT_EQ(bismarck::StrataContains(sample, Key("s2"), 101), false);
+  return 1;
+}
+
+/*! Merging two halves gives the sample of the whole, and weights matter
+ */
+int TEST_Stratamerge() {
+  bismarck::bytea whole, a, b;
+  bismarck::BismarckStrata<void*>::Init(NULL, &whole);
+  bismarck::BismarckStrata<void*>::Init(NULL, &a);
+  bismarck::BismarckStrata<void*>::Init(NULL, &b);
+  for (int i = 0; i < 200; i++) {
+    const char *key = (i % 2) ? "odd" : "even";
+    // ids 0 and 1 are much heavier than the rest
+    double w = i < 2 ? 1e6 : 1.0;
+    bismarck::BismarckStrata<void*>::Step(NULL, Key(key), i, w, 4, 1, &whole);
+    bismarck::BismarckStrata<void*>::Step(NULL, Key(key), i, w, 4, 1,
+                                          i < 77 ? &a : &b);
+  }
+  bismarck::BismarckStrata<void*>::Merge(NULL, b, &a);
+
+  bismarck::bytea s1 = bismarck::BismarckStrata<void*>::Final(NULL, whole);
+  bismarck::bytea s2 = bismarck::BismarckStrata<void*>::Final(NULL, a);
+  EXPECT_EQ(s1.len, 8 * 2 * sizeof(uint64_t));
+  EXPECT_EQ(s2.len, s1.len);
+  EXPECT_EQ(memcmp(s1.str, s2.str, s1.len), 0);
+  EXPECT_EQ(bismarck::StrataContains(s1, Key("even"), 0), true);
+  EXPECT_EQ(bismarck::StrataContains(s1, Key("odd"), 1), true);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Stratacap);
+  RUNTEST(TEST_Stratamerge);
+}
@@ -9,6 +9,7 @@ T* BismarckAllocate(void* ignore, size_t len) {
 }
 
 #include "svm-inl.h"
+#include "downsample-inl.h"
 
 
 using namespace hazy;
@@ -75,9 +76,56 @@ int TEST_SVMpred() {
   return 1;
 }
 
+/*! Negative downsampling keeps all positives and about rate of the
+ * negatives, and a weighted step is a scaled step
+ */
+int TEST_SVMdownsample() {
+  int kept = 0;
+  for (int64_t id = 0; id < 100000; id++) {
+    EXPECT_EQ(bismarck::DownsampleKeep(id, true, 0.1, 3), true);
+    if (bismarck::DownsampleKeep(id, false, 0.1, 3)) kept++;
+    // the same rows are kept in every pass
+    EXPECT_EQ(bismarck::DownsampleKeep(id, false, 0.1, 3),
+              bismarck::DownsampleKeep(id, false, 0.1, 3));
+  }
+  EXPECT_EQ(kept > 9700 && kept < 10300, true);
+  EXPECT_EQ(bismarck::DownsampleWeight(false, 0.1), 10);
+  EXPECT_EQ(bismarck::DownsampleWeight(true, 0.1), 1);
+
+  double exa[3] = {1, 2, 1};
+  bismarck::bytea model;
+  bismarck::BismarckSVM<void*>::Init(NULL, &model);
+  bismarck::bytea ex = {(char*)exa, 3*sizeof(double)};
+  bismarck::BismarckSVM<void*>::Step(NULL, ex, false, &model, 0.1, 0.0,
+                                     bismarck::DownsampleWeight(false, 0.5));
+  EXPECT_EQ(DP(model.str)[0], -0.2);
+  EXPECT_EQ(DP(model.str)[1], -0.4);
+  return 1;
+}
+
+/*! A large weight times the step exceeds 1 / mu, the L2 shrink then zeroes
+ * the model instead of flipping and growing it
+ */
+int TEST_SVMlargeweight() {
+  double exa[2] = {1, 1};
+  bismarck::bytea model;
+  bismarck::BismarckSVM<void*>::Init(NULL, &model);
+  bismarck::bytea ex = {(char*)exa, 2*sizeof(double)};
+  bismarck::BismarckSVM<void*>::Step(NULL, ex, true, &model, 0.1, 0.0);
+  for (int i = 0; i < 10; i++) {
+    bismarck::BismarckSVM<void*>::Step(NULL, ex, true, &model, 0.1, 0.5,
+                                       1000);
+    EXPECT_EQ(DP(model.str)[0], 0);
+    EXPECT_EQ(DP(model.str)[1], 0);
+  }
+  return 1;
+}
+
 int main() {
   RUNTEST(TEST_SVMinit);
   RUNTEST(TEST_SVMAlloc);
   RUNTEST(TEST_SVMloss);
   RUNTEST(TEST_SVMpred);
+  RUNTEST(TEST_SVMdownsample);
+  RUNTEST(TEST_SVMlargeweight);
 }
@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "test-macros.h"
+#include "linalg-inl.h"
+
+using namespace hazy;
+
+/*! The unrolled kernels agree with the plain loops, remainders included
+ */
+int TEST_Tunekernels() {
+  double x[13], y[13], z[13];
+  for (int i = 0; i < 13; i++) {
+    x[i] = i + 1;
+    y[i] = 0.5 * i;
+    z[i] = x[i];
+  }
+  double plain = unrolled_dot<1>(x, y, 13);
+  EXPECT_NEAR(unrolled_dot<4>(x, y, 13), plain, 1e-9);
+  EXPECT_NEAR(unrolled_dot<8>(x, y, 13), plain, 1e-9);
+  EXPECT_NEAR(simple_dot(x, y, 13), plain, 1e-9);
+
+  unrolled_scale_add<8>(z, y, 2.0, 13);
+  for (int i = 0; i < 13; i++) {
+    EXPECT_NEAR(z[i], (x[i] + 2.0 * y[i]), 1e-12);
+  }
+  return 1;
+}
+
+/*! The chosen parameters survive the cache file, which is ignored on
+ * another host
+ */
+int TEST_Tunecache() {
+  const KernelTuning &t = Tuning();
+  EXPECT_EQ((t.dot_unroll == 1 || t.dot_unroll == 4 || t.dot_unroll == 8), true);
+  EXPECT_EQ((t.axpy_unroll == 1 || t.axpy_unroll == 4 || t.axpy_unroll == 8),
+            true);
+
+  // without a cache file the kernels are the plain loops
+  if (getenv("HAZY_TUNE_FILE") == NULL) {
+    EXPECT_EQ(t.dot_unroll, 1);
+    EXPECT_EQ(t.axpy_unroll, 1);
+  }
+
+  char path[] = "/tmp/hazy-tune-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) return 0;
+  close(fd);
+  bool saved = TuneSave(path, t);
+  KernelTuning read;
+  bool loaded = TuneLoad(path, t.host, &read);
+  HostInfo other = t.host;
+  other.l2_bytes *= 2;
+  KernelTuning ignored;
+  bool loaded_other = TuneLoad(path, other, &ignored);
+  unlink(path);
+
+  EXPECT_EQ(saved, true);
+  EXPECT_EQ(loaded, true);
+  EXPECT_EQ(read.dot_unroll, t.dot_unroll);
+  EXPECT_EQ(read.axpy_unroll, t.axpy_unroll);
+  EXPECT_EQ(loaded_other, false);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Tunekernels);
+  RUNTEST(TEST_Tunecache);
+}
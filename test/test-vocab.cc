@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <stdint.h>
+
+#include "test-macros.h"
+#include "bismarck-common.h"
+
+template <class T>
+T* BismarckAllocate(void* ignore, size_t len) {
+  return new T[len];
+}
+
+template <class T>
+void BismarckFree(void* ignore, T* p) {
+  delete [] p;
+}
+
+#include "vocab-inl.h"
+
+
+using namespace hazy;
+
+bismarck::bytea Text(const char *s) {
+  bismarck::bytea b = {(char*) s, strlen(s)};
+  return b;
+}
+
+/*! Build a dictionary from two partial states and check the pruning
+ */
+int TEST_Vocabbuild() {
+  bismarck::bytea a, b;
+  bismarck::BismarckVocab<void*>::Init(NULL, &a);
+  bismarck::BismarckVocab<void*>::Init(NULL, &b);
+  EXPECT_EQ(a.str == NULL, true);
+
+  bismarck::BismarckVocab<void*>::Step(NULL, Text("The cat, the DOG."), 2, &a);
+  bismarck::BismarckVocab<void*>::Step(NULL, Text("a dog and a bird"), 2, &b);
+  bismarck::BismarckVocab<void*>::Merge(NULL, b, &a);
+
+  bismarck::bytea dict = bismarck::BismarckVocab<void*>::Final(NULL, a);
+  EXPECT_EQ(std::string(dict.str, dict.len), "a dog the");
+  return 1;
+}
+
+/*! Grow the state past its initial size
+ */
+int TEST_Vocabgrow() {
+  bismarck::bytea st;
+  bismarck::BismarckVocab<void*>::Init(NULL, &st);
+  char buf[32];
+  for (int i = 0; i < 5000; i++) {
+    sprintf(buf, "w%d w%d", i, i % 10);
+    bismarck::BismarckVocab<void*>::Step(NULL, Text(buf), 100, &st);
+  }
+  bismarck::bytea dict = bismarck::BismarckVocab<void*>::Final(NULL, st);
+  EXPECT_EQ(std::string(dict.str, dict.len), "w0 w1 w2 w3 w4 w5 w6 w7 w8 w9");
+  return 1;
+}
+
+/*! Turn a text into word ids and counts
+ */
+int TEST_Vocabtokenize() {
+  bismarck::bytea dict = Text("a dog the");
+  bismarck::VocabIndex idx;
+  bismarck::VocabIndexInit<void*>(NULL, dict, &idx);
+  EXPECT_EQ(idx.size, 3);
+  EXPECT_EQ(bismarck::VocabLookup(idx, "dog", 3), 1);
+  EXPECT_EQ(bismarck::VocabLookup(idx, "do", 2), -1);
+  EXPECT_EQ(bismarck::VocabLookup(idx, "zebra", 5), -1);
+
+  bismarck::bytea words, counts;
+  bismarck::VocabTokenize<void*>(NULL, idx, Text("The dog saw the cat; THE end"),
+                                 &words, &counts);
+  EXPECT_EQ(words.len, 2 * sizeof(int32_t));
+  int32_t *w = (int32_t*) words.str;
+  int32_t *c = (int32_t*) counts.str;
+  EXPECT_EQ(w[0], 1);
+  EXPECT_EQ(c[0], 1);
+  EXPECT_EQ(w[1], 2);
+  EXPECT_EQ(c[1], 3);
+  return 1;
+}
+
+int main() {
+  RUNTEST(TEST_Vocabbuild);
+  RUNTEST(TEST_Vocabgrow);
+  RUNTEST(TEST_Vocabtokenize);
+}